@@ -0,0 +1,479 @@
+/* File: bench/bench.c
+ *
+ * Benchmark harness for the core library functions (make bench).
+ *
+ * Usage: bench <corpus_dir> [--min-time <seconds>] [--compare <baseline.json>]
+ *              [--threshold <percent>]
+ *
+ * Each benchmark runs its operation until at least --min-time has elapsed
+ * (default 0.25 s) and reports, per operation:
+ *
+ *     ns_per_op        wall-clock time
+ *     bytes_per_op     bytes requested through malloc/calloc/realloc by osla
+ *                      code (the calls are redirected with ld --wrap)
+ *     allocs_per_op    number of those calls
+ *     syscalls_per_op  system calls, counted in a ptrace'd child running a
+ *                      shorter loop (null when ptrace is not permitted)
+ *
+ * Results are printed as JSON, one result object per line. With --compare,
+ * results are checked against a previous run: a slowdown beyond --threshold
+ * percent (default 10) or any growth in allocations or system calls is
+ * reported as a regression and the exit status is 1.
+ */
+
+#define _GNU_SOURCE
+
+#include "bundle.h"
+#include "db.h"
+#include "grep.h"
+#include "io.h"
+#include "license.h"
+#include "search.h"
+#include "subst.h"
+#include "template.h"
+#include "utils.h"
+#include "version.h"
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#define SAMPLE_COUNT 256
+#define SYSCALL_RUNS 64
+#define MAX_RESULTS 16
+
+/* ---- Allocation counters (see BENCH_WRAP in the Makefile) ---- */
+
+static atomic_size_t alloc_bytes;
+static atomic_size_t alloc_calls;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    atomic_fetch_add_explicit(&alloc_bytes, nmemb * size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+/* ---- Fixtures ---- */
+
+/* The default token spellings from config.c, which the corpus generator uses */
+static const SubstToken tokens[] = {
+    { "<YEAR>", SUBST_YEAR },
+    { "[yyyy]", SUBST_YEAR },
+    { "[year]", SUBST_YEAR },
+    { "<AUTHOR>", SUBST_AUTHOR },
+    { "[name of copyright owner]", SUBST_AUTHOR },
+    { "[fullname]", SUBST_AUTHOR },
+    { "<COPYRIGHT HOLDER>", SUBST_AUTHOR },
+    { "[copyright holder]", SUBST_AUTHOR },
+};
+
+static const char *const queries[] = { "warranty", "patent notice", "merchantability fitness", "zzyzx" };
+
+static struct {
+    char licenses_dir[1024];
+    char out_dir[1024];
+    Database db;
+    char **names;
+    size_t name_count;
+    char *samples[SAMPLE_COUNT];
+    size_t sample_lens[SAMPLE_COUNT];
+    size_t sample_count;
+    Subst *subst;
+    Config config;
+    TemplateSet templates;
+    Bundle bundle;
+    uint32_t *packed;       /* indexes of the bundle's packed records */
+    size_t packed_count;
+    GrepPattern grep;
+    FILE *devnull;
+    size_t alias_count;
+} fx;
+
+typedef struct {
+    const char *name;
+    void (*op)(size_t i);
+} Bench;
+
+typedef struct {
+    char name[64];
+    double ns_per_op;
+    double bytes_per_op;
+    double allocs_per_op;
+    double syscalls_per_op;     /* < 0: unavailable */
+    size_t iterations;
+} Result;
+
+static void bench_load_license(size_t i) {
+    free(load_license(fx.names[i % fx.name_count], fx.licenses_dir));
+}
+
+/* The bundle's counterpart of load_license: a lookup, served from the handle's
+ * cache of decompressed texts after the first pass
+ */
+static void bench_bundle_get(size_t i) {
+    char *owned;
+    bundle_find(&fx.bundle, BUNDLE_LICENSE, fx.names[i % fx.name_count], NULL, &owned);
+    free(owned);
+}
+
+/* A cold bundle_get: decompressing one packed text into a fresh buffer */
+static void bench_dict_decompress(size_t i) {
+    if (fx.packed_count == 0) return;
+    const BundleRecord *r = &fx.bundle.records[fx.packed[i % fx.packed_count]];
+    char *text = malloc((size_t)r->data_len + 1);
+    if (!text) return;
+    dict_decompress((const char *)fx.bundle.base + fx.bundle.header->dict_off, (size_t)fx.bundle.header->dict_len,
+                    fx.bundle.base + r->data_off, (size_t)r->packed_len, text, (size_t)r->data_len);
+    free(text);
+}
+
+static void bench_replace_placeholders(size_t i) {
+    size_t k = i % fx.sample_count;
+    free(replace_placeholders(fx.subst, fx.samples[k], fx.sample_lens[k], "2025", "Jane Roe"));
+}
+
+/* What "osla <license>" does before its one writev(): look up and fill in the slots */
+static void bench_render_template(size_t i) {
+    const TemplateEntry *t = template_find(&fx.templates, fx.names[i % fx.name_count]);
+    if (!t) return;
+    TemplateValues values;
+    template_values(&values, &fx.config, "2025", "Jane Roe");
+    struct iovec stack[64];
+    struct iovec *iov = t->op_count <= 64 ? stack : malloc(t->op_count * sizeof(*iov));
+    if (!iov) return;
+    template_iov(&fx.templates, t, &values, iov);
+    if (iov != stack) free(iov);
+}
+
+static void bench_resolve_alias(size_t i) {
+    char out[64];
+    /* Alternate hits and misses */
+    const char *input = i % 2 ? "no-such-license" : alias_map[(i / 2) % fx.alias_count].alias;
+    resolve_alias(input, out, sizeof(out));
+}
+
+/* Writes a rendered result to /dev/null in one call, as write_output() does for stdout */
+static void emit(StrBuf *out) {
+    struct iovec iov = { out->data, out->len };
+    write_iov(fileno(fx.devnull), &iov, 1);
+    sb_free(out);
+}
+
+static void bench_list_license_files(size_t i) {
+    (void)i;
+    StrBuf out = {0};
+    list_license_files(&fx.db, -1, OUTPUT_TABLE, &out);
+    emit(&out);
+}
+
+/* What search_license() does, with the output sent to /dev/null */
+static void bench_search_license(size_t i) {
+    SearchIndex idx;
+    StrBuf out = {0};
+    if (search_index_open(&idx, &fx.db) != 0) return;
+    print_search_results(&idx, queries[i % (sizeof(queries) / sizeof(queries[0]))], &fx.db, NULL, -1,
+                         OUTPUT_TABLE, 0, &out);
+    emit(&out);
+    search_index_close(&idx);
+}
+
+/* The --grep kernel over one license text, for a pattern that never matches */
+static void bench_grep_find(size_t i) {
+    size_t k = i % fx.sample_count;
+    grep_find(&fx.grep, fx.samples[k], fx.sample_lens[k]);
+}
+
+static void bench_write_to_file(size_t i) {
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/LICENSE-%zu", fx.out_dir, i % 64);
+    const char *text = fx.samples[i % fx.sample_count];
+    write_to_file(path, text, strlen(text), -1);
+}
+
+static const Bench benches[] = {
+    { "load_license", bench_load_license },
+    { "bundle_get", bench_bundle_get },
+    { "dict_decompress", bench_dict_decompress },
+    { "replace_placeholders", bench_replace_placeholders },
+    { "render_template", bench_render_template },
+    { "resolve_alias", bench_resolve_alias },
+    { "list_license_files", bench_list_license_files },
+    { "search_license", bench_search_license },
+    { "grep_find", bench_grep_find },
+    { "write_to_file", bench_write_to_file },
+};
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+static int setup(const char *corpus) {
+    snprintf(fx.licenses_dir, sizeof(fx.licenses_dir), "%s/licenses", corpus);
+    snprintf(fx.out_dir, sizeof(fx.out_dir), "%s/out", corpus);
+    if (ensure_directory_exists(fx.out_dir) != 0) return -1;
+
+    /* Keep the search index of the corpus out of the user's cache */
+    char cache[1100];
+    snprintf(cache, sizeof(cache), "%s/cache", corpus);
+    setenv("XDG_CACHE_HOME", cache, 1);
+
+    if (list_dir_stems(fx.licenses_dir, ".txt", &fx.names, &fx.name_count) != 0 || fx.name_count == 0) {
+        fprintf(stderr, "bench: no licenses in '%s'\n", fx.licenses_dir);
+        return -1;
+    }
+    db_open(&fx.db, corpus);
+    for (size_t i = 0; i < fx.name_count && fx.sample_count < SAMPLE_COUNT; i++) {
+        char *text = load_license(fx.names[i * fx.name_count / SAMPLE_COUNT % fx.name_count], fx.licenses_dir);
+        if (!text) continue;
+        fx.samples[fx.sample_count] = text;
+        fx.sample_lens[fx.sample_count++] = strlen(text);
+    }
+    fx.subst = subst_compile(tokens, sizeof(tokens) / sizeof(tokens[0]));
+    for (size_t i = 0; i < sizeof(tokens) / sizeof(tokens[0]); i++) {
+        ConfigToken *t = &fx.config.tokens[fx.config.token_count++];
+        snprintf(t->field, sizeof(t->field), "%s", tokens[i].field == SUBST_YEAR ? "year" : "author");
+        snprintf(t->text, sizeof(t->text), "%s", tokens[i].text);
+    }
+    if (template_set_open(&fx.templates, &fx.db, &fx.config) != 0) {
+        fprintf(stderr, "bench: cannot compile the templates\n");
+        return -1;
+    }
+    char bundle_path[1100];
+    snprintf(bundle_path, sizeof(bundle_path), "%s/%s", fx.out_dir, BUNDLE_FILENAME);
+    DictStats stats;
+    if (bundle_build(corpus, bundle_path, &stats) != 0 || bundle_open(&fx.bundle, bundle_path) != 0) {
+        fprintf(stderr, "bench: cannot build the bundle\n");
+        return -1;
+    }
+    dict_print_stats(&stats, "bench: bundle", stderr);
+    fx.packed = malloc((fx.bundle.header->record_count ? fx.bundle.header->record_count : 1) * sizeof(*fx.packed));
+    for (uint32_t i = 0; fx.packed && i < fx.bundle.header->record_count; i++) {
+        if (fx.bundle.records[i].packed_len) fx.packed[fx.packed_count++] = i;
+    }
+    if (grep_compile(&fx.grep, queries[3]) != 0) {
+        fprintf(stderr, "bench: cannot compile the grep pattern\n");
+        return -1;
+    }
+    fx.devnull = fopen("/dev/null", "w");
+    while (alias_map[fx.alias_count].alias) fx.alias_count++;
+    if (!fx.subst || !fx.devnull || fx.sample_count == 0 || fx.alias_count == 0) {
+        fprintf(stderr, "bench: setup failed\n");
+        return -1;
+    }
+    /* Build the search index once so search_license measures queries */
+    SearchIndex idx;
+    if (search_index_open(&idx, &fx.db) != 0) {
+        fprintf(stderr, "bench: cannot build the search index\n");
+        return -1;
+    }
+    search_index_close(&idx);
+    return 0;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Runs op runs times in a traced child and returns the system calls per run,
+ * or -1 if the child cannot be traced.
+ */
+static double count_syscalls(void (*op)(size_t), size_t runs) {
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) _exit(2);
+        raise(SIGSTOP);
+        for (size_t i = 0; i < runs; i++) op(i);
+        _exit(0);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status) ||
+        ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL)) != 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+    long entries = 0;
+    int in_call = 0;
+    while (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) == 0 && waitpid(pid, &status, 0) == pid) {
+        if (WIFEXITED(status) || WIFSIGNALED(status)) break;
+        if (WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+            if (!in_call) entries++;
+            in_call = !in_call;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    /* Not counting the final exit_group */
+    return (double)(entries - 1) / (double)runs;
+}
+
+static void run_bench(const Bench *b, double min_ns, Result *r) {
+    snprintf(r->name, sizeof(r->name), "%s", b->name);
+    b->op(0);   /* warm-up */
+    size_t iters = 1;
+    for (;;) {
+        size_t bytes0 = atomic_load(&alloc_bytes), calls0 = atomic_load(&alloc_calls);
+        double start = now_ns();
+        for (size_t i = 0; i < iters; i++) b->op(i);
+        double elapsed = now_ns() - start;
+        if (elapsed >= min_ns || iters >= ((size_t)1 << 30)) {
+            r->iterations = iters;
+            r->ns_per_op = elapsed / (double)iters;
+            r->bytes_per_op = (double)(atomic_load(&alloc_bytes) - bytes0) / (double)iters;
+            r->allocs_per_op = (double)(atomic_load(&alloc_calls) - calls0) / (double)iters;
+            break;
+        }
+        /* Aim a little past the target on the next round */
+        double scale = elapsed > 0 ? min_ns * 1.2 / elapsed : 100.0;
+        iters = (size_t)((double)iters * (scale < 2.0 ? 2.0 : scale > 100.0 ? 100.0 : scale));
+    }
+    r->syscalls_per_op = count_syscalls(b->op, r->iterations < SYSCALL_RUNS ? r->iterations : SYSCALL_RUNS);
+}
+
+static void print_results(const char *corpus, const Result *results, size_t count) {
+    printf("{\n  \"bench\": \"osla\",\n  \"version\": \"%s\",\n", OSLA_VERSION);
+    printf("  \"corpus\": {\"dir\": \"%s\", \"licenses\": %zu},\n", corpus, fx.name_count);
+    printf("  \"results\": [\n");
+    for (size_t i = 0; i < count; i++) {
+        const Result *r = &results[i];
+        printf("    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.1f, \"bytes_per_op\": %.1f, "
+               "\"allocs_per_op\": %.2f, \"syscalls_per_op\": ",
+               r->name, r->iterations, r->ns_per_op, r->bytes_per_op, r->allocs_per_op);
+        if (r->syscalls_per_op < 0) {
+            printf("null");
+        } else {
+            printf("%.2f", r->syscalls_per_op);
+        }
+        printf("}%s\n", i + 1 < count ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+/* Reads "key": <number> from a result line. Returns 0 if present and numeric. */
+static int json_number(const char *line, const char *key, double *out) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *p = strstr(line, pattern);
+    if (!p) return -1;
+    char *end;
+    *out = strtod(p + strlen(pattern), &end);
+    return end == p + strlen(pattern) ? -1 : 0;
+}
+
+/* Compares results with a baseline written by an earlier run. Returns the number of regressions. */
+static int compare(const char *baseline_path, const Result *results, size_t count, double threshold) {
+    FILE *fp = fopen(baseline_path, "r");
+    if (!fp) {
+        fprintf(stderr, "bench: cannot open baseline '%s'\n", baseline_path);
+        return -1;
+    }
+    int regressions = 0;
+    char line[1024];
+    fprintf(stderr, "%-22s %-16s %14s %14s %9s\n", "Benchmark", "Metric", "Baseline", "Current", "Change");
+    while (fgets(line, sizeof(line), fp)) {
+        const char *name = strstr(line, "\"name\": \"");
+        if (!name) continue;
+        name += strlen("\"name\": \"");
+        const char *quote = strchr(name, '"');
+        if (!quote) continue;
+        const Result *r = NULL;
+        for (size_t i = 0; i < count; i++) {
+            if (strlen(results[i].name) == (size_t)(quote - name) &&
+                strncmp(results[i].name, name, (size_t)(quote - name)) == 0) {
+                r = &results[i];
+            }
+        }
+        if (!r) continue;
+        struct { const char *key; double current; double limit_pct; } metrics[] = {
+            { "ns_per_op", r->ns_per_op, threshold },
+            { "bytes_per_op", r->bytes_per_op, 1.0 },
+            { "allocs_per_op", r->allocs_per_op, 1.0 },
+            { "syscalls_per_op", r->syscalls_per_op, 1.0 },
+        };
+        for (size_t m = 0; m < sizeof(metrics) / sizeof(metrics[0]); m++) {
+            double base;
+            if (json_number(line, metrics[m].key, &base) != 0 || metrics[m].current < 0) continue;
+            double change = base > 0 ? (metrics[m].current - base) * 100.0 / base
+                                      : (metrics[m].current > 0 ? 100.0 : 0.0);
+            int regressed = change > metrics[m].limit_pct;
+            regressions += regressed;
+            fprintf(stderr, "%-22s %-16s %14.1f %14.1f %+8.1f%%%s\n", r->name, metrics[m].key, base,
+                    metrics[m].current, change, regressed ? "  REGRESSION" : "");
+        }
+    }
+    fclose(fp);
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    const char *corpus = NULL, *baseline = NULL;
+    double min_time = 0.25, threshold = 10.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (!corpus && argv[i][0] != '-') {
+            corpus = argv[i];
+        } else {
+            corpus = NULL;
+            break;
+        }
+    }
+    if (!corpus) {
+        fprintf(stderr, "Usage: %s <corpus_dir> [--min-time <seconds>] [--compare <baseline.json>] "
+                        "[--threshold <percent>]\n", argv[0]);
+        return 2;
+    }
+    if (setup(corpus) != 0) return 2;
+
+    Result results[MAX_RESULTS];
+    for (size_t i = 0; i < BENCH_COUNT; i++) {
+        run_bench(&benches[i], min_time * 1e9, &results[i]);
+    }
+    print_results(corpus, results, BENCH_COUNT);
+
+    int rc = 0;
+    if (baseline) {
+        int regressions = compare(baseline, results, BENCH_COUNT, threshold);
+        if (regressions < 0) {
+            rc = 2;
+        } else if (regressions > 0) {
+            fprintf(stderr, "%d regression(s) against %s.\n", regressions, baseline);
+            rc = 1;
+        } else {
+            fprintf(stderr, "No regressions against %s.\n", baseline);
+        }
+    }
+
+    for (size_t i = 0; i < fx.sample_count; i++) free(fx.samples[i]);
+    free_names(fx.names, fx.name_count);
+    subst_free(fx.subst);
+    template_set_close(&fx.templates);
+    fclose(fx.devnull);
+    db_close(&fx.db);
+    return rc;
+}
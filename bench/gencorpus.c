@@ -0,0 +1,137 @@
+/* File: bench/gencorpus.c
+ *
+ * Generator for the synthetic benchmark data directory (make bench).
+ *
+ * Usage: gencorpus <outdir> [count] [seed]
+ *
+ * Writes <outdir>/licenses/lic-NNNNN.txt and <outdir>/descriptions/lic-NNNNN.desc
+ * for count licenses (default 10000). Sizes are log-uniform between 200 bytes
+ * and 24 KiB and each license gets one of several placeholder densities, so
+ * both small-file overhead and substitution throughput are exercised. The
+ * output depends only on count and seed.
+ */
+
+#include "utils.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MIN_SIZE 200.0
+#define MAX_SIZE 24576.0
+
+static const char *const words[] = {
+    "the", "software", "license", "copyright", "holder", "permission", "granted",
+    "any", "person", "obtaining", "copy", "of", "this", "and", "associated",
+    "documentation", "files", "to", "deal", "in", "without", "restriction",
+    "including", "limitation", "rights", "use", "modify", "merge", "publish",
+    "distribute", "sublicense", "sell", "warranty", "merchantability", "fitness",
+    "for", "a", "particular", "purpose", "liability", "damages", "contract",
+    "tort", "otherwise", "arising", "from", "out", "connection", "with",
+    "source", "code", "object", "form", "derivative", "works", "patent", "notice",
+    "conditions", "terms", "redistribution", "binary", "must", "retain", "above",
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+static const char *const placeholders[] = {
+    "<YEAR>", "[yyyy]", "[year]", "<AUTHOR>", "[fullname]", "<COPYRIGHT HOLDER>",
+};
+#define PLACEHOLDER_COUNT (sizeof(placeholders) / sizeof(placeholders[0]))
+
+/* Placeholders per 1000 words */
+static const unsigned densities[] = { 0, 1, 10, 50 };
+
+static uint64_t rng_state;
+
+static uint64_t rng_next(void) {
+    /* xorshift64* */
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double rng_unit(void) {
+    return (double)(rng_next() >> 11) / 9007199254740992.0;
+}
+
+static int write_text(const char *path, const StrBuf *text) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    size_t n = fwrite(text->data, 1, text->len, fp);
+    return fclose(fp) == 0 && n == text->len ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <outdir> [count] [seed]\n", argv[0]);
+        return 1;
+    }
+    const char *outdir = argv[1];
+    long count = argc > 2 ? atol(argv[2]) : 10000;
+    rng_state = argc > 3 ? strtoull(argv[3], NULL, 10) : 0x05a1ULL;
+    if (rng_state == 0) rng_state = 1;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/licenses", outdir);
+    if (ensure_directory_exists(outdir) != 0 || ensure_directory_exists(path) != 0) {
+        fprintf(stderr, "gencorpus: cannot create '%s'\n", path);
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/descriptions", outdir);
+    if (ensure_directory_exists(path) != 0) {
+        fprintf(stderr, "gencorpus: cannot create '%s'\n", path);
+        return 1;
+    }
+
+    StrBuf text = {0};
+    for (long i = 0; i < count; i++) {
+        size_t target = (size_t)(MIN_SIZE * pow(MAX_SIZE / MIN_SIZE, rng_unit()));
+        unsigned density = densities[rng_next() % (sizeof(densities) / sizeof(densities[0]))];
+
+        text.len = 0;
+        sb_append_str(&text, "Synthetic License ");
+        sb_append_str(&text, placeholders[0]);
+        sb_append_str(&text, "\n\n");
+        size_t column = 0;
+        while (text.len < target) {
+            const char *w = rng_next() % 1000 < density
+                                ? placeholders[rng_next() % PLACEHOLDER_COUNT]
+                                : words[rng_next() % WORD_COUNT];
+            size_t len = strlen(w);
+            if (column + len + 1 > 72) {
+                /* Occasional paragraph breaks */
+                sb_append_str(&text, rng_next() % 8 == 0 ? "\n\n" : "\n");
+                column = 0;
+            } else if (column > 0) {
+                sb_append(&text, " ", 1);
+                column++;
+            }
+            sb_append(&text, w, len);
+            column += len;
+        }
+        sb_append(&text, "\n", 1);
+        snprintf(path, sizeof(path), "%s/licenses/lic-%05ld.txt", outdir, i);
+        if (write_text(path, &text) != 0) {
+            fprintf(stderr, "gencorpus: cannot write '%s'\n", path);
+            sb_free(&text);
+            return 1;
+        }
+
+        text.len = 0;
+        char line[128];
+        snprintf(line, sizeof(line), "Synthetic license %ld (%zu bytes, %u placeholders per 1000 words).\n",
+                 i, target, density);
+        sb_append_str(&text, line);
+        snprintf(path, sizeof(path), "%s/descriptions/lic-%05ld.desc", outdir, i);
+        if (write_text(path, &text) != 0) {
+            fprintf(stderr, "gencorpus: cannot write '%s'\n", path);
+            sb_free(&text);
+            return 1;
+        }
+    }
+    sb_free(&text);
+    printf("Generated %ld licenses in %s.\n", count, outdir);
+    return 0;
+}
@@ -0,0 +1,239 @@
+/* File: src/batch.c
+ *
+ * Implementation of batch LICENSE generation.
+ *
+ * The manifest is parsed up front, aliases are resolved and every target is
+ * matched with its compiled template. Workers then only fill in the slots and
+ * write; the report is printed in manifest order once all are done.
+ */
+
+#define _GNU_SOURCE
+
+#include "batch.h"
+#include "io.h"
+#include "license.h"
+#include "pool.h"
+#include "suggest.h"
+#include "template.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+typedef struct {
+    const char *dir;
+    const char *author;     /* NULL: config value */
+    const char *year;       /* NULL: config value */
+    char license[64];
+    const TemplateEntry *tmpl;
+    int line;
+    const char *error;      /* NULL on success */
+    int err;                /* errno for write failures */
+    int unchanged;          /* the file already held the rendered text */
+} BatchTarget;
+
+typedef struct {
+    BatchTarget *targets;
+    size_t count;
+    const TemplateSet *templates;
+    const Config *config;
+} BatchJob;
+
+/* Splits the next tab-separated field off *cursor. Returns NULL for an absent,
+ * empty or "-" field.
+ */
+static char *next_field(char **cursor) {
+    if (!*cursor) return NULL;
+    char *field = *cursor;
+    char *tab = strchr(field, '\t');
+    if (tab) {
+        *tab = '\0';
+        *cursor = tab + 1;
+    } else {
+        *cursor = NULL;
+    }
+    if (field[0] == '\0' || strcmp(field, "-") == 0) {
+        return NULL;
+    }
+    return field;
+}
+
+static const char LICENSE_NOT_FOUND[] = "license not found";
+
+static char *dup_or_null(const char *s) {
+    return s ? strdup(s) : NULL;
+}
+
+int manifest_read(const char *path, ManifestEntry **out, size_t *out_count) {
+    *out = NULL;
+    *out_count = 0;
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    ManifestEntry *entries = NULL;
+    size_t count = 0, cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    int line_no = 0, rc = 0;
+    while (getline(&line, &line_cap, fp) >= 0) {
+        line_no++;
+        trim_newline(line);
+        if (line[0] == '\0' || line[0] == '#') continue;
+        char *cursor = line;
+        char *dir = next_field(&cursor);
+        char *license = next_field(&cursor);
+        char *author = next_field(&cursor);
+        char *year = next_field(&cursor);
+        if (count == cap) {
+            cap = cap ? cap * 2 : 256;
+            ManifestEntry *grown = realloc(entries, cap * sizeof(*grown));
+            if (!grown) {
+                rc = -2;
+                break;
+            }
+            entries = grown;
+        }
+        ManifestEntry *e = &entries[count++];
+        e->line = line_no;
+        e->dir = dup_or_null(dir);
+        e->license = dup_or_null(license);
+        e->author = dup_or_null(author);
+        e->year = dup_or_null(year);
+    }
+    free(line);
+    if (fp != stdin) fclose(fp);
+    *out = entries;
+    *out_count = count;
+    return rc;
+}
+
+void manifest_free(ManifestEntry *entries, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].dir);
+        free(entries[i].license);
+        free(entries[i].author);
+        free(entries[i].year);
+    }
+    free(entries);
+}
+
+static int parse_manifest(const ManifestEntry *entries, size_t count, const Config *config, BatchTarget **out) {
+    BatchTarget *targets = calloc(count ? count : 1, sizeof(*targets));
+    *out = targets;
+    if (!targets) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const ManifestEntry *e = &entries[i];
+        BatchTarget *t = &targets[i];
+        t->line = e->line;
+        t->dir = e->dir ? e->dir : ".";
+        t->author = e->author;
+        t->year = e->year;
+        snprintf(t->license, sizeof(t->license), "%s", e->license ? e->license : config->default_license);
+        if (!e->dir) {
+            t->error = "missing target directory";
+        } else if (t->license[0] == '\0') {
+            t->error = "no license given and no default_license in config";
+        }
+    }
+    return 0;
+}
+
+static void batch_render(size_t index, void *ctx) {
+    BatchJob *job = ctx;
+    BatchTarget *t = &job->targets[index];
+    if (t->error) return;
+    TemplateValues values;
+    template_values(&values, job->config, t->year, t->author);
+    struct iovec stack[64];
+    struct iovec *iov = t->tmpl->op_count <= 64 ? stack : malloc(t->tmpl->op_count * sizeof(*iov));
+    if (!iov) {
+        t->error = "out of memory";
+        return;
+    }
+    size_t spans = template_iov(job->templates, t->tmpl, &values, iov);
+    char path[4096];
+    int rc;
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", t->dir, job->config->output) >= sizeof(path)) {
+        t->error = "path too long";
+    } else if ((rc = write_iov_to_file(path, iov, spans, job->config->output_mode)) == WRITE_FAILED) {
+        t->error = "write failed";
+        t->err = errno;
+    } else {
+        t->unchanged = rc == WRITE_UNCHANGED;
+    }
+    if (iov != stack) free(iov);
+}
+
+int run_batch(const char *manifest_path, const Database *db, const Config *config, int threads) {
+    ManifestEntry *entries;
+    size_t count;
+    int rc = manifest_read(manifest_path, &entries, &count);
+    if (rc == -1) {
+        char errmsg[512];
+        snprintf(errmsg, sizeof(errmsg), "Unable to open manifest '%s'", manifest_path);
+        print_error(errmsg);
+        return -1;
+    }
+    BatchTarget *targets = NULL;
+    if (rc != 0 || parse_manifest(entries, count, config, &targets) != 0) {
+        print_error("Out of memory reading manifest");
+        free(targets);
+        manifest_free(entries, count);
+        return -1;
+    }
+
+    TemplateSet templates;
+    if (template_set_open(&templates, db, config) != 0) {
+        print_error("Unable to compile the license templates");
+        rc = -1;
+        goto out;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        char resolved[64];
+        if (db_resolve_alias(db, targets[i].license, resolved, sizeof(resolved)) == 0) {
+            snprintf(targets[i].license, sizeof(targets[i].license), "%s", resolved);
+        }
+        if (!targets[i].error && !template_get(&templates, targets[i].license)) {
+            targets[i].error = LICENSE_NOT_FOUND;
+        }
+    }
+    /* template_get() may have recompiled the set, so entries are looked up afterwards */
+    for (size_t i = 0; i < count; i++) {
+        if (!targets[i].error) targets[i].tmpl = template_find(&templates, targets[i].license);
+    }
+
+    BatchJob job = { targets, count, &templates, config };
+    pool_run(count, threads, batch_render, &job);
+
+    size_t failed = 0, unchanged = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (targets[i].error) {
+            char hint[256] = "";
+            if (targets[i].error == LICENSE_NOT_FOUND &&
+                suggest_hint(db, targets[i].license, hint + 1, sizeof(hint) - 1) == 0) {
+                hint[0] = '.';
+            }
+            failed++;
+            printf("FAILED  %s (%s, line %d): %s%s%s%s\n", targets[i].dir, targets[i].license,
+                   targets[i].line, targets[i].error, targets[i].err ? ": " : "",
+                   targets[i].err ? strerror(targets[i].err) : "", hint);
+        } else {
+            unchanged += targets[i].unchanged;
+            printf("%s%s (%s)\n", targets[i].unchanged ? "same    " : "ok      ", targets[i].dir, targets[i].license);
+        }
+    }
+    printf("Batch complete: %zu generated, %zu unchanged, %zu failed.\n", count - failed - unchanged, unchanged, failed);
+    if (failed) rc = -1;
+    template_set_close(&templates);
+
+out:
+    free(targets);
+    manifest_free(entries, count);
+    return rc;
+}
@@ -0,0 +1,43 @@
+/* File: src/batch.h
+ *
+ * Header for batch LICENSE generation.
+ *
+ * A manifest lists one target per line as tab-separated fields:
+ *
+ *     <directory> TAB <license> [TAB <author> [TAB <year>]]
+ *
+ * Empty or "-" fields fall back to the config; blank lines and lines starting
+ * with '#' are ignored.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "config.h"
+#include "db.h"
+
+/* One manifest line. Absent, empty and "-" fields are NULL. */
+typedef struct {
+    char *dir;
+    char *license;
+    char *author;
+    char *year;
+    int line;
+} ManifestEntry;
+
+/* Reads the manifest at path ("-" reads stdin). Returns 0 on success, -1 if it
+ * cannot be opened (errno set), -2 if memory ran out; the entries read until
+ * then are returned either way. Free them with manifest_free().
+ */
+int manifest_read(const char *path, ManifestEntry **entries, size_t *count);
+
+void manifest_free(ManifestEntry *entries, size_t count);
+
+/* Generates <directory>/LICENSE for every manifest entry (manifest_path "-" reads stdin),
+ * loading and compiling each distinct template once and rendering on a thread pool
+ * (threads <= 0 means one per CPU). Prints a per-target report and a summary.
+ * Returns 0 if every target succeeded, non-zero otherwise.
+ */
+int run_batch(const char *manifest_path, const Database *db, const Config *config, int threads);
+
+#endif /* BATCH_H */
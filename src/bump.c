@@ -0,0 +1,346 @@
+/* File: src/bump.c
+ *
+ * Implementation of the bulk copyright-year updater.
+ *
+ * Copyright lines are recognized as the detector recognizes them, and the
+ * run of years ("2019", "2019-2025", "2019, 2021 - 2024") that directly follows
+ * the "Copyright" marker (and any "(c)" or "©" after it) is parsed; years
+ * elsewhere on the line are never touched. In LICENSE and NOTICE files, lines
+ * that are part of the identified license text itself (the FSF's own notice in
+ * the GPL, say) are left alone too. The last year of the run is replaced when it ends a range and
+ * extended into a range otherwise; runs that are open ("2019-present"),
+ * already current or in the future are left alone. Source files are only
+ * read up to the scanner's head size, where headers live, and the rest of a
+ * file that changes is copied behind the new head into a temporary file that
+ * is renamed over the original, as --apply-headers does.
+ */
+
+#define _GNU_SOURCE
+
+#include "bump.h"
+#include "detect.h"
+#include "filetype.h"
+#include "io.h"
+#include "notices.h"
+#include "scan.h"
+#include "trace.h"
+#include "walk.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Bytes of a LICENSE or NOTICE file that are searched for copyright lines */
+#define BUMP_LICENSE_MAX (64 * 1024)
+
+typedef struct {
+    int year;
+    Subst *subst;
+    const Database *db;
+    Detector det;                           /* identifies the texts of license files */
+    pthread_mutex_t lock;                   /* report output */
+    atomic_size_t updated, lines, current, failed;
+} BumpCtx;
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int is_alnum(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Returns the value of a four-digit year at s that stands on its own, or 0. */
+static int year_at(const char *line, const char *s, const char *end) {
+    if (end - s < 4 || (s > line && is_alnum(s[-1]))) return 0;
+    for (int i = 0; i < 4; i++) {
+        if (!is_digit(s[i])) return 0;
+    }
+    if (end - s > 4 && is_alnum(s[4])) return 0;
+    int y = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+    return y >= 1900 && y <= 2999 ? y : 0;
+}
+
+static const char *skip_spaces(const char *p, const char *end) {
+    while (p < end && *p == ' ') p++;
+    return p;
+}
+
+/* Skips a range dash ('-' or an en dash) with the spaces around it, or returns NULL. */
+static const char *skip_dash(const char *p, const char *end) {
+    p = skip_spaces(p, end);
+    if (p < end && *p == '-') {
+        p++;
+    } else if (end - p >= 3 && memcmp(p, "\xe2\x80\x93", 3) == 0) {
+        p += 3;
+    } else {
+        return NULL;
+    }
+    return skip_spaces(p, end);
+}
+
+/* Returns where the years of a copyright line start: right after "Copyright"
+ * (or "CopyrightText:") and the "(c)" or "©" markers that follow it. Returns
+ * NULL when no year stands there.
+ */
+static const char *years_start(const char *line, const char *end) {
+    for (const char *p = line; end - p >= 9; p++) {
+        if (strncasecmp(p, "copyright", 9) != 0) continue;
+        const char *q = p + 9;
+        if (end - q >= 4 && strncasecmp(q, "text", 4) == 0) q += 4;
+        if (q < end && *q == ':') q++;
+        for (;;) {
+            q = skip_spaces(q, end);
+            if (end - q >= 3 && strncasecmp(q, "(c)", 3) == 0) {
+                q += 3;
+            } else if (end - q >= 2 && memcmp(q, "\xc2\xa9", 2) == 0) {
+                q += 2;
+            } else {
+                break;
+            }
+        }
+        if (year_at(line, q, end)) return q;
+    }
+    return NULL;
+}
+
+/* Returns 1 if the line, without its surrounding blanks, occurs in the license text. */
+static int in_license_text(const char *license_text, const char *line, const char *end) {
+    while (line < end && (*line == ' ' || *line == '\t')) line++;
+    while (end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+    return license_text && end > line && memmem(license_text, strlen(license_text), line, (size_t)(end - line));
+}
+
+static int has_year_placeholder(const Subst *subst, const char *line, const char *end) {
+    size_t token, match_len;
+    for (const char *p = line; subst && (p = subst_next(subst, p, end, &token, &match_len)); p += match_len) {
+        if (subst_token_field(subst, token) == SUBST_YEAR) return 1;
+    }
+    return 0;
+}
+
+/* Finds the edit a copyright line needs: [*off, *off + *len) of the line is
+ * replaced by the target year, with a dash before it when *dash is set.
+ * Returns 1 if the line needs one, 0 if it is current, -1 if it holds no
+ * years that can be bumped.
+ */
+static int line_edit(const char *line, const char *end, int year, size_t *off, size_t *len, int *dash) {
+    const char *p = years_start(line, end);
+    if (!p) return -1;
+    int y = year_at(line, p, end);
+    const char *last = p;
+    int last_year = y, max_year = y, in_range = 0;
+    for (p += 4; p < end;) {
+        const char *next = skip_dash(p, end);
+        int range = next != NULL;
+        if (!next) {
+            next = skip_spaces(p, end);
+            if (next < end && *next == ',') next = skip_spaces(next + 1, end);
+            else next = NULL;
+        }
+        if (!next || !(y = year_at(line, next, end))) {
+            /* "2019-present" or "2019-": an open range stays as it is */
+            if (range) return -1;
+            break;
+        }
+        last = next;
+        last_year = y;
+        in_range = range;
+        if (y > max_year) max_year = y;
+        p = next + 4;
+    }
+    if (max_year >= year) return max_year == year && last_year == year ? 0 : -1;
+    *off = (size_t)(last - line) + (in_range ? 0 : 4);
+    *len = in_range ? 4 : 0;
+    *dash = !in_range;
+    return 1;
+}
+
+size_t bump_years(const char *text, size_t len, int partial, int year, const Subst *subst,
+                  const char *license_text, StrBuf *out, size_t *current) {
+    const char *end = text + len, *copied = text;
+    if (partial) {
+        /* A line cut off by the read is left alone */
+        while (end > text && end[-1] != '\n') end--;
+    }
+    char target[16];
+    int target_len = snprintf(target, sizeof(target), "-%d", year);
+    size_t changed = 0;
+    *current = 0;
+    for (const char *line = text; line < end;) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) eol = end;
+        size_t off, edit_len;
+        int dash, rc;
+        if (detect_is_copyright_line(line, (size_t)(eol - line)) && !has_year_placeholder(subst, line, eol) &&
+            !in_license_text(license_text, line, eol) && (rc = line_edit(line, eol, year, &off, &edit_len, &dash)) >= 0) {
+            if (rc == 0) {
+                (*current)++;
+            } else if (sb_append(out, copied, (size_t)(line + off - copied)) == 0 &&
+                       sb_append(out, target + !dash, (size_t)target_len - !dash) == 0) {
+                copied = line + off + edit_len;
+                changed++;
+            } else {
+                return 0;
+            }
+        }
+        line = eol + 1;
+    }
+    if (changed && sb_append(out, copied, (size_t)(text + len - copied)) != 0) {
+        return 0;
+    }
+    return changed;
+}
+
+static void report(BumpCtx *bc, const char *dir, const char *name, const char *what) {
+    pthread_mutex_lock(&bc->lock);
+    printf("%s/%s: %s\n", dir, name, what);
+    pthread_mutex_unlock(&bc->lock);
+}
+
+static void fail(BumpCtx *bc, const char *dir, const char *name, int err) {
+    report(bc, dir, name, strerror(err));
+    atomic_fetch_add(&bc->failed, 1);
+}
+
+static void bump_file(BumpCtx *bc, const char *dir, const char *name, int is_license) {
+    size_t limit = is_license ? BUMP_LICENSE_MAX : SCAN_HEAD_SIZE;
+    char path[4096], tmp_path[4096];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir, name) >= sizeof(path) ||
+        (size_t)snprintf(tmp_path, sizeof(tmp_path), "%s/.%s.osla-XXXXXX", dir, name) >= sizeof(tmp_path)) {
+        fail(bc, dir, name, ENAMETOOLONG);
+        return;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        fail(bc, dir, name, errno);
+        return;
+    }
+    char buf[BUMP_LICENSE_MAX];
+    size_t n = 0;
+    TraceSpan span;
+    trace_begin(&span, TRACE_FILE_READ);
+    while (n < limit) {
+        ssize_t r = read(fd, buf + n, limit - n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        n += (size_t)r;
+    }
+    trace_end(&span, n);
+
+    /* The license a file carries decides which of its lines are its own text */
+    DbText license = {0};
+    DetectMatch match;
+    if (is_license && detector_identify(&bc->det, buf, n, &match) == 0 && match.license &&
+        match.confidence >= 0.5) {
+        db_get(bc->db, DB_LICENSE, match.license, &license);
+    }
+    StrBuf head = {0};
+    size_t current = 0;
+    size_t changed = memchr(buf, '\0', n) ? 0 : bump_years(buf, n, n == limit, bc->year, bc->subst, license.data,
+                                                             &head, &current);
+    db_text_release(&license);
+    if (changed == 0) {
+        if (current) atomic_fetch_add(&bc->current, 1);
+        sb_free(&head);
+        close(fd);
+        return;
+    }
+
+    struct stat st;
+    trace_begin(&span, TRACE_OUTPUT_WRITE);
+    int out = fstat(fd, &st) == 0 ? mkostemp(tmp_path, O_CLOEXEC) : -1;
+    int rc = out < 0 ? -1 : fchmod(out, st.st_mode & 07777);
+    struct iovec iov = { head.data, head.len };
+    if (rc == 0) rc = write_iov(out, &iov, 1);
+    if (rc == 0 && n == limit) rc = copy_fd(fd, out);
+    int err = errno;
+    if (out >= 0 && close(out) != 0 && rc == 0) {
+        rc = -1;
+        err = errno;
+    }
+    close(fd);
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        rc = -1;
+        err = errno;
+    }
+    trace_end(&span, rc == 0 ? head.len : 0);
+    sb_free(&head);
+    if (rc != 0) {
+        if (out >= 0) unlink(tmp_path);
+        fail(bc, dir, name, err);
+        return;
+    }
+    char what[64];
+    snprintf(what, sizeof(what), "updated %zu line%s", changed, changed == 1 ? "" : "s");
+    report(bc, dir, name, what);
+    atomic_fetch_add(&bc->updated, 1);
+    atomic_fetch_add(&bc->lines, changed);
+}
+
+static const void *bump_visit(const char *dir, const WalkEntry *files, size_t count,
+                              const void *inherited, void *ctx) {
+    (void)inherited;
+    for (size_t i = 0; i < count; i++) {
+        const char *name = files[i].name;
+        if (scan_is_license_file(name) || notices_is_notice_file(name)) {
+            bump_file(ctx, dir, name, 1);
+        } else if (filetype_comment_kind(name) >= 0) {
+            bump_file(ctx, dir, name, 0);
+        }
+    }
+    return NULL;
+}
+
+int run_bump_year(const char *root, int year, const Database *db, const Config *config, int threads) {
+    BumpCtx bc;
+    memset(&bc, 0, sizeof(bc));
+    if (year <= 0) {
+        time_t now = time(NULL);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        year = tm.tm_year + 1900;
+    }
+    bc.year = year;
+    bc.db = db;
+    /* Lines holding a placeholder are templates, not dated notices */
+    bc.subst = subst_compile_config(config, NULL);
+    if (!bc.subst) {
+        print_error("Out of memory during placeholder expansion");
+        return -1;
+    }
+    if (detector_open(&bc.det, db, config) != 0) {
+        print_error("Unable to load license fingerprints");
+        subst_free(bc.subst);
+        return -1;
+    }
+    pthread_mutex_init(&bc.lock, NULL);
+    atomic_init(&bc.updated, 0);
+    atomic_init(&bc.lines, 0);
+    atomic_init(&bc.current, 0);
+    atomic_init(&bc.failed, 0);
+
+    int rc = walk_tree(root, threads, bump_visit, NULL, &bc);
+    if (rc < 0) {
+        char errmsg[512];
+        snprintf(errmsg, sizeof(errmsg), "Unable to walk directory '%s'", root);
+        print_error(errmsg);
+    } else {
+        fflush(stdout);
+        printf("Bumped copyright years to %d in %zu files (%zu lines; %zu files already current, %zu failed).\n",
+               year, atomic_load(&bc.updated), atomic_load(&bc.lines), atomic_load(&bc.current),
+               atomic_load(&bc.failed));
+        rc = rc > 0 || atomic_load(&bc.failed) ? 1 : 0;
+    }
+    pthread_mutex_destroy(&bc.lock);
+    detector_close(&bc.det);
+    subst_free(bc.subst);
+    return rc;
+}
@@ -0,0 +1,40 @@
+/* File: src/bump.h
+ *
+ * Header for the bulk copyright-year updater (--bump-year).
+ *
+ * Walks a tree in parallel and moves the year range that follows the
+ * "Copyright" marker of every copyright line in source headers and
+ * LICENSE/NOTICE files up to a target year: "2019-2025" becomes "2019-2026"
+ * and "2025" becomes "2025-2026". Only the years are rewritten; a file is
+ * replaced atomically, and only when one of its lines changes.
+ */
+
+#ifndef BUMP_H
+#define BUMP_H
+
+#include <stddef.h>
+#include "config.h"
+#include "db.h"
+#include "subst.h"
+#include "utils.h"
+
+/* Rewrites the copyright lines of text so that their years run to year and
+ * appends the result to out. Lines still holding a year placeholder of subst
+ * (may be NULL) are templates and left alone, as are lines found in
+ * license_text (the license text identifies, or NULL) and a line cut off at
+ * the end of text when partial is set. *current receives the number of
+ * copyright lines already up to date. Returns the number of lines changed;
+ * out is left untouched when that is 0.
+ */
+size_t bump_years(const char *text, size_t len, int partial, int year, const Subst *subst,
+                  const char *license_text, StrBuf *out, size_t *current);
+
+/* Updates every source file and license or notice file under root on up to
+ * threads workers (threads <= 0 means one per CPU) and prints the files it
+ * changed and a summary. License files are identified against db. year <= 0
+ * means the current year. Returns 0 on success, 1 if some files could not be
+ * updated, -1 if root cannot be walked.
+ */
+int run_bump_year(const char *root, int year, const Database *db, const Config *config, int threads);
+
+#endif /* BUMP_H */
@@ -0,0 +1,426 @@
+/* File: src/bundle.c
+ *
+ * Implementation of the single-file license bundle.
+ *
+ * Building reads the loose data directory once, packs the license texts
+ * against a shared dictionary and lays out header, hash buckets, records, the
+ * dictionary and a string area. Opening maps the file read-only; lookups hash
+ * the case-folded name, probe the bucket array and return pointers into the
+ * mapping, or into the text a packed record decompressed to on first use.
+ */
+
+#define _GNU_SOURCE
+
+#include "bundle.h"
+#include "license.h"
+#include "meta.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t record_hash(BundleKind kind, const char *name, size_t len) {
+    return hash_casefold(name, len) ^ ((uint64_t)kind * 0x9e3779b97f4a7c15ULL);
+}
+
+/* Whether [off, off + len) lies within a file of size bytes. */
+static int in_file(uint64_t off, uint64_t len, size_t size) {
+    return off <= size && len <= size - off;
+}
+
+/* Checks every bucket and record of a mapped bundle, so that lookups can
+ * trust them: bucket entries name records, and names and texts, with the NUL
+ * after each, lie within the file. Returns 0 if they do.
+ */
+static int check_records(const unsigned char *base, size_t size) {
+    const BundleHeader *h = (const BundleHeader *)base;
+    const uint32_t *buckets = (const uint32_t *)(base + h->buckets_off);
+    const BundleRecord *records = (const BundleRecord *)(base + h->records_off);
+    if (h->record_count >= h->bucket_count) return -1;
+    for (uint32_t i = 0; i < h->bucket_count; i++) {
+        if (buckets[i] > h->record_count) return -1;
+    }
+    for (uint32_t i = 0; i < h->record_count; i++) {
+        const BundleRecord *r = &records[i];
+        if (!in_file(r->name_off, (uint64_t)r->name_len + 1, size) || base[r->name_off + r->name_len] != '\0') {
+            return -1;
+        }
+        if (r->packed_len == 0) {
+            if (!in_file(r->data_off, r->data_len + 1, size) || r->data_len >= size ||
+                base[r->data_off + r->data_len] != '\0') {
+                return -1;
+            }
+        } else if (!in_file(r->data_off, r->packed_len, size) || r->data_len > BUNDLE_MAX_TEXT) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int bundle_open(Bundle *bundle, const char *path) {
+    memset(bundle, 0, sizeof(*bundle));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BundleHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    const BundleHeader *h = map;
+    size_t size = (size_t)st.st_size;
+    if (memcmp(h->magic, BUNDLE_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != BUNDLE_VERSION ||
+        h->total_size != size ||
+        h->bucket_count == 0 || (h->bucket_count & (h->bucket_count - 1)) != 0 ||
+        h->buckets_off % sizeof(uint32_t) != 0 || h->records_off % sizeof(uint64_t) != 0 ||
+        !in_file(h->buckets_off, (uint64_t)h->bucket_count * sizeof(uint32_t), size) ||
+        !in_file(h->records_off, (uint64_t)h->record_count * sizeof(BundleRecord), size) ||
+        !in_file(h->dict_off, h->dict_len, size) ||
+        check_records(map, size) != 0) {
+        munmap(map, size);
+        return -1;
+    }
+    bundle->base = map;
+    bundle->size = size;
+    bundle->header = h;
+    bundle->buckets = (const uint32_t *)(bundle->base + h->buckets_off);
+    bundle->records = (const BundleRecord *)(bundle->base + h->records_off);
+    /* Without the cache, lookups decompress into buffers of the caller's */
+    bundle->decoded = calloc(h->record_count ? h->record_count : 1, sizeof(*bundle->decoded));
+    return 0;
+}
+
+void bundle_close(Bundle *bundle) {
+    if (bundle->decoded) {
+        for (uint32_t i = 0; i < bundle->header->record_count; i++) {
+            free(atomic_load(&bundle->decoded[i]));
+        }
+        free(bundle->decoded);
+    }
+    if (bundle->base) {
+        munmap((void *)bundle->base, bundle->size);
+    }
+    memset(bundle, 0, sizeof(*bundle));
+}
+
+/* Decompresses a packed record into a new NUL-terminated buffer. */
+static char *decode_record(const Bundle *bundle, const BundleRecord *r) {
+    char *text = malloc((size_t)r->data_len + 1);
+    if (!text || dict_decompress((const char *)bundle->base + bundle->header->dict_off,
+                                 (size_t)bundle->header->dict_len, bundle->base + r->data_off,
+                                 (size_t)r->packed_len, text, (size_t)r->data_len) != 0) {
+        free(text);
+        return NULL;
+    }
+    text[r->data_len] = '\0';
+    return text;
+}
+
+const char *bundle_find(const Bundle *bundle, BundleKind kind, const char *name, size_t *len, char **owned) {
+    if (owned) {
+        *owned = NULL;
+    }
+    if (!bundle->base) {
+        return NULL;
+    }
+    size_t name_len = strlen(name);
+    uint32_t mask = bundle->header->bucket_count - 1;
+    uint32_t slot = (uint32_t)record_hash(kind, name, name_len) & mask;
+    for (uint32_t probes = 0; probes <= mask; probes++, slot = (slot + 1) & mask) {
+        uint32_t idx = bundle->buckets[slot];
+        if (idx == 0) {
+            return NULL;
+        }
+        const BundleRecord *r = &bundle->records[idx - 1];
+        if (r->kind == (uint32_t)kind && r->name_len == name_len &&
+            strncasecmp((const char *)bundle->base + r->name_off, name, name_len) == 0) {
+            if (len) {
+                *len = (size_t)r->data_len;
+            }
+            if (r->packed_len == 0) {
+                return (const char *)bundle->base + r->data_off;
+            }
+            if (!bundle->decoded) {
+                char *text = owned ? decode_record(bundle, r) : NULL;
+                if (owned) *owned = text;
+                return text;
+            }
+            _Atomic(char *) *slot = &bundle->decoded[idx - 1];
+            char *text = atomic_load_explicit(slot, memory_order_acquire);
+            if (text) return text;
+            text = decode_record(bundle, r);
+            if (!text) return NULL;
+            /* Another thread may have decoded it meanwhile: keep the first copy */
+            char *expected = NULL;
+            if (!atomic_compare_exchange_strong_explicit(slot, &expected, text, memory_order_acq_rel,
+                                                         memory_order_acquire)) {
+                free(text);
+                text = expected;
+            }
+            return text;
+        }
+    }
+    return NULL;
+}
+
+const char *bundle_record_name(const Bundle *bundle, uint32_t i, BundleKind *kind) {
+    const BundleRecord *r = &bundle->records[i];
+    if (kind) {
+        *kind = (BundleKind)r->kind;
+    }
+    return (const char *)bundle->base + r->name_off;
+}
+
+/* In-memory record used while building. */
+typedef struct {
+    BundleKind kind;
+    char *name;
+    char *data;
+    size_t len;
+    const StrBuf *packed;   /* compressed text, or NULL to store data as is */
+} BuildEntry;
+
+typedef struct {
+    BuildEntry *items;
+    size_t count;
+    size_t cap;
+} BuildList;
+
+static int build_push(BuildList *list, BundleKind kind, const char *name, char *data, size_t len) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        BuildEntry *grown = realloc(list->items, cap * sizeof(*grown));
+        if (!grown) return -1;
+        list->items = grown;
+        list->cap = cap;
+    }
+    char *name_copy = strdup(name);
+    if (!name_copy) return -1;
+    list->items[list->count++] = (BuildEntry){ kind, name_copy, data, len, NULL };
+    return 0;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const BuildEntry *x = a, *y = b;
+    if (x->kind != y->kind) {
+        return x->kind < y->kind ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+/* Adds every <dir>/<name><suffix> file as a record of the given kind. */
+static int build_add_dir(BuildList *list, const char *dir, const char *suffix, BundleKind kind) {
+    char **names;
+    size_t count;
+    if (list_dir_stems(dir, suffix, &names, &count) != 0) {
+        return -1;
+    }
+    int rc = 0;
+    for (size_t i = 0; i < count && rc == 0; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s%s", dir, names[i], suffix);
+        size_t len;
+        char *data = read_file(path, &len);
+        if (!data || build_push(list, kind, names[i], data, len) != 0) {
+            free(data);
+            rc = -1;
+        }
+    }
+    free_names(names, count);
+    return rc;
+}
+
+static int is_builtin_alias(const char *key, size_t len) {
+    for (int i = 0; alias_map[i].alias != NULL; i++) {
+        if (strlen(alias_map[i].alias) == len && strncasecmp(alias_map[i].alias, key, len) == 0) return 1;
+    }
+    return 0;
+}
+
+/* Adds the rows of the data dir's licenses.tsv as metadata records, and its
+ * names, SPDX ids and aliases as alias records. Built-in aliases keep
+ * precedence.
+ */
+static int build_add_meta(BuildList *list, const char *datadir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", datadir, META_FILENAME);
+    Meta meta;
+    if (meta_load(&meta, path) != 0) return -1;
+    int rc = 0;
+    StrBuf line = {0};
+    for (size_t i = 0; i < meta.count && rc == 0; i++) {
+        line.len = 0;
+        rc = meta_append_line(&line, &meta.entries[i]);
+        char *data = rc == 0 ? strndup(line.data, line.len - 1) : NULL;
+        if (!data || build_push(list, BUNDLE_META, meta.entries[i].name, data, line.len - 1) != 0) {
+            free(data);
+            rc = -1;
+        }
+    }
+    for (size_t i = 0; i < meta.key_count && rc == 0; i++) {
+        const MetaKey *k = &meta.keys[i];
+        /* Names too, as the loose layout resolves them through the same table */
+        const char *full = meta.entries[k->entry].name;
+        if (is_builtin_alias(k->key, k->len)) continue;
+        char *key = strndup(k->key, k->len);
+        char *data = strdup(full);
+        if (!key || !data || build_push(list, BUNDLE_ALIAS, key, data, strlen(data)) != 0) {
+            free(data);
+            rc = -1;
+        }
+        free(key);
+    }
+    sb_free(&line);
+    meta_free(&meta);
+    return rc;
+}
+
+static int write_all(FILE *fp, const void *data, size_t len) {
+    return fwrite(data, 1, len, fp) == len ? 0 : -1;
+}
+
+/* Compresses the license texts of list against a dictionary trained on them. */
+static int build_pack(BuildList *list, DictPack *pack) {
+    size_t count = 0;
+    const char **texts = malloc((list->count ? list->count : 1) * sizeof(*texts));
+    size_t *lens = malloc((list->count ? list->count : 1) * sizeof(*lens));
+    int rc = -1;
+    if (texts && lens) {
+        /* Licenses sort first */
+        while (count < list->count && list->items[count].kind == BUNDLE_LICENSE) {
+            texts[count] = list->items[count].data;
+            lens[count] = list->items[count].len;
+            count++;
+        }
+        rc = dict_pack(pack, texts, lens, count);
+    }
+    for (size_t i = 0; rc == 0 && i < count; i++) {
+        if (pack->packed[i].len) list->items[i].packed = &pack->packed[i];
+    }
+    free(texts);
+    free(lens);
+    return rc;
+}
+
+int bundle_build(const char *datadir, const char *out_path, DictStats *stats) {
+    BuildList list = {0};
+    DictPack pack;
+    memset(&pack, 0, sizeof(pack));
+    char dir[512];
+    int rc = -1;
+    FILE *fp = NULL;
+    uint32_t *buckets = NULL;
+    BundleRecord *records = NULL;
+    char tmp_path[512];
+    tmp_path[0] = '\0';
+
+    snprintf(dir, sizeof(dir), "%s/licenses", datadir);
+    if (build_add_dir(&list, dir, ".txt", BUNDLE_LICENSE) != 0) goto out;
+    snprintf(dir, sizeof(dir), "%s/descriptions", datadir);
+    /* Descriptions are optional; a data dir may ship texts only. */
+    build_add_dir(&list, dir, ".desc", BUNDLE_DESCRIPTION);
+    for (int i = 0; alias_map[i].alias != NULL; i++) {
+        char *full = strdup(alias_map[i].full);
+        if (!full || build_push(&list, BUNDLE_ALIAS, alias_map[i].alias, full, strlen(full)) != 0) {
+            free(full);
+            goto out;
+        }
+    }
+    if (build_add_meta(&list, datadir) != 0) goto out;
+    qsort(list.items, list.count, sizeof(*list.items), compare_entries);
+    if (build_pack(&list, &pack) != 0) goto out;
+    if (stats) *stats = pack.stats;
+
+    uint32_t bucket_count = 16;
+    while (bucket_count < list.count * 2) {
+        bucket_count *= 2;
+    }
+    buckets = calloc(bucket_count, sizeof(*buckets));
+    records = calloc(list.count ? list.count : 1, sizeof(*records));
+    if (!buckets || !records) goto out;
+
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.record_count = (uint32_t)list.count;
+    header.bucket_count = bucket_count;
+    header.buckets_off = sizeof(header);
+    header.records_off = header.buckets_off + (uint64_t)bucket_count * sizeof(uint32_t);
+    header.dict_off = header.records_off + (uint64_t)list.count * sizeof(BundleRecord);
+    header.dict_len = pack.dict.len;
+
+    /* Strings follow the dictionary: name NUL data NUL, per record. */
+    uint64_t off = header.dict_off + header.dict_len;
+    for (size_t i = 0; i < list.count; i++) {
+        BuildEntry *e = &list.items[i];
+        size_t name_len = strlen(e->name);
+        records[i].kind = (uint32_t)e->kind;
+        records[i].name_len = (uint32_t)name_len;
+        records[i].name_off = off;
+        off += name_len + 1;
+        records[i].data_off = off;
+        records[i].data_len = e->len;
+        records[i].packed_len = e->packed ? e->packed->len : 0;
+        off += (e->packed ? e->packed->len : e->len) + 1;
+
+        uint32_t slot = (uint32_t)record_hash(e->kind, e->name, name_len) & (bucket_count - 1);
+        while (buckets[slot] != 0) {
+            slot = (slot + 1) & (bucket_count - 1);
+        }
+        buckets[slot] = (uint32_t)i + 1;
+    }
+    header.total_size = off;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+    fp = fopen(tmp_path, "wb");
+    if (!fp) goto out;
+    if (write_all(fp, &header, sizeof(header)) != 0 ||
+        write_all(fp, buckets, bucket_count * sizeof(*buckets)) != 0 ||
+        write_all(fp, records, list.count * sizeof(*records)) != 0 ||
+        write_all(fp, pack.dict.data, pack.dict.len) != 0) {
+        goto out;
+    }
+    for (size_t i = 0; i < list.count; i++) {
+        BuildEntry *e = &list.items[i];
+        if (write_all(fp, e->name, strlen(e->name) + 1) != 0 ||
+            (e->packed ? write_all(fp, e->packed->data, e->packed->len)
+                       : write_all(fp, e->data, e->len)) != 0 ||
+            write_all(fp, "", 1) != 0) {
+            goto out;
+        }
+    }
+    if (fclose(fp) != 0) {
+        fp = NULL;
+        goto out;
+    }
+    fp = NULL;
+    if (rename(tmp_path, out_path) != 0) goto out;
+    tmp_path[0] = '\0';
+    rc = 0;
+
+out:
+    if (fp) fclose(fp);
+    if (tmp_path[0]) unlink(tmp_path);
+    for (size_t i = 0; i < list.count; i++) {
+        free(list.items[i].name);
+        free(list.items[i].data);
+    }
+    free(list.items);
+    dict_pack_free(&pack);
+    free(buckets);
+    free(records);
+    return rc;
+}
@@ -0,0 +1,97 @@
+/* File: src/bundle.h
+ *
+ * Header for the single-file license bundle.
+ *
+ * A bundle packs every license text, description and alias, and the rows of
+ * the data directory's licenses.tsv (see meta.h), into one versioned file
+ * with a hash index, so lookups at runtime are a probe into an mmap'ed image
+ * instead of a directory walk plus a file read per license. License texts
+ * are compressed against a dictionary trained on them (see dict.h).
+ */
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "dict.h"
+
+#define BUNDLE_FILENAME "osla.bundle"
+#define BUNDLE_MAGIC "OSLABNDL"
+#define BUNDLE_VERSION 2
+/* Largest text a packed record may decompress to; larger ones are corrupt */
+#define BUNDLE_MAX_TEXT (64u * 1024 * 1024)
+
+typedef enum {
+    BUNDLE_LICENSE = 0,
+    BUNDLE_DESCRIPTION = 1,
+    BUNDLE_ALIAS = 2,       /* data is the canonical license name */
+    BUNDLE_META = 3,        /* data is the license's line of licenses.tsv */
+    BUNDLE_KIND_COUNT
+} BundleKind;
+
+/* On-disk layout. All offsets are from the start of the file and all integers
+ * are in host byte order; a bundle is built on the machine that installs it.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_count;
+    uint32_t bucket_count;  /* power of two */
+    uint32_t reserved;
+    uint64_t buckets_off;   /* uint32_t[bucket_count], record index + 1, 0 = empty */
+    uint64_t records_off;   /* BundleRecord[record_count], sorted by kind then name */
+    uint64_t dict_off;      /* dictionary of the packed records */
+    uint64_t dict_len;
+    uint64_t total_size;
+} BundleHeader;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t name_len;
+    uint64_t name_off;      /* NUL-terminated */
+    uint64_t data_off;      /* NUL-terminated, data_len excludes the NUL */
+    uint64_t data_len;
+    uint64_t packed_len;    /* when non-zero, data_off holds packed_len bytes that
+                               decompress to the data_len bytes of the text */
+} BundleRecord;
+
+typedef struct {
+    const unsigned char *base;
+    size_t size;
+    const BundleHeader *header;
+    const uint32_t *buckets;
+    const BundleRecord *records;
+    _Atomic(char *) *decoded;   /* per record: its text once decompressed, or NULL */
+} Bundle;
+
+/* Maps the bundle at path and checks every bucket and record offset in it.
+ * Returns 0 on success, non-zero if it is missing, truncated, corrupt or of
+ * another version.
+ */
+int bundle_open(Bundle *bundle, const char *path);
+
+void bundle_close(Bundle *bundle);
+
+/* Looks up name (case-insensitively) and returns its NUL-terminated data,
+ * storing the length in len. Plain records are returned as a pointer into the
+ * mapping. Packed ones are decompressed on first use and kept with the bundle
+ * until bundle_close, so later lookups cost only the probe; safe to call from
+ * several threads. If the cache could not be allocated at open, a packed text
+ * is instead decompressed into a buffer stored in *owned for the caller to free
+ * (*owned is NULL otherwise). Returns NULL if there is no such record.
+ */
+const char *bundle_find(const Bundle *bundle, BundleKind kind, const char *name, size_t *len, char **owned);
+
+/* Returns the name of the i-th record and its kind. */
+const char *bundle_record_name(const Bundle *bundle, uint32_t i, BundleKind *kind);
+
+/* Packs the .txt files under <datadir>/licenses, the .desc files under
+ * <datadir>/descriptions and the alias table into a bundle written atomically
+ * to out_path, storing the compression figures of the licenses in stats
+ * (may be NULL). Returns 0 on success.
+ */
+int bundle_build(const char *datadir, const char *out_path, DictStats *stats);
+
+#endif /* BUNDLE_H */
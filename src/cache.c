@@ -0,0 +1,78 @@
+/* File: src/cache.c
+ *
+ * Implementation of the per-user cache directory.
+ */
+
+#define _GNU_SOURCE
+
+#include "cache.h"
+#include "utils.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int cache_path(const char *name, const char *key, const char *ext, char *out, size_t out_size) {
+    char dir[512];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && xdg[0] != '\0') {
+        snprintf(dir, sizeof(dir), "%s", xdg);
+    } else if (home && home[0] != '\0') {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    } else {
+        return -1;
+    }
+    if (ensure_directory_exists(dir) != 0) {
+        return -1;
+    }
+    size_t len = strlen(dir);
+    snprintf(dir + len, sizeof(dir) - len, "/osla");
+    if (ensure_directory_exists(dir) != 0) {
+        return -1;
+    }
+    uint64_t h = hash_casefold(key, strlen(key));
+    int n = snprintf(out, out_size, "%s/%s-%016" PRIx64 ".%s", dir, name, h, ext);
+    return (n < 0 || (size_t)n >= out_size) ? -1 : 0;
+}
+
+int cache_map(const char *path, const unsigned char **base, size_t *size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    *base = map;
+    *size = (size_t)st.st_size;
+    return 0;
+}
+
+void cache_unmap(const unsigned char *base, size_t size) {
+    if (base) munmap((void *)base, size);
+}
+
+int cache_write(const char *path, const void *data, size_t len) {
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+    TraceSpan span;
+    trace_begin(&span, TRACE_OUTPUT_WRITE);
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        trace_end(&span, 0);
+        return -1;
+    }
+    size_t written = fwrite(data, 1, len, fp);
+    int rc = fclose(fp) == 0 && written == len && rename(tmp_path, path) == 0 ? 0 : -1;
+    if (rc != 0) unlink(tmp_path);
+    trace_end(&span, written);
+    return rc;
+}
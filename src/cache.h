@@ -0,0 +1,31 @@
+/* File: src/cache.h
+ *
+ * Header for the per-user cache directory.
+ *
+ * Derived data (search index, fingerprints, ...) lives under
+ * $XDG_CACHE_HOME/osla, or ~/.cache/osla, since the data directory itself
+ * is usually not writable.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+/* Builds the path of a cache file named <name>-<hash of key>.<ext>, so each
+ * data directory (key) gets its own file, creating the cache directory if needed.
+ * Returns 0 on success, -1 if no cache directory is available.
+ */
+int cache_path(const char *name, const char *key, const char *ext, char *out, size_t out_size);
+
+/* Maps a cache file read-only. Returns 0 on success. */
+int cache_map(const char *path, const unsigned char **base, size_t *size);
+
+void cache_unmap(const unsigned char *base, size_t size);
+
+/* Writes data to path through a temporary file and rename, so concurrent
+ * readers never see a partial file. Returns 0 on success.
+ */
+int cache_write(const char *path, const void *data, size_t len);
+
+#endif /* CACHE_H */
@@ -0,0 +1,314 @@
+/* File: src/catalog.c
+ *
+ * Implementation of the license catalog.
+ *
+ * Building reads every license and description once. SPDX ids, categories,
+ * flags and aliases come from db_license_info(): licenses.def and aliases.def
+ * for the licenses osla ships with, the data directory's metadata file for
+ * the rest; licenses neither describes get category "other" and no flags. The full
+ * name is the description's title line. Placeholders are the <...> and
+ * [...] spans made of letters and spaces only, e.g. <YEAR> or
+ * [name of copyright owner].
+ */
+
+#define _GNU_SOURCE
+
+#include "catalog.h"
+#include "cache.h"
+#include "utils.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_PLACEHOLDERS 16
+#define PLACEHOLDER_MAX_LEN 40
+
+static const char *const category_names[] = {
+    [LICENSE_SOFTWARE] = "software",
+    [LICENSE_HARDWARE] = "hardware",
+    [LICENSE_FONT]     = "font",
+    [LICENSE_CONTENT]  = "content",
+    [LICENSE_OTHER]    = "other",
+};
+#define CATEGORY_COUNT ((int)(sizeof(category_names) / sizeof(category_names[0])))
+
+const char *catalog_category_name(int category) {
+    return category >= 0 && category < CATEGORY_COUNT ? category_names[category] : "other";
+}
+
+int catalog_category(const char *name) {
+    for (int i = 0; i < CATEGORY_COUNT; i++) {
+        if (strcasecmp(category_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+/* The built-in metadata is part of the stamp, so a new binary with new
+ * categories, flags or aliases does not keep serving an old catalog.
+ */
+static uint64_t catalog_stamp(const Database *db) {
+    uint64_t h = db_dir_stamp(db);
+    if (h == 0) return 0;
+    for (int i = 0; spdx_map[i].name != NULL; i++) {
+        h = hash_fnv1a(h, spdx_map[i].name, strlen(spdx_map[i].name) + 1);
+        h = hash_fnv1a(h, spdx_map[i].spdx, strlen(spdx_map[i].spdx) + 1);
+        unsigned meta[2] = { (unsigned)spdx_map[i].category, spdx_map[i].flags };
+        h = hash_fnv1a(h, meta, sizeof(meta));
+    }
+    for (int i = 0; alias_map[i].alias != NULL; i++) {
+        h = hash_fnv1a(h, alias_map[i].alias, strlen(alias_map[i].alias) + 1);
+        h = hash_fnv1a(h, alias_map[i].full, strlen(alias_map[i].full) + 1);
+    }
+    return h ? h : 1;
+}
+
+/* ---- builder ---- */
+
+typedef struct {
+    char **names;
+    size_t count, cap;
+} NameList;
+
+static int collect_name(const char *name, void *ctx) {
+    NameList *list = ctx;
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        char **grown = realloc(list->names, cap * sizeof(*grown));
+        if (!grown) return -1;
+        list->names = grown;
+        list->cap = cap;
+    }
+    char *copy = strdup(name);
+    if (!copy) return -1;
+    list->names[list->count++] = copy;
+    return 0;
+}
+
+static uint32_t add_string(StrBuf *strings, const char *s, size_t len) {
+    if (len == 0) return 0;
+    uint32_t off = (uint32_t)strings->len;
+    sb_append(strings, s, len);
+    sb_append(strings, "", 1);
+    return off;
+}
+
+static void collect_placeholders(const char *text, size_t len, StrBuf *out) {
+    const char *found[MAX_PLACEHOLDERS];
+    size_t found_len[MAX_PLACEHOLDERS], count = 0;
+    for (size_t i = 0; i < len && count < MAX_PLACEHOLDERS; i++) {
+        char close = text[i] == '<' ? '>' : text[i] == '[' ? ']' : '\0';
+        if (!close) continue;
+        size_t j = i + 1, letters = 0;
+        while (j < len && j - i <= PLACEHOLDER_MAX_LEN && (isalpha((unsigned char)text[j]) || text[j] == ' ')) {
+            if (text[j] != ' ') letters++;
+            j++;
+        }
+        if (j >= len || text[j] != close || letters == 0) continue;
+        size_t n = j + 1 - i;
+        int seen = 0;
+        for (size_t k = 0; k < count && !seen; k++) {
+            seen = found_len[k] == n && memcmp(found[k], text + i, n) == 0;
+        }
+        if (!seen) {
+            if (count) sb_append(out, ", ", 2);
+            sb_append(out, text + i, n);
+            found[count] = text + i;
+            found_len[count++] = n;
+        }
+        i = j;
+    }
+}
+
+static int build_entry(const Database *db, const char *name, CatalogEntry *e, StrBuf *strings) {
+    DbText text;
+    if (db_get(db, DB_LICENSE, name, &text) != 0) return -1;
+    memset(e, 0, sizeof(*e));
+    e->name_off = add_string(strings, name, strlen(name));
+    e->size = (uint32_t)text.len;
+    e->hash = hash_fnv1a(FNV1A_INIT, text.data, text.len);
+    StrBuf list = {0};
+    collect_placeholders(text.data, text.len, &list);
+    e->placeholders_off = add_string(strings, list.data, list.len);
+    db_text_release(&text);
+    sb_free(&list);
+
+    LicenseInfo info;
+    db_license_info(db, name, &info);
+    e->category = (uint8_t)info.category;
+    e->flags = (uint8_t)info.flags;
+    e->spdx_off = add_string(strings, info.spdx, strlen(info.spdx));
+    e->aliases_off = add_string(strings, info.aliases, strlen(info.aliases));
+
+    /* Title line of the description, without its trailing colon */
+    if (db_get(db, DB_DESCRIPTION, name, &text) == 0) {
+        size_t len = strcspn(text.data, "\r\n");
+        while (len > 0 && (text.data[len - 1] == ':' || isspace((unsigned char)text.data[len - 1]))) len--;
+        e->title_off = add_string(strings, text.data, len);
+        db_text_release(&text);
+    }
+    return 0;
+}
+
+static void pad8(StrBuf *sb) {
+    static const char zeros[8] = {0};
+    if (sb->len % 8) sb_append(sb, zeros, 8 - sb->len % 8);
+}
+
+/* Builds the serialized catalog image into out. */
+static int build_image(const Database *db, StrBuf *out) {
+    NameList list = {0};
+    StrBuf strings = {0};
+    CatalogEntry *entries = NULL;
+    uint32_t *slots = NULL;
+    int rc = -1;
+
+    if (db_each(db, DB_LICENSE, collect_name, &list) != 0) goto out;
+    entries = calloc(list.count ? list.count : 1, sizeof(*entries));
+    if (!entries || sb_append(&strings, "", 1) != 0) goto out;
+    size_t count = 0;
+    for (size_t i = 0; i < list.count; i++) {
+        if (build_entry(db, list.names[i], &entries[count], &strings) == 0) count++;
+    }
+    if (strings.len > UINT32_MAX) goto out;
+
+    CatalogHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    h.version = CATALOG_VERSION;
+    h.count = (uint32_t)count;
+    h.stamp = catalog_stamp(db);
+    h.slot_count = 16;
+    while (h.slot_count < (uint64_t)count * 2) h.slot_count *= 2;
+    slots = calloc(h.slot_count, sizeof(*slots));
+    if (!slots) goto out;
+    for (uint32_t i = 0; i < count; i++) {
+        const char *name = strings.data + entries[i].name_off;
+        size_t at = (size_t)hash_casefold(name, strlen(name)) & (h.slot_count - 1);
+        while (slots[at]) at = (at + 1) & (h.slot_count - 1);
+        slots[at] = i + 1;
+    }
+
+    sb_append(out, (const char *)&h, sizeof(h));
+    pad8(out);
+    h.entries_off = out->len;
+    sb_append(out, (const char *)entries, count * sizeof(*entries));
+    pad8(out);
+    h.slots_off = out->len;
+    sb_append(out, (const char *)slots, h.slot_count * sizeof(*slots));
+    pad8(out);
+    h.strings_off = out->len;
+    if (sb_append(out, strings.data, strings.len) != 0) goto out;
+    h.total_size = out->len;
+    memcpy(out->data, &h, sizeof(h));
+    rc = 0;
+
+out:
+    for (size_t i = 0; i < list.count; i++) free(list.names[i]);
+    free(list.names);
+    free(entries);
+    free(slots);
+    sb_free(&strings);
+    return rc;
+}
+
+int catalog_build(const Database *db, const char *path) {
+    StrBuf image = {0};
+    int rc = build_image(db, &image) == 0 ? cache_write(path, image.data, image.len) : -1;
+    sb_free(&image);
+    return rc;
+}
+
+/* ---- reader ---- */
+
+static int catalog_attach(Catalog *cat, const unsigned char *base, size_t size) {
+    const CatalogHeader *h = (const CatalogHeader *)base;
+    if (size < sizeof(*h) || memcmp(h->magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 ||
+        h->version != CATALOG_VERSION || h->total_size != size ||
+        h->entries_off + (uint64_t)h->count * sizeof(CatalogEntry) > size ||
+        h->slot_count == 0 || (h->slot_count & (h->slot_count - 1)) != 0 || h->slot_count <= h->count ||
+        h->slots_off + h->slot_count * sizeof(uint32_t) > size ||
+        h->strings_off >= size || base[size - 1] != '\0') {
+        return -1;
+    }
+    const CatalogEntry *entries = (const CatalogEntry *)(base + h->entries_off);
+    const uint32_t *slots = (const uint32_t *)(base + h->slots_off);
+    uint64_t strings_len = size - h->strings_off;
+    for (uint64_t i = 0; i < h->slot_count; i++) {
+        if (slots[i] > h->count) return -1;
+    }
+    for (uint32_t i = 0; i < h->count; i++) {
+        const CatalogEntry *e = &entries[i];
+        if (e->name_off >= strings_len || e->spdx_off >= strings_len || e->title_off >= strings_len ||
+            e->aliases_off >= strings_len || e->placeholders_off >= strings_len) {
+            return -1;
+        }
+    }
+    cat->base = base;
+    cat->size = size;
+    cat->header = h;
+    cat->entries = entries;
+    cat->slots = slots;
+    cat->strings = (const char *)(base + h->strings_off);
+    return 0;
+}
+
+/* Maps the catalog at path if it describes the current data. */
+static int catalog_map(Catalog *cat, const char *path, uint64_t stamp) {
+    const unsigned char *base;
+    size_t size;
+    if (cache_map(path, &base, &size) != 0) return -1;
+    if (catalog_attach(cat, base, size) != 0 || cat->header->stamp != stamp) {
+        cache_unmap(base, size);
+        memset(cat, 0, sizeof(*cat));
+        return -1;
+    }
+    return 0;
+}
+
+int catalog_open(Catalog *cat, const Database *db) {
+    memset(cat, 0, sizeof(*cat));
+    if (db->backend != DB_BACKEND_EMBEDDED) {
+        uint64_t stamp = catalog_stamp(db);
+        char path[600];
+        snprintf(path, sizeof(path), "%s/%s", db->datadir, CATALOG_FILENAME);
+        if (catalog_map(cat, path, stamp) == 0) {
+            return 0;
+        }
+        if (cache_path("catalog", db->datadir, "cat", path, sizeof(path)) == 0) {
+            if (catalog_map(cat, path, stamp) == 0) {
+                return 0;
+            }
+            if (catalog_build(db, path) == 0 && catalog_map(cat, path, stamp) == 0) {
+                return 0;
+            }
+        }
+    }
+    /* Embedded data, or no usable cache: keep the image in memory for this run */
+    StrBuf image = {0};
+    if (build_image(db, &image) != 0 || catalog_attach(cat, (const unsigned char *)image.data, image.len) != 0) {
+        sb_free(&image);
+        return -1;
+    }
+    cat->heap = image.data;
+    return 0;
+}
+
+void catalog_close(Catalog *cat) {
+    if (cat->heap) {
+        free(cat->heap);
+    } else if (cat->base) {
+        cache_unmap(cat->base, cat->size);
+    }
+    memset(cat, 0, sizeof(*cat));
+}
+
+const CatalogEntry *catalog_find(const Catalog *cat, const char *name) {
+    size_t mask = (size_t)cat->header->slot_count - 1;
+    for (size_t at = (size_t)hash_casefold(name, strlen(name)) & mask; cat->slots[at]; at = (at + 1) & mask) {
+        const CatalogEntry *e = &cat->entries[cat->slots[at] - 1];
+        if (strcasecmp(catalog_str(cat, e->name_off), name) == 0) return e;
+    }
+    return NULL;
+}
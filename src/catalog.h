@@ -0,0 +1,88 @@
+/* File: src/catalog.h
+ *
+ * Header for the license catalog.
+ *
+ * The catalog is one file holding the metadata of every license in the data
+ * directory: SPDX id, full name, aliases, category, OSI/FSF flags, text size,
+ * placeholders and a content hash. It is written at install time next to the
+ * data (make catalog, osla --build-catalog) and otherwise built on demand
+ * into the cache directory, so --list and the category filters read this one
+ * file instead of every license and description. It is rebuilt when
+ * db_dir_stamp() no longer matches.
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "db.h"
+#include "license.h"
+
+#define CATALOG_MAGIC "OSLACAT"
+#define CATALOG_VERSION 2
+#define CATALOG_FILENAME "osla.catalog"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t stamp;         /* db_dir_stamp() mixed with the built-in metadata */
+    uint64_t entries_off;   /* CatalogEntry[count], in database order */
+    uint64_t slots_off;     /* uint32_t[slot_count]: entry index + 1 by name hash, 0 if empty */
+    uint64_t slot_count;    /* a power of two, at most half full */
+    uint64_t strings_off;   /* NUL-terminated strings; offset 0 is "" */
+    uint64_t total_size;
+} CatalogHeader;
+
+/* String fields are offsets into the strings area. aliases and placeholders
+ * are comma-separated lists.
+ */
+typedef struct {
+    uint32_t name_off;
+    uint32_t spdx_off;
+    uint32_t title_off;
+    uint32_t aliases_off;
+    uint32_t placeholders_off;
+    uint32_t size;          /* bytes of license text */
+    uint8_t category;       /* LicenseCategory */
+    uint8_t flags;          /* LICENSE_OSI, LICENSE_FSF */
+    uint16_t reserved;
+    uint64_t hash;          /* FNV-1a of the license text */
+} CatalogEntry;
+
+typedef struct {
+    const unsigned char *base;
+    size_t size;
+    const CatalogHeader *header;
+    const CatalogEntry *entries;
+    const uint32_t *slots;
+    const char *strings;
+    char *heap;             /* set when the image lives in memory instead of a mapping */
+} Catalog;
+
+/* Opens the catalog of db: the installed one in the data directory if it is
+ * current, else the cached one, else a freshly built one (saved to the cache).
+ * Returns 0 on success, -1 if the licenses cannot be read.
+ */
+int catalog_open(Catalog *cat, const Database *db);
+
+void catalog_close(Catalog *cat);
+
+/* Builds the catalog of db and writes it to path. Returns 0 on success. */
+int catalog_build(const Database *db, const char *path);
+
+static inline const char *catalog_str(const Catalog *cat, uint32_t off) {
+    return cat->strings + off;
+}
+
+/* Finds the entry of a license name (case-insensitive), or NULL. */
+const CatalogEntry *catalog_find(const Catalog *cat, const char *name);
+
+/* Name of a category ("software", ...), and the reverse mapping
+ * (case-insensitive). catalog_category returns -1 for an unknown name.
+ */
+const char *catalog_category_name(int category);
+int catalog_category(const char *name);
+
+#endif /* CATALOG_H */
@@ -0,0 +1,429 @@
+/* File: src/check.c
+ *
+ * Implementation of LICENSE verification.
+ *
+ * Expected licenses are resolved (or identified) and matched with their
+ * compiled templates up front. Workers then render each target in memory and
+ * compare: equal sizes and bytes settle it. Otherwise both texts are split
+ * into lines hashed with whitespace runs collapsed, and Myers' O(ND) diff
+ * over those hashes yields the edit script. An empty script means the file
+ * differs in whitespace only and passes. Reports are printed in argument
+ * order once all are done.
+ */
+
+#define _GNU_SOURCE
+
+#include "check.h"
+#include "detect.h"
+#include "io.h"
+#include "pool.h"
+#include "suggest.h"
+#include "template.h"
+#include "utils.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Lines of context around each change */
+#define DIFF_CONTEXT 3
+/* Edit distance beyond which a file is shown as replaced wholesale */
+#define DIFF_MAX_D 1000
+/* Diff lines printed per file */
+#define DIFF_MAX_LINES 60
+
+typedef enum {
+    CHECK_PENDING,
+    CHECK_MATCH,
+    CHECK_WHITESPACE,       /* differs in whitespace only */
+    CHECK_DIFFERS,
+    CHECK_MISSING,
+    CHECK_FAILED
+} CheckStatus;
+
+typedef struct {
+    const char *path;
+    char file[4096];        /* the file compared */
+    char license[64];
+    const TemplateEntry *tmpl;
+    CheckStatus status;
+    const char *error;
+    StrBuf report;          /* unified diff */
+} CheckTarget;
+
+typedef struct {
+    CheckTarget *targets;
+    const TemplateSet *templates;
+    const TemplateValues *values;
+    const Detector *det;
+} CheckJob;
+
+typedef struct {
+    const char *text;
+    size_t len;
+    uint64_t hash;          /* of the line with whitespace runs collapsed */
+} Line;
+
+typedef enum { EDIT_KEEP, EDIT_DELETE, EDIT_INSERT } EditKind;
+
+typedef struct {
+    EditKind kind;
+    size_t a, b;            /* line indexes in the file and the expected text */
+} Edit;
+
+static const char LICENSE_NOT_FOUND[] = "license not found";
+
+/* ---- lines ---- */
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static uint64_t line_hash(const char *p, size_t len) {
+    uint64_t h = FNV1A_INIT;
+    int started = 0, pending = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (is_space(p[i])) {
+            pending = started;
+            continue;
+        }
+        if (pending) h = (h ^ ' ') * FNV1A_PRIME;
+        started = 1;
+        pending = 0;
+        h = (h ^ (unsigned char)p[i]) * FNV1A_PRIME;
+    }
+    return h;
+}
+
+static Line *split_lines(const char *text, size_t len, size_t *count) {
+    size_t cap = 1;
+    for (size_t i = 0; i < len; i++) cap += text[i] == '\n';
+    Line *lines = malloc(cap * sizeof(*lines));
+    if (!lines) return NULL;
+    size_t n = 0;
+    for (const char *p = text, *end = text + len; p < end;) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        lines[n].text = p;
+        lines[n].len = (size_t)(line_end - p);
+        lines[n].hash = line_hash(p, lines[n].len);
+        n++;
+        p = line_end + 1;
+    }
+    *count = n;
+    return lines;
+}
+
+/* ---- diff ---- */
+
+/* Computes the shortest edit script from a to b (Myers 1986), keeping the V
+ * array of every round for the walk back. Returns the number of edits stored
+ * in *out (caller frees), or -1 on allocation failure. Scripts longer than
+ * DIFF_MAX_D edits are replaced by deleting all of a and inserting all of b.
+ */
+static long diff_lines(const Line *a, size_t n, const Line *b, size_t m, Edit **out) {
+    size_t max_d = n + m < DIFF_MAX_D ? n + m : DIFF_MAX_D;
+    /* Round d keeps V[-d..d] at trace[d * d] */
+    int32_t *trace = malloc((max_d + 1) * (max_d + 1) * sizeof(*trace));
+    int32_t *v = malloc((2 * max_d + 3) * sizeof(*v));
+    Edit *edits = malloc((n + m + 1) * sizeof(*edits));
+    if (!trace || !v || !edits) {
+        free(trace);
+        free(v);
+        free(edits);
+        return -1;
+    }
+    long off = (long)max_d + 1;
+    long found = -1;
+    v[off + 1] = 0;
+    for (long d = 0; d <= (long)max_d && found < 0; d++) {
+        for (long k = -d; k <= d; k += 2) {
+            long x;
+            if (k == -d || (k != d && v[off + k - 1] < v[off + k + 1])) {
+                x = v[off + k + 1];
+            } else {
+                x = v[off + k - 1] + 1;
+            }
+            long y = x - k;
+            while (x < (long)n && y < (long)m && a[x].hash == b[y].hash) {
+                x++;
+                y++;
+            }
+            v[off + k] = (int32_t)x;
+            if (x >= (long)n && y >= (long)m) {
+                found = d;
+                break;
+            }
+        }
+        memcpy(&trace[d * d], &v[off - d], (size_t)(2 * d + 1) * sizeof(*trace));
+    }
+
+    size_t count = 0;
+    if (found < 0) {
+        for (size_t i = 0; i < n; i++) edits[count++] = (Edit){ EDIT_DELETE, i, 0 };
+        for (size_t j = 0; j < m; j++) edits[count++] = (Edit){ EDIT_INSERT, n, j };
+    } else {
+        /* Walk back from (n, m), emitting the script in reverse */
+        long x = (long)n, y = (long)m;
+        for (long d = found; d >= 0; d--) {
+            long k = x - y, prev_k = 0, prev_x = 0, prev_y = 0;
+            if (d > 0) {
+                const int32_t *pv = &trace[(d - 1) * (d - 1)] + (d - 1);    /* pv[k] is V[k] of round d-1 */
+                prev_k = (k == -d || (k != d && pv[k - 1] < pv[k + 1])) ? k + 1 : k - 1;
+                prev_x = pv[prev_k];
+                prev_y = prev_x - prev_k;
+            }
+            while (x > prev_x && y > prev_y) {
+                x--;
+                y--;
+                edits[count++] = (Edit){ EDIT_KEEP, (size_t)x, (size_t)y };
+            }
+            if (d > 0) {
+                if (prev_k == k + 1) {
+                    edits[count++] = (Edit){ EDIT_INSERT, (size_t)x, (size_t)prev_y };
+                } else {
+                    edits[count++] = (Edit){ EDIT_DELETE, (size_t)prev_x, (size_t)y };
+                }
+                x = prev_x;
+                y = prev_y;
+            }
+        }
+        for (size_t i = 0; i < count / 2; i++) {
+            Edit t = edits[i];
+            edits[i] = edits[count - 1 - i];
+            edits[count - 1 - i] = t;
+        }
+    }
+    free(trace);
+    free(v);
+    *out = edits;
+    return (long)count;
+}
+
+static void report_line(StrBuf *out, char tag, const Line *line, size_t *printed) {
+    if ((*printed)++ == DIFF_MAX_LINES) {
+        sb_append_str(out, "...\n");
+        return;
+    }
+    if (*printed > DIFF_MAX_LINES) return;
+    size_t len = line->len;
+    if (len > 0 && line->text[len - 1] == '\r') len--;
+    sb_append(out, &tag, 1);
+    sb_append(out, line->text, len);
+    sb_append(out, "\n", 1);
+}
+
+/* Appends the edits as unified diff hunks. */
+static void format_hunks(StrBuf *out, const Edit *edits, size_t count, const Line *a, const Line *b) {
+    size_t printed = 0;
+    for (size_t i = 0; i < count;) {
+        if (edits[i].kind == EDIT_KEEP) {
+            i++;
+            continue;
+        }
+        /* Extend the hunk while the next change is within two contexts */
+        size_t start = i > DIFF_CONTEXT ? i - DIFF_CONTEXT : 0;
+        size_t end = i, keep_run = 0;
+        for (size_t j = i; j < count; j++) {
+            if (edits[j].kind == EDIT_KEEP) {
+                if (++keep_run > 2 * DIFF_CONTEXT) break;
+            } else {
+                keep_run = 0;
+                end = j + 1;
+            }
+        }
+        end = end + DIFF_CONTEXT < count ? end + DIFF_CONTEXT : count;
+        size_t a_len = 0, b_len = 0;
+        for (size_t j = start; j < end; j++) {
+            a_len += edits[j].kind != EDIT_INSERT;
+            b_len += edits[j].kind != EDIT_DELETE;
+        }
+        char header[96];
+        snprintf(header, sizeof(header), "@@ -%zu,%zu +%zu,%zu @@\n",
+                 edits[start].a + (a_len > 0), a_len, edits[start].b + (b_len > 0), b_len);
+        if (printed < DIFF_MAX_LINES) sb_append_str(out, header);
+        for (size_t j = start; j < end; j++) {
+            const Edit *e = &edits[j];
+            if (e->kind == EDIT_KEEP) {
+                report_line(out, ' ', &a[e->a], &printed);
+            } else if (e->kind == EDIT_DELETE) {
+                report_line(out, '-', &a[e->a], &printed);
+            } else {
+                report_line(out, '+', &b[e->b], &printed);
+            }
+        }
+        i = end;
+    }
+}
+
+/* Compares the file with the expected text, setting the status and report. */
+static void compare_texts(CheckTarget *t, const char *text, size_t len, const char *expected, size_t expected_len) {
+    if (len == expected_len && memcmp(text, expected, len) == 0) {
+        t->status = CHECK_MATCH;
+        return;
+    }
+    size_t n, m;
+    Line *a = split_lines(text, len, &n);
+    Line *b = split_lines(expected, expected_len, &m);
+    Edit *edits = NULL;
+    long count = a && b ? diff_lines(a, n, b, m, &edits) : -1;
+    if (count < 0) {
+        t->status = CHECK_FAILED;
+        t->error = "out of memory";
+    } else {
+        int changed = 0;
+        for (long i = 0; i < count && !changed; i++) changed = edits[i].kind != EDIT_KEEP;
+        t->status = changed ? CHECK_DIFFERS : CHECK_WHITESPACE;
+        if (changed) {
+            sb_append_str(&t->report, "--- ");
+            sb_append_str(&t->report, t->file);
+            sb_append_str(&t->report, "\n+++ expected (");
+            sb_append_str(&t->report, t->license);
+            sb_append_str(&t->report, ")\n");
+            format_hunks(&t->report, edits, (size_t)count, a, b);
+        }
+    }
+    free(edits);
+    free(a);
+    free(b);
+}
+
+/* ---- workers ---- */
+
+static void identify_target(size_t index, void *ctx) {
+    CheckJob *job = ctx;
+    CheckTarget *t = &job->targets[index];
+    if (t->status != CHECK_PENDING) return;
+    size_t len;
+    char *text = read_file(t->file, &len);
+    if (!text) {
+        t->status = CHECK_FAILED;
+        t->error = "unreadable";
+        return;
+    }
+    DetectMatch match;
+    if (detector_identify(job->det, text, len, &match) != 0) {
+        t->status = CHECK_FAILED;
+        t->error = "out of memory";
+    } else if (!match.license || match.confidence < 0.5) {
+        t->status = CHECK_FAILED;
+        t->error = "license not recognized";
+    } else {
+        snprintf(t->license, sizeof(t->license), "%s", match.license);
+    }
+    free(text);
+}
+
+static void check_target(size_t index, void *ctx) {
+    CheckJob *job = ctx;
+    CheckTarget *t = &job->targets[index];
+    if (t->status != CHECK_PENDING) return;
+    size_t len;
+    char *text = read_file(t->file, &len);
+    StrBuf expected = {0};
+    if (!text) {
+        t->status = CHECK_FAILED;
+        t->error = "unreadable";
+    } else if (template_render(job->templates, t->tmpl, job->values, &expected) != 0) {
+        t->status = CHECK_FAILED;
+        t->error = "out of memory";
+    } else {
+        compare_texts(t, text, len, expected.data, expected.len);
+    }
+    sb_free(&expected);
+    free(text);
+}
+
+int run_check(char **paths, int count, const char *license, const Database *db,
+              const Config *config, int threads) {
+    CheckTarget *targets = calloc(count > 0 ? (size_t)count : 1, sizeof(*targets));
+    if (!targets) {
+        print_error("Out of memory");
+        return -1;
+    }
+    char resolved[64] = "";
+    if (license && db_resolve_alias(db, license, resolved, sizeof(resolved)) != 0) {
+        snprintf(resolved, sizeof(resolved), "%s", license);
+    }
+    for (int i = 0; i < count; i++) {
+        CheckTarget *t = &targets[i];
+        struct stat st;
+        t->path = paths[i];
+        snprintf(t->license, sizeof(t->license), "%s", resolved);
+        int is_dir = stat(paths[i], &st) == 0 && S_ISDIR(st.st_mode);
+        int n = is_dir ? snprintf(t->file, sizeof(t->file), "%s/%s", paths[i], config->output)
+                       : snprintf(t->file, sizeof(t->file), "%s", paths[i]);
+        if ((size_t)n >= sizeof(t->file)) {
+            t->status = CHECK_FAILED;
+            t->error = "path too long";
+        } else if (stat(t->file, &st) != 0) {
+            t->status = CHECK_MISSING;
+        }
+    }
+
+    CheckJob job = { targets, NULL, NULL, NULL };
+    Detector det;
+    int rc = 0;
+    if (!license) {
+        if (detector_open(&det, db, config) != 0) {
+            print_error("Unable to load license fingerprints");
+            free(targets);
+            return -1;
+        }
+        job.det = &det;
+        pool_run((size_t)count, threads, identify_target, &job);
+        detector_close(&det);
+    }
+
+    TemplateSet templates;
+    if (template_set_open(&templates, db, config) != 0) {
+        print_error("Unable to compile the license templates");
+        free(targets);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (targets[i].status == CHECK_PENDING && !template_get(&templates, targets[i].license)) {
+            targets[i].status = CHECK_FAILED;
+            targets[i].error = LICENSE_NOT_FOUND;
+        }
+    }
+    /* template_get() may have recompiled the set, so entries are looked up afterwards */
+    for (int i = 0; i < count; i++) {
+        if (targets[i].status == CHECK_PENDING) targets[i].tmpl = template_find(&templates, targets[i].license);
+    }
+
+    TemplateValues values;
+    template_values(&values, config, NULL, NULL);
+    job.templates = &templates;
+    job.values = &values;
+    pool_run((size_t)count, threads, check_target, &job);
+
+    size_t tally[CHECK_FAILED + 1] = {0};
+    for (int i = 0; i < count; i++) {
+        CheckTarget *t = &targets[i];
+        tally[t->status]++;
+        if (t->status == CHECK_DIFFERS) {
+            printf("DIFFERS %s (%s)\n", t->file, t->license);
+            fwrite(t->report.data, 1, t->report.len, stdout);
+        } else if (t->status == CHECK_MISSING) {
+            printf("MISSING %s\n", t->file);
+        } else if (t->status == CHECK_FAILED) {
+            char hint[256] = "";
+            if (t->error == LICENSE_NOT_FOUND && suggest_hint(db, t->license, hint + 1, sizeof(hint) - 1) == 0) {
+                hint[0] = '.';
+            }
+            printf("FAILED  %s%s%s%s: %s%s\n", t->file, t->license[0] ? " (" : "", t->license,
+                   t->license[0] ? ")" : "", t->error, hint);
+        }
+        sb_free(&t->report);
+    }
+    printf("Check complete: %zu match", tally[CHECK_MATCH] + tally[CHECK_WHITESPACE]);
+    if (tally[CHECK_WHITESPACE]) printf(" (%zu ignoring whitespace)", tally[CHECK_WHITESPACE]);
+    printf(", %zu differ, %zu missing, %zu failed.\n", tally[CHECK_DIFFERS], tally[CHECK_MISSING], tally[CHECK_FAILED]);
+    if (tally[CHECK_DIFFERS] || tally[CHECK_MISSING] || tally[CHECK_FAILED]) rc = -1;
+
+    template_set_close(&templates);
+    free(targets);
+    return rc;
+}
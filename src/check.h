@@ -0,0 +1,27 @@
+/* File: src/check.h
+ *
+ * Header for LICENSE verification (--check).
+ *
+ * Each path (a LICENSE file, or a directory holding the configured output
+ * file) is compared with the text osla would render for it with the current
+ * config. Files that match byte for byte cost one read and a memcmp; only a
+ * mismatch pays for a whitespace-normalized line diff, which decides whether
+ * the file really drifted and is printed as a compact unified diff.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "config.h"
+#include "db.h"
+
+/* Checks the count paths on up to threads workers (threads <= 0 means one
+ * per CPU). license is the expected license for every path; when NULL, each
+ * file is expected to hold the license the detector identifies in it.
+ * Prints a diff for every file that differs, then a summary. Returns 0 if
+ * every file matches (ignoring whitespace), -1 otherwise.
+ */
+int run_check(char **paths, int count, const char *license, const Database *db,
+              const Config *config, int threads);
+
+#endif /* CHECK_H */
@@ -8,10 +8,12 @@
 
 #include "config.h"
 #include "io.h"
+#include "trace.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 
 #define CONFIG_DIR "~/.config/OSLA"
@@ -19,6 +21,111 @@
 #define DEFAULT_AUTHOR "author"
 #define DEFAULT_YEAR "2025"
 #define DEFAULT_LICENSE "mit"
+#define DEFAULT_OUTPUT "LICENSE"
+
+/* Placeholder spellings used by the bundled license texts. Written to new
+ * config files and used whenever a config file declares no token lines
+ * for every license.
+ */
+static const ConfigToken default_tokens[] = {
+    { "year",   "<YEAR>", "" },
+    { "year",   "[yyyy]", "" },
+    { "year",   "[year]", "" },
+    { "author", "<AUTHOR>", "" },
+    { "author", "[name of copyright owner]", "" },
+    { "author", "[fullname]", "" },
+    { "author", "<COPYRIGHT HOLDER>", "" },
+    { "author", "[copyright holder]", "" },
+};
+#define DEFAULT_TOKEN_COUNT ((int)(sizeof(default_tokens) / sizeof(default_tokens[0])))
+
+/* Parses a "field[@license]:spelling" token value. Returns 0 on success. */
+static int parse_token(const char *value, ConfigToken *token) {
+    const char *colon = strchr(value, ':');
+    if (!colon || colon == value || colon[1] == '\0') {
+        return -1;
+    }
+    const char *at = memchr(value, '@', (size_t)(colon - value));
+    size_t field_len = (size_t)((at ? at : colon) - value);
+    size_t license_len = at ? (size_t)(colon - at - 1) : 0;
+    if (field_len == 0 || field_len >= sizeof(token->field) || (at && license_len == 0) ||
+        license_len >= sizeof(token->license) || strlen(colon + 1) >= sizeof(token->text)) {
+        return -1;
+    }
+    memcpy(token->field, value, field_len);
+    token->field[field_len] = '\0';
+    memcpy(token->license, at ? at + 1 : "", license_len);
+    token->license[license_len] = '\0';
+    strcpy(token->text, colon + 1);
+    return 0;
+}
+
+/* Parses an "alias:license" value. Returns 0 on success. */
+static int parse_alias(const char *value, ConfigAlias *alias) {
+    const char *colon = strchr(value, ':');
+    if (!colon || colon == value || colon[1] == '\0') {
+        return -1;
+    }
+    size_t alias_len = (size_t)(colon - value);
+    if (alias_len >= sizeof(alias->alias) || strlen(colon + 1) >= sizeof(alias->license)) {
+        return -1;
+    }
+    memcpy(alias->alias, value, alias_len);
+    alias->alias[alias_len] = '\0';
+    strcpy(alias->license, colon + 1);
+    return 0;
+}
+
+/* Finds the slot holding name, or the empty slot where it belongs. */
+static size_t alias_slot(const Config *config, const char *name) {
+    size_t mask = CONFIG_ALIAS_SLOTS - 1;
+    size_t i = (size_t)hash_casefold(name, strlen(name)) & mask;
+    while (config->alias_slots[i] &&
+           strcasecmp(config->aliases[config->alias_slots[i] - 1].alias, name) != 0) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/* Adds a parsed alias; a later line for the same alias replaces the earlier one. */
+static void add_alias(Config *config, const ConfigAlias *alias) {
+    size_t slot = alias_slot(config, alias->alias);
+    if (config->alias_slots[slot]) {
+        config->aliases[config->alias_slots[slot] - 1] = *alias;
+        return;
+    }
+    config->aliases[config->alias_count] = *alias;
+    config->alias_slots[slot] = (unsigned char)++config->alias_count;
+}
+
+int config_parse_mode(const char *value) {
+    char *end;
+    long mode = strtol(value, &end, 8);
+    if (end == value || *end != '\0' || mode < 0 || mode > 07777) {
+        return -1;
+    }
+    return (int)mode;
+}
+
+const char *config_find_alias(const Config *config, const char *name) {
+    if (!config || config->alias_count == 0) {
+        return NULL;
+    }
+    size_t slot = alias_slot(config, name);
+    return config->alias_slots[slot] ? config->aliases[config->alias_slots[slot] - 1].license : NULL;
+}
+
+/* Adds the built-in spellings unless the config declared spellings of its own
+ * for every license; per-license spellings alone keep the built-in set.
+ */
+void config_finish(Config *config) {
+    for (int i = 0; i < config->token_count; i++) {
+        if (config->tokens[i].license[0] == '\0') return;
+    }
+    for (int i = 0; i < DEFAULT_TOKEN_COUNT && config->token_count < CONFIG_MAX_TOKENS; i++) {
+        config->tokens[config->token_count++] = default_tokens[i];
+    }
+}
 
 /* Helper function to expand home directory shorthand ~ */
 static void expand_home(char *path, size_t size) {
@@ -34,14 +141,80 @@ static void expand_home(char *path, size_t size) {
     }
 }
 
-int load_config(Config *config, int debug) {
-    /* Set defaults first */
-    strncpy(config->author, DEFAULT_AUTHOR, sizeof(config->author));
-    strncpy(config->year, DEFAULT_YEAR, sizeof(config->year));
-    strncpy(config->default_license, DEFAULT_LICENSE, sizeof(config->default_license));
-    
-    char config_path[256] = CONFIG_PATH;
-    expand_home(config_path, sizeof(config_path));
+void config_file_path(char *out, size_t size) {
+    snprintf(out, size, "%s", CONFIG_PATH);
+    expand_home(out, size);
+}
+
+void config_defaults(Config *config) {
+    memset(config, 0, sizeof(*config));
+    snprintf(config->author, sizeof(config->author), "%s", DEFAULT_AUTHOR);
+    snprintf(config->year, sizeof(config->year), "%s", DEFAULT_YEAR);
+    snprintf(config->default_license, sizeof(config->default_license), "%s", DEFAULT_LICENSE);
+    snprintf(config->output, sizeof(config->output), "%s", DEFAULT_OUTPUT);
+    config->output_mode = -1;
+}
+
+int config_set(Config *config, const char *key, const char *value, int debug) {
+    if (strcmp(key, "author") == 0) {
+        strncpy(config->author, value, sizeof(config->author));
+        config->author[sizeof(config->author)-1] = '\0';
+    } else if (strcmp(key, "year") == 0) {
+        strncpy(config->year, value, sizeof(config->year));
+        config->year[sizeof(config->year)-1] = '\0';
+    } else if (strcmp(key, "project") == 0) {
+        snprintf(config->project, sizeof(config->project), "%s", value);
+    } else if (strcmp(key, "url") == 0) {
+        snprintf(config->url, sizeof(config->url), "%s", value);
+    } else if (strcmp(key, "default_license") == 0) {
+        strncpy(config->default_license, value, sizeof(config->default_license));
+        config->default_license[sizeof(config->default_license)-1] = '\0';
+    } else if (strcmp(key, "output") == 0) {
+        if (value[0] == '\0') return -1;
+        strncpy(config->output, value, sizeof(config->output));
+        config->output[sizeof(config->output)-1] = '\0';
+    } else if (strcmp(key, "mode") == 0) {
+        config->output_mode = config_parse_mode(value);
+        if (config->output_mode < 0) {
+            print_error("Ignoring invalid mode in config; expected an octal mode such as 0644");
+            return -1;
+        }
+    } else if (strcmp(key, "token") == 0) {
+        if (config->token_count >= CONFIG_MAX_TOKENS) {
+            print_error("Too many token entries in config; ignoring the rest");
+            return -1;
+        }
+        if (parse_token(value, &config->tokens[config->token_count]) != 0) {
+            if (debug) {
+                debug_print("Ignoring malformed token entry in config");
+            }
+            return -1;
+        }
+        config->token_count++;
+    } else if (strcmp(key, "alias") == 0) {
+        ConfigAlias alias;
+        if (parse_alias(value, &alias) != 0) {
+            if (debug) {
+                debug_print("Ignoring malformed alias entry in config");
+            }
+            return -1;
+        }
+        if (config->alias_count >= CONFIG_MAX_ALIASES && !config_find_alias(config, alias.alias)) {
+            print_error("Too many alias entries in config; ignoring the rest");
+            return -1;
+        }
+        add_alias(config, &alias);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int read_config(Config *config, int debug, size_t *bytes) {
+    config_defaults(config);
+
+    char config_path[256];
+    config_file_path(config_path, sizeof(config_path));
     
     FILE *fp = fopen(config_path, "r");
     if (!fp) {
@@ -58,39 +231,43 @@ int load_config(Config *config, int debug) {
             return -1;
         }
         fprintf(fp, "author=%s\nyear=%s\ndefault_license=%s\n", DEFAULT_AUTHOR, DEFAULT_YEAR, DEFAULT_LICENSE);
+        for (int i = 0; i < DEFAULT_TOKEN_COUNT; i++) {
+            fprintf(fp, "token=%s:%s\n", default_tokens[i].field, default_tokens[i].text);
+        }
         fclose(fp);
+        config_finish(config);
         if (debug) {
             debug_print("Default configuration file created");
         }
         return 0;
     }
     
-    char line[256];
+    char line[512];
     while (fgets(line, sizeof(line), fp)) {
+        *bytes += strlen(line);
         trim_newline(line);
         char *eq = strchr(line, '=');
         if (!eq) continue;
         *eq = '\0';
-        char *key = line;
-        char *value = eq + 1;
-        if (strcmp(key, "author") == 0) {
-            strncpy(config->author, value, sizeof(config->author));
-            config->author[sizeof(config->author)-1] = '\0';
-        } else if (strcmp(key, "year") == 0) {
-            strncpy(config->year, value, sizeof(config->year));
-            config->year[sizeof(config->year)-1] = '\0';
-        } else if (strcmp(key, "default_license") == 0) {
-            strncpy(config->default_license, value, sizeof(config->default_license));
-            config->default_license[sizeof(config->default_license)-1] = '\0';
-        }
+        config_set(config, line, eq + 1, debug);
     }
     fclose(fp);
+    config_finish(config);
     if (debug) {
         debug_print("Configuration loaded successfully");
     }
     return 0;
 }
 
+int load_config(Config *config, int debug) {
+    TraceSpan span;
+    size_t bytes = 0;
+    trace_begin(&span, TRACE_CONFIG_LOAD);
+    int rc = read_config(config, debug, &bytes);
+    trace_end(&span, bytes);
+    return rc;
+}
+
 void free_config(Config *config) {
     (void)config;
 }
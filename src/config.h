@@ -8,10 +8,44 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <stddef.h>
+
+#define CONFIG_MAX_TOKENS 32
+#define CONFIG_MAX_ALIASES 64
+/* Open-addressing slots for the site aliases; a power of two, at most half full */
+#define CONFIG_ALIAS_SLOTS 128
+
+/* A placeholder spelling and the config field it expands to, declared in the
+ * config file as "token=<field>:<spelling>", or "token=<field>@<license>:<spelling>"
+ * for a spelling that only one license uses.
+ */
+typedef struct {
+    char field[16];
+    char text[48];
+    char license[64];       /* empty: every license */
+} ConfigToken;
+
+/* A site-local alias, declared in the config file as "alias=<alias>:<license>".
+ * Site aliases take precedence over the built-in ones.
+ */
+typedef struct {
+    char alias[64];
+    char license[64];
+} ConfigAlias;
+
 typedef struct {
-    char author[128];
-    char year[16];
+    char author[256];       /* copyright holders, separated by ';' */
+    char year[16];          /* a year or range; "2019-" runs to the current year */
+    char project[128];
+    char url[256];
     char default_license[64];
+    char output[256];       /* file written by "osla <license>" (default LICENSE) */
+    int output_mode;        /* permission bits for it, or -1 to keep/default them */
+    ConfigToken tokens[CONFIG_MAX_TOKENS];
+    int token_count;
+    ConfigAlias aliases[CONFIG_MAX_ALIASES];
+    int alias_count;
+    unsigned char alias_slots[CONFIG_ALIAS_SLOTS];  /* index + 1 into aliases, 0 if empty */
 } Config;
 
 /* Loads the configuration from ~/.config/osla/osla.conf.
@@ -20,6 +54,29 @@ typedef struct {
  */
 int load_config(Config *config, int debug);
 
+/* Writes the path of the user config file (~/.config/OSLA/osla.conf). */
+void config_file_path(char *out, size_t size);
+
+/* Resets config to the built-in defaults without reading any file; call
+ * config_finish() once the settings are applied.
+ */
+void config_defaults(Config *config);
+
+/* Applies one "key=value" setting as it would appear in the config file
+ * (author, year, project, url, default_license, output, mode, token, alias).
+ * Returns 0 on success, -1 for an unknown key or an invalid value.
+ */
+int config_set(Config *config, const char *key, const char *value, int debug);
+
+/* Adds the built-in placeholder spellings unless the settings declared their own. */
+void config_finish(Config *config);
+
+/* Parses an octal permission mode such as "0644". Returns it, or -1 if invalid. */
+int config_parse_mode(const char *value);
+
+/* Returns the license a site alias stands for (case-insensitive), or NULL. */
+const char *config_find_alias(const Config *config, const char *name);
+
 /* Frees resources allocated for the configuration.
  * Currently a stub since Config uses static allocations.
  */
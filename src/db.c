@@ -0,0 +1,379 @@
+/* File: src/db.c
+ *
+ * Implementation of the license database.
+ *
+ * Prefers <datadir>/osla.bundle and falls back to the loose-file layout
+ * (<datadir>/licenses/<name>.txt, <datadir>/descriptions/<name>.desc).
+ * The embedded backend is chosen by the caller through db_open_embedded().
+ * The loose layout's metadata file is parsed on open; a bundle carries the
+ * same metadata as records.
+ */
+
+#define _GNU_SOURCE
+
+#include "db.h"
+#include "embed.h"
+#include "license.h"
+#include "trace.h"
+#include "utils.h"
+#include <stdio.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+static const char *const kind_dirs[] = { "licenses", "descriptions" };
+static const char *const kind_suffixes[] = { ".txt", ".desc" };
+
+void db_open(Database *db, const char *datadir) {
+    memset(db, 0, sizeof(*db));
+    snprintf(db->datadir, sizeof(db->datadir), "%s", datadir);
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", datadir, BUNDLE_FILENAME);
+    db->backend = bundle_open(&db->bundle, path) == 0 ? DB_BACKEND_BUNDLE : DB_BACKEND_LOOSE;
+    if (db->backend == DB_BACKEND_LOOSE) {
+        snprintf(path, sizeof(path), "%s/%s", datadir, META_FILENAME);
+        meta_load(&db->meta, path);
+    }
+}
+
+int db_open_embedded(Database *db) {
+    memset(db, 0, sizeof(*db));
+    if (!embed_available()) {
+        return -1;
+    }
+    snprintf(db->datadir, sizeof(db->datadir), "(embedded)");
+    db->backend = DB_BACKEND_EMBEDDED;
+    return 0;
+}
+
+void db_close(Database *db) {
+    if (db->backend == DB_BACKEND_BUNDLE) {
+        bundle_close(&db->bundle);
+    }
+    meta_free(&db->meta);
+    db->backend = DB_BACKEND_LOOSE;
+}
+
+static BundleKind bundle_kind(DbKind kind) {
+    return kind == DB_LICENSE ? BUNDLE_LICENSE : BUNDLE_DESCRIPTION;
+}
+
+static EmbedKind embed_kind(DbKind kind) {
+    return kind == DB_LICENSE ? EMBED_LICENSE : EMBED_DESCRIPTION;
+}
+
+int db_get(const Database *db, DbKind kind, const char *name, DbText *out) {
+    memset(out, 0, sizeof(*out));
+    /* Packed texts of the bundle and embedded backends are decompressed here */
+    TraceSpan span;
+    trace_begin(&span, TRACE_FILE_READ);
+    if (db->backend == DB_BACKEND_EMBEDDED) {
+        out->data = embed_find(embed_kind(kind), name, &out->len, &out->owned);
+    } else if (db->backend == DB_BACKEND_BUNDLE) {
+        out->data = bundle_find(&db->bundle, bundle_kind(kind), name, &out->len, &out->owned);
+    } else {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s/%s%s", db->datadir, kind_dirs[kind], name, kind_suffixes[kind]);
+        out->owned = read_file(path, &out->len);
+        out->data = out->owned;
+    }
+    trace_end(&span, out->data ? out->len : 0);
+    return out->data ? 0 : -1;
+}
+
+void db_text_release(DbText *text) {
+    free(text->owned);
+    memset(text, 0, sizeof(*text));
+}
+
+int db_each(const Database *db, DbKind kind, DbVisit visit, void *ctx) {
+    if (db->backend == DB_BACKEND_EMBEDDED) {
+        uint32_t count = embed_entry_count(embed_kind(kind));
+        for (uint32_t i = 0; i < count; i++) {
+            if (visit(embed_entry_name(embed_kind(kind), i), ctx) != 0) {
+                break;
+            }
+        }
+        return 0;
+    }
+    if (db->backend == DB_BACKEND_BUNDLE) {
+        BundleKind want = bundle_kind(kind);
+        for (uint32_t i = 0; i < db->bundle.header->record_count; i++) {
+            BundleKind k;
+            const char *name = bundle_record_name(&db->bundle, i, &k);
+            if (k == want && visit(name, ctx) != 0) {
+                break;
+            }
+        }
+        return 0;
+    }
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/%s", db->datadir, kind_dirs[kind]);
+    char **names;
+    size_t count;
+    TraceSpan span;
+    trace_begin(&span, TRACE_DIR_SCAN);
+    if (list_dir_stems(dir, kind_suffixes[kind], &names, &count) != 0) {
+        trace_end(&span, 0);
+        return -1;
+    }
+    trace_end(&span, count);
+    for (size_t i = 0; i < count; i++) {
+        if (visit(names[i], ctx) != 0) {
+            break;
+        }
+    }
+    free_names(names, count);
+    return 0;
+}
+
+void db_use_site_aliases(Database *db, const Config *config) {
+    db->site = config;
+}
+
+/* Looks key up among the names, SPDX ids and aliases the data itself defines. */
+static const char *data_alias(const Database *db, const char *key) {
+    if (db->backend == DB_BACKEND_EMBEDDED) {
+        return embed_find(EMBED_ALIAS, key, NULL, NULL);
+    }
+    if (db->backend == DB_BACKEND_BUNDLE) {
+        return bundle_find(&db->bundle, BUNDLE_ALIAS, key, NULL, NULL);
+    }
+    const MetaEntry *e = meta_find(&db->meta, key);
+    return e ? e->name : NULL;
+}
+
+/* Like data_alias(), but also accepts the "GPL-2.0", "GPL-2.0+" and
+ * "-or-later" spellings of an id the data lists as "-only" or "-or-later".
+ */
+static const char *data_spdx(const Database *db, const char *id) {
+    const char *full = data_alias(db, id);
+    if (full) {
+        return full;
+    }
+    static const char *const suffixes[] = { "-only", "-or-later", "+" };
+    size_t len = strlen(id), base = len;
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]) && base == len; i++) {
+        size_t n = strlen(suffixes[i]);
+        if (len > n && strcasecmp(id + len - n, suffixes[i]) == 0) {
+            base = len - n;
+        }
+    }
+    if (len == 0 || base > 64) {
+        return NULL;
+    }
+    char variant[80];
+    if (id[len - 1] == '+') {
+        snprintf(variant, sizeof(variant), "%.*s-or-later", (int)base, id);
+        if ((full = data_alias(db, variant))) return full;
+    }
+    snprintf(variant, sizeof(variant), "%.*s-only", (int)base, id);
+    if ((full = data_alias(db, variant))) return full;
+    if (base < len) {
+        snprintf(variant, sizeof(variant), "%.*s", (int)base, id);
+        full = data_alias(db, variant);
+    }
+    return full;
+}
+
+int db_resolve_alias(const Database *db, const char *input, char *output, size_t out_size) {
+    const char *site = config_find_alias(db->site, input);
+    if (site) {
+        /* A site alias may name a built-in alias or SPDX id, or a license only the data directory has */
+        if (resolve_alias(site, output, out_size) != 0) {
+            const char *full = data_spdx(db, site);
+            snprintf(output, out_size, "%s", full ? full : site);
+        }
+        return 0;
+    }
+    if (resolve_alias(input, output, out_size) == 0) {
+        return 0;
+    }
+    const char *full = data_spdx(db, input);
+    if (full) {
+        snprintf(output, out_size, "%s", full);
+        return 0;
+    }
+    return -1;
+}
+
+int db_license_info(const Database *db, const char *name, LicenseInfo *info) {
+    memset(info, 0, sizeof(*info));
+    info->category = LICENSE_OTHER;
+    for (int i = 0; spdx_map[i].name != NULL; i++) {
+        if (strcasecmp(spdx_map[i].name, name) == 0) {
+            snprintf(info->spdx, sizeof(info->spdx), "%s", spdx_map[i].spdx);
+            info->category = spdx_map[i].category;
+            info->flags = spdx_map[i].flags;
+            break;
+        }
+    }
+    size_t len = 0;
+    for (int i = 0; alias_map[i].alias != NULL; i++) {
+        if (strcasecmp(alias_map[i].full, name) == 0) {
+            len += (size_t)snprintf(info->aliases + len, sizeof(info->aliases) - len, "%s%s", len ? ", " : "",
+                                    alias_map[i].alias);
+            if (len >= sizeof(info->aliases)) len = sizeof(info->aliases) - 1;
+        }
+    }
+    if (info->spdx[0] || len) {
+        return 0;
+    }
+
+    MetaEntry e;
+    char line[1024];
+    if (db->backend == DB_BACKEND_BUNDLE) {
+        const char *row = bundle_find(&db->bundle, BUNDLE_META, name, NULL, NULL);
+        if (!row) return -1;
+        snprintf(line, sizeof(line), "%s", row);
+        if (meta_parse_line(line, &e) != 0) return -1;
+    } else {
+        const MetaEntry *found = db->backend == DB_BACKEND_LOOSE ? meta_find(&db->meta, name) : NULL;
+        if (!found || strcasecmp(found->name, name) != 0) return -1;
+        e = *found;
+    }
+    snprintf(info->spdx, sizeof(info->spdx), "%s", e.spdx);
+    info->category = e.category;
+    info->flags = e.flags;
+    for (const char *a = e.aliases; *a;) {
+        size_t n = strcspn(a, ",");
+        len += (size_t)snprintf(info->aliases + len, sizeof(info->aliases) - len, "%s%.*s", len ? ", " : "",
+                                (int)n, a);
+        if (len >= sizeof(info->aliases)) len = sizeof(info->aliases) - 1;
+        a += n + (a[n] == ',');
+    }
+    return 0;
+}
+
+static uint64_t stamp_mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+static uint64_t stamp_stat(uint64_t h, const struct stat *st) {
+    h = stamp_mix(h, (uint64_t)st->st_size);
+    h = stamp_mix(h, (uint64_t)st->st_mtim.tv_sec);
+    return stamp_mix(h, (uint64_t)st->st_mtim.tv_nsec);
+}
+
+static uint64_t stamp_embedded(uint64_t h) {
+    for (int k = 0; k < EMBED_KIND_COUNT; k++) {
+        uint32_t count = embed_entry_count((EmbedKind)k);
+        h = stamp_mix(h, count);
+        for (uint32_t i = 0; i < count; i++) {
+            const char *name = embed_entry_name((EmbedKind)k, i);
+            h = stamp_mix(h, hash_casefold(name, strlen(name)) ^ embed_entry_size((EmbedKind)k, i));
+        }
+    }
+    return h;
+}
+
+/* Fingerprints the files of dir ending in suffix. Per-file fingerprints are
+ * summed, so neither the order readdir returns them in nor a sort matters,
+ * and each file costs one fstatat().
+ */
+static uint64_t stamp_files(const char *dir, const char *suffix) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        return 0;
+    }
+    size_t suffix_len = strlen(suffix);
+    uint64_t sum = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        struct stat st;
+        if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, suffix) != 0 ||
+            fstatat(dirfd(d), entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        sum += stamp_stat(hash_casefold(entry->d_name, len - suffix_len), &st);
+    }
+    closedir(d);
+    return sum;
+}
+
+/* Mixes in the metadata file of the loose layout, or a marker for its absence. */
+static uint64_t stamp_meta(uint64_t h, const Database *db) {
+    char path[1024];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", db->datadir, META_FILENAME);
+    return stat(path, &st) == 0 ? stamp_stat(h, &st) : stamp_mix(h, 0);
+}
+
+uint64_t db_stamp(const Database *db) {
+    uint64_t h = hash_casefold(db->datadir, strlen(db->datadir));
+    struct stat st;
+    char path[1024];
+    if (db->backend == DB_BACKEND_EMBEDDED) {
+        return stamp_embedded(h);
+    }
+    if (db->backend == DB_BACKEND_BUNDLE) {
+        snprintf(path, sizeof(path), "%s/%s", db->datadir, BUNDLE_FILENAME);
+        return stat(path, &st) == 0 ? stamp_stat(h, &st) : 0;
+    }
+    for (int kind = DB_LICENSE; kind <= DB_DESCRIPTION; kind++) {
+        snprintf(path, sizeof(path), "%s/%s", db->datadir, kind_dirs[kind]);
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        h = stamp_stat(h, &st);
+        h = stamp_mix(h, stamp_files(path, kind_suffixes[kind]));
+    }
+    h = stamp_meta(h, db);
+    return h ? h : 1;
+}
+
+uint64_t db_dir_stamp(const Database *db) {
+    uint64_t h = FNV1A_INIT;
+    struct stat st;
+    char path[1024];
+    if (db->backend == DB_BACKEND_EMBEDDED) {
+        return stamp_embedded(h);
+    }
+    if (db->backend == DB_BACKEND_BUNDLE) {
+        snprintf(path, sizeof(path), "%s/%s", db->datadir, BUNDLE_FILENAME);
+        return stat(path, &st) == 0 ? stamp_stat(h, &st) : 0;
+    }
+    for (int kind = DB_LICENSE; kind <= DB_DESCRIPTION; kind++) {
+        snprintf(path, sizeof(path), "%s/%s", db->datadir, kind_dirs[kind]);
+        if (stat(path, &st) == 0) {
+            h = stamp_stat(h, &st);
+        }
+    }
+    h = stamp_meta(h, db);
+    return h ? h : 1;
+}
+
+uint64_t db_entry_stamp(const Database *db, DbKind kind, const char *name) {
+    if (db->backend != DB_BACKEND_LOOSE) {
+        return 0;
+    }
+    char path[1024];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s/%s%s", db->datadir, kind_dirs[kind], name, kind_suffixes[kind]);
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+    uint64_t h = stamp_stat(FNV1A_INIT, &st);
+    return h ? h : 1;
+}
+
+int db_path(const Database *db, DbKind kind, const char *name, char *out, size_t out_size) {
+    if (db->backend != DB_BACKEND_LOOSE) {
+        return -1;
+    }
+    snprintf(out, out_size, "%s/%s/%s%s", db->datadir, kind_dirs[kind], name, kind_suffixes[kind]);
+    return 0;
+}
+
+const char *db_backend_name(const Database *db) {
+    switch (db->backend) {
+    case DB_BACKEND_EMBEDDED: return "embedded";
+    case DB_BACKEND_BUNDLE:   return "bundle";
+    default:                  return "loose files";
+    }
+}
@@ -0,0 +1,130 @@
+/* File: src/db.h
+ *
+ * Header for the license database.
+ *
+ * Serves license texts, descriptions and names from the table compiled into
+ * the binary (make EMBED=1), from the mmap'ed bundle in the data directory
+ * when one is installed, and from the loose licenses/ and descriptions/
+ * layout otherwise.
+ */
+
+#ifndef DB_H
+#define DB_H
+
+#include <stddef.h>
+#include "bundle.h"
+#include "config.h"
+#include "meta.h"
+
+typedef enum {
+    DB_LICENSE,
+    DB_DESCRIPTION
+} DbKind;
+
+/* A text served by the database. data is NUL-terminated; owned is set when the
+ * text had to be read into memory and is released by db_text_release().
+ */
+typedef struct {
+    const char *data;
+    size_t len;
+    char *owned;
+} DbText;
+
+typedef enum {
+    DB_BACKEND_LOOSE,
+    DB_BACKEND_BUNDLE,
+    DB_BACKEND_EMBEDDED
+} DbBackend;
+
+typedef struct {
+    char datadir[256];
+    DbBackend backend;
+    Bundle bundle;
+    const Config *site;     /* site aliases consulted first, or NULL */
+    Meta meta;              /* licenses.tsv of the loose layout */
+} Database;
+
+/* What is known about a license beyond its texts. */
+typedef struct {
+    char spdx[64];          /* "" if none */
+    char aliases[256];      /* ", "-separated, "" if none */
+    int category;           /* LicenseCategory */
+    unsigned flags;         /* LICENSE_OSI, LICENSE_FSF */
+} LicenseInfo;
+
+/* Opens the database rooted at datadir. Never fails: without a usable bundle
+ * the loose-file layout is used.
+ */
+void db_open(Database *db, const char *datadir);
+
+/* Opens the database compiled into the binary.
+ * Returns 0 on success, -1 if the binary was built without one.
+ */
+int db_open_embedded(Database *db);
+
+void db_close(Database *db);
+
+/* Makes db_resolve_alias consult the alias= lines of config before the
+ * built-in names. config must outlive the database; it may be reloaded in place.
+ */
+void db_use_site_aliases(Database *db, const Config *config);
+
+/* Fetches the text for name. Returns 0 on success, -1 if it does not exist. */
+int db_get(const Database *db, DbKind kind, const char *name, DbText *out);
+
+void db_text_release(DbText *text);
+
+/* Calls visit for every entry of the given kind, stopping early if it returns non-zero.
+ * Returns 0 on success, -1 if the entries cannot be enumerated.
+ */
+typedef int (*DbVisit)(const char *name, void *ctx);
+int db_each(const Database *db, DbKind kind, DbVisit visit, void *ctx);
+
+/* Resolves a site alias, then a built-in alias, SPDX identifier or license
+ * name through the name table, then a name, SPDX identifier or alias of the
+ * metadata file (the alias records of the bundle or embedded data), trying
+ * the "-only"/"-or-later" spellings of an SPDX identifier last.
+ * Returns 0 if resolved, non-zero otherwise.
+ */
+int db_resolve_alias(const Database *db, const char *input, char *output, size_t out_size);
+
+/* Fills info for a license name: from licenses.def and aliases.def for the
+ * licenses osla ships with, else from the metadata file of the data directory
+ * (or the bundle built from it). Returns 0 if the license is described, -1
+ * if not; info then holds category "other" and nothing else.
+ */
+int db_license_info(const Database *db, const char *name, LicenseInfo *info);
+
+/* Returns a fingerprint of the database contents (file names, sizes and
+ * modification times, and the metadata file) that changes whenever the data
+ * directory does.
+ * Derived caches store it to detect staleness. Returns 0 if it cannot be computed.
+ */
+uint64_t db_stamp(const Database *db);
+
+/* Like db_stamp(), but from the licenses/ and descriptions/ directories' own
+ * modification times and the metadata file's (or the bundle file's) alone:
+ * three stat calls whatever the number of licenses. Adding, removing or
+ * renaming a file changes it; editing a license in place does not. It does
+ * not depend on the data directory's path, so files derived from it can be
+ * installed with the data.
+ */
+uint64_t db_dir_stamp(const Database *db);
+
+/* Returns a fingerprint (size and modification time) of one loose file, for
+ * caches built from db_dir_stamp() that must notice in-place edits. Returns 0
+ * for the bundle and embedded backends, whose stamps already cover every
+ * entry, and for a missing file.
+ */
+uint64_t db_entry_stamp(const Database *db, DbKind kind, const char *name);
+
+/* Writes the path of the loose file holding name, for output that points
+ * users at the data. Returns 0 on success, -1 for the bundle and embedded
+ * backends, whose entries have no file of their own.
+ */
+int db_path(const Database *db, DbKind kind, const char *name, char *out, size_t out_size);
+
+/* Returns a short description of the backend in use, for debug output. */
+const char *db_backend_name(const Database *db);
+
+#endif /* DB_H */
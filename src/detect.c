@@ -0,0 +1,474 @@
+/* File: src/detect.c
+ *
+ * Implementation of license identification.
+ *
+ * Fingerprints are 5-word shingles winnowed with a window of 4, which keeps a
+ * guaranteed match for any shared run of 8 or more words. The cache image holds
+ * each template's normalized word hashes (for the confirmation diff) and one
+ * (fingerprint, template) pair per distinct fingerprint, sorted for binary search.
+ */
+
+#define _GNU_SOURCE
+
+#include "detect.h"
+#include "cache.h"
+#include "utils.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define SHINGLE_WORDS 5
+#define WINNOW_WINDOW 4
+#define CONFIRM_CANDIDATES 3
+#define MIN_CONFIDENCE 0.5
+#define TOKEN_MARKER '\x01'
+
+/* ---- normalization ---- */
+
+static int has_year(const char *line, size_t len) {
+    for (size_t i = 0; i + 4 <= len; i++) {
+        if ((line[i] == '1' && line[i + 1] == '9') || (line[i] == '2' && line[i + 1] == '0')) {
+            if (isdigit((unsigned char)line[i + 2]) && isdigit((unsigned char)line[i + 3]) &&
+                (i == 0 || !isdigit((unsigned char)line[i - 1])) &&
+                (i + 4 == len || !isdigit((unsigned char)line[i + 4]))) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* A copyright line names holders or years rather than license terms:
+ * "Copyright (c) 2024 Jane Doe", "Copyright [yyyy] [name of copyright owner]".
+ */
+int detect_is_copyright_line(const char *line, size_t len) {
+    const char *c = memmem(line, len, "opyright", 8);
+    if (!c || c == line || tolower((unsigned char)c[-1]) != 'c') {
+        return 0;
+    }
+    return memmem(line, len, "(c)", 3) || memmem(line, len, "(C)", 3) ||
+           memmem(line, len, "\xc2\xa9", 2) || memchr(line, TOKEN_MARKER, len) ||
+           has_year(line, len);
+}
+
+static int push_word(uint32_t **words, size_t *count, size_t *cap, uint32_t h) {
+    if (*count == *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 1024;
+        uint32_t *grown = realloc(*words, grown_cap * sizeof(*grown));
+        if (!grown) return -1;
+        *words = grown;
+        *cap = grown_cap;
+    }
+    (*words)[(*count)++] = h;
+    return 0;
+}
+
+int detector_normalize(const Detector *det, const char *text, size_t len, uint32_t **words, size_t *count) {
+    *words = NULL;
+    *count = 0;
+    /* Placeholders become a marker byte so copyright lines holding them are recognized */
+    StrBuf marked = {0};
+    if (det->subst) {
+        static const char marker[2] = { TOKEN_MARKER, '\0' };
+        const char *values[SUBST_FIELD_COUNT];
+        for (int i = 0; i < SUBST_FIELD_COUNT; i++) values[i] = marker;
+        if (subst_render(det->subst, text, len, values, &marked) != 0) {
+            sb_free(&marked);
+            return -1;
+        }
+        text = marked.data;
+        len = marked.len;
+    }
+    size_t cap = 0;
+    const char *p = text, *end = text + len;
+    int rc = 0;
+    while (p < end && rc == 0) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        if (!detect_is_copyright_line(p, (size_t)(line_end - p))) {
+            const char *q = p;
+            while (q < line_end && rc == 0) {
+                while (q < line_end && !isalnum((unsigned char)*q)) q++;
+                if (q >= line_end) break;
+                uint32_t h = 2166136261u;
+                while (q < line_end && isalnum((unsigned char)*q)) {
+                    h ^= (uint32_t)tolower((unsigned char)*q++);
+                    h *= 16777619u;
+                }
+                rc = push_word(words, count, &cap, h);
+            }
+        }
+        p = line_end + 1;
+    }
+    sb_free(&marked);
+    if (rc != 0) {
+        free(*words);
+        *words = NULL;
+        *count = 0;
+    }
+    return rc;
+}
+
+/* ---- fingerprints ---- */
+
+static uint64_t shingle_hash(const uint32_t *w) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < SHINGLE_WORDS; i++) {
+        h ^= w[i];
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+    }
+    return h;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Winnows the shingles of words into a sorted set of distinct fingerprints. */
+static int fingerprint(const uint32_t *words, size_t count, uint64_t **out, size_t *out_count) {
+    *out = NULL;
+    *out_count = 0;
+    if (count == 0) return 0;
+    size_t n_sh = count >= SHINGLE_WORDS ? count - SHINGLE_WORDS + 1 : 1;
+    uint64_t *sh = malloc(n_sh * sizeof(*sh));
+    uint64_t *fp = malloc(n_sh * sizeof(*fp));
+    if (!sh || !fp) {
+        free(sh);
+        free(fp);
+        return -1;
+    }
+    if (count >= SHINGLE_WORDS) {
+        for (size_t i = 0; i < n_sh; i++) sh[i] = shingle_hash(words + i);
+    } else {
+        uint32_t padded[SHINGLE_WORDS] = {0};
+        memcpy(padded, words, count * sizeof(*words));
+        sh[0] = shingle_hash(padded);
+    }
+    size_t n_fp = 0, last = (size_t)-1;
+    size_t window = n_sh < WINNOW_WINDOW ? n_sh : WINNOW_WINDOW;
+    for (size_t start = 0; start + window <= n_sh; start++) {
+        size_t best = start;
+        for (size_t i = start + 1; i < start + window; i++) {
+            if (sh[i] <= sh[best]) best = i;
+        }
+        if (best != last) {
+            fp[n_fp++] = sh[best];
+            last = best;
+        }
+    }
+    free(sh);
+    qsort(fp, n_fp, sizeof(*fp), compare_u64);
+    size_t unique = 0;
+    for (size_t i = 0; i < n_fp; i++) {
+        if (unique == 0 || fp[i] != fp[unique - 1]) fp[unique++] = fp[i];
+    }
+    *out = fp;
+    *out_count = unique;
+    return 0;
+}
+
+/* ---- cache image ---- */
+
+typedef struct {
+    const Detector *det;
+    const Database *db;
+    StrBuf names;
+    DetectTemplate *templates;
+    size_t count, cap;
+    uint32_t *words;
+    size_t word_count, word_cap;
+    DetectPair *pairs;
+    size_t pair_count, pair_cap;
+    int failed;
+} DetectBuild;
+
+static int build_visit(const char *name, void *ctx) {
+    DetectBuild *b = ctx;
+    DbText text;
+    if (db_get(b->db, DB_LICENSE, name, &text) != 0) return 0;
+    uint32_t *words;
+    size_t n_words;
+    uint64_t *fp = NULL;
+    size_t n_fp = 0;
+    int rc = detector_normalize(b->det, text.data, text.len, &words, &n_words);
+    db_text_release(&text);
+    if (rc == 0) rc = fingerprint(words, n_words, &fp, &n_fp);
+    if (rc == 0 && b->count == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 64;
+        DetectTemplate *grown = realloc(b->templates, cap * sizeof(*grown));
+        if (grown) {
+            b->templates = grown;
+            b->cap = cap;
+        } else {
+            rc = -1;
+        }
+    }
+    if (rc == 0 && b->pair_count + n_fp > b->pair_cap) {
+        size_t cap = b->pair_cap ? b->pair_cap : 4096;
+        while (cap < b->pair_count + n_fp) cap *= 2;
+        DetectPair *grown = realloc(b->pairs, cap * sizeof(*grown));
+        if (grown) {
+            b->pairs = grown;
+            b->pair_cap = cap;
+        } else {
+            rc = -1;
+        }
+    }
+    if (rc == 0) {
+        DetectTemplate *t = &b->templates[b->count];
+        memset(t, 0, sizeof(*t));
+        t->name_off = (uint32_t)b->names.len;
+        t->fp_count = (uint32_t)n_fp;
+        t->word_off = b->word_count;
+        t->word_count = (uint32_t)n_words;
+        rc = sb_append(&b->names, name, strlen(name) + 1);
+        for (size_t i = 0; rc == 0 && i < n_words; i++) {
+            rc = push_word(&b->words, &b->word_count, &b->word_cap, words[i]);
+        }
+        for (size_t i = 0; i < n_fp; i++) {
+            b->pairs[b->pair_count++] = (DetectPair){ fp[i], (uint32_t)b->count, 0 };
+        }
+        b->count++;
+    }
+    free(words);
+    free(fp);
+    if (rc != 0) {
+        b->failed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static int compare_pairs(const void *a, const void *b) {
+    const DetectPair *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->tmpl < y->tmpl ? -1 : (x->tmpl > y->tmpl);
+}
+
+static void pad8(StrBuf *sb) {
+    static const char zeros[8] = {0};
+    if (sb->len % 8) sb_append(sb, zeros, 8 - sb->len % 8);
+}
+
+static int build_image(const Detector *det, const Database *db, uint64_t stamp, StrBuf *out) {
+    DetectBuild b;
+    memset(&b, 0, sizeof(b));
+    b.det = det;
+    b.db = db;
+    int rc = -1;
+    if (db_each(db, DB_LICENSE, build_visit, &b) != 0 || b.failed) goto out;
+    qsort(b.pairs, b.pair_count, sizeof(*b.pairs), compare_pairs);
+
+    DetectHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, DETECT_MAGIC, sizeof(DETECT_MAGIC));
+    h.version = DETECT_VERSION;
+    h.template_count = (uint32_t)b.count;
+    h.stamp = stamp;
+    h.pair_count = b.pair_count;
+    h.word_count = b.word_count;
+    sb_append(out, (const char *)&h, sizeof(h));
+    pad8(out);
+    h.templates_off = out->len;
+    sb_append(out, (const char *)b.templates, b.count * sizeof(*b.templates));
+    pad8(out);
+    h.pairs_off = out->len;
+    sb_append(out, (const char *)b.pairs, b.pair_count * sizeof(*b.pairs));
+    pad8(out);
+    h.words_off = out->len;
+    sb_append(out, (const char *)b.words, b.word_count * sizeof(*b.words));
+    pad8(out);
+    h.strings_off = out->len;
+    if (sb_append(out, b.names.data ? b.names.data : "", b.names.len) != 0) goto out;
+    h.total_size = out->len;
+    memcpy(out->data, &h, sizeof(h));
+    rc = 0;
+out:
+    sb_free(&b.names);
+    free(b.templates);
+    free(b.words);
+    free(b.pairs);
+    return rc;
+}
+
+static int detector_attach(Detector *det, const unsigned char *base, size_t size, uint64_t stamp) {
+    const DetectHeader *h = (const DetectHeader *)base;
+    if (size < sizeof(*h) || memcmp(h->magic, DETECT_MAGIC, sizeof(DETECT_MAGIC)) != 0 ||
+        h->version != DETECT_VERSION || h->stamp != stamp || h->total_size != size ||
+        h->templates_off + (uint64_t)h->template_count * sizeof(DetectTemplate) > size ||
+        h->pairs_off + h->pair_count * sizeof(DetectPair) > size ||
+        h->words_off + h->word_count * sizeof(uint32_t) > size || h->strings_off > size) {
+        return -1;
+    }
+    det->base = base;
+    det->size = size;
+    det->header = h;
+    det->templates = (const DetectTemplate *)(base + h->templates_off);
+    det->pairs = (const DetectPair *)(base + h->pairs_off);
+    det->words = (const uint32_t *)(base + h->words_off);
+    det->strings = (const char *)(base + h->strings_off);
+    return 0;
+}
+
+int detector_open(Detector *det, const Database *db, const Config *config) {
+    memset(det, 0, sizeof(*det));
+    det->subst = subst_compile_config(config, NULL);
+    if (!det->subst) return -1;
+
+    /* The token set changes normalization, so it is part of the stamp */
+    uint64_t stamp = db_stamp(db);
+    for (int i = 0; i < config->token_count; i++) {
+        stamp ^= hash_casefold(config->tokens[i].text, strlen(config->tokens[i].text)) + (uint64_t)i;
+        stamp *= FNV1A_PRIME;
+    }
+
+    char path[600];
+    const unsigned char *base;
+    size_t size;
+    /* Fingerprints of the embedded database stay in memory, like its templates */
+    int have_path = db->backend != DB_BACKEND_EMBEDDED &&
+                    cache_path("detect", db->datadir, "fp", path, sizeof(path)) == 0;
+    if (have_path && cache_map(path, &base, &size) == 0) {
+        if (detector_attach(det, base, size, stamp) == 0) return 0;
+        cache_unmap(base, size);
+    }
+    StrBuf image = {0};
+    if (build_image(det, db, stamp, &image) != 0 ||
+        detector_attach(det, (const unsigned char *)image.data, image.len, stamp) != 0) {
+        sb_free(&image);
+        detector_close(det);
+        return -1;
+    }
+    if (have_path) {
+        cache_write(path, image.data, image.len);
+    }
+    det->heap = image.data;
+    return 0;
+}
+
+void detector_close(Detector *det) {
+    if (det->heap) {
+        free(det->heap);
+    } else {
+        cache_unmap(det->base, det->size);
+    }
+    subst_free(det->subst);
+    memset(det, 0, sizeof(*det));
+}
+
+/* ---- matching ---- */
+
+size_t word_diff_distance(const uint32_t *a, size_t n, const uint32_t *b, size_t m, size_t max_d) {
+    if (max_d > n + m) max_d = n + m;
+    size_t width = 2 * max_d + 3;
+    long *v = malloc(width * sizeof(*v));
+    if (!v) return max_d + 1;
+    long off = (long)max_d + 1;
+    v[off + 1] = 0;
+    for (long d = 0; d <= (long)max_d; d++) {
+        for (long k = -d; k <= d; k += 2) {
+            long x;
+            if (k == -d || (k != d && v[off + k - 1] < v[off + k + 1])) {
+                x = v[off + k + 1];
+            } else {
+                x = v[off + k - 1] + 1;
+            }
+            long y = x - k;
+            while (x < (long)n && y < (long)m && a[x] == b[y]) {
+                x++;
+                y++;
+            }
+            v[off + k] = x;
+            if (x >= (long)n && y >= (long)m) {
+                free(v);
+                return (size_t)d;
+            }
+        }
+    }
+    free(v);
+    return max_d + 1;
+}
+
+typedef struct {
+    uint32_t tmpl;
+    double dice;
+} Candidate;
+
+static int compare_candidates(const void *a, const void *b) {
+    const Candidate *x = a, *y = b;
+    if (x->dice != y->dice) return x->dice > y->dice ? -1 : 1;
+    return x->tmpl < y->tmpl ? -1 : (x->tmpl > y->tmpl);
+}
+
+int detector_identify(const Detector *det, const char *text, size_t len, DetectMatch *match) {
+    memset(match, 0, sizeof(*match));
+    uint32_t *words;
+    size_t n_words;
+    if (detector_normalize(det, text, len, &words, &n_words) != 0) return -1;
+    uint64_t *fp;
+    size_t n_fp;
+    if (fingerprint(words, n_words, &fp, &n_fp) != 0) {
+        free(words);
+        return -1;
+    }
+    uint32_t n_tmpl = det->header->template_count;
+    uint32_t *shared = calloc(n_tmpl ? n_tmpl : 1, sizeof(*shared));
+    Candidate *cands = malloc((n_tmpl ? n_tmpl : 1) * sizeof(*cands));
+    if (!shared || !cands) {
+        free(words);
+        free(fp);
+        free(shared);
+        free(cands);
+        return -1;
+    }
+
+    /* Count shared fingerprints per template via the sorted pair index */
+    for (size_t i = 0; i < n_fp; i++) {
+        size_t lo = 0, hi = det->header->pair_count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (det->pairs[mid].hash < fp[i]) lo = mid + 1; else hi = mid;
+        }
+        for (; lo < det->header->pair_count && det->pairs[lo].hash == fp[i]; lo++) {
+            shared[det->pairs[lo].tmpl]++;
+        }
+    }
+    size_t n_cand = 0;
+    for (uint32_t t = 0; t < n_tmpl; t++) {
+        if (!shared[t]) continue;
+        double dice = 2.0 * shared[t] / (double)(n_fp + det->templates[t].fp_count);
+        cands[n_cand++] = (Candidate){ t, dice };
+    }
+    qsort(cands, n_cand, sizeof(*cands), compare_candidates);
+
+    /* Confirm the best candidates with a word-level diff */
+    for (size_t c = 0; c < n_cand && c < CONFIRM_CANDIDATES; c++) {
+        const DetectTemplate *t = &det->templates[cands[c].tmpl];
+        const uint32_t *tw = det->words + t->word_off;
+        size_t total = n_words + t->word_count;
+        double confidence;
+        int exact = 0;
+        if (n_words == t->word_count && memcmp(words, tw, n_words * sizeof(*words)) == 0) {
+            confidence = 1.0;
+            exact = 1;
+        } else {
+            size_t max_d = (size_t)((1.0 - MIN_CONFIDENCE) * (double)total);
+            size_t d = word_diff_distance(words, n_words, tw, t->word_count, max_d);
+            confidence = d > max_d ? cands[c].dice * MIN_CONFIDENCE : 1.0 - (double)d / (double)total;
+        }
+        if (!match->license || confidence > match->confidence) {
+            match->license = det->strings + t->name_off;
+            match->confidence = confidence;
+            match->exact = exact;
+        }
+    }
+    free(words);
+    free(fp);
+    free(shared);
+    free(cands);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/* File: src/detect.h
+ *
+ * Header for license identification.
+ *
+ * Texts are normalized (case, punctuation, whitespace, copyright lines and the
+ * configured placeholder tokens are dropped) into a sequence of word hashes.
+ * Winnowed word shingles of every template form a fingerprint index; an input
+ * is matched by looking up its own fingerprints, so the cost depends on the
+ * input rather than on the size of the corpus. The best candidates are then
+ * confirmed with a word-level diff, which yields the confidence.
+ */
+
+#ifndef DETECT_H
+#define DETECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "db.h"
+#include "subst.h"
+
+#define DETECT_MAGIC "OSLADET"
+#define DETECT_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t template_count;
+    uint64_t stamp;             /* db_stamp() mixed with the token set */
+    uint64_t pair_count;
+    uint64_t word_count;
+    uint64_t templates_off;     /* DetectTemplate[template_count] */
+    uint64_t pairs_off;         /* DetectPair[pair_count], sorted by hash */
+    uint64_t words_off;         /* uint32_t normalized word hashes */
+    uint64_t strings_off;
+    uint64_t total_size;
+} DetectHeader;
+
+typedef struct {
+    uint32_t name_off;
+    uint32_t fp_count;          /* distinct fingerprints */
+    uint64_t word_off;
+    uint32_t word_count;
+    uint32_t reserved;
+} DetectTemplate;
+
+typedef struct {
+    uint64_t hash;
+    uint32_t tmpl;
+    uint32_t reserved;
+} DetectPair;
+
+typedef struct {
+    const unsigned char *base;
+    size_t size;
+    char *heap;
+    const DetectHeader *header;
+    const DetectTemplate *templates;
+    const DetectPair *pairs;
+    const uint32_t *words;
+    const char *strings;
+    Subst *subst;               /* placeholder tokens stripped during normalization */
+} Detector;
+
+typedef struct {
+    const char *license;        /* NULL when nothing matched; points into the detector */
+    double confidence;          /* 0..1 */
+    int exact;                  /* normalized texts are identical */
+} DetectMatch;
+
+/* Loads the cached fingerprints for db, rebuilding them when stale.
+ * Returns 0 on success.
+ */
+int detector_open(Detector *det, const Database *db, const Config *config);
+
+void detector_close(Detector *det);
+
+/* Identifies the license in text. Thread-safe for a shared detector.
+ * Returns 0 on success (match->license may still be NULL), -1 on allocation failure.
+ */
+int detector_identify(const Detector *det, const char *text, size_t len, DetectMatch *match);
+
+/* Normalizes text into word hashes as used for matching (caller frees *words).
+ * Returns 0 on success.
+ */
+int detector_normalize(const Detector *det, const char *text, size_t len, uint32_t **words, size_t *count);
+
+/* Returns 1 if a line of a license text names holders or years rather than
+ * license terms ("Copyright (c) 2024 Jane Doe"); such lines are ignored by matching.
+ */
+int detect_is_copyright_line(const char *line, size_t len);
+
+/* Word-level edit distance between two hash sequences (insertions plus deletions),
+ * giving up and returning max_d + 1 once it exceeds max_d.
+ */
+size_t word_diff_distance(const uint32_t *a, size_t n, const uint32_t *b, size_t m, size_t max_d);
+
+#endif /* DETECT_H */
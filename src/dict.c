@@ -0,0 +1,344 @@
+/* File: src/dict.c
+ *
+ * Implementation of shared-dictionary compression.
+ *
+ * Training walks the texts from the largest down and appends to the
+ * dictionary every passage of at least DICT_MIN_RUN bytes that another text
+ * of the corpus shares and the dictionary does not hold yet. Shared passages
+ * are thus stored once, while text unique to one license stays in its own
+ * stream, where copies from earlier in the same text still shrink it. Every
+ * text is then compressed against the final dictionary with a greedy parse
+ * over hash chains of 8-byte prefixes. Compression only runs when a bundle or
+ * the embedded table is built; decompression is a loop of memcpy.
+ */
+
+#include "dict.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DICT_HASH_BITS 16
+/* Shortest passage two texts must share to enter the dictionary */
+#define DICT_MIN_RUN 32
+/* Distance between probed positions while training */
+#define DICT_TRAIN_STRIDE (DICT_MIN_RUN - DICT_MIN_MATCH + 1)
+/* Bytes of the corpus searched for shared passages */
+#define DICT_TRAIN_MAX (16 * 1024 * 1024)
+/* Candidates examined per position */
+#define DICT_CHAIN_DEPTH 32
+/* A match this long ends the search early */
+#define DICT_NICE_MATCH 258
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+    uint32_t *head;         /* position + 1 by hash, 0 if none */
+    uint32_t *prev;         /* previous position + 1 with the same hash */
+} Matcher;
+
+static uint32_t hash8(const char *p, int bits) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+}
+
+static size_t common_length(const char *a, const char *b, size_t max) {
+    size_t n = 0;
+    while (n < max && a[n] == b[n]) n++;
+    return n;
+}
+
+static int matcher_init(Matcher *m, size_t cap) {
+    memset(m, 0, sizeof(*m));
+    m->data = malloc(cap ? cap : 1);
+    m->head = calloc((size_t)1 << DICT_HASH_BITS, sizeof(*m->head));
+    m->prev = malloc((cap ? cap : 1) * sizeof(*m->prev));
+    m->cap = cap;
+    return m->data && m->head && m->prev ? 0 : -1;
+}
+
+static void matcher_free(Matcher *m) {
+    free(m->data);
+    free(m->head);
+    free(m->prev);
+}
+
+/* Appends as much of data as fits and indexes the new positions. */
+static void matcher_append(Matcher *m, const char *data, size_t len) {
+    if (len > m->cap - m->len) len = m->cap - m->len;
+    size_t old = m->len;
+    memcpy(m->data + m->len, data, len);
+    m->len += len;
+    size_t from = old >= DICT_MIN_MATCH - 1 ? old - (DICT_MIN_MATCH - 1) : 0;
+    for (size_t p = from; p + DICT_MIN_MATCH <= m->len; p++) {
+        uint32_t h = hash8(m->data + p, DICT_HASH_BITS);
+        m->prev[p] = m->head[h];
+        m->head[h] = (uint32_t)p + 1;
+    }
+}
+
+static int put_varint(StrBuf *out, uint64_t v) {
+    unsigned char buf[10];
+    size_t n = 0;
+    do {
+        buf[n] = (unsigned char)(v & 0x7f);
+        v >>= 7;
+        if (v) buf[n] |= 0x80;
+        n++;
+    } while (v);
+    return sb_append(out, (const char *)buf, n);
+}
+
+static int get_varint(const unsigned char **p, const unsigned char *end, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p >= end) return -1;
+        unsigned char b = *(*p)++;
+        *v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return 0;
+    }
+    return -1;
+}
+
+/* Returns the length of the longest match for s (at most max bytes) in the
+ * text of m, ignoring candidates in [skip_from, skip_to), and stores its position.
+ */
+static size_t longest_match(const Matcher *m, const char *s, size_t max, size_t skip_from, size_t skip_to,
+                            size_t *pos) {
+    size_t best = 0;
+    uint32_t c = m->head[hash8(s, DICT_HASH_BITS)];
+    for (int depth = 0; c && depth < DICT_CHAIN_DEPTH; c = m->prev[c - 1], depth++) {
+        size_t p = c - 1;
+        if (p >= skip_from && p < skip_to) continue;
+        size_t limit = m->len - p < max ? m->len - p : max;
+        /* A candidate can only beat best if it agrees on byte best */
+        if (limit <= best || m->data[p + best] != s[best]) continue;
+        size_t n = common_length(m->data + p, s, limit);
+        if (n > best) {
+            best = n;
+            *pos = p;
+            if (n >= DICT_NICE_MATCH) break;
+        }
+    }
+    return best;
+}
+
+/* Appends to the dictionary the passages of text, which sits at own in the
+ * corpus, that some other text shares and the dictionary does not hold yet.
+ * Any such passage holds DICT_MIN_MATCH bytes starting at a multiple of
+ * DICT_TRAIN_STRIDE, so only those positions are probed and a hit is extended
+ * backwards; probing every byte of a large corpus is dominated by cache misses.
+ */
+static void train_text(Matcher *dict, const Matcher *corpus, const char *text, size_t len, size_t own) {
+    size_t i = 0, done = 0, pos;
+    while (i + DICT_MIN_MATCH <= len && dict->len < dict->cap) {
+        size_t n = longest_match(dict, text + i, len - i, 0, 0, &pos);
+        if (n >= DICT_MIN_RUN) {
+            i += n;
+            done = i;
+            continue;
+        }
+        n = longest_match(corpus, text + i, len - i, own, own + len, &pos);
+        if (n >= DICT_MIN_MATCH) {
+            size_t back = 0;
+            while (back < i - done && back < pos && corpus->data[pos - back - 1] == text[i - back - 1]) back++;
+            if (n + back >= DICT_MIN_RUN) {
+                matcher_append(dict, text + i - back, n + back);
+                i += n;
+                done = i;
+                continue;
+            }
+        }
+        i += DICT_TRAIN_STRIDE;
+    }
+}
+
+/* Compresses src against the dictionary of m, appending the stream to out.
+ * Returns 0 on success, -1 on allocation failure.
+ */
+static int compress(const Matcher *m, const char *src, size_t len, StrBuf *out) {
+    int bits = 8;
+    while (bits < DICT_HASH_BITS && ((size_t)1 << bits) < len) bits++;
+    uint32_t *head = calloc((size_t)1 << bits, sizeof(*head));
+    uint32_t *prev = malloc((len ? len : 1) * sizeof(*prev));
+    int rc = head && prev ? 0 : -1;
+
+    size_t i = 0, literal = 0;
+    while (rc == 0 && i + DICT_MIN_MATCH <= len) {
+        size_t pos = 0, dist = 0;
+        size_t best = m->len >= DICT_MIN_MATCH ? longest_match(m, src + i, len - i, 0, 0, &pos) : 0;
+        if (best) dist = m->len + i - pos;
+        uint32_t h = hash8(src + i, bits);
+        uint32_t c = head[h];
+        for (int depth = 0; c && depth < DICT_CHAIN_DEPTH; c = prev[c - 1], depth++) {
+            size_t q = c - 1;
+            if (best >= DICT_NICE_MATCH) break;
+            if (src[q + best] != src[i + best]) continue;
+            size_t n = common_length(src + q, src + i, len - i);
+            if (n > best) {
+                best = n;
+                dist = i - q;
+            }
+        }
+        if (best < DICT_MIN_MATCH) {
+            prev[i] = head[h];
+            head[h] = (uint32_t)i + 1;
+            i++;
+            continue;
+        }
+        if (put_varint(out, i - literal) != 0 || sb_append(out, src + literal, i - literal) != 0 ||
+            put_varint(out, best - DICT_MIN_MATCH + 1) != 0 || put_varint(out, dist) != 0) {
+            rc = -1;
+        }
+        for (size_t end = i + best; i < end; i++) {
+            if (i + DICT_MIN_MATCH > len) continue;
+            uint32_t hi = hash8(src + i, bits);
+            prev[i] = head[hi];
+            head[hi] = (uint32_t)i + 1;
+        }
+        literal = i;
+    }
+    if (rc == 0 && (put_varint(out, len - literal) != 0 ||
+                    sb_append(out, src + literal, len - literal) != 0 || put_varint(out, 0) != 0)) {
+        rc = -1;
+    }
+    free(head);
+    free(prev);
+    return rc;
+}
+
+typedef struct {
+    size_t len;
+    size_t index;
+} TextOrder;
+
+static int compare_by_size(const void *a, const void *b) {
+    const TextOrder *x = a, *y = b;
+    if (x->len != y->len) return x->len > y->len ? -1 : 1;
+    return x->index < y->index ? -1 : 1;
+}
+
+int dict_pack(DictPack *pack, const char *const *texts, const size_t *lens, size_t count) {
+    memset(pack, 0, sizeof(*pack));
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) total += lens[i];
+    size_t corpus_cap = total < DICT_TRAIN_MAX ? total : DICT_TRAIN_MAX;
+    Matcher dict, corpus;
+    TextOrder *order = malloc((count ? count : 1) * sizeof(*order));
+    size_t *offsets = malloc((count ? count : 1) * sizeof(*offsets));
+    pack->packed = calloc(count ? count : 1, sizeof(*pack->packed));
+    int rc = matcher_init(&dict, total < DICT_MAX_SIZE ? total : DICT_MAX_SIZE);
+    if (matcher_init(&corpus, corpus_cap) != 0 || !order || !offsets || !pack->packed) rc = -1;
+
+    if (rc == 0) {
+        for (size_t i = 0; i < count; i++) {
+            offsets[i] = corpus.len;
+            matcher_append(&corpus, texts[i], lens[i]);
+            order[i].len = lens[i];
+            order[i].index = i;
+        }
+        qsort(order, count, sizeof(*order), compare_by_size);
+        for (size_t k = 0; k < count && dict.len < dict.cap; k++) {
+            size_t i = order[k].index;
+            train_text(&dict, &corpus, texts[i], lens[i], offsets[i]);
+        }
+    }
+
+    for (size_t i = 0; i < count && rc == 0; i++) {
+        rc = compress(&dict, texts[i], lens[i], &pack->packed[i]);
+        if (pack->packed[i].len >= lens[i]) sb_free(&pack->packed[i]);
+        pack->stats.packed_bytes += pack->packed[i].len ? pack->packed[i].len : lens[i];
+    }
+    if (rc == 0 && dict.len > 0 && sb_append(&pack->dict, dict.data, dict.len) != 0) rc = -1;
+    pack->stats.count = count;
+    pack->stats.raw_bytes = total;
+    pack->stats.dict_bytes = pack->dict.len;
+    matcher_free(&dict);
+    matcher_free(&corpus);
+    free(order);
+    free(offsets);
+    if (rc != 0) dict_pack_free(pack);
+    return rc;
+}
+
+void dict_pack_free(DictPack *pack) {
+    for (size_t i = 0; pack->packed && i < pack->stats.count; i++) sb_free(&pack->packed[i]);
+    free(pack->packed);
+    sb_free(&pack->dict);
+    memset(pack, 0, sizeof(*pack));
+}
+
+/* Reads a varint; most fields fit in one byte */
+static inline int next_varint(const unsigned char **p, const unsigned char *end, uint64_t *v) {
+    if (*p < end && **p < 0x80) {
+        *v = *(*p)++;
+        return 0;
+    }
+    return get_varint(p, end, v);
+}
+
+/* Copies n bytes in 16-byte blocks, writing up to 15 bytes past dst + n */
+static inline void copy_wide(char *dst, const char *src, size_t n) {
+    for (size_t j = 0; j < n; j += 16) memcpy(dst + j, src + j, 16);
+}
+
+int dict_decompress(const char *dict, size_t dict_len, const unsigned char *src, size_t src_len,
+                    char *out, size_t out_len) {
+    const unsigned char *p = src, *end = src + src_len;
+    size_t o = 0;
+    for (;;) {
+        uint64_t literal, m, dist;
+        if (next_varint(&p, end, &literal) != 0 || literal > (uint64_t)(end - p) || literal > out_len - o) {
+            return -1;
+        }
+        /* Block copies may run past the token into output that is written next */
+        if (literal + 16 <= (uint64_t)(end - p) && literal + 16 <= out_len - o) {
+            copy_wide(out + o, (const char *)p, (size_t)literal);
+        } else {
+            memcpy(out + o, p, (size_t)literal);
+        }
+        o += (size_t)literal;
+        p += literal;
+        if (next_varint(&p, end, &m) != 0) return -1;
+        if (m == 0) break;
+        if (next_varint(&p, end, &dist) != 0 || m > out_len - o) return -1;
+        size_t n = (size_t)m + DICT_MIN_MATCH - 1, at = dict_len + o;
+        if (n > out_len - o || dist == 0 || dist > at) return -1;
+        size_t from = at - (size_t)dist;
+        int room = n + 16 <= out_len - o;
+        if (from < dict_len) {
+            if (n > dict_len - from) return -1;
+            if (room && n + 16 <= dict_len - from) {
+                copy_wide(out + o, dict + from, n);
+            } else {
+                memcpy(out + o, dict + from, n);
+            }
+        } else if (dist >= 16 && room) {
+            copy_wide(out + o, out + (from - dict_len), n);
+        } else if (dist >= n) {
+            memcpy(out + o, out + (from - dict_len), n);
+        } else {
+            /* Overlapping copy: a run repeating the last dist bytes. Each pass
+             * copies everything written so far, doubling the block. */
+            char *dst = out + o;
+            const char *run = out + (from - dict_len);
+            size_t left = n, step = (size_t)dist;
+            while (left > 0) {
+                size_t c = step < left ? step : left;
+                memcpy(dst, run, c);
+                dst += c;
+                left -= c;
+                step *= 2;
+            }
+        }
+        o += n;
+    }
+    return o == out_len && p == end ? 0 : -1;
+}
+
+void dict_print_stats(const DictStats *stats, const char *what, FILE *out) {
+    size_t stored = stats->dict_bytes + stats->packed_bytes;
+    fprintf(out, "%s: %zu texts, %.1f KiB raw -> %.1f KiB (dictionary %.1f KiB + texts %.1f KiB), %.1f%% of raw\n",
+            what, stats->count, stats->raw_bytes / 1024.0, stored / 1024.0, stats->dict_bytes / 1024.0,
+            stats->packed_bytes / 1024.0, stats->raw_bytes ? 100.0 * stored / stats->raw_bytes : 100.0);
+}
@@ -0,0 +1,63 @@
+/* File: src/dict.h
+ *
+ * Header for shared-dictionary compression of license texts.
+ *
+ * License texts are near-duplicates of each other (GPL/LGPL/AGPL, the CERN
+ * OHL variants, the CC-BY texts), so the corpus is compressed against a
+ * dictionary trained on the corpus itself: passages shared by several texts
+ * are stored once in the dictionary, and each text becomes a short LZ77
+ * stream of literals and copies from the dictionary or its own output. Texts
+ * decompress independently with nothing but memcpy, so random access stays
+ * as cheap as reading a file.
+ *
+ * Stream format, repeated until the end marker:
+ *
+ *   varint literal_count, literal bytes,
+ *   varint m (0 ends the stream), varint distance
+ *
+ * which copies m + DICT_MIN_MATCH - 1 bytes starting distance bytes back in
+ * the dictionary followed by the output produced so far. A copy never spans
+ * the end of the dictionary, and copies within the output may overlap.
+ */
+
+#ifndef DICT_H
+#define DICT_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "utils.h"
+
+#define DICT_MIN_MATCH 8
+/* Largest dictionary dict_pack() trains */
+#define DICT_MAX_SIZE (1024 * 1024)
+
+typedef struct {
+    size_t count;           /* texts */
+    size_t raw_bytes;
+    size_t dict_bytes;
+    size_t packed_bytes;    /* compressed texts, counting raw ones where packing did not pay */
+} DictStats;
+
+typedef struct {
+    StrBuf dict;
+    StrBuf *packed;         /* per text; empty where the raw text is smaller */
+    DictStats stats;
+} DictPack;
+
+/* Trains a dictionary of at most DICT_MAX_SIZE bytes on the count texts and
+ * compresses each against it. Returns 0 on success, -1 on allocation failure.
+ */
+int dict_pack(DictPack *pack, const char *const *texts, const size_t *lens, size_t count);
+
+void dict_pack_free(DictPack *pack);
+
+/* Decompresses src into exactly out_len bytes at out. Returns 0 on success,
+ * -1 if the stream is malformed or does not produce out_len bytes.
+ */
+int dict_decompress(const char *dict, size_t dict_len, const unsigned char *src, size_t src_len,
+                    char *out, size_t out_len);
+
+/* Prints one line comparing the packed and raw sizes, e.g. for --build-bundle. */
+void dict_print_stats(const DictStats *stats, const char *what, FILE *out);
+
+#endif /* DICT_H */
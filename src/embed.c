@@ -0,0 +1,114 @@
+/* File: src/embed.c
+ *
+ * Lookups into the embedded license database.
+ *
+ * Without OSLA_EMBED the functions report an empty database so callers can
+ * test for it at runtime instead of sprinkling #ifdefs.
+ */
+
+#define _GNU_SOURCE
+
+#include "embed.h"
+#include "dict.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef OSLA_EMBED
+
+static uint32_t pool_len(uint32_t off) {
+    const unsigned char *p = embed_pool + off;
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const char *pool_str(uint32_t off) {
+    return (const char *)embed_pool + off + 4;
+}
+
+int embed_available(void) {
+    return 1;
+}
+
+const char *embed_find(EmbedKind kind, const char *name, size_t *len, char **owned) {
+    const EmbedEntry *index = embed_index[kind];
+    if (owned) {
+        *owned = NULL;
+    }
+    uint32_t lo = 0, hi = embed_count[kind];
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = strcasecmp(name, pool_str(index[mid].name));
+        if (cmp == 0) {
+            const EmbedEntry *e = &index[mid];
+            if (len) {
+                *len = e->size;
+            }
+            if (!e->packed) {
+                return pool_str(e->data);
+            }
+            char *text = owned ? malloc((size_t)e->size + 1) : NULL;
+            if (!text || dict_decompress((const char *)embed_dict, embed_dict_len,
+                                         (const unsigned char *)pool_str(e->data), pool_len(e->data),
+                                         text, e->size) != 0) {
+                free(text);
+                return NULL;
+            }
+            text[e->size] = '\0';
+            *owned = text;
+            return text;
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+uint32_t embed_entry_count(EmbedKind kind) {
+    return embed_count[kind];
+}
+
+const char *embed_entry_name(EmbedKind kind, uint32_t i) {
+    return pool_str(embed_index[kind][i].name);
+}
+
+size_t embed_entry_size(EmbedKind kind, uint32_t i) {
+    return embed_index[kind][i].size;
+}
+
+#else
+
+int embed_available(void) {
+    return 0;
+}
+
+const char *embed_find(EmbedKind kind, const char *name, size_t *len, char **owned) {
+    (void)kind;
+    (void)name;
+    (void)len;
+    if (owned) {
+        *owned = NULL;
+    }
+    return NULL;
+}
+
+uint32_t embed_entry_count(EmbedKind kind) {
+    (void)kind;
+    return 0;
+}
+
+const char *embed_entry_name(EmbedKind kind, uint32_t i) {
+    (void)kind;
+    (void)i;
+    return NULL;
+}
+
+size_t embed_entry_size(EmbedKind kind, uint32_t i) {
+    (void)kind;
+    (void)i;
+    return 0;
+}
+
+#endif /* OSLA_EMBED */
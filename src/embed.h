@@ -0,0 +1,63 @@
+/* File: src/embed.h
+ *
+ * Header for the license database compiled into the binary (make EMBED=1).
+ *
+ * The generated table is a pool of deduplicated strings, each stored as a
+ * 4-byte little-endian length, the bytes and a terminating NUL, plus index
+ * arrays sorted by case-folded name that point into the pool. License texts
+ * are stored compressed against a shared dictionary (see dict.h).
+ */
+
+#ifndef EMBED_H
+#define EMBED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    EMBED_LICENSE,
+    EMBED_DESCRIPTION,
+    EMBED_ALIAS,            /* data is the canonical license name */
+    EMBED_KIND_COUNT
+} EmbedKind;
+
+/* Pool offsets of an entry's name and data strings. The data string of a
+ * packed entry holds the text compressed against embed_dict; size is the
+ * length of the text either way.
+ */
+typedef struct {
+    uint32_t name;
+    uint32_t data;
+    uint32_t size;
+    uint32_t packed;
+} EmbedEntry;
+
+#ifdef OSLA_EMBED
+
+/* Provided by the generated embedded_data.c */
+extern const unsigned char embed_pool[];
+extern const EmbedEntry *const embed_index[EMBED_KIND_COUNT];
+extern const uint32_t embed_count[EMBED_KIND_COUNT];
+extern const unsigned char embed_dict[];
+extern const uint32_t embed_dict_len;
+
+#endif /* OSLA_EMBED */
+
+/* Returns 1 when the binary carries an embedded database. */
+int embed_available(void);
+
+/* Looks up name (case-insensitively). Returns the NUL-terminated data and stores
+ * its length in len, or returns NULL if there is no such entry. A packed entry
+ * is decompressed into a buffer that is also stored in *owned for the caller
+ * to free (*owned is NULL otherwise); it cannot be fetched with a NULL owned.
+ */
+const char *embed_find(EmbedKind kind, const char *name, size_t *len, char **owned);
+
+/* Returns the number of entries of a kind and the name of the i-th one (in sorted order). */
+uint32_t embed_entry_count(EmbedKind kind);
+const char *embed_entry_name(EmbedKind kind, uint32_t i);
+
+/* Returns the length of the i-th entry's data without decompressing it. */
+size_t embed_entry_size(EmbedKind kind, uint32_t i);
+
+#endif /* EMBED_H */
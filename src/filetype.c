@@ -0,0 +1,57 @@
+/* File: src/filetype.c
+ *
+ * Implementation of the source file type table.
+ */
+
+#include "filetype.h"
+#include <string.h>
+#include <strings.h>
+
+const CommentStyle comment_styles[COMMENT_STYLE_COUNT] = {
+    [COMMENT_BLOCK_C]   = { "/*", " * ", " */" },
+    [COMMENT_SLASH]     = { NULL, "// ", NULL },
+    [COMMENT_HASH]      = { NULL, "# ", NULL },
+    [COMMENT_DASH]      = { NULL, "-- ", NULL },
+    [COMMENT_PERCENT]   = { NULL, "% ", NULL },
+    [COMMENT_SEMICOLON] = { NULL, ";; ", NULL },
+    [COMMENT_BLOCK_ML]  = { "(*", " * ", " *)" },
+    [COMMENT_MARKUP]    = { "<!--", "  ", "-->" },
+};
+
+typedef struct {
+    const char *ext;
+    CommentKind kind;
+} FileType;
+
+static const FileType file_types[] = {
+    { "c", COMMENT_BLOCK_C },   { "h", COMMENT_BLOCK_C },    { "css", COMMENT_BLOCK_C },
+    { "scss", COMMENT_BLOCK_C }, { "less", COMMENT_BLOCK_C },
+    { "cc", COMMENT_SLASH },    { "cpp", COMMENT_SLASH },    { "cxx", COMMENT_SLASH },
+    { "hh", COMMENT_SLASH },    { "hpp", COMMENT_SLASH },    { "hxx", COMMENT_SLASH },
+    { "m", COMMENT_SLASH },     { "mm", COMMENT_SLASH },     { "go", COMMENT_SLASH },
+    { "rs", COMMENT_SLASH },    { "java", COMMENT_SLASH },   { "kt", COMMENT_SLASH },
+    { "kts", COMMENT_SLASH },   { "scala", COMMENT_SLASH },  { "swift", COMMENT_SLASH },
+    { "cs", COMMENT_SLASH },    { "fs", COMMENT_SLASH },     { "php", COMMENT_SLASH },
+    { "js", COMMENT_SLASH },    { "jsx", COMMENT_SLASH },    { "mjs", COMMENT_SLASH },
+    { "cjs", COMMENT_SLASH },   { "ts", COMMENT_SLASH },     { "tsx", COMMENT_SLASH },
+    { "dart", COMMENT_SLASH },  { "proto", COMMENT_SLASH },
+    { "py", COMMENT_HASH },     { "rb", COMMENT_HASH },      { "pl", COMMENT_HASH },
+    { "pm", COMMENT_HASH },     { "sh", COMMENT_HASH },      { "bash", COMMENT_HASH },
+    { "zsh", COMMENT_HASH },    { "r", COMMENT_HASH },       { "jl", COMMENT_HASH },
+    { "ex", COMMENT_HASH },     { "exs", COMMENT_HASH },     { "cmake", COMMENT_HASH },
+    { "tf", COMMENT_HASH },
+    { "lua", COMMENT_DASH },    { "hs", COMMENT_DASH },      { "sql", COMMENT_DASH },
+    { "erl", COMMENT_PERCENT },
+    { "clj", COMMENT_SEMICOLON },
+    { "ml", COMMENT_BLOCK_ML },
+    { "html", COMMENT_MARKUP }, { "xml", COMMENT_MARKUP },   { "vue", COMMENT_MARKUP },
+};
+
+int filetype_comment_kind(const char *name) {
+    const char *dot = strrchr(name, '.');
+    if (!dot || dot == name) return -1;
+    for (size_t i = 0; i < sizeof(file_types) / sizeof(file_types[0]); i++) {
+        if (strcasecmp(dot + 1, file_types[i].ext) == 0) return (int)file_types[i].kind;
+    }
+    return -1;
+}
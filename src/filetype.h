@@ -0,0 +1,41 @@
+/* File: src/filetype.h
+ *
+ * Header for the source file type table.
+ *
+ * Maps a file extension to the comment syntax used for license headers. The
+ * scanner uses it to decide which files should carry a header and the header
+ * writer to format one.
+ */
+
+#ifndef FILETYPE_H
+#define FILETYPE_H
+
+/* How a header is commented out: an optional opening line, a prefix for every
+ * header line and an optional closing line.
+ */
+typedef struct {
+    const char *open;       /* NULL: no opening line */
+    const char *prefix;
+    const char *close;      /* NULL: no closing line */
+} CommentStyle;
+
+typedef enum {
+    COMMENT_BLOCK_C,        /* C block comment */
+    COMMENT_SLASH,          /* // line comments */
+    COMMENT_HASH,           /* # line comments */
+    COMMENT_DASH,           /* -- line comments */
+    COMMENT_PERCENT,        /* % line comments */
+    COMMENT_SEMICOLON,      /* ;; line comments */
+    COMMENT_BLOCK_ML,       /* (* ... *) block comment */
+    COMMENT_MARKUP,         /* <!-- ... --> block comment */
+    COMMENT_STYLE_COUNT
+} CommentKind;
+
+extern const CommentStyle comment_styles[COMMENT_STYLE_COUNT];
+
+/* Returns the comment kind for a file name by its extension (case-insensitive),
+ * or -1 if the file is not a recognized source file.
+ */
+int filetype_comment_kind(const char *name);
+
+#endif /* FILETYPE_H */
@@ -0,0 +1,473 @@
+/* File: src/grep.c
+ *
+ * Implementation of --grep.
+ *
+ * The kernel is the usual first-and-last-byte filter: for every position in
+ * a vector it compares the haystack byte with the pattern's first byte and
+ * the byte len - 1 further on with its last byte, both folded by OR'ing in
+ * 0x20 when the pattern byte is a letter, and compares the bytes in between
+ * only where both agree. That rejects almost every position 16 (SSE2) or 32
+ * (AVX2, picked at run time) at a time. Each worker reads one file (or maps
+ * it, if large), runs the kernel from match to match, counts lines only up to
+ * each match, and keeps a copy of the matching lines, so nothing stays
+ * mapped after its file is done.
+ */
+
+#define _GNU_SOURCE
+
+#include "grep.h"
+#include "catalog.h"
+#include "io.h"
+#include "pool.h"
+#include "trace.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define GREP_HAVE_AVX2 1
+#endif
+
+/* Loose files smaller than this are read into the stack; for a typical
+ * license one read() costs less than setting up and faulting in a mapping.
+ */
+#define GREP_READ_MAX (64 * 1024)
+/* Matching lines longer than this are cut to a window around the match */
+#define GREP_CONTEXT_MAX 240
+
+typedef struct {
+    size_t line;
+    size_t column;          /* 1-based, in bytes */
+    size_t off;             /* context in GrepFile.context */
+    size_t len;
+    size_t hit;             /* the match within the context */
+    size_t hit_len;
+} GrepMatch;
+
+typedef struct {
+    DbKind kind;
+    char *name;
+    StrBuf context;
+    GrepMatch *matches;
+    size_t count;
+    size_t cap;
+    int failed;
+} GrepFile;
+
+typedef struct {
+    const GrepPattern *pattern;
+    const Database *db;
+    GrepFile *files;
+    size_t count;
+    size_t cap;
+    DbKind kind;            /* of the names being collected */
+    const Catalog *cat;
+    int category;
+    int failed;
+} GrepCtx;
+
+static const char *const kind_dirs[] = { "licenses", "descriptions" };
+static const char *const kind_suffixes[] = { ".txt", ".desc" };
+static const char *const kind_names[] = { "license", "description" };
+
+static unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+}
+
+static unsigned char case_bit(unsigned char c) {
+    return c >= 'a' && c <= 'z' ? 0x20 : 0;
+}
+
+int grep_compile(GrepPattern *p, const char *pattern) {
+    memset(p, 0, sizeof(*p));
+    p->len = strlen(pattern);
+    if (p->len == 0 || !(p->folded = malloc(p->len + 1))) {
+        return -1;
+    }
+    for (size_t i = 0; i <= p->len; i++) {
+        p->folded[i] = (char)fold((unsigned char)pattern[i]);
+    }
+    p->first = (unsigned char)p->folded[0];
+    p->last = (unsigned char)p->folded[p->len - 1];
+    p->first_case = case_bit(p->first);
+    p->last_case = case_bit(p->last);
+    p->kernel = GREP_SCALAR;
+#if defined(__SSE2__)
+    p->kernel = GREP_SSE2;
+#endif
+#if defined(GREP_HAVE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        p->kernel = GREP_AVX2;
+    }
+#endif
+    return 0;
+}
+
+void grep_free(GrepPattern *p) {
+    free(p->folded);
+    memset(p, 0, sizeof(*p));
+}
+
+const char *grep_kernel_name(GrepKernel kernel) {
+    switch (kernel) {
+    case GREP_AVX2: return "avx2";
+    case GREP_SSE2: return "sse2";
+    default:        return "scalar";
+    }
+}
+
+/* Compares the bytes between the first and the last, which the kernels have already matched */
+static int middle_equal(const GrepPattern *p, const char *s) {
+    for (size_t i = 1; i + 1 < p->len; i++) {
+        if (fold((unsigned char)s[i]) != (unsigned char)p->folded[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static const char *find_scalar(const GrepPattern *p, const char *s, const char *end) {
+    for (; (size_t)(end - s) >= p->len; s++) {
+        if (((unsigned char)s[0] | p->first_case) == p->first &&
+            ((unsigned char)s[p->len - 1] | p->last_case) == p->last && middle_equal(p, s)) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+#if defined(__SSE2__)
+static const char *find_sse2(const GrepPattern *p, const char *s, const char *end) {
+    const __m128i first = _mm_set1_epi8((char)p->first);
+    const __m128i last = _mm_set1_epi8((char)p->last);
+    const __m128i first_case = _mm_set1_epi8((char)p->first_case);
+    const __m128i last_case = _mm_set1_epi8((char)p->last_case);
+    while ((size_t)(end - s) >= p->len - 1 + 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i *)s), first_case);
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i *)(s + p->len - 1)), last_case);
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            const char *at = s + __builtin_ctz(mask);
+            if (middle_equal(p, at)) {
+                return at;
+            }
+            mask &= mask - 1;
+        }
+        s += 16;
+    }
+    return find_scalar(p, s, end);
+}
+#endif
+
+#if defined(GREP_HAVE_AVX2)
+__attribute__((target("avx2")))
+static const char *find_avx2(const GrepPattern *p, const char *s, const char *end) {
+    const __m256i first = _mm256_set1_epi8((char)p->first);
+    const __m256i last = _mm256_set1_epi8((char)p->last);
+    const __m256i first_case = _mm256_set1_epi8((char)p->first_case);
+    const __m256i last_case = _mm256_set1_epi8((char)p->last_case);
+    while ((size_t)(end - s) >= p->len - 1 + 32) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)s), first_case);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(s + p->len - 1)), last_case);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            const char *at = s + __builtin_ctz(mask);
+            if (middle_equal(p, at)) {
+                return at;
+            }
+            mask &= mask - 1;
+        }
+        s += 32;
+    }
+    return find_scalar(p, s, end);
+}
+#endif
+
+const char *grep_find(const GrepPattern *p, const char *text, size_t len) {
+    const char *end = text + len;
+    switch (p->kernel) {
+#if defined(GREP_HAVE_AVX2)
+    case GREP_AVX2: return find_avx2(p, text, end);
+#endif
+#if defined(__SSE2__)
+    case GREP_SSE2: return find_sse2(p, text, end);
+#endif
+    default:        return find_scalar(p, text, end);
+    }
+}
+
+/* Records the line [line, eol) holding a match at hit, cut to a window if it is long. */
+static void add_match(GrepFile *f, size_t line_no, const char *line, const char *eol, const char *hit,
+                      size_t hit_len) {
+    if (f->count == f->cap) {
+        size_t cap = f->cap ? f->cap * 2 : 8;
+        GrepMatch *grown = realloc(f->matches, cap * sizeof(*grown));
+        if (!grown) {
+            f->failed = 1;
+            return;
+        }
+        f->matches = grown;
+        f->cap = cap;
+    }
+    if (eol > line && eol[-1] == '\r') eol--;
+    const char *start = line, *end = eol;
+    if ((size_t)(end - start) > GREP_CONTEXT_MAX) {
+        start = (size_t)(hit - line) > GREP_CONTEXT_MAX / 3 ? hit - GREP_CONTEXT_MAX / 3 : line;
+        end = (size_t)(eol - start) > GREP_CONTEXT_MAX ? start + GREP_CONTEXT_MAX : eol;
+    }
+    if (hit + hit_len > end) hit_len = hit < end ? (size_t)(end - hit) : 0;
+    GrepMatch *m = &f->matches[f->count];
+    m->line = line_no;
+    m->column = (size_t)(hit - line) + 1;
+    m->off = f->context.len;
+    if ((start > line && sb_append(&f->context, "...", 3) != 0) ||
+        sb_append(&f->context, start, (size_t)(end - start)) != 0 ||
+        (end < eol && sb_append(&f->context, "...", 3) != 0)) {
+        f->failed = 1;
+        return;
+    }
+    m->len = f->context.len - m->off;
+    m->hit = (size_t)(hit - start) + (start > line ? 3 : 0);
+    m->hit_len = hit_len;
+    f->count++;
+}
+
+/* Reports each line of text holding the pattern once, at its first match. */
+static void grep_text(const GrepPattern *p, const char *text, size_t len, GrepFile *f) {
+    const char *end = text + len, *line = text, *hit;
+    size_t line_no = 1;
+    while (!f->failed && line < end && (hit = grep_find(p, line, (size_t)(end - line)))) {
+        for (const char *nl; (nl = memchr(line, '\n', (size_t)(hit - line))); line = nl + 1) {
+            line_no++;
+        }
+        const char *eol = memchr(hit, '\n', (size_t)(end - hit));
+        if (!eol) eol = end;
+        add_match(f, line_no, line, eol, hit, p->len);
+        line = eol + 1;
+        line_no++;
+    }
+}
+
+/* Reads a small loose file into the stack or maps a large one, or fetches
+ * the text from the bundle or embedded data.
+ */
+static void grep_file(size_t index, void *ctx) {
+    GrepCtx *g = ctx;
+    GrepFile *f = &g->files[index];
+    char path[1024];
+    if (db_path(g->db, f->kind, f->name, path, sizeof(path)) != 0) {
+        DbText text;
+        if (db_get(g->db, f->kind, f->name, &text) == 0) {
+            grep_text(g->pattern, text.data, text.len, f);
+            db_text_release(&text);
+        }
+        return;
+    }
+    TraceSpan span;
+    trace_begin(&span, TRACE_FILE_READ);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        trace_end(&span, 0);
+        return;
+    }
+    char buf[GREP_READ_MAX];
+    size_t total = 0;
+    while (total < sizeof(buf)) {
+        ssize_t n = read(fd, buf + total, sizeof(buf) - total);
+        if (n <= 0) break;
+        total += (size_t)n;
+    }
+    struct stat st;
+    if (total < sizeof(buf) || fstat(fd, &st) != 0) {
+        close(fd);
+        trace_end(&span, total);
+        grep_text(g->pattern, buf, total, f);
+        return;
+    }
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    trace_end(&span, map == MAP_FAILED ? 0 : len);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    madvise(map, len, MADV_SEQUENTIAL);
+    grep_text(g->pattern, map, len, f);
+    munmap(map, len);
+}
+
+static int collect_name(const char *name, void *ctx) {
+    GrepCtx *g = ctx;
+    if (g->category >= 0) {
+        const CatalogEntry *e = catalog_find(g->cat, name);
+        if (!e || e->category != g->category) {
+            return 0;
+        }
+    }
+    if (g->count == g->cap) {
+        size_t cap = g->cap ? g->cap * 2 : 64;
+        GrepFile *grown = realloc(g->files, cap * sizeof(*grown));
+        if (!grown) {
+            g->failed = 1;
+            return -1;
+        }
+        g->files = grown;
+        g->cap = cap;
+    }
+    GrepFile *f = &g->files[g->count];
+    memset(f, 0, sizeof(*f));
+    f->kind = g->kind;
+    if (!(f->name = strdup(name))) {
+        g->failed = 1;
+        return -1;
+    }
+    g->count++;
+    return 0;
+}
+
+static int compare_files(const void *a, const void *b) {
+    const GrepFile *x = a, *y = b;
+    if (x->kind != y->kind) return x->kind < y->kind ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+/* Writes the file name a match is reported under: the loose file's path, or
+ * its place in the data directory layout for the other backends.
+ */
+static void file_label(const Database *db, const GrepFile *f, char *out, size_t size) {
+    if (db_path(db, f->kind, f->name, out, size) != 0) {
+        snprintf(out, size, "%s/%s%s", kind_dirs[f->kind], f->name, kind_suffixes[f->kind]);
+    }
+}
+
+/* grep -n style: file:line:column:text */
+static int append_lines(StrBuf *out, const Database *db, const GrepFile *f, int color) {
+    char label[1024], prefix[1100];
+    file_label(db, f, label, sizeof(label));
+    int rc = 0;
+    for (size_t i = 0; i < f->count && rc == 0; i++) {
+        const GrepMatch *m = &f->matches[i];
+        const char *text = f->context.data + m->off;
+        int n = snprintf(prefix, sizeof(prefix), "%s:%zu:%zu:", label, m->line, m->column);
+        rc = sb_append(out, prefix, (size_t)n);
+        if (rc == 0 && color && m->hit_len) {
+            rc = sb_append(out, text, m->hit) || sb_append(out, "\x1b[1m", 4) ||
+                 sb_append(out, text + m->hit, m->hit_len) || sb_append(out, "\x1b[0m", 4) ||
+                 sb_append(out, text + m->hit + m->hit_len, m->len - m->hit - m->hit_len);
+        } else if (rc == 0) {
+            rc = sb_append(out, text, m->len);
+        }
+        if (rc == 0) rc = sb_append(out, "\n", 1);
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+/* Fields of --grep in the machine formats; the table is grep -n style lines */
+enum { GREP_FILE, GREP_NAME, GREP_KIND, GREP_LINE, GREP_COLUMN, GREP_TEXT };
+
+static const OutputField grep_fields[] = {
+    { "file", NULL, FIELD_STRING, 0, 0 },
+    { "name", NULL, FIELD_STRING, 0, 0 },
+    { "kind", NULL, FIELD_STRING, 0, 0 },
+    { "line", NULL, FIELD_NUMBER, 0, 0 },
+    { "column", NULL, FIELD_NUMBER, 0, 0 },
+    { "text", NULL, FIELD_STRING, 0, 0 },
+};
+
+static void add_rows(Output *o, const Database *db, const GrepFile *f) {
+    char label[1024];
+    file_label(db, f, label, sizeof(label));
+    for (size_t i = 0; i < f->count; i++) {
+        const GrepMatch *m = &f->matches[i];
+        output_row(o);
+        output_str(o, GREP_FILE, label);
+        output_str(o, GREP_NAME, f->name);
+        output_str(o, GREP_KIND, kind_names[f->kind]);
+        output_number(o, GREP_LINE, (double)m->line);
+        output_number(o, GREP_COLUMN, (double)m->column);
+        output_string(o, GREP_TEXT, f->context.data + m->off, m->len);
+    }
+}
+
+int run_grep(const char *pattern, const Database *db, int category, OutputFormat format, int color,
+             int threads, int debug) {
+    GrepPattern p;
+    if (grep_compile(&p, pattern) != 0) {
+        print_error("--grep expects a non-empty pattern");
+        return -1;
+    }
+    Catalog cat;
+    GrepCtx g = { &p, db, NULL, 0, 0, DB_LICENSE, &cat, category, 0 };
+    if (category >= 0 && catalog_open(&cat, db) != 0) {
+        print_error("Unable to build the license catalog.");
+        grep_free(&p);
+        return -1;
+    }
+    int rc = 0;
+    for (int kind = DB_LICENSE; kind <= DB_DESCRIPTION && rc == 0; kind++) {
+        g.kind = (DbKind)kind;
+        rc = db_each(db, g.kind, collect_name, &g) != 0 || g.failed ? -1 : 0;
+    }
+    if (category >= 0) {
+        catalog_close(&cat);
+    }
+    if (rc == 0 && g.count > 0) {
+        qsort(g.files, g.count, sizeof(*g.files), compare_files);
+        if (debug) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Scanning %zu files for '%s' (%s kernel)", g.count, pattern,
+                     grep_kernel_name(p.kernel));
+            debug_print(msg);
+        }
+        pool_run(g.count, threads, grep_file, &g);
+    }
+
+    /* Report in file order once every worker is done */
+    StrBuf out = {0};
+    size_t matches = 0;
+    Output o;
+    if (format != OUTPUT_TABLE) {
+        output_init(&o, format, grep_fields, sizeof(grep_fields) / sizeof(grep_fields[0]), NULL, NULL);
+    }
+    for (size_t i = 0; i < g.count; i++) {
+        GrepFile *f = &g.files[i];
+        if (rc == 0 && f->failed) rc = -1;
+        if (rc == 0 && format == OUTPUT_TABLE) {
+            rc = append_lines(&out, db, f, color);
+        } else if (rc == 0) {
+            add_rows(&o, db, f);
+        }
+        matches += f->count;
+        free(f->name);
+        free(f->matches);
+        sb_free(&f->context);
+    }
+    if (format != OUTPUT_TABLE) {
+        if (rc == 0) rc = output_finish(&o, &out);
+        output_free(&o);
+    }
+    if (rc != 0) {
+        print_error("Out of memory while scanning the licenses.");
+    } else if (out.len > 0 && write_output(&out) != 0) {
+        print_error("Unable to write the matches.");
+        rc = -1;
+    }
+    sb_free(&out);
+    free(g.files);
+    grep_free(&p);
+    if (rc != 0) return -1;
+    return matches > 0 ? 0 : 1;
+}
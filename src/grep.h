@@ -0,0 +1,60 @@
+/* File: src/grep.h
+ *
+ * Header for --grep, a case-insensitive substring scan of every license text
+ * and description.
+ *
+ * Unlike --search, which answers from the prebuilt index, --grep reads the
+ * texts themselves and reports every matching line with its file, line and
+ * column, like grep -n. Loose files are scanned in parallel over the worker
+ * pool, large ones through mmap; the bundle and embedded backends hand over
+ * their texts directly. Case is folded for ASCII letters only.
+ */
+
+#ifndef GREP_H
+#define GREP_H
+
+#include <stddef.h>
+#include "db.h"
+#include "output.h"
+
+typedef enum {
+    GREP_SCALAR,
+    GREP_SSE2,
+    GREP_AVX2
+} GrepKernel;
+
+/* A compiled pattern. The kernels look for the pattern's first and last
+ * bytes a vector at a time and compare the rest only where both match.
+ */
+typedef struct {
+    char *folded;           /* the pattern in lower case */
+    size_t len;
+    unsigned char first, last;
+    unsigned char first_case, last_case;    /* 0x20 when the byte is a letter: OR'ed in to fold */
+    GrepKernel kernel;
+} GrepPattern;
+
+/* Compiles pattern for the fastest kernel the CPU supports.
+ * Returns 0 on success, -1 if pattern is empty or memory runs out.
+ */
+int grep_compile(GrepPattern *p, const char *pattern);
+
+void grep_free(GrepPattern *p);
+
+/* Returns the first occurrence of the pattern in text, ignoring ASCII case,
+ * or NULL if there is none.
+ */
+const char *grep_find(const GrepPattern *p, const char *text, size_t len);
+
+/* Returns the name of a kernel, for debug output. */
+const char *grep_kernel_name(GrepKernel kernel);
+
+/* Scans every license and description (only those of category when it is
+ * >= 0) on up to threads workers (threads <= 0 means one per CPU) and writes
+ * the matching lines to stdout in format, highlighting matches if color is
+ * set. Returns 0 if something matched, 1 if nothing did, -1 on failure.
+ */
+int run_grep(const char *pattern, const Database *db, int category, OutputFormat format, int color,
+             int threads, int debug);
+
+#endif /* GREP_H */
@@ -0,0 +1,318 @@
+/* File: src/headers.c
+ *
+ * Implementation of bulk license-header insertion.
+ *
+ * Files are handled by the walker's workers as their directory is listed.
+ * Only the head of each file is read to look for an existing header; a file
+ * that needs one is rewritten as a stream into a temporary file next to it
+ * (kept lines such as "#!" first, then the header, then the original bytes)
+ * which is renamed over the original, so readers never see a partial file.
+ */
+
+#define _GNU_SOURCE
+
+#include "headers.h"
+#include "filetype.h"
+#include "io.h"
+#include "license.h"
+#include "scan.h"
+#include "subst.h"
+#include "template.h"
+#include "trace.h"
+#include "utils.h"
+#include "walk.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef struct {
+    const char *license;
+    const char *spdx;
+    StrBuf headers[COMMENT_STYLE_COUNT][2];    /* per comment kind, LF and CRLF */
+    pthread_mutex_t lock;                      /* report output */
+    atomic_size_t added, present, skipped, failed;
+} HeaderCtx;
+
+/* Returns the first spelling of a placeholder field shared by every license, or NULL. */
+static const char *first_token(const Config *config, const char *field) {
+    for (int i = 0; i < config->token_count; i++) {
+        if (strcmp(config->tokens[i].field, field) == 0 && config->tokens[i].license[0] == '\0') {
+            return config->tokens[i].text;
+        }
+    }
+    return NULL;
+}
+
+/* Renders the copyright line through the same placeholder expansion as LICENSE files. */
+static char *render_copyright(const Config *config) {
+    const char *year = first_token(config, "year");
+    const char *author = first_token(config, "author");
+    StrBuf tmpl = {0};
+    sb_append_str(&tmpl, "Copyright (c) ");
+    sb_append_str(&tmpl, year ? year : config->year);
+    sb_append(&tmpl, " ", 1);
+    if (sb_append_str(&tmpl, author ? author : config->author) != 0) {
+        sb_free(&tmpl);
+        return NULL;
+    }
+    /* Year ranges and holder lists read as they do in LICENSE files */
+    TemplateValues values;
+    template_values(&values, config, NULL, NULL);
+    Subst *subst = subst_compile_config(config, NULL);
+    char *line = subst ? replace_placeholders(subst, tmpl.data, tmpl.len, values.year, values.author) : NULL;
+    subst_free(subst);
+    sb_free(&tmpl);
+    return line;
+}
+
+/* Formats the header lines as a comment in the given style, followed by a blank line. */
+static int build_header(StrBuf *out, const CommentStyle *style, const char *const *lines,
+                        size_t count, const char *eol) {
+    int rc = 0;
+    if (style->open) {
+        rc |= sb_append_str(out, style->open);
+        rc |= sb_append_str(out, eol);
+    }
+    for (size_t i = 0; i < count; i++) {
+        rc |= sb_append_str(out, style->prefix);
+        rc |= sb_append_str(out, lines[i]);
+        rc |= sb_append_str(out, eol);
+    }
+    if (style->close) {
+        rc |= sb_append_str(out, style->close);
+        rc |= sb_append_str(out, eol);
+    }
+    rc |= sb_append_str(out, eol);
+    return rc ? -1 : 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Returns the length of the leading bytes that must stay first: a UTF-8 byte
+ * order mark, then a "#!", "<?xml" or "<?php" line and a following encoding
+ * declaration. Returns -1 when such a line does not end within the head.
+ */
+static long kept_prefix(const char *head, size_t n, size_t file_size, int *need_eol) {
+    *need_eol = 0;
+    size_t bom = n >= 3 && memcmp(head, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    const char *line = head + bom;
+    size_t rest = n - bom;
+    if (!(rest >= 2 && memcmp(line, "#!", 2) == 0) && !(rest >= 5 && memcmp(line, "<?xml", 5) == 0) &&
+        !(rest >= 5 && memcmp(line, "<?php", 5) == 0)) {
+        return (long)bom;
+    }
+    const char *nl = memchr(line, '\n', rest);
+    if (!nl) {
+        if (n < file_size) return -1;
+        *need_eol = 1;
+        return (long)n;
+    }
+    size_t keep = (size_t)(nl - head) + 1;
+    /* A Python/Ruby coding declaration must stay on the first two lines */
+    const char *next = head + keep, *end = head + n;
+    const char *nl2 = memchr(next, '\n', (size_t)(end - next));
+    if (nl2 && next < end && *next == '#' && memmem(next, (size_t)(nl2 - next), "coding", 6)) {
+        keep = (size_t)(nl2 - head) + 1;
+    }
+    return (long)keep;
+}
+
+/* Returns 1 if the SPDX expression found in a file names the license being applied. */
+static int spdx_matches(const HeaderCtx *hc, const char *found) {
+    if (strcasecmp(found, hc->spdx) == 0) return 1;
+    const char *name = license_from_spdx(found);
+    return name && strcasecmp(name, hc->license) == 0;
+}
+
+static void report(HeaderCtx *hc, const char *dir, const char *name, const char *reason) {
+    pthread_mutex_lock(&hc->lock);
+    printf("%s/%s: %s\n", dir, name, reason);
+    pthread_mutex_unlock(&hc->lock);
+}
+
+static void apply_file(HeaderCtx *hc, const char *dir, const char *name, CommentKind kind) {
+    char path[4096], tmp_path[4096];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir, name) >= sizeof(path) ||
+        (size_t)snprintf(tmp_path, sizeof(tmp_path), "%s/.%s.osla-XXXXXX", dir, name) >= sizeof(tmp_path)) {
+        report(hc, dir, name, "path too long");
+        atomic_fetch_add(&hc->failed, 1);
+        return;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        report(hc, dir, name, strerror(errno));
+        atomic_fetch_add(&hc->failed, 1);
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    char head[SCAN_HEAD_SIZE];
+    size_t n = 0;
+    TraceSpan span;
+    trace_begin(&span, TRACE_FILE_READ);
+    while (n < sizeof(head)) {
+        ssize_t r = read(fd, head + n, sizeof(head) - n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        n += (size_t)r;
+    }
+    trace_end(&span, n);
+
+    char found[128];
+    if (scan_find_spdx(head, n, found, sizeof(found))) {
+        if (spdx_matches(hc, found)) {
+            atomic_fetch_add(&hc->present, 1);
+        } else {
+            char reason[192];
+            snprintf(reason, sizeof(reason), "skipped, header names %s", found);
+            report(hc, dir, name, reason);
+            atomic_fetch_add(&hc->skipped, 1);
+        }
+        close(fd);
+        return;
+    }
+    if (memchr(head, '\0', n)) {
+        report(hc, dir, name, "skipped, binary file");
+        atomic_fetch_add(&hc->skipped, 1);
+        close(fd);
+        return;
+    }
+    int need_eol;
+    long keep = kept_prefix(head, n, (size_t)st.st_size, &need_eol);
+    if (keep < 0) {
+        report(hc, dir, name, "skipped, first line too long");
+        atomic_fetch_add(&hc->skipped, 1);
+        close(fd);
+        return;
+    }
+    int crlf = memmem(head, n, "\r\n", 2) != NULL;
+    const StrBuf *header = &hc->headers[kind][crlf];
+
+    trace_begin(&span, TRACE_OUTPUT_WRITE);
+    int out = mkostemp(tmp_path, O_CLOEXEC);
+    if (out < 0) {
+        trace_end(&span, 0);
+        report(hc, dir, name, strerror(errno));
+        atomic_fetch_add(&hc->failed, 1);
+        close(fd);
+        return;
+    }
+    int rc = fchmod(out, st.st_mode & 07777);
+    if (rc == 0) rc = write_all(out, head, (size_t)keep);
+    if (rc == 0 && need_eol) rc = write_all(out, crlf ? "\r\n" : "\n", crlf ? 2 : 1);
+    /* Drop the trailing blank line when nothing follows the header */
+    size_t header_len = (size_t)keep < n ? header->len : header->len - (crlf ? 2 : 1);
+    if (rc == 0) rc = write_all(out, header->data, header_len);
+    if (rc == 0) rc = write_all(out, head + keep, n - (size_t)keep);
+    if (rc == 0 && n == sizeof(head)) rc = copy_fd(fd, out);
+    int err = errno;
+    if (close(out) != 0 && rc == 0) {
+        rc = -1;
+        err = errno;
+    }
+    close(fd);
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        rc = -1;
+        err = errno;
+    }
+    trace_end(&span, (size_t)st.st_size + header_len);
+    if (rc != 0) {
+        unlink(tmp_path);
+        report(hc, dir, name, strerror(err));
+        atomic_fetch_add(&hc->failed, 1);
+        return;
+    }
+    atomic_fetch_add(&hc->added, 1);
+}
+
+static const void *headers_visit(const char *dir, const WalkEntry *files, size_t count,
+                                 const void *inherited, void *ctx) {
+    (void)inherited;
+    for (size_t i = 0; i < count; i++) {
+        int kind = filetype_comment_kind(files[i].name);
+        if (kind >= 0) apply_file(ctx, dir, files[i].name, (CommentKind)kind);
+    }
+    return NULL;
+}
+
+int run_apply_headers(const char *root, const char *license, const Database *db, const Config *config,
+                      int threads) {
+    HeaderCtx hc;
+    memset(&hc, 0, sizeof(hc));
+    hc.license = license;
+    hc.spdx = license_spdx_id(license);
+
+    char spdx_line[128], ref[96];
+    LicenseInfo info;
+    if (!hc.spdx && db_license_info(db, license, &info) == 0 && info.spdx[0]) {
+        snprintf(ref, sizeof(ref), "%s", info.spdx);
+        hc.spdx = ref;
+    } else if (!hc.spdx) {
+        /* Licenses without an SPDX identifier get a LicenseRef- one */
+        snprintf(ref, sizeof(ref), "LicenseRef-%.80s", license);
+        hc.spdx = ref;
+    }
+    snprintf(spdx_line, sizeof(spdx_line), "SPDX-License-Identifier: %s", hc.spdx);
+    char *copyright = render_copyright(config);
+    if (!copyright) {
+        print_error("Out of memory during placeholder expansion");
+        return -1;
+    }
+    const char *lines[] = { spdx_line, copyright };
+    for (int k = 0; k < COMMENT_STYLE_COUNT; k++) {
+        if (build_header(&hc.headers[k][0], &comment_styles[k], lines, 2, "\n") != 0 ||
+            build_header(&hc.headers[k][1], &comment_styles[k], lines, 2, "\r\n") != 0) {
+            print_error("Out of memory while preparing headers");
+            free(copyright);
+            for (int j = 0; j <= k; j++) {
+                sb_free(&hc.headers[j][0]);
+                sb_free(&hc.headers[j][1]);
+            }
+            return -1;
+        }
+    }
+    free(copyright);
+
+    pthread_mutex_init(&hc.lock, NULL);
+    atomic_init(&hc.added, 0);
+    atomic_init(&hc.present, 0);
+    atomic_init(&hc.skipped, 0);
+    atomic_init(&hc.failed, 0);
+
+    int rc = walk_tree(root, threads, headers_visit, NULL, &hc);
+    if (rc < 0) {
+        char errmsg[512];
+        snprintf(errmsg, sizeof(errmsg), "Unable to walk directory '%s'", root);
+        print_error(errmsg);
+    } else {
+        printf("Added headers to %zu files (%zu already present, %zu skipped, %zu failed).\n",
+               atomic_load(&hc.added), atomic_load(&hc.present), atomic_load(&hc.skipped),
+               atomic_load(&hc.failed));
+        rc = rc > 0 || atomic_load(&hc.skipped) || atomic_load(&hc.failed) ? 1 : 0;
+    }
+    pthread_mutex_destroy(&hc.lock);
+    for (int k = 0; k < COMMENT_STYLE_COUNT; k++) {
+        sb_free(&hc.headers[k][0]);
+        sb_free(&hc.headers[k][1]);
+    }
+    return rc;
+}
@@ -0,0 +1,27 @@
+/* File: src/headers.h
+ *
+ * Header for bulk license-header insertion.
+ *
+ * Stamps an SPDX-License-Identifier and copyright line into every source file
+ * of a tree, commented out in the syntax of each file type.
+ */
+
+#ifndef HEADERS_H
+#define HEADERS_H
+
+#include "config.h"
+#include "db.h"
+
+/* Adds a header for license to every source file under root that does not
+ * already carry one, on up to threads workers (threads <= 0 means one per CPU).
+ * Files whose SPDX header names another license are reported and left alone.
+ * The SPDX id comes from the built-in table or db's metadata, and is a
+ * LicenseRef- one for licenses neither lists. The copyright line is rendered
+ * with the config's year, author and tokens.
+ * Returns 0 if every file has a matching header afterwards, 1 if some files
+ * were skipped or failed, -1 if root cannot be walked.
+ */
+int run_apply_headers(const char *root, const char *license, const Database *db, const Config *config,
+                      int threads);
+
+#endif /* HEADERS_H */
@@ -2,34 +2,236 @@
  *
  * Implementation for input/output functions.
  *
- * Handles writing to files, error reporting, listing licenses, printing descriptions,
- * and searching license texts.
+ * Handles writing to files (atomically, and not at all when the content is
+ * unchanged, so build systems watching the mtime stay quiet), error reporting,
+ * listing licenses, printing descriptions, and searching license texts.
  */
 
 #define _GNU_SOURCE  /* Ensure that strcasestr is declared */
 
 #include "io.h"
 #include "utils.h"
-#include "license.h"  // For alias_map
+#include "license.h"
+#include "names.h"  // For the alias column of the license list
+#include "catalog.h"
+#include "output.h"
+#include "db.h"
+#include "search.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
-#include <sys/types.h>
 #include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include <strings.h>  // For strcasecmp and strcasestr
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-int write_to_file(const char *filename, const char *content) {
-    FILE *fp = fopen(filename, "w");
-    if (!fp) {
-        return -1;
+/* Spans handed to one writev() call */
+#define IOV_WINDOW 64
+/* Buffer of copy_fd() when the kernel cannot copy */
+#define COPY_BUF_SIZE 65536
+
+int write_iov(int fd, const struct iovec *iov, size_t count) {
+    struct iovec window[IOV_WINDOW];
+    size_t next = 0, n = 0;
+    for (;;) {
+        while (n < IOV_WINDOW && next < count) {
+            if (iov[next].iov_len) window[n++] = iov[next];
+            next++;
+        }
+        if (n == 0) return 0;
+        ssize_t written = writev(fd, window, (int)n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        /* Drop the spans written in full and trim a partly written one */
+        size_t done = (size_t)written, i = 0;
+        while (i < n && done >= window[i].iov_len) {
+            done -= window[i++].iov_len;
+        }
+        if (i < n) {
+            window[i].iov_base = (char *)window[i].iov_base + done;
+            window[i].iov_len -= done;
+        }
+        memmove(window, window + i, (n - i) * sizeof(*window));
+        n -= i;
     }
-    if (fputs(content, fp) < 0) {
-        fclose(fp);
-        return -1;
+}
+
+int copy_fd(int in, int out) {
+    for (;;) {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0);
+        if (n > 0) continue;
+        if (n == 0) return 0;
+        if (errno == EINTR) continue;
+        if (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP) return -1;
+        break;
     }
-    fclose(fp);
-    return 0;
+    char *buf = malloc(COPY_BUF_SIZE);
+    if (!buf) return -1;
+    int rc = 0;
+    for (;;) {
+        ssize_t n = read(in, buf, COPY_BUF_SIZE);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            rc = -1;
+            break;
+        }
+        struct iovec iov = { buf, (size_t)n };
+        if (write_iov(out, &iov, 1) != 0) {
+            rc = -1;
+            break;
+        }
+    }
+    free(buf);
+    return rc;
+}
+
+/* Returns 1 if the open file fd of size bytes holds exactly the spans of iov. */
+static int file_equals(int fd, size_t size, const struct iovec *iov, size_t count) {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) len += iov[i].iov_len;
+    if (size != len) return 0;
+    if (len == 0) return 1;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return 0;
+    const char *p = map;
+    int same = 1;
+    for (size_t i = 0; i < count && same; i++) {
+        same = memcmp(p, iov[i].iov_base, iov[i].iov_len) == 0;
+        p += iov[i].iov_len;
+    }
+    munmap(map, len);
+    return same;
+}
+
+/* Creates a fresh temporary file next to path. O_EXCL with mode 0666 lets the
+ * kernel apply the umask, as fopen would for a new file.
+ */
+static int open_temp(const char *path, char *tmp, size_t tmp_size) {
+    static atomic_uint counter;
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path + 1) : 0;
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if ((size_t)snprintf(tmp, tmp_size, "%.*s.%s.%ld.%u.tmp", dir_len, path, slash ? slash + 1 : path,
+                             (long)getpid(), atomic_fetch_add(&counter, 1)) >= tmp_size) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd >= 0 || errno != EEXIST) return fd;
+    }
+    return -1;
+}
+
+int write_to_file(const char *filename, const char *content, size_t len, int mode) {
+    struct iovec iov = { (void *)content, len };
+    return write_iov_to_file(filename, &iov, 1, mode);
+}
+
+int write_iov_to_file(const char *filename, const struct iovec *iov, size_t count, int mode) {
+    TraceSpan span;
+    trace_begin(&span, TRACE_OUTPUT_WRITE);
+
+    /* Write through a symlink to its target rather than replacing the link */
+    char target[PATH_MAX];
+    struct stat st;
+    if (lstat(filename, &st) == 0 && S_ISLNK(st.st_mode) && realpath(filename, target)) {
+        filename = target;
+    }
+
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    int exists = fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    int same = exists && file_equals(fd, (size_t)st.st_size, iov, count);
+    if (fd >= 0) close(fd);
+    if (same) {
+        int rc = WRITE_UNCHANGED;
+        if (mode >= 0 && (st.st_mode & 07777) != (mode_t)mode && chmod(filename, (mode_t)mode) != 0) {
+            rc = WRITE_FAILED;
+        }
+        trace_end(&span, 0);
+        return rc;
+    }
+
+    char tmp[PATH_MAX];
+    int out = open_temp(filename, tmp, sizeof(tmp));
+    if (out < 0) {
+        trace_end(&span, 0);
+        return WRITE_FAILED;
+    }
+    int rc = 0;
+    /* An explicit mode wins; otherwise a replaced file keeps its own */
+    if (mode >= 0) {
+        rc = fchmod(out, (mode_t)mode);
+    } else if (exists) {
+        rc = fchmod(out, st.st_mode & 07777);
+    }
+    if (rc == 0) rc = write_iov(out, iov, count);
+    /* The data must be on disk before the rename makes it the file */
+    if (rc == 0) rc = fsync(out);
+    int err = errno;
+    if (close(out) != 0 && rc == 0) {
+        rc = -1;
+        err = errno;
+    }
+    if (rc == 0 && rename(tmp, filename) != 0) {
+        rc = -1;
+        err = errno;
+    }
+    if (rc != 0) {
+        unlink(tmp);
+        errno = err;
+    }
+    size_t len = 0;
+    for (size_t i = 0; rc == 0 && i < count; i++) len += iov[i].iov_len;
+    trace_end(&span, len);
+    return rc == 0 ? WRITE_DONE : WRITE_FAILED;
+}
+
+FILE *open_replacement(const char *filename, char *tmp, size_t tmp_size) {
+    int fd = open_temp(filename, tmp, tmp_size);
+    if (fd < 0) return NULL;
+    FILE *out = fdopen(fd, "w");
+    if (!out) {
+        int err = errno;
+        close(fd);
+        unlink(tmp);
+        errno = err;
+    }
+    return out;
+}
+
+int commit_replacement(FILE *out, const char *tmp, const char *filename, int mode, int ok) {
+    struct stat st;
+    int rc = ok && !ferror(out) ? 0 : -1;
+    int err = rc == 0 ? 0 : EIO;
+    if (rc == 0 && mode >= 0) {
+        rc = fchmod(fileno(out), (mode_t)mode);
+    } else if (rc == 0 && stat(filename, &st) == 0) {
+        rc = fchmod(fileno(out), st.st_mode & 07777);
+    }
+    if (rc == 0 && (fflush(out) != 0 || fsync(fileno(out)) != 0)) rc = -1;
+    if (rc != 0 && err == 0) err = errno;
+    if (fclose(out) != 0 && rc == 0) {
+        rc = -1;
+        err = errno;
+    }
+    if (rc == 0 && rename(tmp, filename) != 0) {
+        rc = -1;
+        err = errno;
+    }
+    if (rc != 0) {
+        unlink(tmp);
+        errno = err;
+    }
+    return rc;
 }
 
 void print_error(const char *message) {
@@ -38,104 +240,242 @@ void print_error(const char *message) {
 
 void debug_print(const char *message) {
     fprintf(stderr, "[DEBUG]: %s\n", message);
+    trace_message(message);
 }
 
-void list_license_files(const char *dir_path) {
-    DIR *dir = opendir(dir_path);
-    if (!dir) {
-        print_error("Unable to open licenses directory.");
-        return;
+/* Fields of --list; only the first two show in the table. */
+enum { LIST_NAME, LIST_ALIASES, LIST_SPDX, LIST_TITLE, LIST_CATEGORY, LIST_OSI, LIST_FSF, LIST_SIZE, LIST_PATH };
+
+static const OutputField list_fields[] = {
+    { "name", "Short Name", FIELD_STRING, 20, 0 },
+    { "aliases", "Aliases / Description", FIELD_LIST, 30, 0 },
+    { "spdx", NULL, FIELD_STRING, 0, 0 },
+    { "title", NULL, FIELD_STRING, 0, 0 },
+    { "category", NULL, FIELD_STRING, 0, 0 },
+    { "osi", NULL, FIELD_BOOL, 0, 0 },
+    { "fsf", NULL, FIELD_BOOL, 0, 0 },
+    { "size", NULL, FIELD_NUMBER, 0, 0 },
+    { "path", NULL, FIELD_STRING, 0, 0 },
+};
+
+typedef struct {
+    Output *out;
+    const Database *db;
+} ListVisit;
+
+static void list_path(Output *o, size_t field, const Database *db, DbKind kind, const char *name) {
+    char path[1024];
+    if (db_path(db, kind, name, path, sizeof(path)) == 0) {
+        output_str(o, field, path);
     }
-    struct dirent *entry;
-    printf("Available licenses:\n");
-    printf("%-20s %-30s\n", "Short Name", "Aliases / Description");
-    printf("-------------------------------------------------------------\n");
-    while ((entry = readdir(dir)) != NULL) {
-        /* Check if the directory entry is a regular file.
-         * Note: Some filesystems may not support d_type. */
-        #ifdef DT_REG
-        if (entry->d_type == DT_REG) {
-        #else
-        if (1) { /* Fallback: process all entries */
-        #endif
-            char *dot = strrchr(entry->d_name, '.');
-            if (dot && strcmp(dot, ".txt") == 0) {
-                char lic_name[128];
-                size_t name_len = dot - entry->d_name;
-                if (name_len >= sizeof(lic_name))
-                    name_len = sizeof(lic_name) - 1;
-                strncpy(lic_name, entry->d_name, name_len);
-                lic_name[name_len] = '\0';
-                const char *alias_found = "";
-                for (int i = 0; alias_map[i].alias != NULL; i++) {
-                    if (strcmp(alias_map[i].full, lic_name) == 0){
-                        alias_found = alias_map[i].alias;
-                        break;
-                    }
-                }
-                printf("%-20s %-30s\n", lic_name, alias_found);
+}
+
+static int list_visit(const char *lic_name, void *ctx) {
+    ListVisit *v = ctx;
+    const NameEntry *e = name_find(lic_name);
+    output_row(v->out);
+    output_str(v->out, LIST_NAME, lic_name);
+    output_str(v->out, LIST_ALIASES, e && e->alias ? e->alias : "");
+    output_str(v->out, LIST_SPDX, e ? e->spdx : NULL);
+    list_path(v->out, LIST_PATH, v->db, DB_LICENSE, lic_name);
+    return 0;
+}
+
+int list_license_files(const Database *db, int category, OutputFormat format, StrBuf *out) {
+    Catalog cat;
+    int have_catalog = catalog_open(&cat, db) == 0;
+    if (!have_catalog && category >= 0) {
+        return -1;
+    }
+    Output o;
+    output_init(&o, format, list_fields, sizeof(list_fields) / sizeof(list_fields[0]), "Available licenses:", NULL);
+    int rc = 0;
+    if (!have_catalog) {
+        ListVisit v = { &o, db };
+        rc = db_each(db, DB_LICENSE, list_visit, &v) == 0 ? 0 : -1;
+    } else {
+        for (uint32_t i = 0; i < cat.header->count; i++) {
+            const CatalogEntry *e = &cat.entries[i];
+            if (category >= 0 && e->category != category) {
+                continue;
             }
+            const char *name = catalog_str(&cat, e->name_off);
+            const char *spdx = catalog_str(&cat, e->spdx_off);
+            const char *title = catalog_str(&cat, e->title_off);
+            output_row(&o);
+            output_str(&o, LIST_NAME, name);
+            output_str(&o, LIST_ALIASES, catalog_str(&cat, e->aliases_off));
+            output_str(&o, LIST_SPDX, spdx[0] ? spdx : NULL);
+            output_str(&o, LIST_TITLE, title[0] ? title : NULL);
+            output_str(&o, LIST_CATEGORY, catalog_category_name(e->category));
+            output_number(&o, LIST_OSI, (e->flags & LICENSE_OSI) != 0);
+            output_number(&o, LIST_FSF, (e->flags & LICENSE_FSF) != 0);
+            output_number(&o, LIST_SIZE, e->size);
+            list_path(&o, LIST_PATH, db, DB_LICENSE, name);
         }
+        catalog_close(&cat);
+    }
+    if (rc == 0) {
+        rc = output_finish(&o, out);
     }
-    closedir(dir);
+    output_free(&o);
+    return rc;
 }
 
-void print_description(const char *license, const char *desc_dir) {
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s/%s.desc", desc_dir, license);
-    FILE *fp = fopen(filepath, "r");
-    if (!fp) {
-        char errmsg[128];
-        snprintf(errmsg, sizeof(errmsg), "Description file for '%s' not found.", license);
-        print_error(errmsg);
-        return;
+enum { DESC_NAME, DESC_PATH, DESC_TEXT };
+
+static const OutputField desc_fields[] = {
+    { "name", NULL, FIELD_STRING, 0, 0 },
+    { "path", NULL, FIELD_STRING, 0, 0 },
+    { "description", NULL, FIELD_STRING, 0, 0 },
+};
+
+int print_description(const char *license, const Database *db, OutputFormat format, StrBuf *out) {
+    DbText text;
+    if (db_get(db, DB_DESCRIPTION, license, &text) != 0) {
+        return -1;
     }
-    char buffer[1024];
-    while (fgets(buffer, sizeof(buffer), fp)) {
-        printf("%s", buffer);
+    int rc;
+    if (format == OUTPUT_TABLE) {
+        /* People get the description as written */
+        rc = sb_append(out, text.data, text.len);
+    } else {
+        Output o;
+        output_init(&o, format, desc_fields, sizeof(desc_fields) / sizeof(desc_fields[0]), NULL, NULL);
+        output_row(&o);
+        output_str(&o, DESC_NAME, license);
+        list_path(&o, DESC_PATH, db, DB_DESCRIPTION, license);
+        output_string(&o, DESC_TEXT, text.data, text.len);
+        rc = output_finish(&o, out);
+        output_free(&o);
     }
-    fclose(fp);
+    db_text_release(&text);
+    return rc;
 }
 
-void search_license(const char *keyword, const char *licenses_dir, const char *desc_dir) {
-    (void) desc_dir; /* Unused parameter */
-    DIR *dir = opendir(licenses_dir);
-    if (!dir) {
-        print_error("Unable to open licenses directory for searching.");
-        return;
+/* Appends up to width bytes of text around [hit, hit + hit_len) as one line,
+ * with whitespace collapsed, highlighting the match if color is set.
+ */
+static int append_snippet(StrBuf *out, const char *text, size_t len, size_t hit, size_t hit_len, size_t width,
+                          int color) {
+    size_t start = hit > width / 3 ? hit - width / 3 : 0;
+    size_t end = start + width < len ? start + width : len;
+    if (hit + hit_len > end) hit_len = hit < end ? end - hit : 0;
+    if (sb_reserve(out, end - start + 16) != 0) {
+        return -1;
     }
-    struct dirent *entry;
-    printf("Search results for \"%s\":\n", keyword);
-    printf("%-20s %-30s\n", "License", "Snippet");
-    printf("-------------------------------------------------------------\n");
-    while ((entry = readdir(dir)) != NULL) {
-        #ifdef DT_REG
-        if (entry->d_type == DT_REG) {
-        #else
-        if (1) {
-        #endif
-            char *dot = strrchr(entry->d_name, '.');
-            if (dot && strcmp(dot, ".txt") == 0) {
-                char lic_name[128];
-                size_t name_len = dot - entry->d_name;
-                if (name_len >= sizeof(lic_name))
-                    name_len = sizeof(lic_name) - 1;
-                strncpy(lic_name, entry->d_name, name_len);
-                lic_name[name_len] = '\0';
-                char filepath[256];
-                snprintf(filepath, sizeof(filepath), "%s/%s.txt", licenses_dir, lic_name);
-                FILE *fp = fopen(filepath, "r");
-                if (!fp) continue;
-                char snippet[256] = "";
-                if (fgets(snippet, sizeof(snippet), fp)) {
-                    if (strcasestr(snippet, keyword) || strcasestr(lic_name, keyword)) {
-                        printf("%-20s %-30.27s...\n", lic_name, snippet);
-                    }
-                }
-                fclose(fp);
-            }
+    int last_space = 1;
+    if (start > 0) sb_append(out, "...", 3);
+    for (size_t i = start; i < end; i++) {
+        if (hit_len && i == hit && color) sb_append(out, "\x1b[1m", 4);
+        unsigned char c = (unsigned char)text[i];
+        if (isspace(c)) {
+            if (!last_space) sb_append(out, " ", 1);
+            last_space = 1;
+        } else {
+            sb_append(out, text + i, 1);
+            last_space = 0;
         }
+        if (hit_len && i + 1 == hit + hit_len && color) sb_append(out, "\x1b[0m", 4);
     }
-    closedir(dir);
+    if (end < len) return sb_append(out, "...", 3);
+    return 0;
 }
 
+/* Fields of --search; aliases and path stay out of the table. */
+enum { SEARCH_NAME, SEARCH_SCORE, SEARCH_SNIPPET, SEARCH_ALIASES, SEARCH_OFFSET, SEARCH_PATH };
+
+static const OutputField search_fields[] = {
+    { "name", "License", FIELD_STRING, 20, 0 },
+    { "score", "Score", FIELD_NUMBER, 7, 2 },
+    { "snippet", "Snippet", FIELD_STRING, 0, 0 },
+    { "aliases", NULL, FIELD_LIST, 0, 0 },
+    { "offset", NULL, FIELD_NUMBER, 0, 0 },
+    { "path", NULL, FIELD_STRING, 0, 0 },
+};
+
+int print_search_results(const SearchIndex *idx, const char *keyword, const Database *db, const Catalog *cat,
+                         int category, OutputFormat format, int color, StrBuf *out) {
+    SearchResult *results;
+    size_t count;
+    if (search_index_query(idx, keyword, &results, &count) != 0) {
+        return -1;
+    }
+    char title[320];
+    snprintf(title, sizeof(title), "Search results for \"%.256s\":", keyword);
+    Output o;
+    output_init(&o, format, search_fields, sizeof(search_fields) / sizeof(search_fields[0]), title, "No matches.");
+    StrBuf snippet = {0};
+    int rc = 0;
+    for (size_t i = 0; i < count && rc == 0; i++) {
+        size_t text_len;
+        const char *name = search_doc_name(idx, results[i].doc, NULL);
+        const CatalogEntry *e = cat ? catalog_find(cat, name) : NULL;
+        if (cat && category >= 0 && (!e || e->category != category)) {
+            continue;
+        }
+        const char *text = search_doc_text(idx, results[i].doc, &text_len);
+        snippet.len = 0;
+        rc = append_snippet(&snippet, text, text_len, results[i].hit_off, results[i].hit_len, 60,
+                            color && format == OUTPUT_TABLE);
+        output_row(&o);
+        output_str(&o, SEARCH_NAME, name);
+        output_number(&o, SEARCH_SCORE, results[i].score);
+        output_string(&o, SEARCH_SNIPPET, snippet.data, snippet.len);
+        if (e) {
+            output_str(&o, SEARCH_ALIASES, catalog_str(cat, e->aliases_off));
+        } else {
+            const NameEntry *n = name_find(name);
+            output_str(&o, SEARCH_ALIASES, n && n->alias ? n->alias : "");
+        }
+        output_number(&o, SEARCH_OFFSET, results[i].hit_off);
+        if (db) {
+            list_path(&o, SEARCH_PATH, db, DB_LICENSE, name);
+        }
+    }
+    if (rc == 0) {
+        rc = output_finish(&o, out);
+    }
+    output_free(&o);
+    sb_free(&snippet);
+    free(results);
+    return rc;
+}
+
+/* Writes a rendered result to stdout in one call. Returns 0 on success. */
+int write_output(const StrBuf *out) {
+    TraceSpan span;
+    trace_begin(&span, TRACE_OUTPUT_WRITE);
+    struct iovec iov = { out->data, out->len };
+    fflush(stdout);
+    int rc = write_iov(STDOUT_FILENO, &iov, 1);
+    trace_end(&span, out->len);
+    return rc;
+}
+
+void search_license(const char *keyword, int category, const Database *db, OutputFormat format) {
+    SearchIndex idx;
+    Catalog cat;
+    /* The catalog filters by category and supplies the aliases of the machine formats */
+    int have_catalog = (category >= 0 || format != OUTPUT_TABLE) && catalog_open(&cat, db) == 0;
+    if (category >= 0 && !have_catalog) {
+        print_error("Unable to build the license catalog.");
+        return;
+    }
+    if (search_index_open(&idx, db) != 0) {
+        print_error("Unable to build the search index.");
+    } else {
+        StrBuf out = {0};
+        if (print_search_results(&idx, keyword, db, have_catalog ? &cat : NULL, category, format,
+                                 isatty(STDOUT_FILENO), &out) != 0) {
+            print_error("Out of memory while searching.");
+        } else if (write_output(&out) != 0) {
+            print_error("Unable to write the search results.");
+        }
+        sb_free(&out);
+        search_index_close(&idx);
+    }
+    if (have_catalog) {
+        catalog_close(&cat);
+    }
+}
@@ -8,10 +8,52 @@
 #ifndef IO_H
 #define IO_H
 
-/* Writes the content to a file with the given filename.
- * Returns 0 on success, non-zero on failure.
+#include <stdio.h>
+#include <sys/uio.h>
+#include "catalog.h"
+#include "db.h"
+#include "output.h"
+#include "search.h"
+
+/* Results of write_to_file() */
+#define WRITE_FAILED    (-1)
+#define WRITE_DONE      0
+#define WRITE_UNCHANGED 1
+
+/* Writes len bytes of content to filename, unless the file already holds
+ * exactly those bytes; then it is left alone and its mtime kept. The new
+ * content goes to a temporary file in the same directory that is synced and
+ * renamed over filename, so a crash never leaves a truncated file. mode sets the permission
+ * bits (-1: keep those of the file being replaced, or 0666 minus the umask for
+ * a new one). Returns WRITE_DONE, WRITE_UNCHANGED or WRITE_FAILED with errno set.
+ */
+int write_to_file(const char *filename, const char *content, size_t len, int mode);
+
+/* write_to_file() for content gathered from count spans, e.g. a rendered template. */
+int write_iov_to_file(const char *filename, const struct iovec *iov, size_t count, int mode);
+
+/* Opens a temporary file next to filename for output too large to build in
+ * memory; commit_replacement() then renames it into place, so readers never
+ * see a partial file. tmp receives the temporary path. Returns NULL with
+ * errno set on failure.
+ */
+FILE *open_replacement(const char *filename, char *tmp, size_t tmp_size);
+
+/* Closes out and, if ok and everything was written, gives it mode (-1: 0666
+ * minus the umask, or the mode of the file being replaced), syncs it and
+ * renames it over filename; otherwise removes it. Returns 0 on success, -1 with errno set.
+ */
+int commit_replacement(FILE *out, const char *tmp, const char *filename, int mode, int ok);
+
+/* Writes every span of iov to fd with writev(), resuming after short writes.
+ * Returns 0 on success, -1 with errno set.
  */
-int write_to_file(const char *filename, const char *content);
+int write_iov(int fd, const struct iovec *iov, size_t count);
+
+/* Copies the rest of in, from its current offset, to out, in the kernel when
+ * the filesystem allows it. Returns 0 on success, -1 with errno set.
+ */
+int copy_fd(int in, int out);
 
 /* Prints an error message to stderr with a consistent format. */
 void print_error(const char *message);
@@ -19,14 +61,36 @@ void print_error(const char *message);
 /* Debug printing to stderr if enabled. */
 void debug_print(const char *message);
 
-/* Lists license files in the given directory in a tabulated format. */
-void list_license_files(const char *dir_path);
+/* Appends the licenses in the database to out in the given format, read from
+ * the catalog; only those of the given LicenseCategory unless category is -1.
+ * Returns 0 on success, -1 if the licenses cannot be enumerated.
+ */
+int list_license_files(const Database *db, int category, OutputFormat format, StrBuf *out);
 
-/* Prints a formatted description for a given license from a descriptions directory. */
-void print_description(const char *license, const char *desc_dir);
+/* Appends the description of a license to out: as written for OUTPUT_TABLE,
+ * else as one record with its name and path. Returns 0 on success, -1 if the
+ * license has no description.
+ */
+int print_description(const char *license, const Database *db, OutputFormat format, StrBuf *out);
 
-/* Searches licenses by keyword in the specified directories. */
-void search_license(const char *keyword, const char *licenses_dir, const char *desc_dir);
+/* Appends the ranked results of a query against an open index to out. With a
+ * catalog and a category other than -1, only licenses of that category are
+ * shown; the catalog also supplies the aliases. db (may be NULL) supplies the
+ * file paths. color highlights the match in table snippets.
+ * Returns 0 on success, -1 on allocation failure.
+ */
+int print_search_results(const SearchIndex *idx, const char *keyword, const Database *db, const Catalog *cat,
+                         int category, OutputFormat format, int color, StrBuf *out);
+
+/* Searches license texts and descriptions through the full-text index and prints
+ * ranked results, limited to one LicenseCategory unless category is -1.
+ */
+void search_license(const char *keyword, int category, const Database *db, OutputFormat format);
+
+/* Writes a result built by the functions above to stdout with one write.
+ * Returns 0 on success, -1 with errno set.
+ */
+int write_output(const StrBuf *out);
 
 #endif /* IO_H */
 
@@ -3,140 +3,107 @@
  * Implementation for license related functionalities.
  *
  * Responsible for reading license files, performing text placeholder replacement,
- * and mapping alias names to full license names.
+ * and mapping alias names and SPDX identifiers to license names through the
+ * generated name table (names.h).
  */
 
 #define _GNU_SOURCE  /* Ensure proper feature test macros for functions like strcasecmp */
 
 #include "license.h"
+#include "names.h"
 #include "utils.h"
 #include "io.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <sys/stat.h>
-#include <stdbool.h>
 
 const AliasMapping alias_map[] = {
-//  {"alias", "name"},    
-    {"gpl", "gpl-3.0"},
-    {"apache", "apache-2.0"},
-    {"agpl", "gnu-agplv-3.0"},
-    {"lgpl", "gnu-lgplv-3.0"},
-    {"mpl", "mpl-2.0"},
-    {"bsd-2", "bsd-2-clause"},
-    {"bsd-3", "bsd-3-clause"},
-    {"mit", "mit"},
-    {"ul", "unlicense"},
-    {"cern-ohl-w", "cern-ohl-w-2.0"},
-    {"cern-ohl-p", "cern-ohl-p-2.0"},
-    {"cern-ohl-s", "cern-ohl-s-2.0"},
-    {"sil-ofl", "sil-ofl-1.1"},
-    {"wtfpl", "wtfpl-2.0"},
-    {"cc0", "cc0-1.0"},
-    {"cc-by-sa", "cc-by-sa-4.0"},
-    {"cc-by", "cc-by-4.0"},
-    {"boost", "boost"},
+#define OSLA_ALIAS(alias, name) { alias, name },
+#include "aliases.def"
+#undef OSLA_ALIAS
     {NULL, NULL}
 };
 
+const SpdxMapping spdx_map[] = {
+#define OSLA_LICENSE(name, spdx, category, flags) { name, spdx, LICENSE_##category, flags },
+#include "licenses.def"
+#undef OSLA_LICENSE
+    {NULL, NULL, LICENSE_OTHER, 0}
+};
+
 char *load_license(const char *license, const char *licenses_dir) {
     char filepath[256];
     snprintf(filepath, sizeof(filepath), "%s/%s.txt", licenses_dir, license);
-    
-    FILE *fp = fopen(filepath, "r");
-    if (!fp) {
-        return NULL;
-    }
-    
-    // Get file size
-    if (fseek(fp, 0, SEEK_END) != 0) {
-        fclose(fp);
-        return NULL;
-    }
-    long filesize = ftell(fp);
-    if (filesize < 0) {
-        fclose(fp);
-        return NULL;
-    }
-    rewind(fp);
-    
-    char *buffer = (char *)malloc(filesize + 1);
-    if (!buffer) {
-        fclose(fp);
+    TraceSpan span;
+    size_t len = 0;
+    trace_begin(&span, TRACE_FILE_READ);
+    char *text = read_file(filepath, &len);
+    trace_end(&span, len);
+    return text;
+}
+
+char *replace_placeholders(const Subst *subst, const char *content, size_t len,
+                           const char *year, const char *author) {
+    const char *values[SUBST_FIELD_COUNT] = {
+        [SUBST_YEAR]   = year,
+        [SUBST_AUTHOR] = author,
+    };
+    StrBuf out = {0};
+    if (subst_render(subst, content, len, values, &out) != 0) {
+        sb_free(&out);
         return NULL;
     }
-    size_t read_size = fread(buffer, 1, filesize, fp);
-    if (read_size != (size_t)filesize) {
-        free(buffer);
-        fclose(fp);
-        return NULL;
+    return out.data;
+}
+
+int resolve_alias(const char *input, char *output, size_t out_size) {
+    const char *license = license_from_spdx(input);
+    if (!license) {
+        return -1;
     }
-    buffer[filesize] = '\0';
-    fclose(fp);
-    return buffer;
+    strncpy(output, license, out_size);
+    output[out_size - 1] = '\0';
+    return 0;
 }
 
-char *replace_placeholders(const char *content, const char *year, const char *author) {
-    typedef struct { const char *token; const char *value; } TokenMap;
-    const TokenMap tokens[] = {
-        { "<YEAR>",              year },
-        { "[yyyy]",              year },
-        { "[year]",              year },
-        { "(c) [year]",          NULL },   // keep "(c)" literal, replace only [year]
-        { "[year]",              year },
-        { "<AUTHOR>",            author },
-        { "[name of copyright owner]", author },
-        { "[fullname]",          author },
-        { "<COPYRIGHT HOLDER>",  author },
-        { "[copyright holder]",  author },
-        { NULL,                  NULL }
-    };
-    // Estimate output size generously
-    size_t buf_size = strlen(content) + 512;
-    char *result = malloc(buf_size);
-    if (!result) return NULL;
-    result[0] = '\0';
+const char *license_spdx_id(const char *license) {
+    const NameEntry *e = name_find(license);
+    return e ? e->spdx : NULL;
+}
 
-    const char *p = content;
-    while (*p) {
-        bool matched = false;
-        for (int i = 0; tokens[i].token; i++) {
-            size_t tlen = strlen(tokens[i].token);
-            if (strncmp(p, tokens[i].token, tlen) == 0) {
-                if (tokens[i].value) {
-                    strncat(result, tokens[i].value, buf_size - strlen(result) - 1);
-                } else {
-                    // Special case "(c) [year]": output "(c) " then year
-                    if (strcmp(tokens[i].token, "(c) [year]") == 0) {
-                        strncat(result, "(c) ", buf_size - strlen(result) - 1);
-                        strncat(result, year, buf_size - strlen(result) - 1);
-                    }
-                }
-                p += tlen;
-                matched = true;
-                break;
-            }
-        }
-        if (!matched) {
-            // Copy one character
-            size_t len = strlen(result);
-            result[len] = *p++;
-            result[len + 1] = '\0';
+/* Length of id without a trailing "-only", "-or-later" or "+" */
+static size_t spdx_base_len(const char *id) {
+    static const char *const suffixes[] = { "-only", "-or-later", "+" };
+    size_t len = strlen(id);
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t n = strlen(suffixes[i]);
+        if (len > n && strcasecmp(id + len - n, suffixes[i]) == 0) {
+            return len - n;
         }
     }
-    return result;
+    return len;
 }
 
-int resolve_alias(const char *input, char *output, size_t out_size) {
-    for (int i = 0; alias_map[i].alias != NULL; i++) {
-        if (strcasecmp(input, alias_map[i].alias) == 0) {
-            strncpy(output, alias_map[i].full, out_size);
-            output[out_size - 1] = '\0';
-            return 0;
-        }
+const char *license_from_spdx(const char *id) {
+    const NameEntry *e = name_find(id);
+    if (e) {
+        return e->license;
+    }
+    /* "GPL-3.0", "GPL-3.0+" and "GPL-3.0-or-later" all name the "-only" entry */
+    size_t base = spdx_base_len(id);
+    char only[128];
+    if (base + sizeof("-only") > sizeof(only)) {
+        return NULL;
+    }
+    memcpy(only, id, base);
+    memcpy(only + base, "-only", sizeof("-only"));
+    e = name_lookup(id, base);
+    if (!e) {
+        e = name_find(only);
     }
-    return -1;
+    return e ? e->license : NULL;
 }
-
@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "subst.h"
 
 /* Loads the license text for the given license short name from the specified directory.
  * Returns a dynamically allocated string containing the license text,
@@ -19,13 +20,16 @@
  */
 char *load_license(const char *license, const char *licenses_dir);
 
-/* Replaces placeholders <YEAR> and <AUTHOR> in the given content with provided values.
- * Returns a new dynamically allocated string with replacements.
+/* Replaces the placeholder tokens compiled into subst (e.g. <YEAR>, [fullname])
+ * in the first len bytes of content with the provided values.
+ * Returns a new dynamically allocated string with replacements, or NULL on allocation failure.
  */
-char *replace_placeholders(const char *content, const char *year, const char *author);
+char *replace_placeholders(const Subst *subst, const char *content, size_t len,
+                           const char *year, const char *author);
 
-/* Resolves a license alias to its full name. Returns 0 if resolved, non-zero otherwise.
- * If the alias is not found, license is unchanged.
+/* Resolves a built-in alias, an SPDX identifier (see license_from_spdx) or a
+ * license name in any case to the canonical license name. Returns 0 if
+ * resolved, non-zero otherwise. If the name is not found, output is unchanged.
  */
 int resolve_alias(const char *input, char *output, size_t out_size);
 
@@ -36,5 +40,33 @@ typedef struct {
 
 extern const AliasMapping alias_map[];
 
+typedef enum {
+    LICENSE_SOFTWARE,
+    LICENSE_HARDWARE,
+    LICENSE_FONT,
+    LICENSE_CONTENT,
+    LICENSE_OTHER           /* not in licenses.def */
+} LicenseCategory;
+
+#define LICENSE_OSI 0x1     /* OSI approved */
+#define LICENSE_FSF 0x2     /* FSF free/libre */
+
+typedef struct {
+    const char *name;
+    const char *spdx;
+    LicenseCategory category;
+    unsigned flags;
+} SpdxMapping;
+
+extern const SpdxMapping spdx_map[];
+
+/* Returns the SPDX identifier of a license name, or NULL if it has none. */
+const char *license_spdx_id(const char *license);
+
+/* Maps an SPDX identifier (case-insensitive; "-only", "-or-later" and "+"
+ * suffixes accepted) or an alias to a license name. Returns NULL if unknown.
+ */
+const char *license_from_spdx(const char *id);
+
 #endif /* LICENSE_H */
 
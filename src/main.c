@@ -5,33 +5,58 @@
  * supports configuration, aliases, placeholder expansion, and pretty output.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <unistd.h>
 #include "config.h"
 #include "license.h"
 #include "io.h"
+#include "db.h"
+#include "bump.h"
+#include "bundle.h"
+#include "catalog.h"
+#include "check.h"
+#include "batch.h"
+#include "detect.h"
+#include "grep.h"
+#include "notices.h"
+#include "osla_private.h"
+#include "scan.h"
+#include "headers.h"
+#include "server.h"
+#include "spdx.h"
+#include "suggest.h"
+#include "template.h"
+#include "trace.h"
 #include "utils.h"
 #include "paths.h"
 #include "version.h"
+#include "watch.h"
 
 #define PROGRAM_NAME "osla"
 
 /* Function prototypes */
 static void print_usage(void);
 static void print_version(void);
-static void list_licenses(bool debug);
-static void print_license_description(const char *lic, bool debug);
-static void search_licenses(const char *keyword, bool debug);
-static void generate_license(const char *lic, bool to_stdout, bool debug);
-
-/* Helper to build a full data path (<datadir>/<subdir>) */
-static void build_data_path(const char *subdir, char *buffer, size_t buflen) {
-    const char *datadir = get_data_dir();
-    snprintf(buffer, buflen, "%s/%s", datadir, subdir);
-}
+static void list_licenses(const Database *db, int category, OutputFormat format, bool debug);
+static void print_license_description(const Database *db, const char *lic, OutputFormat format, bool debug);
+static void search_licenses(const Database *db, const char *keyword, int category, OutputFormat format,
+                            bool debug);
+static int generate_license(Osla *osla, const char *lic, bool to_stdout, bool debug);
+static int build_bundle(const char *out_path, bool debug);
+static void open_database(Database *db);
+static void apply_output_options(Config *config, const char *output_path, int output_mode);
+static int build_catalog(const char *out_path, bool debug);
+static int forward_to_server(bool list, const char *desc_license, const char *search_keyword,
+                             OutputFormat format, const char *license_arg, bool default_flag, bool to_stdout,
+                             const char *output_path, int output_mode);
+static int write_license(const struct iovec *iov, size_t count, const Config *config);
+static int detect_files(const Database *db, const Config *config, char **paths, int count, bool debug);
 
 int main(int argc, char *argv[]) {
     bool debug = false;
@@ -42,8 +67,41 @@ int main(int argc, char *argv[]) {
     bool default_flag = false;
     bool desc_flag = false;
     bool search_flag = false;
+    bool build_bundle_flag = false;
+    char *bundle_path = NULL;
+    char *batch_manifest = NULL;
+    bool watch_flag = false;
+    char *watch_manifest = NULL;
+    int jobs = 0;
+    char **detect_paths = NULL;
+    int detect_count = 0;
+    bool detect_flag = false;
+    char **notices_roots = NULL;
+    int notices_count = 0;
+    char **check_paths = NULL;
+    int check_count = 0;
+    bool check_flag = false;
+    char *scan_dir = NULL;
+    char *headers_dir = NULL;
+    char *bump_dir = NULL;
+    int bump_to = 0;
+    bool serve_flag = false;
+    bool stats_flag = false;
+    char *trace_path = NULL;
+    char *serve_socket = NULL;
     char *desc_license = NULL;
     char *search_keyword = NULL;
+    char *grep_pattern = NULL;
+    char *suggest_name = NULL;
+    char *category_name = NULL;
+    OutputFormat format = OUTPUT_TABLE;
+    int category = -1;
+    bool build_catalog_flag = false;
+    char *import_src = NULL;
+    char *import_datadir = NULL;
+    char *catalog_path = NULL;
+    char *output_path = NULL;
+    int output_mode = -1;
     char *license_arg = NULL;
     
     /* Simple argument parsing */
@@ -68,6 +126,31 @@ int main(int argc, char *argv[]) {
             debug = true;
         } else if (strcmp(argv[i], "--stdout") == 0) {
             to_stdout = true;
+        } else if ((strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "--output") == 0)) {
+            if (i+1 < argc) {
+                output_path = argv[++i];
+            } else {
+                print_error("Missing <file> argument for --output flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--mode") == 0) {
+            if (i+1 < argc && (output_mode = config_parse_mode(argv[i+1])) >= 0) {
+                i++;
+            } else {
+                print_error("--mode expects an octal mode such as 0644");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_flag = true;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_path = argv[i] + 8;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            if (i+1 < argc) {
+                trace_path = argv[++i];
+            } else {
+                print_error("Missing <file> argument for --trace flag");
+                exit(EXIT_FAILURE);
+            }
         } else if (strcmp(argv[i], "--search") == 0) {
             if (i+1 < argc) {
                 search_flag = true;
@@ -76,6 +159,140 @@ int main(int argc, char *argv[]) {
                 print_error("Missing <keyword> argument for --search flag");
                 exit(EXIT_FAILURE);
             }
+        } else if (strcmp(argv[i], "--grep") == 0) {
+            if (i+1 < argc) {
+                grep_pattern = argv[++i];
+            } else {
+                print_error("Missing <pattern> argument for --grep flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--format=", 9) == 0 || strcmp(argv[i], "--format") == 0) {
+            const char *name = argv[i][8] == '=' ? argv[i] + 9 : (i+1 < argc ? argv[++i] : "");
+            int parsed = output_format_parse(name);
+            if (parsed < 0) {
+                print_error("--format expects table, json, ndjson or tsv");
+                exit(EXIT_FAILURE);
+            }
+            format = (OutputFormat)parsed;
+        } else if (strcmp(argv[i], "--category") == 0) {
+            if (i+1 < argc) {
+                category_name = argv[++i];
+            } else {
+                print_error("Missing <category> argument for --category flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--build-catalog") == 0) {
+            build_catalog_flag = true;
+            /* Optional output path */
+            if (i+1 < argc && argv[i+1][0] != '-') {
+                catalog_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--import-spdx") == 0) {
+            if (i+1 < argc) {
+                import_src = argv[++i];
+            } else {
+                print_error("Missing <dir> argument for --import-spdx flag");
+                exit(EXIT_FAILURE);
+            }
+            /* Optional target data directory */
+            if (i+1 < argc && argv[i+1][0] != '-') {
+                import_datadir = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--suggest") == 0) {
+            if (i+1 < argc) {
+                suggest_name = argv[++i];
+            } else {
+                print_error("Missing <name> argument for --suggest flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            /* Manifest path, or stdin when omitted or "-" */
+            if (i+1 < argc && (argv[i+1][0] != '-' || strcmp(argv[i+1], "-") == 0)) {
+                batch_manifest = argv[++i];
+            } else {
+                batch_manifest = "-";
+            }
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch_flag = true;
+            /* Optional manifest path; without one the LICENSE of the current directory is kept */
+            if (i+1 < argc && (argv[i+1][0] != '-' || strcmp(argv[i+1], "-") == 0)) {
+                watch_manifest = argv[++i];
+            }
+        } else if ((i == 1 && strcmp(argv[i], "scan") == 0) || strcmp(argv[i], "--scan") == 0) {
+            /* Optional directory, defaulting to the current one */
+            scan_dir = (i+1 < argc && argv[i+1][0] != '-') ? argv[++i] : ".";
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve_flag = true;
+            /* Optional socket path */
+            if (i+1 < argc && argv[i+1][0] != '-') {
+                serve_socket = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--bump-year") == 0) {
+            if (i+1 < argc) {
+                bump_dir = argv[++i];
+            } else {
+                print_error("Missing <dir> argument for --bump-year flag");
+                exit(EXIT_FAILURE);
+            }
+            /* Optional target year, defaulting to the current one */
+            if (i+1 < argc && strspn(argv[i+1], "0123456789") == strlen(argv[i+1])) {
+                bump_to = atoi(argv[++i]);
+                if (bump_to < 1900 || bump_to > 2999) {
+                    print_error("--bump-year expects a four-digit year");
+                    exit(EXIT_FAILURE);
+                }
+            }
+        } else if (strcmp(argv[i], "--apply-headers") == 0) {
+            if (i+1 < argc) {
+                headers_dir = argv[++i];
+            } else {
+                print_error("Missing <dir> argument for --apply-headers flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--detect") == 0) {
+            /* Consumes every following non-flag argument */
+            detect_flag = true;
+            detect_paths = &argv[i+1];
+            while (i+1 < argc && argv[i+1][0] != '-') {
+                detect_count++;
+                i++;
+            }
+            if (detect_count == 0) {
+                print_error("Missing <file> argument for --detect flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--notices") == 0) {
+            /* Consumes every following non-flag argument */
+            notices_roots = &argv[i+1];
+            while (i+1 < argc && argv[i+1][0] != '-') {
+                notices_count++;
+                i++;
+            }
+            if (notices_count == 0) {
+                print_error("Missing <dir> argument for --notices flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--check") == 0) {
+            /* Consumes every following non-flag argument, defaulting to the current directory */
+            check_flag = true;
+            check_paths = &argv[i+1];
+            while (i+1 < argc && argv[i+1][0] != '-') {
+                check_count++;
+                i++;
+            }
+        } else if ((strcmp(argv[i], "-j") == 0) || (strcmp(argv[i], "--jobs") == 0)) {
+            if (i+1 < argc) {
+                jobs = atoi(argv[++i]);
+            } else {
+                print_error("Missing <count> argument for --jobs flag");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--build-bundle") == 0) {
+            build_bundle_flag = true;
+            /* Optional output path */
+            if (i+1 < argc && argv[i+1][0] != '-') {
+                bundle_path = argv[++i];
+            }
         } else {
             /* Assume first non-flag argument is license name if not already set */
             if (license_arg == NULL) {
@@ -94,62 +311,185 @@ int main(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
-    /* Load configuration (auto-create if missing) */
-    Config config;
-    if (load_config(&config, debug) != 0) {
+    if (build_bundle_flag) {
+        return build_bundle(bundle_path, debug) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (build_catalog_flag) {
+        return build_catalog(catalog_path, debug) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (import_src) {
+        int rc = run_import_spdx(import_src, import_datadir ? import_datadir : get_data_dir(), debug);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (category_name && (category = catalog_category(category_name)) < 0) {
+        char errmsg[256];
+        snprintf(errmsg, sizeof(errmsg), "Unknown category '%s'. Categories: software, hardware, font, content, other.",
+                 category_name);
+        print_error(errmsg);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((stats_flag || trace_path) && trace_start(trace_path, stats_flag) != 0) {
+        print_error("Unable to start tracing");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Hand plain queries to a running server; fall through to local work if there is none.
+     * Traced runs stay local so that their phases are measured.
+     */
+    if (!trace_active && !serve_flag && !batch_manifest && !watch_flag && !scan_dir && !headers_dir && !bump_dir &&
+        !detect_flag && !notices_roots && !check_flag && !grep_pattern && !suggest_name && !build_catalog_flag && category < 0) {
+        int rc = forward_to_server(list, desc_flag ? desc_license : NULL, search_flag ? search_keyword : NULL,
+                                   format, license_arg, default_flag, to_stdout, output_path, output_mode);
+        if (rc >= 0) {
+            return rc;
+        }
+    }
+
+    /* Load configuration (auto-create if missing) and open the database */
+    Osla *osla;
+    OslaOptions options = { NULL, 1, debug };
+    if (osla_open(&osla, &options) != OSLA_OK) {
         print_error("Failed to load configuration");
         exit(EXIT_FAILURE);
     }
+    Config *config = &osla->config;
+    Database *db = &osla->db;
+    apply_output_options(config, output_path, output_mode);
     
     if (default_flag) {
         /* Use default license from config */
-        if (strlen(config.default_license) == 0) {
+        if (strlen(config->default_license) == 0) {
             print_error("No default license set in config.");
+            osla_close(osla);
             exit(EXIT_FAILURE);
         }
-        license_arg = config.default_license;
+        license_arg = config->default_license;
     }
-    
+
+    if (serve_flag) {
+        int rc = run_server(serve_socket, db, config, debug);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (batch_manifest) {
+        int rc = run_batch(batch_manifest, db, config, jobs);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (watch_flag) {
+        int rc = run_watch(watch_manifest, license_arg, db, config, debug);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (scan_dir) {
+        int rc = run_scan(scan_dir, db, config, jobs);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (headers_dir) {
+        /* Stamp the given license, or the config default */
+        char resolved[64];
+        const char *lic = license_arg ? license_arg : config->default_license;
+        if (db_resolve_alias(db, lic, resolved, sizeof(resolved)) != 0) {
+            snprintf(resolved, sizeof(resolved), "%s", lic);
+        }
+        DbText text;
+        int rc = -1;
+        if (db_get(db, DB_LICENSE, resolved, &text) != 0) {
+            char errmsg[512], hint[256];
+            if (suggest_hint(db, lic, hint, sizeof(hint)) != 0) {
+                snprintf(hint, sizeof(hint), " Try '%s --list' to see available licenses.", PROGRAM_NAME);
+            }
+            snprintf(errmsg, sizeof(errmsg), "License '%s' not found.%s", resolved, hint);
+            print_error(errmsg);
+        } else {
+            db_text_release(&text);
+            rc = run_apply_headers(headers_dir, resolved, db, config, jobs);
+        }
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (bump_dir) {
+        int rc = run_bump_year(bump_dir, bump_to, db, config, jobs);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (detect_flag) {
+        int rc = detect_files(db, config, detect_paths, detect_count, debug);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (notices_roots) {
+        const char *out = to_stdout ? NULL : output_path ? output_path : NOTICES_FILENAME;
+        int rc = run_notices(notices_roots, notices_count, out, config->output_mode, db, config, jobs);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (check_flag) {
+        static char *here[] = { "." };
+        int rc = run_check(check_count ? check_paths : here, check_count ? check_count : 1,
+                           license_arg, db, config, jobs);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     if (list) {
-        list_licenses(debug);
-        free_config(&config);
+        list_licenses(db, category, format, debug);
+        osla_close(osla);
         return EXIT_SUCCESS;
     }
     
     if (desc_flag) {
-        print_license_description(desc_license, debug);
-        free_config(&config);
+        print_license_description(db, desc_license, format, debug);
+        osla_close(osla);
         return EXIT_SUCCESS;
     }
     
     if (search_flag) {
-        search_licenses(search_keyword, debug);
-        free_config(&config);
+        search_licenses(db, search_keyword, category, format, debug);
+        osla_close(osla);
         return EXIT_SUCCESS;
     }
     
+    if (grep_pattern) {
+        int rc = run_grep(grep_pattern, db, category, format, isatty(STDOUT_FILENO), jobs, debug);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (suggest_name) {
+        int rc = print_suggestions(db, suggest_name, stdout);
+        osla_close(osla);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     if (license_arg == NULL) {
         print_error("No license specified. Use -h for help.");
-        free_config(&config);
+        osla_close(osla);
         exit(EXIT_FAILURE);
     }
     
-    /* Resolve alias if applicable */
-    char resolved_license[64];
-    if (resolve_alias(license_arg, resolved_license, sizeof(resolved_license)) != 0) {
-        /* If not an alias, copy as-is */
-        strncpy(resolved_license, license_arg, sizeof(resolved_license));
-        resolved_license[sizeof(resolved_license) - 1] = '\0';
-    }
-    
-    generate_license(resolved_license, to_stdout, debug);
-    free_config(&config);
-    return EXIT_SUCCESS;
+    int rc = generate_license(osla, license_arg, to_stdout, debug);
+    osla_close(osla);
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 /* Prints usage message to stdout */
 static void print_usage(void) {
     printf("Usage: %s [options] <license>\n", PROGRAM_NAME);
+    printf("       %s scan [dir]\n", PROGRAM_NAME);
     printf("Options:\n");
     printf("  -h, --help                 Show this help message.\n");
     printf("  -v, --version              Print program version.\n");
@@ -157,8 +497,35 @@ static void print_usage(void) {
     printf("  -l, --list                 List all available licenses.\n");
     printf("  -D, --description <license>    Show formatted description of the license.\n");
     printf("  --debug                    Enable debug output to stderr.\n");
+    printf("  --stats                    Print time, bytes and syscalls per phase to stderr.\n");
+    printf("  --trace=<file>             Write a Chrome trace-event JSON file of every phase.\n");
     printf("  --stdout                   Output license to stdout instead of file.\n");
+    printf("  -o, --output <file>        Write the license to <file> instead of LICENSE (config: output=).\n");
+    printf("  --mode <octal>             Permission bits of the written file, e.g. 0644 (config: mode=).\n");
     printf("  --search <keyword>         Search licenses by keyword.\n");
+    printf("  --grep <pattern>           Print every line of every license and description containing <pattern>\n");
+    printf("                             (ignoring case) as file:line:column:text.\n");
+    printf("  --category <category>      Limit --list, --search and --grep to software, hardware, font, content or other.\n");
+    printf("  --format <format>          Output of --list, -D, --search and --grep: table (default), json, ndjson or tsv.\n");
+    printf("  --suggest <name>           List the licenses whose names are closest to <name>.\n");
+    printf("  --batch [manifest|-]       Generate LICENSE files for every manifest entry (stdin if omitted).\n");
+    printf("  [license] --watch [manifest]  Keep LICENSE (or every manifest entry) in sync with the config and\n");
+    printf("                             the license texts, rewriting only the outputs a change affects.\n");
+    printf("  -j, --jobs <count>         Worker threads for batch operations (default: one per CPU).\n");
+    printf("  scan [dir], --scan [dir]   Report SPDX headers and license files per directory.\n");
+    printf("  --apply-headers <dir> [license]  Add SPDX/copyright headers to source files (default license from config).\n");
+    printf("  --bump-year <dir> [year]   Extend the copyright years of headers and LICENSE files to [year]\n");
+    printf("                             (default: the current year).\n");
+    printf("  --detect <file...>         Identify the license contained in existing files.\n");
+    printf("  --notices <dir...>         Collect the license and NOTICE files of vendored dependencies into\n");
+    printf("                             THIRD_PARTY_NOTICES (or -o <file>, or --stdout).\n");
+    printf("  [license] --check [path...]  Verify that LICENSE files (or <dir>/LICENSE) match what osla would\n");
+    printf("                             generate; prints a unified diff of each drifted file.\n");
+    printf("  --serve [socket]           Run a resident server answering queries over a Unix socket.\n");
+    printf("  --build-bundle [file]      Pack the data directory into a single bundle file.\n");
+    printf("  --build-catalog [file]     Write the license metadata catalog (default: <datadir>/osla.catalog).\n");
+    printf("  --import-spdx <dir> [datadir]  Add the licenses of an SPDX license-list-data checkout that osla\n");
+    printf("                             does not ship to [datadir] (default: the data directory).\n");
 }
 
 /* Prints the version using the version header */
@@ -166,84 +533,297 @@ static void print_version(void) {
     printf("%s\n", OSLA_VERSION);
 }
 
-/* Lists all available licenses from the global licenses directory */
-static void list_licenses(bool debug) {
-    char data_path[256];
-    build_data_path("licenses", data_path, sizeof(data_path));
+/* Lists all available licenses from the database */
+static void list_licenses(const Database *db, int category, OutputFormat format, bool debug) {
     if (debug) {
         char msg[512];  /* increased to 512 bytes */
-        snprintf(msg, sizeof(msg), "Listing licenses from directory '%s'", data_path);
+        snprintf(msg, sizeof(msg), "Listing licenses from '%s'", db->datadir);
         debug_print(msg);
     }
-    list_license_files(data_path);
+    StrBuf out = {0};
+    if (list_license_files(db, category, format, &out) != 0) {
+        print_error("Unable to open licenses directory.");
+    } else if (write_output(&out) != 0) {
+        print_error("Unable to write the license list.");
+    }
+    sb_free(&out);
 }
 
-/* Prints the description for a given license from the global descriptions directory */
-static void print_license_description(const char *lic, bool debug) {
-    char data_path[256];
-    build_data_path("descriptions", data_path, sizeof(data_path));
+/* Prints the description for a given license from the database */
+static void print_license_description(const Database *db, const char *lic, OutputFormat format, bool debug) {
     if (debug) {
         char msg[512];  /* increased to 512 bytes */
-        snprintf(msg, sizeof(msg), "Printing description for license '%s' from '%s'", lic, data_path);
+        snprintf(msg, sizeof(msg), "Printing description for license '%s' from '%s'", lic, db->datadir);
         debug_print(msg);
     }
-    print_description(lic, data_path);
+    StrBuf out = {0};
+    if (print_description(lic, db, format, &out) != 0) {
+        char errmsg[128];
+        snprintf(errmsg, sizeof(errmsg), "Description file for '%s' not found.", lic);
+        print_error(errmsg);
+    } else if (write_output(&out) != 0) {
+        print_error("Unable to write the description.");
+    }
+    sb_free(&out);
 }
 
-/* Searches licenses by keyword in the global licenses directory */
-static void search_licenses(const char *keyword, bool debug) {
-    char data_path[256];
-    build_data_path("licenses", data_path, sizeof(data_path));
+/* Searches licenses by keyword in the database */
+static void search_licenses(const Database *db, const char *keyword, int category, OutputFormat format,
+                            bool debug) {
     if (debug) {
         char msg[512];  /* increased to 512 bytes */
-        snprintf(msg, sizeof(msg), "Searching licenses with keyword '%s' in '%s'", keyword, data_path);
+        snprintf(msg, sizeof(msg), "Searching licenses with keyword '%s' in '%s'", keyword, db->datadir);
         debug_print(msg);
     }
-    search_license(keyword, data_path, NULL);
+    search_license(keyword, category, db, format);
 }
 
-/* Generates the LICENSE file (or outputs to stdout) for the specified license */
-static void generate_license(const char *lic, bool to_stdout, bool debug) {
-    char data_path[256];
-    build_data_path("licenses", data_path, sizeof(data_path));
+/* Packs the data directory into a bundle (default: <datadir>/osla.bundle) */
+static int build_bundle(const char *out_path, bool debug) {
+    const char *datadir = get_data_dir();
+    char default_path[512];
+    if (!out_path) {
+        snprintf(default_path, sizeof(default_path), "%s/%s", datadir, BUNDLE_FILENAME);
+        out_path = default_path;
+    }
     if (debug) {
-        char msg[512];  /* increased to 512 bytes */
-        snprintf(msg, sizeof(msg), "Generating license for '%s' from '%s'", lic, data_path);
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Building bundle '%s' from '%s'", out_path, datadir);
         debug_print(msg);
     }
-    /* Get license content and perform placeholder replacement from global licenses directory */
-    char *content = load_license(lic, data_path);
-    if (!content) {
+    DictStats stats;
+    if (bundle_build(datadir, out_path, &stats) != 0) {
+        print_error("Failed to build license bundle");
+        return -1;
+    }
+    printf("Built %s.\n", out_path);
+    dict_print_stats(&stats, "Licenses", stdout);
+    return 0;
+}
+
+/* Opens the database compiled into the binary, unless OSLA_DATADIR overrides it */
+static void open_database(Database *db) {
+    if (data_dir_overridden() || db_open_embedded(db) != 0) {
+        db_open(db, get_data_dir());
+    }
+}
+
+/* Lets --output and --mode override the config */
+static void apply_output_options(Config *config, const char *output_path, int output_mode) {
+    if (output_path) {
+        snprintf(config->output, sizeof(config->output), "%s", output_path);
+    }
+    if (output_mode >= 0) {
+        config->output_mode = output_mode;
+    }
+}
+
+/* Writes a rendered license to the configured output file, leaving it alone
+ * when it already holds the same text. Returns 0 on success.
+ */
+static int write_license(const struct iovec *iov, size_t count, const Config *config) {
+    int rc = write_iov_to_file(config->output, iov, count, config->output_mode);
+    if (rc == WRITE_FAILED) {
         char errmsg[512];
-        snprintf(errmsg, sizeof(errmsg), "[osla error]: license '%s' not found. Try '%s --list' to see available licenses.", lic, PROGRAM_NAME);
+        snprintf(errmsg, sizeof(errmsg), "Failed to write %s: %s", config->output, strerror(errno));
         print_error(errmsg);
-        exit(EXIT_FAILURE);
+        return -1;
     }
-    
-    /* Replace placeholders <YEAR> and <AUTHOR> */
-    Config config;
-    if (load_config(&config, debug) != 0) {
-        print_error("Failed to load configuration for placeholder expansion");
-        free(content);
-        exit(EXIT_FAILURE);
+    if (rc == WRITE_UNCHANGED) {
+        printf("%s is already up to date.\n", config->output);
+    } else {
+        printf("Generated %s file.\n", config->output);
     }
-    char *filled = replace_placeholders(content, config.year, config.author);
-    free(content);
-    free_config(&config);
+    return 0;
+}
 
-    if (to_stdout) {
-        printf("%s", filled);
+/* Writes the license catalog (default: <datadir>/osla.catalog) */
+static int build_catalog(const char *out_path, bool debug) {
+    Database db;
+    open_database(&db);
+    char default_path[512];
+    if (!out_path) {
+        snprintf(default_path, sizeof(default_path), "%s/%s", db.datadir, CATALOG_FILENAME);
+        out_path = default_path;
+    }
+    if (debug) {
+        char msg[1024];
+        snprintf(msg, sizeof(msg), "Building catalog '%s' from '%s'", out_path, db.datadir);
+        debug_print(msg);
+    }
+    int rc = catalog_build(&db, out_path);
+    db_close(&db);
+    if (rc != 0) {
+        print_error("Failed to build license catalog");
+        return -1;
+    }
+    printf("Built %s.\n", out_path);
+    return 0;
+}
+
+/* Sends a list/describe/search/render query to a running server and prints the answer.
+ * Returns the exit status, or -1 if the query is not forwardable or no server answered.
+ */
+static int forward_to_server(bool list, const char *desc_license, const char *search_keyword,
+                             OutputFormat format, const char *license_arg, bool default_flag, bool to_stdout,
+                             const char *output_path, int output_mode) {
+    const char *fields[3];
+    size_t count = 0;
+    if (list) {
+        fields[count++] = "list";
+    } else if (desc_license) {
+        fields[count++] = "describe";
+        fields[count++] = desc_license;
+    } else if (search_keyword) {
+        fields[count++] = "search";
+        fields[count++] = search_keyword;
+    } else if (default_flag || license_arg) {
+        fields[count++] = "render";
+        fields[count++] = default_flag ? "" : license_arg;
     } else {
-        if (write_to_file("LICENSE", filled) != 0) {
-            print_error("Failed to write LICENSE file");
-            free(filled);
-            exit(EXIT_FAILURE);
+        return -1;
+    }
+    /* Queries carry the format only when it is not the default table */
+    if (format != OUTPUT_TABLE && strcmp(fields[0], "render") != 0) {
+        fields[count++] = output_format_name(format);
+    }
+
+    char socket_path[PATH_MAX];
+    StrBuf out = {0};
+    int ok;
+    if (server_default_socket(socket_path, sizeof(socket_path)) != 0 ||
+        server_request(socket_path, fields, count, &out, &ok) != 0) {
+        sb_free(&out);
+        return -1;
+    }
+    int rc = EXIT_SUCCESS;
+    if (!ok) {
+        print_error(out.data ? out.data : "Server error");
+        rc = EXIT_FAILURE;
+    } else if (strcmp(fields[0], "render") == 0 && !to_stdout) {
+        /* The output path and mode may come from the config */
+        Config config;
+        if (load_config(&config, false) != 0) {
+            print_error("Failed to load configuration");
+            rc = EXIT_FAILURE;
+        } else {
+            apply_output_options(&config, output_path, output_mode);
+            struct iovec iov = { out.data, out.len };
+            rc = write_license(&iov, 1, &config) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+            free_config(&config);
         }
-        printf("Generated LICENSE file.\n");
+    } else if (write_output(&out) != 0) {
+        rc = EXIT_FAILURE;
+    }
+    sb_free(&out);
+    return rc;
+}
+
+/* Identifies the license in each file and prints the best match with its confidence.
+ * Returns 0 if every file was recognized.
+ */
+static int detect_files(const Database *db, const Config *config, char **paths, int count, bool debug) {
+    Detector det;
+    if (detector_open(&det, db, config) != 0) {
+        print_error("Unable to load license fingerprints");
+        return -1;
     }
-    free(filled);
     if (debug) {
-        debug_print("License generation completed.");
+        char msg[256];
+        snprintf(msg, sizeof(msg), "Loaded fingerprints for %u licenses", det.header->template_count);
+        debug_print(msg);
+    }
+    int rc = 0;
+    for (int i = 0; i < count; i++) {
+        size_t len;
+        char *text = read_file(paths[i], &len);
+        if (!text) {
+            char errmsg[512];
+            snprintf(errmsg, sizeof(errmsg), "Unable to read '%s'", paths[i]);
+            print_error(errmsg);
+            rc = -1;
+            continue;
+        }
+        DetectMatch match;
+        if (detector_identify(&det, text, len, &match) != 0) {
+            print_error("Out of memory during detection");
+            free(text);
+            rc = -1;
+            break;
+        }
+        if (match.license && match.confidence >= 0.5) {
+            printf("%s: %s (%.1f%% confidence%s)\n", paths[i], match.license,
+                   match.confidence * 100.0, match.exact ? ", exact" : "");
+        } else if (match.license) {
+            printf("%s: unknown (closest: %s, %.1f%%)\n", paths[i], match.license, match.confidence * 100.0);
+            rc = -1;
+        } else {
+            printf("%s: unknown\n", paths[i]);
+            rc = -1;
+        }
+        free(text);
     }
+    detector_close(&det);
+    return rc;
 }
 
+/* Generates the LICENSE file (or outputs to stdout) for the specified license.
+ * Returns 0 on success.
+ */
+static int generate_license(Osla *osla, const char *lic, bool to_stdout, bool debug) {
+    char resolved[64];
+    if (osla_resolve(osla, lic, resolved, sizeof(resolved)) != OSLA_OK) {
+        snprintf(resolved, sizeof(resolved), "%s", lic);
+    }
+    if (debug) {
+        char msg[512];  /* increased to 512 bytes */
+        snprintf(msg, sizeof(msg), "Generating license for '%s' from '%s'", resolved, osla->db.datadir);
+        debug_print(msg);
+    }
+    /* Render into the stack; only an unusually long license needs the heap */
+    char stack[65536];
+    char *text = stack;
+    size_t len;
+    OslaStatus status = osla_render(osla, resolved, NULL, stack, sizeof(stack), &len);
+    if (status == OSLA_NO_SPACE) {
+        text = malloc(len + 1);
+        status = text ? osla_render(osla, resolved, NULL, text, len + 1, &len) : OSLA_NO_MEMORY;
+    }
+    int rc = 0;
+    if (status == OSLA_NOT_FOUND) {
+        char errmsg[512], hint[256];
+        if (suggest_hint(&osla->db, resolved, hint, sizeof(hint)) != 0) {
+            snprintf(hint, sizeof(hint), " Try '%s --list' to see available licenses.", PROGRAM_NAME);
+        }
+        snprintf(errmsg, sizeof(errmsg), "[osla error]: license '%s' not found.%s", resolved, hint);
+        print_error(errmsg);
+        rc = -1;
+    } else if (status == OSLA_NO_DATA) {
+        print_error("Unable to compile the license templates");
+        rc = -1;
+    } else if (status != OSLA_OK) {
+        print_error("Out of memory during placeholder expansion");
+        rc = -1;
+    } else {
+        struct iovec iov = { text, len };
+        if (to_stdout) {
+            TraceSpan span;
+            trace_begin(&span, TRACE_OUTPUT_WRITE);
+            fflush(stdout);
+            rc = write_iov(STDOUT_FILENO, &iov, 1);
+            trace_end(&span, len);
+            if (rc != 0) {
+                char errmsg[256];
+                snprintf(errmsg, sizeof(errmsg), "Failed to write to stdout: %s", strerror(errno));
+                print_error(errmsg);
+            }
+        } else {
+            rc = write_license(&iov, 1, &osla->config);
+        }
+    }
+    if (text != stack) free(text);
+    if (rc == 0 && debug) {
+        debug_print("License generation completed.");
+    }
+    return rc;
+}
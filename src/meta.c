@@ -0,0 +1,162 @@
+/* File: src/meta.c
+ *
+ * Implementation of the license metadata file.
+ *
+ * The file is copied once and split in place; entries point into the copy.
+ * Keys are added names first, then SPDX ids, then aliases, and a key already
+ * present is not added again, which gives names precedence on collisions.
+ */
+
+#define _GNU_SOURCE
+
+#include "meta.h"
+#include "catalog.h"
+#include "license.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Returns the field at *cursor and moves past its tab; "-" and absent fields are "". */
+static char *next_field(char **cursor) {
+    if (!*cursor) return "";
+    char *field = *cursor;
+    char *tab = strchr(field, '\t');
+    if (tab) {
+        *tab = '\0';
+        *cursor = tab + 1;
+    } else {
+        *cursor = NULL;
+    }
+    return strcmp(field, "-") == 0 ? "" : field;
+}
+
+int meta_parse_line(char *line, MetaEntry *e) {
+    trim_newline(line);
+    if (line[0] == '\0' || line[0] == '#') return -1;
+    char *cursor = line;
+    e->name = next_field(&cursor);
+    e->spdx = next_field(&cursor);
+    const char *category = next_field(&cursor);
+    char *flags = next_field(&cursor);
+    e->aliases = next_field(&cursor);
+    if (e->name[0] == '\0') return -1;
+    int c = catalog_category(category);
+    e->category = (uint8_t)(c >= 0 ? c : LICENSE_OTHER);
+    e->flags = 0;
+    for (char *save = NULL, *flag = strtok_r(flags, ",", &save); flag; flag = strtok_r(NULL, ",", &save)) {
+        if (strcasecmp(flag, "osi") == 0) e->flags |= LICENSE_OSI;
+        if (strcasecmp(flag, "fsf") == 0) e->flags |= LICENSE_FSF;
+    }
+    return 0;
+}
+
+static const MetaKey *find_key(const Meta *meta, const char *key, size_t len) {
+    if (meta->slot_count == 0) return NULL;
+    size_t mask = meta->slot_count - 1;
+    for (size_t j = (size_t)hash_casefold(key, len) & mask; meta->slots[j]; j = (j + 1) & mask) {
+        const MetaKey *k = &meta->keys[meta->slots[j] - 1];
+        if (k->len == len && strncasecmp(k->key, key, len) == 0) return k;
+    }
+    return NULL;
+}
+
+static void add_key(Meta *meta, const char *key, size_t len, size_t entry) {
+    while (len > 0 && *key == ' ') {
+        key++;
+        len--;
+    }
+    while (len > 0 && key[len - 1] == ' ') len--;
+    if (len == 0 || find_key(meta, key, len)) return;
+    MetaKey *k = &meta->keys[meta->key_count++];
+    k->key = key;
+    k->len = (uint32_t)len;
+    k->entry = (uint32_t)entry;
+    size_t mask = meta->slot_count - 1;
+    size_t j = (size_t)hash_casefold(key, len) & mask;
+    while (meta->slots[j]) j = (j + 1) & mask;
+    meta->slots[j] = (uint32_t)meta->key_count;
+}
+
+int meta_parse(Meta *meta, const char *text, size_t len) {
+    memset(meta, 0, sizeof(*meta));
+    meta->text = malloc(len + 1);
+    if (!meta->text) return -1;
+    memcpy(meta->text, text, len);
+    meta->text[len] = '\0';
+
+    size_t lines = 1, commas = 0;
+    for (size_t i = 0; i < len; i++) {
+        lines += text[i] == '\n';
+        commas += text[i] == ',';
+    }
+    /* Every line has a name and an SPDX id, and every comma adds an alias */
+    size_t max_keys = lines * 3 + commas;
+    meta->slot_count = 16;
+    while (meta->slot_count < max_keys * 2) meta->slot_count *= 2;
+    meta->entries = malloc(lines * sizeof(*meta->entries));
+    meta->keys = malloc(max_keys * sizeof(*meta->keys));
+    meta->slots = calloc(meta->slot_count, sizeof(*meta->slots));
+    if (!meta->entries || !meta->keys || !meta->slots) {
+        meta_free(meta);
+        return -1;
+    }
+
+    for (char *line = meta->text; line;) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        if (meta_parse_line(line, &meta->entries[meta->count]) == 0) meta->count++;
+        line = next;
+    }
+    for (size_t i = 0; i < meta->count; i++) {
+        add_key(meta, meta->entries[i].name, strlen(meta->entries[i].name), i);
+    }
+    for (size_t i = 0; i < meta->count; i++) {
+        add_key(meta, meta->entries[i].spdx, strlen(meta->entries[i].spdx), i);
+    }
+    for (size_t i = 0; i < meta->count; i++) {
+        for (const char *a = meta->entries[i].aliases; *a;) {
+            size_t n = strcspn(a, ",");
+            add_key(meta, a, n, i);
+            a += n + (a[n] == ',');
+        }
+    }
+    return 0;
+}
+
+int meta_load(Meta *meta, const char *path) {
+    size_t len;
+    char *text = read_file(path, &len);
+    if (!text) {
+        memset(meta, 0, sizeof(*meta));
+        return 0;
+    }
+    int rc = meta_parse(meta, text, len);
+    free(text);
+    return rc;
+}
+
+void meta_free(Meta *meta) {
+    free(meta->text);
+    free(meta->entries);
+    free(meta->keys);
+    free(meta->slots);
+    memset(meta, 0, sizeof(*meta));
+}
+
+const MetaEntry *meta_find(const Meta *meta, const char *key) {
+    const MetaKey *k = find_key(meta, key, strlen(key));
+    return k ? &meta->entries[k->entry] : NULL;
+}
+
+int meta_append_line(StrBuf *out, const MetaEntry *e) {
+    const char *flags = e->flags == (LICENSE_OSI | LICENSE_FSF) ? "osi,fsf"
+                      : e->flags == LICENSE_OSI ? "osi"
+                      : e->flags == LICENSE_FSF ? "fsf" : "-";
+    char line[1024];
+    int n = snprintf(line, sizeof(line), "%s\t%s\t%s\t%s\t%s\n", e->name, e->spdx[0] ? e->spdx : "-",
+                     catalog_category_name(e->category), flags, e->aliases[0] ? e->aliases : "-");
+    if (n < 0 || (size_t)n >= sizeof(line)) return -1;
+    return sb_append(out, line, (size_t)n);
+}
@@ -0,0 +1,79 @@
+/* File: src/meta.h
+ *
+ * Header for the license metadata file of a data directory.
+ *
+ * licenses.def and aliases.def describe the licenses osla ships with; the
+ * metadata file, licenses.tsv next to licenses/, does the same for licenses
+ * added to a data directory later, typically by --import-spdx. One line per
+ * license holds tab-separated fields:
+ *
+ *     <name> TAB <SPDX id> TAB <category> TAB <flags> TAB <aliases>
+ *
+ * category is a catalog category name ("software", ...), flags is "osi",
+ * "fsf", "osi,fsf" or "-", aliases is a comma-separated list or "-". Blank
+ * lines and lines starting with '#' are ignored. The file is parsed into an
+ * open-addressing table over every name, SPDX id and alias, so a lookup costs
+ * the same for 20 licenses as for 600.
+ */
+
+#ifndef META_H
+#define META_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "utils.h"
+
+#define META_FILENAME "licenses.tsv"
+
+typedef struct {
+    const char *name;
+    const char *spdx;       /* "" if none */
+    const char *aliases;    /* comma-separated, "" if none */
+    uint8_t category;       /* LicenseCategory */
+    uint8_t flags;          /* LICENSE_OSI, LICENSE_FSF */
+} MetaEntry;
+
+typedef struct {
+    const char *key;
+    uint32_t len;
+    uint32_t entry;
+} MetaKey;
+
+typedef struct {
+    char *text;             /* the file, split in place */
+    MetaEntry *entries;
+    size_t count;
+    MetaKey *keys;
+    size_t key_count;
+    uint32_t *slots;        /* key index + 1 by key hash, 0 if empty */
+    size_t slot_count;      /* a power of two, at most half full */
+} Meta;
+
+/* Parses the metadata in text (copied). Malformed lines are skipped. Returns
+ * 0 on success, -1 on allocation failure.
+ */
+int meta_parse(Meta *meta, const char *text, size_t len);
+
+/* Loads the metadata file at path. A missing file gives empty metadata.
+ * Returns 0 on success, -1 on allocation failure.
+ */
+int meta_load(Meta *meta, const char *path);
+
+void meta_free(Meta *meta);
+
+/* Splits one metadata line in place into e. Returns 0 on success, -1 if the
+ * line is blank, a comment or malformed.
+ */
+int meta_parse_line(char *line, MetaEntry *e);
+
+/* Finds the entry whose name, SPDX id or alias is key (case-insensitive), or
+ * NULL. Names win over SPDX ids, and those over aliases, when keys collide.
+ */
+const MetaEntry *meta_find(const Meta *meta, const char *key);
+
+/* Appends e as a metadata line, newline included, to out. Returns 0 on
+ * success, -1 on allocation failure.
+ */
+int meta_append_line(StrBuf *out, const MetaEntry *e);
+
+#endif /* META_H */
@@ -0,0 +1,15 @@
+/* File: src/names.c
+ *
+ * Implementation of the license name table lookup.
+ */
+
+#include "names.h"
+#include <strings.h>
+
+const NameEntry *name_lookup(const char *key, size_t len) {
+    if (name_entry_count == 0) return NULL;
+    uint64_t h = hash_casefold(key, len);
+    uint32_t seed = name_seeds[name_bucket(h, name_bucket_count)];
+    const NameEntry *e = &name_entries[name_mix(h, seed) % name_entry_count];
+    return strncasecmp(e->key, key, len) == 0 && e->key[len] == '\0' ? e : NULL;
+}
@@ -0,0 +1,63 @@
+/* File: src/names.h
+ *
+ * Header for the license name table.
+ *
+ * Every canonical license name, built-in alias and SPDX identifier of the
+ * bundled data set is placed by tools/namegen.c into a minimal perfect hash
+ * (hash and displace): the case-folded hash of a key picks a bucket, the
+ * bucket's seed re-mixes the hash into a slot, and the generator has chosen
+ * seeds so that no two keys share a slot. A lookup is one hash, one slot and
+ * one case-insensitive compare, whatever the number of names.
+ */
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "utils.h"
+
+typedef enum {
+    NAME_LICENSE,           /* key is a canonical license name */
+    NAME_ALIAS,             /* key is a built-in alias */
+    NAME_SPDX               /* key is an SPDX identifier */
+} NameKind;
+
+typedef struct {
+    const char *key;
+    const char *license;    /* canonical name the key stands for */
+    const char *alias;      /* first built-in alias of license, or NULL */
+    const char *spdx;       /* SPDX identifier of license, or NULL */
+    uint8_t kind;
+} NameEntry;
+
+/* Generated into obj/name_table.c */
+extern const NameEntry name_entries[];
+extern const uint32_t name_seeds[];
+extern const uint32_t name_entry_count;
+extern const uint32_t name_bucket_count;
+
+/* Re-mixes a key hash with a bucket seed (splitmix64 finalizer). */
+static inline uint64_t name_mix(uint64_t h, uint32_t seed) {
+    uint64_t x = h ^ ((uint64_t)seed * 0x9e3779b97f4a7c15ULL);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint32_t name_bucket(uint64_t h, uint32_t bucket_count) {
+    return (uint32_t)((h >> 32) % bucket_count);
+}
+
+/* Finds the entry for the first len bytes of key (case-insensitive), or NULL. */
+const NameEntry *name_lookup(const char *key, size_t len);
+
+static inline const NameEntry *name_find(const char *key) {
+    return name_lookup(key, strlen(key));
+}
+
+#endif /* NAMES_H */
@@ -0,0 +1,474 @@
+/* File: src/notices.c
+ *
+ * Implementation of third-party notice aggregation.
+ *
+ * Workers hash each license file's normalized words (the detector's
+ * normalization, which drops case, punctuation, whitespace and copyright
+ * lines) and keep only a small record per file: its directory, name, group
+ * and copyright lines. Copies of one text share a group, so identification
+ * runs once per distinct text, over the thread pool, after the walk. The
+ * document is then streamed out group by group, re-reading one representative
+ * file at a time, so memory grows with the number of files, never with the
+ * size of their texts.
+ */
+
+#define _GNU_SOURCE
+
+#include "notices.h"
+#include "catalog.h"
+#include "detect.h"
+#include "io.h"
+#include "pool.h"
+#include "scan.h"
+#include "utils.h"
+#include "walk.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+/* Bytes of each file that are hashed and identified */
+#define NOTICE_READ_MAX (256 * 1024)
+/* Copyright lines kept per file, and their length */
+#define MAX_COPYRIGHT_LINES 8
+#define COPYRIGHT_LINE_MAX 200
+#define RULE "================================================================================\n"
+#define THIN_RULE "--------------------------------------------------------------------------------\n"
+
+typedef struct {
+    char *dir;              /* the package: directory holding the file */
+    char *name;
+    char *copyright;        /* its copyright lines, '\n'-terminated, or NULL */
+    uint32_t group;
+    int is_rep;             /* the representative of its group, across the sort */
+} NoticeRecord;
+
+typedef struct {
+    uint64_t hash;          /* of the normalized text, and of the file kind */
+    size_t rep;             /* record shown as the text of the group: the smallest path */
+    int is_notice;
+    const char *license;    /* identified license name, or NULL */
+    size_t count;           /* files in the group */
+    size_t rank;            /* position in the document */
+} NoticeGroup;
+
+typedef struct {
+    const Detector *det;
+    pthread_mutex_t lock;   /* records and groups */
+    NoticeRecord *records;
+    size_t record_count, record_cap;
+    NoticeGroup *groups;
+    size_t group_count, group_cap;
+    uint32_t *slots;        /* group index + 1 by hash, 0 if empty */
+    size_t slot_cap;
+    atomic_size_t unreadable;
+    atomic_int failed;      /* out of memory */
+} NoticeCtx;
+
+int notices_is_notice_file(const char *name) {
+    static const char stem[] = "NOTICE";
+    size_t n = sizeof(stem) - 1;
+    return strncasecmp(name, stem, n) == 0 &&
+           (name[n] == '\0' || name[n] == '.' || name[n] == '-' || name[n] == '_');
+}
+
+static int path_cmp(const NoticeRecord *a, const NoticeRecord *b) {
+    int c = strcmp(a->dir, b->dir);
+    return c ? c : strcmp(a->name, b->name);
+}
+
+/* Copyright lines of the configured placeholders ("Copyright [yyyy] [name of
+ * copyright owner]") are part of the license text, not a holder.
+ */
+static int is_holder_line(const Detector *det, const char *line, size_t len) {
+    size_t token, match_len;
+    return detect_is_copyright_line(line, len) &&
+           !(det->subst && subst_next(det->subst, line, line + len, &token, &match_len));
+}
+
+static void collect_copyright(const Detector *det, const char *text, size_t len, StrBuf *out) {
+    size_t lines = 0;
+    const char *end = text + len;
+    for (const char *p = text; p < end && lines < MAX_COPYRIGHT_LINES;) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        if (is_holder_line(det, p, (size_t)(line_end - p))) {
+            const char *q = p, *e = line_end;
+            while (q < e && (*q == ' ' || *q == '\t')) q++;
+            while (e > q && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
+            size_t n = (size_t)(e - q) < COPYRIGHT_LINE_MAX ? (size_t)(e - q) : COPYRIGHT_LINE_MAX;
+            sb_append(out, q, n);
+            sb_append(out, "\n", 1);
+            lines++;
+        }
+        p = line_end + 1;
+    }
+}
+
+/* Finds or adds the group of hash. Called with the lock held. Returns its index, or -1. */
+static long group_for(NoticeCtx *nc, uint64_t hash, int is_notice, size_t record) {
+    if (nc->group_count * 2 >= nc->slot_cap) {
+        size_t cap = nc->slot_cap ? nc->slot_cap * 2 : 256;
+        uint32_t *slots = calloc(cap, sizeof(*slots));
+        if (!slots) return -1;
+        for (size_t i = 0; i < nc->group_count; i++) {
+            size_t at = (size_t)nc->groups[i].hash & (cap - 1);
+            while (slots[at]) at = (at + 1) & (cap - 1);
+            slots[at] = (uint32_t)i + 1;
+        }
+        free(nc->slots);
+        nc->slots = slots;
+        nc->slot_cap = cap;
+    }
+    size_t at = (size_t)hash & (nc->slot_cap - 1);
+    for (; nc->slots[at]; at = (at + 1) & (nc->slot_cap - 1)) {
+        NoticeGroup *g = &nc->groups[nc->slots[at] - 1];
+        if (g->hash == hash) {
+            g->count++;
+            if (path_cmp(&nc->records[record], &nc->records[g->rep]) < 0) g->rep = record;
+            return (long)(nc->slots[at] - 1);
+        }
+    }
+    if (nc->group_count == nc->group_cap) {
+        size_t cap = nc->group_cap ? nc->group_cap * 2 : 64;
+        NoticeGroup *grown = realloc(nc->groups, cap * sizeof(*grown));
+        if (!grown) return -1;
+        nc->groups = grown;
+        nc->group_cap = cap;
+    }
+    NoticeGroup *g = &nc->groups[nc->group_count];
+    memset(g, 0, sizeof(*g));
+    g->hash = hash;
+    g->rep = record;
+    g->is_notice = is_notice;
+    g->count = 1;
+    nc->slots[at] = (uint32_t)++nc->group_count;
+    return (long)(nc->group_count - 1);
+}
+
+static int add_record(NoticeCtx *nc, const char *dir, const char *name, uint64_t hash,
+                      int is_notice, const StrBuf *copyright) {
+    NoticeRecord r = { strdup(dir), strdup(name), copyright->len ? strdup(copyright->data) : NULL, 0, 0 };
+    if (!r.dir || !r.name || (copyright->len && !r.copyright)) goto fail;
+    pthread_mutex_lock(&nc->lock);
+    if (nc->record_count == nc->record_cap) {
+        size_t cap = nc->record_cap ? nc->record_cap * 2 : 256;
+        NoticeRecord *grown = realloc(nc->records, cap * sizeof(*grown));
+        if (!grown) {
+            pthread_mutex_unlock(&nc->lock);
+            goto fail;
+        }
+        nc->records = grown;
+        nc->record_cap = cap;
+    }
+    nc->records[nc->record_count] = r;
+    long group = group_for(nc, hash, is_notice, nc->record_count);
+    if (group >= 0) {
+        nc->records[nc->record_count++].group = (uint32_t)group;
+    }
+    pthread_mutex_unlock(&nc->lock);
+    if (group < 0) goto fail;
+    return 0;
+
+fail:
+    free(r.dir);
+    free(r.name);
+    free(r.copyright);
+    return -1;
+}
+
+static const void *notices_visit(const char *dir, const WalkEntry *files, size_t count,
+                                 const void *inherited, void *ctx) {
+    NoticeCtx *nc = ctx;
+    char *buf = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const char *name = files[i].name;
+        int is_notice = notices_is_notice_file(name);
+        if (!is_notice && !scan_is_license_file(name)) continue;
+        if (!buf && !(buf = malloc(NOTICE_READ_MAX))) break;
+        long n = walk_read_head(dir, name, buf, NOTICE_READ_MAX);
+        if (n < 0) {
+            atomic_fetch_add(&nc->unreadable, 1);
+            continue;
+        }
+        uint32_t *words;
+        size_t n_words;
+        if (detector_normalize(nc->det, buf, (size_t)n, &words, &n_words) != 0) {
+            atomic_store(&nc->failed, 1);
+            break;
+        }
+        uint64_t hash = hash_fnv1a(FNV1A_INIT ^ (uint64_t)is_notice, words, n_words * sizeof(*words));
+        free(words);
+        StrBuf copyright = {0};
+        collect_copyright(nc->det, buf, (size_t)n, &copyright);
+        if (add_record(nc, dir, name, hash, is_notice, &copyright) != 0) atomic_store(&nc->failed, 1);
+        sb_free(&copyright);
+    }
+    free(buf);
+    return inherited;
+}
+
+/* Identifies the text of one group from its representative file. */
+static void identify_group(size_t index, void *ctx) {
+    NoticeCtx *nc = ctx;
+    NoticeGroup *g = &nc->groups[index];
+    if (g->is_notice) return;
+    char *buf = malloc(NOTICE_READ_MAX);
+    if (!buf) return;
+    const NoticeRecord *r = &nc->records[g->rep];
+    long n = walk_read_head(r->dir, r->name, buf, NOTICE_READ_MAX);
+    DetectMatch match;
+    if (n > 0 && detector_identify(nc->det, buf, (size_t)n, &match) == 0 && match.license &&
+        match.confidence >= 0.5) {
+        g->license = match.license;
+    }
+    free(buf);
+}
+
+/* ---- ordering ---- */
+
+/* Licenses by name, then unrecognized texts, then NOTICE files; ties by first package */
+static int compare_groups(const void *a, const void *b, void *arg) {
+    const NoticeCtx *nc = arg;
+    const NoticeGroup *x = &nc->groups[*(const size_t *)a];
+    const NoticeGroup *y = &nc->groups[*(const size_t *)b];
+    int kx = x->is_notice ? 2 : x->license ? 0 : 1;
+    int ky = y->is_notice ? 2 : y->license ? 0 : 1;
+    if (kx != ky) return kx - ky;
+    if (x->license && y->license) {
+        int c = strcasecmp(x->license, y->license);
+        if (c) return c;
+    }
+    return path_cmp(&nc->records[x->rep], &nc->records[y->rep]);
+}
+
+static int compare_records(const void *a, const void *b, void *arg) {
+    const NoticeCtx *nc = arg;
+    const NoticeRecord *x = a, *y = b;
+    size_t rx = nc->groups[x->group].rank, ry = nc->groups[y->group].rank;
+    if (rx != ry) return rx < ry ? -1 : 1;
+    return path_cmp(x, y);
+}
+
+/* ---- output ---- */
+
+static void print_group_title(FILE *out, const NoticeGroup *g, const Catalog *cat) {
+    if (g->is_notice) {
+        fputs("Notices\n", out);
+        return;
+    }
+    if (!g->license) {
+        fputs("Unrecognized license text\n", out);
+        return;
+    }
+    const CatalogEntry *e = cat ? catalog_find(cat, g->license) : NULL;
+    const char *title = e ? catalog_str(cat, e->title_off) : "";
+    const char *spdx = e ? catalog_str(cat, e->spdx_off) : "";
+    fprintf(out, "%s (%s)\n", *title ? title : g->license, *spdx ? spdx : g->license);
+}
+
+/* Returns 1 if the '\n'-terminated list lines holds line. */
+static int has_line(const char *lines, const char *line, size_t len) {
+    for (const char *p = lines; p && *p; p = strchr(p, '\n') + 1) {
+        if (strncmp(p, line, len) == 0 && p[len] == '\n') return 1;
+    }
+    return 0;
+}
+
+/* Returns 1 if every record of recs holds line: it belongs to the text (the
+ * FSF's line of the GPL), or the group has a single holder shown by the text.
+ */
+static int shared_line(const NoticeRecord *recs, size_t count, const char *line, size_t len) {
+    for (size_t i = 0; i < count; i++) {
+        if (!has_line(recs[i].copyright, line, len)) return 0;
+    }
+    return 1;
+}
+
+/* Writes the text of the representative file; text holds its first len bytes. */
+static int stream_text(FILE *out, const NoticeRecord *rep, const char *text, size_t len) {
+    fwrite(text, 1, len, out);
+    int ends_nl = len > 0 && text[len - 1] == '\n';
+    if (len == NOTICE_READ_MAX) {
+        /* Longer than what was hashed: copy the rest straight from the file */
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", rep->dir, rep->name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0) return -1;
+        char chunk[65536];
+        ssize_t n;
+        if (lseek(fd, (off_t)len, SEEK_SET) >= 0) {
+            while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+                fwrite(chunk, 1, (size_t)n, out);
+                ends_nl = chunk[n - 1] == '\n';
+            }
+        }
+        close(fd);
+    }
+    if (!ends_nl) fputc('\n', out);
+    return 0;
+}
+
+static int write_document(FILE *out, NoticeCtx *nc, char **roots, int count, const Catalog *cat,
+                          size_t packages) {
+    fputs("THIRD-PARTY SOFTWARE NOTICES\n\n", out);
+    fputs("This document lists the licenses and notices of the third-party packages found under:\n", out);
+    for (int i = 0; i < count; i++) fprintf(out, "    %s\n", roots[i]);
+    fprintf(out, "%zu packages, %zu distinct texts.\n", packages, nc->group_count);
+
+    char *buf = malloc(NOTICE_READ_MAX);
+    if (!buf) return -1;
+    int rc = 0;
+    for (size_t i = 0; i < nc->record_count && rc == 0;) {
+        const NoticeGroup *g = &nc->groups[nc->records[i].group];
+        const NoticeRecord *rep = &nc->records[g->rep];
+        long n = walk_read_head(rep->dir, rep->name, buf, NOTICE_READ_MAX);
+        if (n < 0) n = 0;
+
+        fputs("\n" RULE, out);
+        print_group_title(out, g, cat);
+        fprintf(out, "Used by %zu package%s:\n", g->count, g->count == 1 ? "" : "s");
+        const NoticeRecord *recs = &nc->records[i];
+        for (size_t j = 0; j < g->count; j++) {
+            fprintf(out, "    %s/%s\n", recs[j].dir, recs[j].name);
+            for (const char *line = recs[j].copyright; line && *line;) {
+                const char *nl = strchr(line, '\n');
+                size_t len = (size_t)(nl - line);
+                if (!shared_line(recs, g->count, line, len)) fprintf(out, "        %.*s\n", (int)len, line);
+                line = nl + 1;
+            }
+        }
+        i += g->count;
+        fputs(THIN_RULE "\n", out);
+        rc = stream_text(out, rep, buf, (size_t)n);
+        if (ferror(out)) rc = -1;
+    }
+    free(buf);
+    return rc;
+}
+
+static int compare_dirs(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Number of distinct directories holding license files */
+static size_t count_packages(const NoticeCtx *nc) {
+    char **dirs = malloc((nc->record_count ? nc->record_count : 1) * sizeof(*dirs));
+    if (!dirs) return nc->record_count;
+    for (size_t i = 0; i < nc->record_count; i++) dirs[i] = nc->records[i].dir;
+    qsort(dirs, nc->record_count, sizeof(*dirs), compare_dirs);
+    size_t packages = 0;
+    for (size_t i = 0; i < nc->record_count; i++) {
+        packages += i == 0 || strcmp(dirs[i], dirs[i - 1]) != 0;
+    }
+    free(dirs);
+    return packages;
+}
+
+int run_notices(char **roots, int count, const char *out_path, int mode,
+                const Database *db, const Config *config, int threads) {
+    NoticeCtx nc;
+    memset(&nc, 0, sizeof(nc));
+    pthread_mutex_init(&nc.lock, NULL);
+    atomic_init(&nc.unreadable, 0);
+    atomic_init(&nc.failed, 0);
+
+    Detector det;
+    if (detector_open(&det, db, config) != 0) {
+        print_error("Unable to load license fingerprints");
+        pthread_mutex_destroy(&nc.lock);
+        return -1;
+    }
+    nc.det = &det;
+
+    int rc = 0;
+    for (int i = 0; i < count && rc == 0 && !atomic_load(&nc.failed); i++) {
+        if (walk_tree(roots[i], threads, notices_visit, NULL, &nc) < 0) {
+            char errmsg[512];
+            snprintf(errmsg, sizeof(errmsg), "Unable to scan directory '%s'", roots[i]);
+            print_error(errmsg);
+            rc = -1;
+        }
+    }
+    if (atomic_load(&nc.failed)) {
+        print_error("Out of memory while collecting notices");
+        rc = -1;
+    }
+
+    size_t *order = NULL;
+    if (rc == 0) {
+        pool_run(nc.group_count, threads, identify_group, &nc);
+        order = malloc((nc.group_count ? nc.group_count : 1) * sizeof(*order));
+        if (!order) rc = -1;
+    }
+    size_t packages = 0, unrecognized = 0;
+    if (rc == 0) {
+        for (size_t i = 0; i < nc.group_count; i++) order[i] = i;
+        qsort_r(order, nc.group_count, sizeof(*order), compare_groups, &nc);
+        for (size_t i = 0; i < nc.group_count; i++) {
+            nc.groups[order[i]].rank = i;
+            unrecognized += !nc.groups[i].is_notice && !nc.groups[i].license;
+        }
+        /* Representatives are record indexes: find them again after the sort */
+        for (size_t i = 0; i < nc.record_count; i++) {
+            nc.records[i].is_rep = nc.groups[nc.records[i].group].rep == i;
+        }
+        qsort_r(nc.records, nc.record_count, sizeof(*nc.records), compare_records, &nc);
+        for (size_t i = 0; i < nc.record_count; i++) {
+            NoticeRecord *r = &nc.records[i];
+            if (r->is_rep) nc.groups[r->group].rep = i;
+        }
+        packages = count_packages(&nc);
+    }
+
+    if (rc == 0) {
+        Catalog cat;
+        int have_cat = catalog_open(&cat, db) == 0;
+        char tmp[PATH_MAX];
+        FILE *out = out_path ? open_replacement(out_path, tmp, sizeof(tmp)) : stdout;
+        if (!out) {
+            rc = -1;
+        } else {
+            rc = write_document(out, &nc, roots, count, have_cat ? &cat : NULL, packages);
+            if (out_path) {
+                rc = commit_replacement(out, tmp, out_path, mode, rc == 0);
+            } else if (fflush(stdout) != 0) {
+                rc = -1;
+            }
+        }
+        if (rc != 0) {
+            char errmsg[512];
+            snprintf(errmsg, sizeof(errmsg), "Failed to write %s: %s", out_path ? out_path : "notices", strerror(errno));
+            print_error(errmsg);
+        } else if (out_path) {
+            printf("Wrote %s: %zu packages, %zu distinct texts (%zu unrecognized).\n",
+                   out_path, packages, nc.group_count, unrecognized);
+        }
+        if (have_cat) catalog_close(&cat);
+    }
+    size_t unreadable = atomic_load(&nc.unreadable);
+    if (rc == 0 && unreadable > 0) {
+        char errmsg[128];
+        snprintf(errmsg, sizeof(errmsg), "%zu license files could not be read", unreadable);
+        print_error(errmsg);
+    }
+
+    for (size_t i = 0; i < nc.record_count; i++) {
+        free(nc.records[i].dir);
+        free(nc.records[i].name);
+        free(nc.records[i].copyright);
+    }
+    free(nc.records);
+    free(nc.groups);
+    free(nc.slots);
+    free(order);
+    detector_close(&det);
+    pthread_mutex_destroy(&nc.lock);
+    return rc;
+}
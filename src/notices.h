@@ -0,0 +1,32 @@
+/* File: src/notices.h
+ *
+ * Header for third-party notice aggregation.
+ *
+ * Walks vendored dependency trees (vendor/, third_party/, node_modules, ...)
+ * in parallel for LICENSE, COPYING and NOTICE files, identifies each distinct
+ * text once against the license corpus and writes a THIRD_PARTY_NOTICES
+ * document: one section per distinct text, listing every package that ships
+ * it with its own copyright lines, followed by the text itself.
+ */
+
+#ifndef NOTICES_H
+#define NOTICES_H
+
+#include "config.h"
+#include "db.h"
+
+/* Default output of osla --notices */
+#define NOTICES_FILENAME "THIRD_PARTY_NOTICES"
+
+/* Returns 1 if name looks like a notice file (NOTICE, NOTICE.txt, ...). */
+int notices_is_notice_file(const char *name);
+
+/* Collects the license and notice files under the count roots on up to
+ * threads workers (threads <= 0 means one per CPU) and writes the notices
+ * document to out_path, or to stdout if out_path is NULL. mode is as for
+ * write_to_file(). Returns 0 on success, -1 on failure.
+ */
+int run_notices(char **roots, int count, const char *out_path, int mode,
+                const Database *db, const Config *config, int threads);
+
+#endif /* NOTICES_H */
@@ -0,0 +1,301 @@
+/* File: src/osla.c
+ *
+ * Implementation of the libosla interface.
+ *
+ * The handle wraps the same database, config, template set, catalog and
+ * search index the command line uses. The derived parts are loaded on first
+ * use under the handle's write lock; every query then runs under the read
+ * lock, so concurrent renders share one mapping of the compiled templates.
+ * A render resolves the name, finds the template and copies its spans into
+ * the caller's memory; the slot values are formatted on the stack.
+ */
+
+#define _GNU_SOURCE
+#include "osla_private.h"
+#include <stdlib.h>
+#include <string.h>
+#include "io.h"
+#include "paths.h"
+#include "suggest.h"
+#include "trace.h"
+#include "version.h"
+
+/* Renders retried after the template set was recompiled under them */
+#define RENDER_ATTEMPTS 3
+
+typedef enum {
+    NEED_TEMPLATES,
+    NEED_CATALOG,
+    NEED_INDEX
+} Need;
+
+static const char *const status_messages[] = {
+    "Success",
+    "License not found",
+    "Buffer too small",
+    "License data unavailable",
+    "Invalid setting",
+    "Configuration unavailable",
+    "Out of memory",
+};
+
+const char *osla_version(void) {
+    return OSLA_VERSION;
+}
+
+const char *osla_strerror(OslaStatus status) {
+    if ((size_t)status >= sizeof(status_messages) / sizeof(status_messages[0])) return "Unknown error";
+    return status_messages[status];
+}
+
+OslaStatus osla_open(Osla **handle, const OslaOptions *options) {
+    static const OslaOptions defaults = { NULL, 0, 0 };
+    if (!options) options = &defaults;
+    *handle = NULL;
+    Osla *h = calloc(1, sizeof(*h));
+    if (!h) return OSLA_NO_MEMORY;
+    h->debug = options->debug;
+    if (options->user_config) {
+        if (load_config(&h->config, h->debug) != 0) {
+            free(h);
+            return OSLA_NO_CONFIG;
+        }
+    } else {
+        config_defaults(&h->config);
+        config_finish(&h->config);
+    }
+    if (pthread_rwlock_init(&h->lock, NULL) != 0) {
+        free(h);
+        return OSLA_NO_MEMORY;
+    }
+
+    /* An OSLA_DATADIR override wins over a database compiled into the binary */
+    TraceSpan span;
+    trace_begin(&span, TRACE_DATADIR);
+    if (options->datadir) {
+        db_open(&h->db, options->datadir);
+    } else if (data_dir_overridden() || db_open_embedded(&h->db) != 0) {
+        db_open(&h->db, get_data_dir());
+    }
+    db_use_site_aliases(&h->db, &h->config);
+    trace_end(&span, 0);
+    if (h->debug) {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Using data directory '%s' (%s)", h->db.datadir, db_backend_name(&h->db));
+        debug_print(msg);
+    }
+    *handle = h;
+    return OSLA_OK;
+}
+
+void osla_close(Osla *h) {
+    if (!h) return;
+    if (h->have_templates) template_set_close(&h->templates);
+    if (h->have_catalog) catalog_close(&h->catalog);
+    if (h->have_index) search_index_close(&h->index);
+    db_close(&h->db);
+    free_config(&h->config);
+    pthread_rwlock_destroy(&h->lock);
+    free(h);
+}
+
+static int loaded(const Osla *h, Need need) {
+    switch (need) {
+    case NEED_TEMPLATES: return h->have_templates;
+    case NEED_CATALOG:   return h->have_catalog;
+    default:             return h->have_index;
+    }
+}
+
+/* Called with the write lock held. */
+static OslaStatus load(Osla *h, Need need) {
+    if (loaded(h, need)) return OSLA_OK;
+    switch (need) {
+    case NEED_TEMPLATES:
+        h->have_templates = template_set_open(&h->templates, &h->db, &h->config) == 0;
+        break;
+    case NEED_CATALOG:
+        h->have_catalog = catalog_open(&h->catalog, &h->db) == 0;
+        break;
+    default:
+        h->have_index = search_index_open(&h->index, &h->db) == 0;
+        break;
+    }
+    return loaded(h, need) ? OSLA_OK : OSLA_NO_DATA;
+}
+
+/* Returns with the read lock held and the needed part loaded, or with no
+ * lock held and the status of the failed load.
+ */
+static OslaStatus acquire(Osla *h, Need need) {
+    for (;;) {
+        pthread_rwlock_rdlock(&h->lock);
+        if (loaded(h, need)) return OSLA_OK;
+        pthread_rwlock_unlock(&h->lock);
+        pthread_rwlock_wrlock(&h->lock);
+        OslaStatus status = load(h, need);
+        pthread_rwlock_unlock(&h->lock);
+        if (status != OSLA_OK) return status;
+    }
+}
+
+OslaStatus osla_set(Osla *h, const char *key, const char *value) {
+    pthread_rwlock_wrlock(&h->lock);
+    int rc = config_set(&h->config, key, value, h->debug);
+    if (rc == 0 && strcmp(key, "token") == 0 && h->have_templates) {
+        /* The token set is part of the compiled templates */
+        template_set_close(&h->templates);
+        h->have_templates = 0;
+    }
+    pthread_rwlock_unlock(&h->lock);
+    return rc == 0 ? OSLA_OK : OSLA_INVALID;
+}
+
+const char *osla_get(const Osla *h, const char *key) {
+    if (strcmp(key, "author") == 0) return h->config.author;
+    if (strcmp(key, "year") == 0) return h->config.year;
+    if (strcmp(key, "project") == 0) return h->config.project;
+    if (strcmp(key, "url") == 0) return h->config.url;
+    if (strcmp(key, "default_license") == 0) return h->config.default_license;
+    if (strcmp(key, "output") == 0) return h->config.output;
+    return NULL;
+}
+
+/* Resolves name into out; called with the lock held. */
+static void resolve_locked(const Osla *h, const char *name, char *out, size_t size) {
+    if (db_resolve_alias(&h->db, name, out, size) != 0) {
+        snprintf(out, size, "%s", name);
+    }
+}
+
+OslaStatus osla_resolve(Osla *h, const char *name, char *out, size_t size) {
+    char resolved[64];
+    pthread_rwlock_rdlock(&h->lock);
+    resolve_locked(h, name, resolved, sizeof(resolved));
+    pthread_rwlock_unlock(&h->lock);
+    size_t len = strlen(resolved);
+    if (len >= size) return OSLA_NO_SPACE;
+    memcpy(out, resolved, len + 1);
+    return OSLA_OK;
+}
+
+OslaStatus osla_render(Osla *h, const char *license, const OslaValues *values, char *buf, size_t size,
+                       size_t *len) {
+    for (int attempt = 0; attempt < RENDER_ATTEMPTS; attempt++) {
+        OslaStatus status = acquire(h, NEED_TEMPLATES);
+        if (status != OSLA_OK) return status;
+        char resolved[64];
+        resolve_locked(h, license, resolved, sizeof(resolved));
+        const TemplateEntry *t = template_find(&h->templates, resolved);
+        if (!t) {
+            pthread_rwlock_unlock(&h->lock);
+            return OSLA_NOT_FOUND;
+        }
+        if (!h->templates.checked[t - h->templates.entries]) {
+            /* First render of this license: make sure its file was not edited since compiling */
+            pthread_rwlock_unlock(&h->lock);
+            pthread_rwlock_wrlock(&h->lock);
+            if (h->have_templates) {
+                template_get(&h->templates, resolved);
+                h->have_templates = h->templates.header != NULL;
+            }
+            pthread_rwlock_unlock(&h->lock);
+            continue;
+        }
+        TemplateValues v;
+        template_values(&v, &h->config, values ? values->year : NULL, values ? values->author : NULL);
+        if (values && values->project) {
+            v.values[SUBST_PROJECT] = values->project;
+            v.lengths[SUBST_PROJECT] = strlen(values->project);
+        }
+        if (values && values->url) {
+            v.values[SUBST_URL] = values->url;
+            v.lengths[SUBST_URL] = strlen(values->url);
+        }
+        *len = template_copy(&h->templates, t, &v, buf, size);
+        pthread_rwlock_unlock(&h->lock);
+        return *len <= size ? OSLA_OK : OSLA_NO_SPACE;
+    }
+    return OSLA_NO_DATA;
+}
+
+OslaStatus osla_render_arena(Osla *h, const char *license, const OslaValues *values, OslaArena *arena,
+                             const char **text, size_t *len) {
+    char *at = arena->base + arena->used;
+    size_t avail = arena->size - arena->used;
+    OslaStatus status = osla_render(h, license, values, at, avail, len);
+    if (status != OSLA_OK) return status;
+    if (*len + 1 > avail) return OSLA_NO_SPACE;
+    arena->used += *len + 1;
+    *text = at;
+    return OSLA_OK;
+}
+
+OslaStatus osla_describe(Osla *h, const char *license, char *buf, size_t size, size_t *len) {
+    char resolved[64];
+    DbText text;
+    pthread_rwlock_rdlock(&h->lock);
+    resolve_locked(h, license, resolved, sizeof(resolved));
+    int rc = db_get(&h->db, DB_DESCRIPTION, resolved, &text);
+    pthread_rwlock_unlock(&h->lock);
+    if (rc != 0) return OSLA_NOT_FOUND;
+    *len = text.len;
+    if (text.len <= size) {
+        memcpy(buf, text.data, text.len);
+        if (text.len < size) buf[text.len] = '\0';
+    }
+    db_text_release(&text);
+    return *len <= size ? OSLA_OK : OSLA_NO_SPACE;
+}
+
+OslaStatus osla_list(Osla *h, OslaLicense *out, size_t cap, size_t *count) {
+    OslaStatus status = acquire(h, NEED_CATALOG);
+    if (status != OSLA_OK) return status;
+    const Catalog *cat = &h->catalog;
+    *count = cat->header->count;
+    for (size_t i = 0; i < *count && i < cap; i++) {
+        const CatalogEntry *e = &cat->entries[i];
+        out[i].name = catalog_str(cat, e->name_off);
+        out[i].spdx = catalog_str(cat, e->spdx_off);
+        out[i].title = catalog_str(cat, e->title_off);
+        out[i].aliases = catalog_str(cat, e->aliases_off);
+        out[i].category = catalog_category_name(e->category);
+        out[i].osi = (e->flags & LICENSE_OSI) != 0;
+        out[i].fsf = (e->flags & LICENSE_FSF) != 0;
+        out[i].size = e->size;
+    }
+    pthread_rwlock_unlock(&h->lock);
+    return OSLA_OK;
+}
+
+OslaStatus osla_search(Osla *h, const char *query, OslaHit *out, size_t cap, size_t *count) {
+    OslaStatus status = acquire(h, NEED_INDEX);
+    if (status != OSLA_OK) return status;
+    SearchResult *results;
+    if (search_index_query(&h->index, query, &results, count) != 0) {
+        pthread_rwlock_unlock(&h->lock);
+        return OSLA_NO_MEMORY;
+    }
+    for (size_t i = 0; i < *count && i < cap; i++) {
+        out[i].name = search_doc_name(&h->index, results[i].doc, NULL);
+        out[i].score = results[i].score;
+        out[i].offset = results[i].hit_off;
+        out[i].length = results[i].hit_len;
+    }
+    pthread_rwlock_unlock(&h->lock);
+    free(results);
+    return OSLA_OK;
+}
+
+size_t osla_suggest(Osla *h, const char *name, OslaSuggestion *out, size_t cap) {
+    Suggestion found[SUGGEST_MAX];
+    pthread_rwlock_rdlock(&h->lock);
+    size_t n = suggest_licenses(&h->db, name, found, cap < SUGGEST_MAX ? cap : SUGGEST_MAX);
+    pthread_rwlock_unlock(&h->lock);
+    for (size_t i = 0; i < n; i++) {
+        memcpy(out[i].license, found[i].license, sizeof(out[i].license));
+        memcpy(out[i].matched, found[i].matched, sizeof(out[i].matched));
+        out[i].distance = found[i].distance;
+    }
+    return n;
+}
@@ -0,0 +1,175 @@
+/* File: src/osla.h
+ *
+ * Public interface of libosla, the core of osla as a library (make lib
+ * builds libosla.a and libosla.so).
+ *
+ * A handle owns everything one osla run would load: the settings, the
+ * license database and, once first needed, the compiled templates, the
+ * catalog and the search index. There is no global state, nothing calls
+ * exit(), and errors come back as an OslaStatus. Handles are independent
+ * of each other, and one handle may be shared by threads: rendering,
+ * resolving and listing run concurrently, while osla_set() waits for them.
+ *
+ * Rendering allocates nothing. It fills the caller's buffer, or carves the
+ * text out of a caller-supplied arena, so a build tool can render millions
+ * of licenses in one process:
+ *
+ *     Osla *osla;
+ *     OslaOptions opts = { NULL, 0, 0 };
+ *     char buf[65536];
+ *     size_t len;
+ *     if (osla_open(&osla, &opts) == OSLA_OK) {
+ *         osla_set(osla, "author", "Jane Doe");
+ *         OslaValues values = { "2024", NULL, NULL, NULL };
+ *         if (osla_render(osla, "mit", &values, buf, sizeof(buf), &len) == OSLA_OK) {
+ *             fwrite(buf, 1, len, stdout);
+ *         }
+ *         osla_close(osla);
+ *     }
+ *
+ * Strings returned by osla_list(), osla_search() and osla_get() stay valid
+ * until the handle is closed or, for osla_get(), the setting changes.
+ */
+
+#ifndef OSLA_H
+#define OSLA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OSLA_API __attribute__((visibility("default")))
+
+typedef struct Osla Osla;
+
+typedef enum {
+    OSLA_OK = 0,
+    OSLA_NOT_FOUND,         /* no such license or description */
+    OSLA_NO_SPACE,          /* the buffer or arena is too small; the needed length is reported */
+    OSLA_NO_DATA,           /* the license data or what is derived from it cannot be read */
+    OSLA_INVALID,           /* unknown setting or invalid value */
+    OSLA_NO_CONFIG,         /* the user config cannot be read or created */
+    OSLA_NO_MEMORY
+} OslaStatus;
+
+typedef struct {
+    const char *datadir;    /* NULL: $OSLA_DATADIR, else the data built into the library, else the installed data */
+    int user_config;        /* non-zero: start from ~/.config/OSLA/osla.conf (created if missing) */
+    int debug;              /* non-zero: debug messages on stderr */
+} OslaOptions;
+
+/* Per-render values; NULL fields use the handle's settings. */
+typedef struct {
+    const char *year;       /* "2019-" runs to the current year */
+    const char *author;     /* holders separated by ';' */
+    const char *project;
+    const char *url;
+} OslaValues;
+
+/* Caller-owned memory that renders are carved from; reset it to reuse it. */
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+} OslaArena;
+
+typedef struct {
+    const char *name;
+    const char *spdx;       /* "" when the license has no SPDX identifier */
+    const char *title;
+    const char *aliases;    /* comma-separated */
+    const char *category;   /* software, hardware, font, content or other */
+    int osi;                /* OSI approved */
+    int fsf;                /* FSF free */
+    size_t size;            /* bytes of license text */
+} OslaLicense;
+
+typedef struct {
+    const char *name;
+    double score;
+    size_t offset;          /* best match in the license's description and text */
+    size_t length;
+} OslaHit;
+
+typedef struct {
+    char license[64];
+    char matched[64];       /* the name, alias or title closest to the input */
+    int distance;
+} OslaSuggestion;
+
+static inline void osla_arena_init(OslaArena *arena, void *memory, size_t size) {
+    arena->base = (char *)memory;
+    arena->size = size;
+    arena->used = 0;
+}
+
+static inline void osla_arena_reset(OslaArena *arena) {
+    arena->used = 0;
+}
+
+OSLA_API const char *osla_version(void);
+
+OSLA_API const char *osla_strerror(OslaStatus status);
+
+/* Opens a handle (options may be NULL for the defaults). */
+OSLA_API OslaStatus osla_open(Osla **handle, const OslaOptions *options);
+
+OSLA_API void osla_close(Osla *handle);
+
+/* Changes a setting, with the keys and values of the config file: author,
+ * year, project, url, default_license, output, mode, token and alias. A
+ * token adds a placeholder spelling; the templates are recompiled on the
+ * next render.
+ */
+OSLA_API OslaStatus osla_set(Osla *handle, const char *key, const char *value);
+
+/* Returns a setting (author, year, project, url, default_license, output),
+ * or NULL for another key.
+ */
+OSLA_API const char *osla_get(const Osla *handle, const char *key);
+
+/* Resolves a site alias, built-in alias or SPDX identifier to the license
+ * name. Names that resolve to nothing are copied as they are. Returns
+ * OSLA_NO_SPACE if out is too small.
+ */
+OSLA_API OslaStatus osla_resolve(Osla *handle, const char *name, char *out, size_t size);
+
+/* Renders a license (a name, alias or SPDX identifier) into buf, which is
+ * NUL-terminated when there is room. *len receives the length of the text,
+ * also when OSLA_NO_SPACE reports that buf is too small.
+ */
+OSLA_API OslaStatus osla_render(Osla *handle, const char *license, const OslaValues *values, char *buf,
+                                size_t size, size_t *len);
+
+/* Like osla_render(), but takes the NUL-terminated text from the arena and
+ * points *text at it. On OSLA_NO_SPACE the arena is unchanged and *len is
+ * the length that did not fit.
+ */
+OSLA_API OslaStatus osla_render_arena(Osla *handle, const char *license, const OslaValues *values,
+                                      OslaArena *arena, const char **text, size_t *len);
+
+/* Copies the description of a license into buf like osla_render(). */
+OSLA_API OslaStatus osla_describe(Osla *handle, const char *license, char *buf, size_t size, size_t *len);
+
+/* Fills out with up to cap licenses from the catalog and sets *count to the
+ * number of licenses there are.
+ */
+OSLA_API OslaStatus osla_list(Osla *handle, OslaLicense *out, size_t cap, size_t *count);
+
+/* Runs a full-text query and fills out with up to cap hits, best first.
+ * *count receives the number of hits there are.
+ */
+OSLA_API OslaStatus osla_search(Osla *handle, const char *query, OslaHit *out, size_t cap, size_t *count);
+
+/* Fills out with up to cap licenses whose names are closest to name and
+ * returns how many it found.
+ */
+OSLA_API size_t osla_suggest(Osla *handle, const char *name, OslaSuggestion *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OSLA_H */
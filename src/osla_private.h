@@ -0,0 +1,33 @@
+/* File: src/osla_private.h
+ *
+ * The libosla handle as the rest of the tree sees it. The command line
+ * keeps one handle for its whole run and hands its database and config to
+ * the modules the public interface does not cover (batch, scan, server...).
+ */
+
+#ifndef OSLA_PRIVATE_H
+#define OSLA_PRIVATE_H
+
+#include <pthread.h>
+#include "osla.h"
+#include "catalog.h"
+#include "config.h"
+#include "db.h"
+#include "search.h"
+#include "template.h"
+
+struct Osla {
+    Database db;
+    Config config;
+    int debug;
+    /* Loaded on first use under the write lock; renders and queries hold the read lock */
+    pthread_rwlock_t lock;
+    TemplateSet templates;
+    int have_templates;
+    Catalog catalog;
+    int have_catalog;
+    SearchIndex index;
+    int have_index;
+};
+
+#endif /* OSLA_PRIVATE_H */
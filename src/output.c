@@ -0,0 +1,367 @@
+/* File: src/output.c
+ *
+ * Implementation of the record output layer.
+ *
+ * Cells are collected into one string arena while the caller walks its data;
+ * output_finish() then knows every row, so table columns are sized to their
+ * longest cell, and renders the whole result into the caller's buffer.
+ */
+
+#include "output.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Width of the rule under the table headings */
+#define TABLE_RULE 61
+
+static const char *format_names[] = { "table", "json", "ndjson", "tsv" };
+
+int output_format_parse(const char *name) {
+    for (size_t i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++) {
+        if (strcasecmp(name, format_names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
+
+const char *output_format_name(OutputFormat format) {
+    return format_names[format];
+}
+
+void output_init(Output *o, OutputFormat format, const OutputField *fields, size_t field_count,
+                 const char *title, const char *empty) {
+    memset(o, 0, sizeof(*o));
+    o->format = format;
+    o->fields = fields;
+    o->field_count = field_count;
+    o->title = title;
+    o->empty = empty;
+}
+
+void output_row(Output *o) {
+    size_t need = (o->row_count + 1) * o->field_count;
+    if (need > o->cell_cap) {
+        size_t cap = o->cell_cap ? o->cell_cap * 2 : 16 * o->field_count;
+        while (cap < need) cap *= 2;
+        OutputCell *cells = realloc(o->cells, cap * sizeof(*cells));
+        if (!cells) {
+            o->failed = 1;
+            return;
+        }
+        o->cells = cells;
+        o->cell_cap = cap;
+    }
+    OutputCell *row = o->cells + o->row_count * o->field_count;
+    for (size_t i = 0; i < o->field_count; i++) {
+        row[i].off = SIZE_MAX;
+        row[i].len = 0;
+        row[i].number = 0;
+    }
+    o->row_count++;
+}
+
+static OutputCell *current_cell(Output *o, size_t i) {
+    if (o->failed || o->row_count == 0 || i >= o->field_count) return NULL;
+    return &o->cells[(o->row_count - 1) * o->field_count + i];
+}
+
+void output_string(Output *o, size_t i, const char *s, size_t len) {
+    OutputCell *cell = current_cell(o, i);
+    if (!cell || !s) return;
+    cell->off = o->strings.len;
+    cell->len = len;
+    if (sb_append(&o->strings, s, len) != 0) o->failed = 1;
+}
+
+void output_number(Output *o, size_t i, double value) {
+    OutputCell *cell = current_cell(o, i);
+    if (!cell) return;
+    cell->off = 0;
+    cell->number = value;
+}
+
+/* ---- Rendering ---- */
+
+/* The output buffer, remembering whether an append failed. */
+typedef struct {
+    StrBuf *buf;
+    int failed;
+} Sink;
+
+static void put(Sink *out, const char *data, size_t len) {
+    if (!out->failed && sb_append(out->buf, data, len) != 0) out->failed = 1;
+}
+
+static void put_str(Sink *out, const char *s) {
+    put(out, s, strlen(s));
+}
+
+static const char *cell_text(const Output *o, const OutputCell *cell) {
+    return o->strings.data + cell->off;
+}
+
+/* Formats a number or flag cell for the table (precision >= 0) or the
+ * machine formats (precision < 0).
+ */
+static int format_scalar(const OutputField *f, const OutputCell *cell, int precision, char *buf, size_t size) {
+    if (f->type == FIELD_BOOL) {
+        const char *s = cell->number != 0 ? (precision >= 0 ? "yes" : "true") : (precision >= 0 ? "no" : "false");
+        return snprintf(buf, size, "%s", s);
+    }
+    if (precision >= 0) return snprintf(buf, size, "%.*f", precision, cell->number);
+    return snprintf(buf, size, "%.10g", cell->number);
+}
+
+static int is_scalar(const OutputField *f) {
+    return f->type == FIELD_NUMBER || f->type == FIELD_BOOL;
+}
+
+static size_t table_cell_width(const OutputField *f, const OutputCell *cell) {
+    char buf[64];
+    if (cell->off == SIZE_MAX) return 0;
+    if (is_scalar(f)) return (size_t)format_scalar(f, cell, f->precision, buf, sizeof(buf));
+    return cell->len;
+}
+
+static void append_padding(Sink *out, size_t n) {
+    static const char spaces[] = "                                ";
+    while (n > 0) {
+        size_t k = n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1;
+        put(out, spaces, k);
+        n -= k;
+    }
+}
+
+/* Appends one table line: column i holds text[i] of len[i] bytes, padded to widths[i]. */
+static void append_table_line(const Output *o, const size_t *widths, const char **text, const size_t *len,
+                              Sink *out) {
+    int first = 1;
+    for (size_t i = 0; i < o->field_count; i++) {
+        if (!o->fields[i].heading) continue;
+        if (!first) put(out, " ", 1);
+        first = 0;
+        put(out, text[i], len[i]);
+        if (widths[i] > len[i]) append_padding(out, widths[i] - len[i]);
+    }
+    put(out, "\n", 1);
+}
+
+static int render_table(const Output *o, Sink *out) {
+    size_t n = o->field_count;
+    size_t *widths = calloc(n, sizeof(*widths));
+    size_t *lens = calloc(n, sizeof(*lens));
+    const char **text = calloc(n, sizeof(*text));
+    char (*scalars)[64] = calloc(n, sizeof(*scalars));
+    if (!widths || !lens || !text || !scalars) {
+        free(widths);
+        free(lens);
+        free(text);
+        free(scalars);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const OutputField *f = &o->fields[i];
+        if (!f->heading || f->width <= 0) continue;
+        widths[i] = (size_t)f->width;
+        for (size_t r = 0; r < o->row_count; r++) {
+            size_t w = table_cell_width(f, &o->cells[r * n + i]);
+            if (w > widths[i]) widths[i] = w;
+        }
+    }
+
+    if (o->title) {
+        put_str(out, o->title);
+        put(out, "\n", 1);
+    }
+    for (size_t i = 0; i < n; i++) {
+        text[i] = o->fields[i].heading ? o->fields[i].heading : "";
+        lens[i] = strlen(text[i]);
+    }
+    append_table_line(o, widths, text, lens, out);
+    for (int i = 0; i < TABLE_RULE; i++) put(out, "-", 1);
+    put(out, "\n", 1);
+
+    for (size_t r = 0; r < o->row_count; r++) {
+        const OutputCell *row = o->cells + r * n;
+        for (size_t i = 0; i < n; i++) {
+            const OutputField *f = &o->fields[i];
+            if (row[i].off == SIZE_MAX) {
+                text[i] = "";
+                lens[i] = 0;
+            } else if (is_scalar(f)) {
+                lens[i] = (size_t)format_scalar(f, &row[i], f->precision, scalars[i], sizeof(scalars[i]));
+                text[i] = scalars[i];
+            } else {
+                text[i] = cell_text(o, &row[i]);
+                lens[i] = row[i].len;
+            }
+        }
+        append_table_line(o, widths, text, lens, out);
+    }
+    if (o->row_count == 0 && o->empty) {
+        put_str(out, o->empty);
+        put(out, "\n", 1);
+    }
+    free(widths);
+    free(lens);
+    free(text);
+    free(scalars);
+    return 0;
+}
+
+static void append_json_string(Sink *out, const char *s, size_t len) {
+    put(out, "\"", 1);
+    size_t run = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+        put(out, s + run, i - run);
+        run = i + 1;
+        char esc[8];
+        switch (c) {
+        case '"':  put(out, "\\\"", 2); break;
+        case '\\': put(out, "\\\\", 2); break;
+        case '\n': put(out, "\\n", 2); break;
+        case '\t': put(out, "\\t", 2); break;
+        case '\r': put(out, "\\r", 2); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            put(out, esc, 6);
+        }
+    }
+    put(out, s + run, len - run);
+    put(out, "\"", 1);
+}
+
+/* Appends a comma-separated list as a JSON array, trimming blanks around items. */
+static void append_json_list(Sink *out, const char *s, size_t len) {
+    put(out, "[", 1);
+    size_t i = 0;
+    int first = 1;
+    while (i < len) {
+        size_t end = i;
+        while (end < len && s[end] != ',') end++;
+        size_t a = i, b = end;
+        while (a < b && (s[a] == ' ' || s[a] == '\t')) a++;
+        while (b > a && (s[b - 1] == ' ' || s[b - 1] == '\t')) b--;
+        if (b > a) {
+            if (!first) put(out, ", ", 2);
+            first = 0;
+            append_json_string(out, s + a, b - a);
+        }
+        i = end + 1;
+    }
+    put(out, "]", 1);
+}
+
+static void append_json_object(const Output *o, const OutputCell *row, Sink *out) {
+    put(out, "{", 1);
+    for (size_t i = 0; i < o->field_count; i++) {
+        const OutputField *f = &o->fields[i];
+        if (i > 0) put(out, ", ", 2);
+        append_json_string(out, f->key, strlen(f->key));
+        put(out, ": ", 2);
+        if (row[i].off == SIZE_MAX) {
+            put(out, "null", 4);
+        } else if (is_scalar(f)) {
+            char buf[64];
+            int n = format_scalar(f, &row[i], -1, buf, sizeof(buf));
+            put(out, buf, (size_t)n);
+        } else if (f->type == FIELD_LIST) {
+            append_json_list(out, cell_text(o, &row[i]), row[i].len);
+        } else {
+            append_json_string(out, cell_text(o, &row[i]), row[i].len);
+        }
+    }
+    put(out, "}", 1);
+}
+
+static void render_json(const Output *o, Sink *out) {
+    if (o->row_count == 0) {
+        put(out, "[]\n", 3);
+        return;
+    }
+    put(out, "[\n", 2);
+    for (size_t r = 0; r < o->row_count; r++) {
+        put(out, "  ", 2);
+        append_json_object(o, o->cells + r * o->field_count, out);
+        put(out, r + 1 < o->row_count ? ",\n" : "\n", r + 1 < o->row_count ? 2 : 1);
+    }
+    put(out, "]\n", 2);
+}
+
+static void render_ndjson(const Output *o, Sink *out) {
+    for (size_t r = 0; r < o->row_count; r++) {
+        append_json_object(o, o->cells + r * o->field_count, out);
+        put(out, "\n", 1);
+    }
+}
+
+/* TSV cells escape the characters that would break the layout: \\, \t, \n, \r. */
+static void append_tsv_cell(Sink *out, const char *s, size_t len) {
+    size_t run = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        if (c != '\\' && c != '\t' && c != '\n' && c != '\r') continue;
+        put(out, s + run, i - run);
+        run = i + 1;
+        char esc[2] = { '\\', c == '\t' ? 't' : c == '\n' ? 'n' : c == '\r' ? 'r' : '\\' };
+        put(out, esc, 2);
+    }
+    put(out, s + run, len - run);
+}
+
+static void render_tsv(const Output *o, Sink *out) {
+    for (size_t i = 0; i < o->field_count; i++) {
+        if (i > 0) put(out, "\t", 1);
+        put_str(out, o->fields[i].key);
+    }
+    put(out, "\n", 1);
+    for (size_t r = 0; r < o->row_count; r++) {
+        const OutputCell *row = o->cells + r * o->field_count;
+        for (size_t i = 0; i < o->field_count; i++) {
+            const OutputField *f = &o->fields[i];
+            if (i > 0) put(out, "\t", 1);
+            if (row[i].off == SIZE_MAX) continue;
+            if (is_scalar(f)) {
+                char buf[64];
+                int n = format_scalar(f, &row[i], -1, buf, sizeof(buf));
+                put(out, buf, (size_t)n);
+            } else {
+                append_tsv_cell(out, cell_text(o, &row[i]), row[i].len);
+            }
+        }
+        put(out, "\n", 1);
+    }
+}
+
+int output_finish(Output *o, StrBuf *out) {
+    if (o->failed) return -1;
+    Sink sink = { out, 0 };
+    /* Rendering appends many small pieces; reserve the bulk up front */
+    if (sb_reserve(out, o->strings.len + o->row_count * o->field_count * 8 + 256) != 0) return -1;
+    switch (o->format) {
+    case OUTPUT_TABLE:
+        if (render_table(o, &sink) != 0) return -1;
+        break;
+    case OUTPUT_JSON:
+        render_json(o, &sink);
+        break;
+    case OUTPUT_NDJSON:
+        render_ndjson(o, &sink);
+        break;
+    case OUTPUT_TSV:
+        render_tsv(o, &sink);
+        break;
+    }
+    return sink.failed ? -1 : 0;
+}
+
+void output_free(Output *o) {
+    sb_free(&o->strings);
+    free(o->cells);
+    memset(o, 0, sizeof(*o));
+}
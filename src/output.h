@@ -0,0 +1,87 @@
+/* File: src/output.h
+ *
+ * Header for the record output layer behind --list, --description and
+ * --search.
+ *
+ * Results are collected as rows of typed fields and rendered in one of the
+ * --format styles: an aligned table for people, or JSON, NDJSON or TSV for
+ * tools. Everything is rendered into one buffer that the caller writes with a
+ * single call, so a pipe reader never sees a partial result. Table columns
+ * grow to their longest cell instead of misaligning on long names, and the
+ * machine formats carry every field, including those the table leaves out.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include "utils.h"
+
+typedef enum {
+    OUTPUT_TABLE,
+    OUTPUT_JSON,            /* one array of objects */
+    OUTPUT_NDJSON,          /* one object per line */
+    OUTPUT_TSV              /* a header line of keys, then one line per row */
+} OutputFormat;
+
+typedef enum {
+    FIELD_STRING,
+    FIELD_LIST,             /* comma-separated string, a JSON array */
+    FIELD_NUMBER,
+    FIELD_BOOL
+} FieldType;
+
+typedef struct {
+    const char *key;        /* JSON key and TSV heading */
+    const char *heading;    /* table heading, or NULL to leave the field out of the table */
+    FieldType type;
+    int width;              /* minimum table width; 0 leaves the column unpadded */
+    int precision;          /* digits after the point in the table (FIELD_NUMBER) */
+} OutputField;
+
+typedef struct {
+    size_t off;             /* into Output.strings; SIZE_MAX for null */
+    size_t len;
+    double number;          /* FIELD_NUMBER and FIELD_BOOL */
+} OutputCell;
+
+typedef struct {
+    OutputFormat format;
+    const OutputField *fields;
+    size_t field_count;
+    const char *title;      /* table only: line printed above the headings, or NULL */
+    const char *empty;      /* table only: line printed when there are no rows, or NULL */
+    StrBuf strings;
+    OutputCell *cells;
+    size_t row_count;
+    size_t cell_cap;
+    int failed;
+} Output;
+
+/* Parses a --format value. Returns the format, or -1 if name is unknown. */
+int output_format_parse(const char *name);
+
+const char *output_format_name(OutputFormat format);
+
+void output_init(Output *o, OutputFormat format, const OutputField *fields, size_t field_count,
+                 const char *title, const char *empty);
+
+/* Starts a new row; its fields are null until set. */
+void output_row(Output *o);
+
+/* Set field i of the current row. A NULL string stays null. */
+void output_string(Output *o, size_t i, const char *s, size_t len);
+void output_number(Output *o, size_t i, double value);
+
+static inline void output_str(Output *o, size_t i, const char *s) {
+    if (s) output_string(o, i, s, strlen(s));
+}
+
+/* Renders every row in the output's format and appends it to out. Returns 0
+ * on success, -1 if an allocation failed while collecting or rendering.
+ */
+int output_finish(Output *o, StrBuf *out);
+
+void output_free(Output *o);
+
+#endif /* OUTPUT_H */
@@ -17,5 +17,11 @@ static inline const char *get_data_dir(void) {
     return (env && env[0] != '\0') ? env : OSLA_DATA_DIR;
 }
 
+/* Returns 1 if OSLA_DATADIR is set, which takes precedence over an embedded database */
+static inline int data_dir_overridden(void) {
+    const char *env = getenv("OSLA_DATADIR");
+    return env && env[0] != '\0';
+}
+
 #endif /* PATHS_H */
 
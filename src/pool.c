@@ -0,0 +1,64 @@
+/* File: src/pool.c
+ *
+ * Implementation of the worker thread pool.
+ */
+
+#define _GNU_SOURCE
+
+#include "pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    atomic_size_t next;
+    size_t count;
+    PoolJob job;
+    void *ctx;
+} PoolState;
+
+int pool_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void *pool_worker(void *arg) {
+    PoolState *state = arg;
+    size_t i;
+    while ((i = atomic_fetch_add(&state->next, 1)) < state->count) {
+        state->job(i, state->ctx);
+    }
+    return NULL;
+}
+
+void pool_run(size_t count, int threads, PoolJob job, void *ctx) {
+    PoolState state;
+    atomic_init(&state.next, 0);
+    state.count = count;
+    state.job = job;
+    state.ctx = ctx;
+
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+    if ((size_t)threads > count) {
+        threads = (int)count;
+    }
+    /* The calling thread works too, so spawn one fewer. */
+    pthread_t *tids = NULL;
+    int spawned = 0;
+    if (threads > 1) {
+        tids = malloc((size_t)(threads - 1) * sizeof(*tids));
+        for (; tids && spawned < threads - 1; spawned++) {
+            if (pthread_create(&tids[spawned], NULL, pool_worker, &state) != 0) {
+                break;
+            }
+        }
+    }
+    pool_worker(&state);
+    for (int i = 0; i < spawned; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+}
@@ -0,0 +1,26 @@
+/* File: src/pool.h
+ *
+ * Header for the worker thread pool.
+ *
+ * Runs an indexed job over a fixed set of POSIX threads that claim indices
+ * from a shared atomic counter, so uneven items balance themselves.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/* Called once per index in [0, count). Must be safe to run concurrently. */
+typedef void (*PoolJob)(size_t index, void *ctx);
+
+/* Returns the number of online CPUs (at least 1). */
+int pool_default_threads(void);
+
+/* Runs job for every index in [0, count) on up to threads workers
+ * (threads <= 0 means one per CPU) and returns when all have finished.
+ * Falls back to running inline if threads cannot be created.
+ */
+void pool_run(size_t count, int threads, PoolJob job, void *ctx);
+
+#endif /* POOL_H */
@@ -0,0 +1,292 @@
+/* File: src/scan.c
+ *
+ * Implementation of the source-tree license scanner.
+ *
+ * Each directory is summarized by the worker that lists it, right after its
+ * files are read, and printed under a lock; nothing per file outlives its
+ * directory. A license file found in a directory becomes the inherited
+ * license of its subdirectories.
+ */
+
+#define _GNU_SOURCE
+
+#include "scan.h"
+#include "detect.h"
+#include "filetype.h"
+#include "io.h"
+#include "license.h"
+#include "utils.h"
+#include "walk.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* License files are read whole up to this size for identification */
+#define LICENSE_READ_MAX (256 * 1024)
+#define MAX_DIR_IDS 16
+
+typedef struct {
+    const Database *db;
+    const Detector *det;
+    pthread_mutex_t lock;       /* output */
+    atomic_size_t dirs, sources, missing_spdx, missing_copyright, license_files;
+} ScanCtx;
+
+int scan_is_source_file(const char *name) {
+    return filetype_comment_kind(name) >= 0;
+}
+
+/* Returns 1 if ext may end the name of a license file: a document format
+ * (LICENSE.md), a version (LICENSE-Apache-2.0) or an upper-case tag
+ * (COPYING.LIB). Source and object extensions (license.c, license.o) may not.
+ */
+static int is_license_extension(const char *ext) {
+    static const char *const docs[] = { "txt", "md", "markdown", "rst", "adoc", "html", "htm", "rtf", NULL };
+    for (int i = 0; docs[i]; i++) {
+        if (strcasecmp(ext, docs[i]) == 0) return 1;
+    }
+    size_t digits = 0, upper = 0, len = strlen(ext);
+    for (const char *p = ext; *p; p++) {
+        digits += *p >= '0' && *p <= '9';
+        upper += *p >= 'A' && *p <= 'Z';
+    }
+    return len > 0 && (digits == len || (len >= 2 && digits + upper == len));
+}
+
+int scan_is_license_file(const char *name) {
+    static const char *const stems[] = { "LICENSE", "LICENCE", "COPYING", "UNLICENSE", NULL };
+    for (int i = 0; stems[i]; i++) {
+        size_t n = strlen(stems[i]);
+        if (strncasecmp(name, stems[i], n) != 0) continue;
+        const char *rest = name + n;
+        if (*rest == '\0') return 1;
+        if (*rest != '.' && *rest != '-' && *rest != '_') return 0;
+        /* LICENSE-MIT and LICENSE_APACHE name the license; a last extension must fit */
+        const char *dot = strrchr(rest, '.');
+        return !dot || is_license_extension(dot + 1);
+    }
+    return 0;
+}
+
+int scan_find_spdx(const char *text, size_t len, char *id, size_t id_size) {
+    static const char tag[] = "SPDX-License-Identifier:";
+    const char *hit = memmem(text, len, tag, sizeof(tag) - 1);
+    if (!hit) return 0;
+    const char *p = hit + sizeof(tag) - 1, *end = text + len;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    /* The expression runs to the end of the line or a closing comment marker */
+    const char *q = p;
+    while (q < end && *q != '\n' && *q != '\r' && !(q + 1 < end && q[0] == '*' && q[1] == '/') &&
+           !(q + 2 < end && q[0] == '-' && q[1] == '-' && q[2] == '>')) {
+        q++;
+    }
+    while (q > p && isspace((unsigned char)q[-1])) q--;
+    if (q == p || id_size == 0) return 0;
+    size_t n = (size_t)(q - p) < id_size - 1 ? (size_t)(q - p) : id_size - 1;
+    memcpy(id, p, n);
+    id[n] = '\0';
+    return 1;
+}
+
+static int has_copyright(const char *text, size_t len) {
+    return memmem(text, len, "Copyright", 9) || memmem(text, len, "copyright", 9) ||
+           memmem(text, len, "COPYRIGHT", 9) || memmem(text, len, "\xc2\xa9", 2);
+}
+
+/* Returns the SPDX id of license, from the built-in table or the data
+ * directory's metadata (copied into buf), or license itself if it has none.
+ */
+static const char *spdx_of(const ScanCtx *sc, const char *license, char *buf, size_t size) {
+    const char *spdx = license_spdx_id(license);
+    if (spdx) return spdx;
+    LicenseInfo info;
+    if (db_license_info(sc->db, license, &info) == 0 && info.spdx[0]) {
+        snprintf(buf, size, "%s", info.spdx);
+        return buf;
+    }
+    return license;
+}
+
+/* Identifies a license file: a LICENSE-<alias> suffix, an SPDX tag, then its text. */
+static const char *identify_license_file(ScanCtx *sc, const char *dir, const char *name,
+                                         char *spdx_buf, size_t spdx_size) {
+    const char *suffix = strpbrk(name, "-_");
+    if (suffix) {
+        char alias[64];
+        snprintf(alias, sizeof(alias), "%.63s", suffix + 1);
+        char *dot = strrchr(alias, '.');
+        if (dot) *dot = '\0';
+        const char *lic = license_from_spdx(alias);
+        if (lic) return license_spdx_id(lic) ? license_spdx_id(lic) : lic;
+        /* An SPDX id or alias only the data directory knows */
+        char full[64];
+        LicenseInfo info;
+        if (db_resolve_alias(sc->db, alias, full, sizeof(full)) == 0 &&
+            db_license_info(sc->db, full, &info) == 0 && info.spdx[0]) {
+            snprintf(spdx_buf, spdx_size, "%s", info.spdx);
+            return spdx_buf;
+        }
+    }
+    char *buf = malloc(LICENSE_READ_MAX);
+    if (!buf) return NULL;
+    long n = walk_read_head(dir, name, buf, LICENSE_READ_MAX);
+    const char *result = NULL;
+    if (n > 0 && scan_find_spdx(buf, (size_t)n, spdx_buf, spdx_size)) {
+        result = spdx_buf;
+    } else if (n > 0 && sc->det) {
+        DetectMatch match;
+        if (detector_identify(sc->det, buf, (size_t)n, &match) == 0 && match.license && match.confidence >= 0.5) {
+            result = spdx_of(sc, match.license, spdx_buf, spdx_size);
+        }
+    }
+    free(buf);
+    return result;
+}
+
+typedef struct {
+    char id[64];
+    size_t count;
+} IdCount;
+
+static void tally(IdCount *ids, size_t *n, const char *id) {
+    for (size_t i = 0; i < *n; i++) {
+        if (strcmp(ids[i].id, id) == 0) {
+            ids[i].count++;
+            return;
+        }
+    }
+    if (*n >= MAX_DIR_IDS) id = "(other)";
+    for (size_t i = 0; i < *n; i++) {
+        if (strcmp(ids[i].id, id) == 0) {
+            ids[i].count++;
+            return;
+        }
+    }
+    snprintf(ids[*n].id, sizeof(ids[*n].id), "%.63s", id);
+    ids[*n].count = 1;
+    (*n)++;
+}
+
+static const void *scan_visit(const char *dir, const WalkEntry *files, size_t count,
+                              const void *inherited, void *ctx) {
+    ScanCtx *sc = ctx;
+    IdCount ids[MAX_DIR_IDS + 1];
+    size_t n_ids = 0, sources = 0, missing_copyright = 0;
+    StrBuf missing = {0};
+    StrBuf own = {0};
+    char head[SCAN_HEAD_SIZE];
+    char spdx[128];
+
+    atomic_fetch_add(&sc->dirs, 1);
+    for (size_t i = 0; i < count; i++) {
+        const char *name = files[i].name;
+        if (scan_is_license_file(name)) {
+            const char *lic = identify_license_file(sc, dir, name, spdx, sizeof(spdx));
+            char item[512];
+            snprintf(item, sizeof(item), "%s%s (%s/%s)", own.len ? ", " : "", lic ? lic : "unrecognized", dir, name);
+            sb_append_str(&own, item);
+            atomic_fetch_add(&sc->license_files, 1);
+            continue;
+        }
+        if (!scan_is_source_file(name)) continue;
+        sources++;
+        long n = walk_read_head(dir, name, head, sizeof(head));
+        if (n < 0) continue;
+        if (scan_find_spdx(head, (size_t)n, spdx, sizeof(spdx))) {
+            tally(ids, &n_ids, spdx);
+        } else {
+            sb_append_str(&missing, "    missing header: ");
+            sb_append_str(&missing, name);
+            sb_append(&missing, "\n", 1);
+        }
+        if (!has_copyright(head, (size_t)n)) missing_copyright++;
+    }
+
+    /* The label lives on for the subdirectories; scan_release frees it after them */
+    const char *applies = inherited;
+    if (own.len) {
+        char *label = strdup(own.data);
+        if (label) applies = label;
+    }
+
+    if (sources > 0 || own.len) {
+        size_t missing_spdx = sources;
+        for (size_t i = 0; i < n_ids; i++) missing_spdx -= ids[i].count;
+        atomic_fetch_add(&sc->sources, sources);
+        atomic_fetch_add(&sc->missing_spdx, missing_spdx);
+        atomic_fetch_add(&sc->missing_copyright, missing_copyright);
+
+        StrBuf out = {0};
+        char line[256];
+        sb_append_str(&out, dir);
+        snprintf(line, sizeof(line), ": %zu source files, %zu without SPDX header, %zu without copyright\n",
+                 sources, missing_spdx, missing_copyright);
+        sb_append_str(&out, line);
+        if (n_ids) {
+            sb_append_str(&out, "    SPDX:");
+            for (size_t i = 0; i < n_ids; i++) {
+                sb_append_str(&out, i ? ", " : " ");
+                sb_append_str(&out, ids[i].id);
+                snprintf(line, sizeof(line), " (%zu)", ids[i].count);
+                sb_append_str(&out, line);
+            }
+            sb_append(&out, "\n", 1);
+        }
+        sb_append_str(&out, "    applies: ");
+        sb_append_str(&out, applies ? (const char *)applies : "none found");
+        sb_append(&out, "\n", 1);
+        if (missing.len) sb_append(&out, missing.data, missing.len);
+        pthread_mutex_lock(&sc->lock);
+        fwrite(out.data, 1, out.len, stdout);
+        pthread_mutex_unlock(&sc->lock);
+        sb_free(&out);
+    }
+    sb_free(&missing);
+    sb_free(&own);
+    return applies;
+}
+
+/* Frees a directory's label once the last subdirectory inheriting it is done. */
+static void scan_release(const void *label, void *ctx) {
+    (void)ctx;
+    free((void *)label);
+}
+
+int run_scan(const char *root, const Database *db, const Config *config, int threads) {
+    ScanCtx sc;
+    memset(&sc, 0, sizeof(sc));
+    sc.db = db;
+    pthread_mutex_init(&sc.lock, NULL);
+    atomic_init(&sc.dirs, 0);
+    atomic_init(&sc.sources, 0);
+    atomic_init(&sc.missing_spdx, 0);
+    atomic_init(&sc.missing_copyright, 0);
+    atomic_init(&sc.license_files, 0);
+
+    Detector det;
+    if (detector_open(&det, db, config) == 0) {
+        sc.det = &det;
+    } else {
+        print_error("License fingerprints unavailable; license files are identified by SPDX tag only");
+    }
+
+    int rc = walk_tree(root, threads, scan_visit, scan_release, &sc);
+    if (rc < 0) {
+        char errmsg[512];
+        snprintf(errmsg, sizeof(errmsg), "Unable to scan directory '%s'", root);
+        print_error(errmsg);
+    } else {
+        printf("Scanned %zu directories: %zu source files, %zu without SPDX header, "
+               "%zu without copyright, %zu license files.\n",
+               atomic_load(&sc.dirs), atomic_load(&sc.sources), atomic_load(&sc.missing_spdx),
+               atomic_load(&sc.missing_copyright), atomic_load(&sc.license_files));
+        rc = rc > 0 || atomic_load(&sc.missing_spdx) ? 1 : 0;
+    }
+    if (sc.det) detector_close(&det);
+    pthread_mutex_destroy(&sc.lock);
+    return rc;
+}
@@ -0,0 +1,39 @@
+/* File: src/scan.h
+ *
+ * Header for the source-tree license scanner.
+ *
+ * Walks a tree in parallel, reads only the head of each source file to pick out
+ * SPDX-License-Identifier tags and copyright lines, identifies LICENSE/COPYING
+ * files, and prints a summary per directory of the licenses that apply and the
+ * files that lack a header.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "config.h"
+#include "db.h"
+
+/* Bytes read from the start of each source file */
+#define SCAN_HEAD_SIZE 4096
+
+/* Scans the tree at root on up to threads workers (threads <= 0 means one per CPU).
+ * Returns 0 if every source file carries an SPDX header, 1 if some do not,
+ * -1 if root cannot be scanned.
+ */
+int run_scan(const char *root, const Database *db, const Config *config, int threads);
+
+/* Finds an SPDX-License-Identifier tag in text and copies its expression into id.
+ * Returns 1 if found, 0 otherwise.
+ */
+int scan_find_spdx(const char *text, size_t len, char *id, size_t id_size);
+
+/* Returns 1 if name looks like a license file (LICENSE, COPYING, LICENSE-MIT,
+ * LICENSE.md, COPYING.LIB, ...); license.c or license.o do not.
+ */
+int scan_is_license_file(const char *name);
+
+/* Returns 1 if name has an extension of a source file that should carry a header. */
+int scan_is_source_file(const char *name);
+
+#endif /* SCAN_H */
@@ -0,0 +1,798 @@
+/* File: src/search.c
+ *
+ * Implementation of the full-text search index.
+ *
+ * Building tokenizes each document (description followed by license text) into
+ * lowercase alphanumeric terms, accumulates positional postings in a hash table
+ * and collects the distinct lowercase trigrams of each document. The result is
+ * serialized into one image laid out like the bundle (header, fixed-size
+ * arrays, a uint32 word area and a string area) and mmap'ed for queries.
+ */
+
+#define _GNU_SOURCE
+
+#include "search.h"
+#include "cache.h"
+#include "utils.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_TERM_LEN 32
+#define MAX_QUERY_TERMS 16
+#define BM25_K1 1.2
+#define BM25_B 0.75
+#define PHRASE_BONUS 1.5
+#define NAME_BONUS 2.0
+
+/* ---- tokenizer ---- */
+
+/* Finds the next term at or after *pos. Copies it lowercased into term and
+ * returns its length (0 at end of text); *start receives its byte offset.
+ */
+static size_t next_term(const char *text, size_t len, size_t *pos, char term[MAX_TERM_LEN + 1], size_t *start) {
+    size_t i = *pos;
+    while (i < len && !isalnum((unsigned char)text[i])) i++;
+    if (i >= len) {
+        *pos = len;
+        return 0;
+    }
+    *start = i;
+    size_t n = 0;
+    while (i < len && isalnum((unsigned char)text[i])) {
+        if (n < MAX_TERM_LEN) {
+            term[n++] = (char)tolower((unsigned char)text[i]);
+        }
+        i++;
+    }
+    term[n] = '\0';
+    *pos = i;
+    return n;
+}
+
+/* Case-insensitive search for needle (already lowercase) in hay. */
+static const char *casefind(const char *hay, size_t hay_len, const char *needle, size_t needle_len) {
+    if (needle_len == 0 || needle_len > hay_len) return NULL;
+    int first_lo = (unsigned char)needle[0];
+    int first_up = toupper(first_lo);
+    const char *end = hay + hay_len - needle_len + 1;
+    for (const char *p = hay; p < end; p++) {
+        if ((unsigned char)*p != first_lo && (unsigned char)*p != first_up) continue;
+        if (strncasecmp(p, needle, needle_len) == 0) return p;
+    }
+    return NULL;
+}
+
+/* Trigram keys are three bytes */
+#define TRIGRAM_KEYS (1u << 24)
+
+static uint32_t trigram_key(const char *p) {
+    return ((uint32_t)tolower((unsigned char)p[0]) << 16) |
+           ((uint32_t)tolower((unsigned char)p[1]) << 8) |
+           (uint32_t)tolower((unsigned char)p[2]);
+}
+
+/* ---- builder ---- */
+
+typedef struct {
+    uint32_t doc, pos, off;
+} Occurrence;
+
+typedef struct {
+    char *term;
+    uint32_t len;
+    Occurrence *occ;
+    size_t count, cap;
+} TermAcc;
+
+typedef struct {
+    TermAcc *slots;
+    size_t cap, used;
+} TermTable;
+
+typedef struct {
+    char *name;
+    char *text;
+    size_t len;
+    size_t desc_len;
+    uint32_t tokens;
+} BuildDoc;
+
+typedef struct {
+    BuildDoc *docs;
+    size_t count, cap;
+    const Database *db;
+} DocList;
+
+typedef struct {
+    uint32_t key, doc;
+} KeyDoc;
+
+typedef struct {
+    uint32_t *data;
+    size_t count, cap;
+} WordVec;
+
+static int words_push(WordVec *w, uint32_t v) {
+    if (w->count == w->cap) {
+        size_t cap = w->cap ? w->cap * 2 : 4096;
+        uint32_t *grown = realloc(w->data, cap * sizeof(*grown));
+        if (!grown) return -1;
+        w->data = grown;
+        w->cap = cap;
+    }
+    w->data[w->count++] = v;
+    return 0;
+}
+
+static TermAcc *term_lookup(TermTable *t, const char *term, size_t len) {
+    if ((t->used + 1) * 2 > t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 4096;
+        TermAcc *slots = calloc(cap, sizeof(*slots));
+        if (!slots) return NULL;
+        for (size_t i = 0; i < t->cap; i++) {
+            if (!t->slots[i].term) continue;
+            size_t j = (size_t)hash_casefold(t->slots[i].term, t->slots[i].len) & (cap - 1);
+            while (slots[j].term) j = (j + 1) & (cap - 1);
+            slots[j] = t->slots[i];
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->cap = cap;
+    }
+    size_t j = (size_t)hash_casefold(term, len) & (t->cap - 1);
+    while (t->slots[j].term) {
+        if (t->slots[j].len == len && memcmp(t->slots[j].term, term, len) == 0) {
+            return &t->slots[j];
+        }
+        j = (j + 1) & (t->cap - 1);
+    }
+    t->slots[j].term = strndup(term, len);
+    if (!t->slots[j].term) return NULL;
+    t->slots[j].len = (uint32_t)len;
+    t->used++;
+    return &t->slots[j];
+}
+
+static int collect_doc(const char *name, void *ctx) {
+    DocList *list = ctx;
+    DbText lic, desc;
+    if (db_get(list->db, DB_LICENSE, name, &lic) != 0) {
+        return 0;
+    }
+    int has_desc = db_get(list->db, DB_DESCRIPTION, name, &desc) == 0;
+    size_t desc_len = has_desc ? desc.len : 0;
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        BuildDoc *grown = realloc(list->docs, cap * sizeof(*grown));
+        if (!grown) goto fail;
+        list->docs = grown;
+        list->cap = cap;
+    }
+    BuildDoc *d = &list->docs[list->count];
+    d->name = strdup(name);
+    d->len = desc_len + (has_desc ? 2 : 0) + lic.len;
+    d->text = malloc(d->len + 1);
+    if (!d->name || !d->text) {
+        free(d->name);
+        free(d->text);
+        goto fail;
+    }
+    size_t off = 0;
+    if (has_desc) {
+        memcpy(d->text, desc.data, desc.len);
+        memcpy(d->text + desc.len, "\n\n", 2);
+        off = desc.len + 2;
+    }
+    memcpy(d->text + off, lic.data, lic.len);
+    d->text[d->len] = '\0';
+    d->desc_len = desc_len;
+    d->tokens = 0;
+    list->count++;
+fail:
+    if (has_desc) db_text_release(&desc);
+    db_text_release(&lic);
+    return 0;
+}
+
+/* Sorts pairs by key with two stable 12-bit counting passes. Pairs are
+ * pushed in document order, so documents stay ascending within a key.
+ */
+static int sort_pairs(KeyDoc *pairs, size_t count) {
+    KeyDoc *tmp = malloc((count ? count : 1) * sizeof(*tmp));
+    size_t *counts = malloc(4096 * sizeof(*counts));
+    if (!tmp || !counts) {
+        free(tmp);
+        free(counts);
+        return -1;
+    }
+    KeyDoc *from = pairs, *to = tmp;
+    for (int shift = 0; shift < 24; shift += 12) {
+        memset(counts, 0, 4096 * sizeof(*counts));
+        for (size_t i = 0; i < count; i++) counts[(from[i].key >> shift) & 4095]++;
+        size_t sum = 0;
+        for (size_t b = 0; b < 4096; b++) {
+            size_t c = counts[b];
+            counts[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < count; i++) to[counts[(from[i].key >> shift) & 4095]++] = from[i];
+        KeyDoc *swap = from;
+        from = to;
+        to = swap;
+    }
+    /* An even number of passes leaves the result in pairs */
+    free(tmp);
+    free(counts);
+    return 0;
+}
+
+static int compare_term_ptr(const void *a, const void *b) {
+    const TermAcc *x = *(TermAcc *const *)a, *y = *(TermAcc *const *)b;
+    return strcmp(x->term, y->term);
+}
+
+static void pad8(StrBuf *sb) {
+    static const char zeros[8] = {0};
+    if (sb->len % 8) sb_append(sb, zeros, 8 - sb->len % 8);
+}
+
+/* Builds the serialized index image into out. */
+static int build_image(const Database *db, StrBuf *out) {
+    DocList list = { NULL, 0, 0, db };
+    TermTable terms = {0};
+    KeyDoc *pairs = NULL;
+    size_t pair_count = 0, pair_cap = 0;
+    WordVec words = {0};
+    StrBuf strings = {0};
+    TermAcc **sorted = NULL;
+    IndexTrigram *tris = NULL;
+    size_t tri_count = 0;
+    uint64_t *seen = NULL;
+    int rc = -1;
+    uint64_t total_tokens = 0;
+
+    if (db_each(db, DB_LICENSE, collect_doc, &list) != 0) goto out;
+    seen = calloc(TRIGRAM_KEYS / 64, sizeof(*seen));
+    if (!seen) goto out;
+
+    for (size_t d = 0; d < list.count; d++) {
+        BuildDoc *doc = &list.docs[d];
+        size_t pos = 0, start;
+        char term[MAX_TERM_LEN + 1];
+        size_t n;
+        while ((n = next_term(doc->text, doc->len, &pos, term, &start)) > 0) {
+            TermAcc *acc = term_lookup(&terms, term, n);
+            if (!acc) goto out;
+            if (acc->count == acc->cap) {
+                size_t cap = acc->cap ? acc->cap * 2 : 4;
+                Occurrence *grown = realloc(acc->occ, cap * sizeof(*grown));
+                if (!grown) goto out;
+                acc->occ = grown;
+                acc->cap = cap;
+            }
+            acc->occ[acc->count++] = (Occurrence){ (uint32_t)d, doc->tokens++, (uint32_t)start };
+        }
+        total_tokens += doc->tokens;
+
+        /* Distinct trigrams of this document, found with a bit per key; the
+         * bits set are cleared from the pairs again before the next one */
+        size_t first = pair_count;
+        for (size_t i = 0; i + 3 <= doc->len; i++) {
+            uint32_t key = trigram_key(doc->text + i);
+            uint64_t bit = 1ULL << (key & 63);
+            if (seen[key >> 6] & bit) continue;
+            seen[key >> 6] |= bit;
+            if (pair_count == pair_cap) {
+                size_t cap = pair_cap ? pair_cap * 2 : 65536;
+                KeyDoc *grown = realloc(pairs, cap * sizeof(*grown));
+                if (!grown) goto out;
+                pairs = grown;
+                pair_cap = cap;
+            }
+            pairs[pair_count++] = (KeyDoc){ key, (uint32_t)d };
+        }
+        for (size_t i = first; i < pair_count; i++) seen[pairs[i].key >> 6] = 0;
+    }
+
+    /* Strings: document names and texts first, then terms */
+    IndexDoc *docs = calloc(list.count ? list.count : 1, sizeof(*docs));
+    if (!docs) goto out;
+    for (size_t d = 0; d < list.count; d++) {
+        docs[d].name_off = (uint32_t)strings.len;
+        docs[d].name_len = (uint32_t)strlen(list.docs[d].name);
+        sb_append(&strings, list.docs[d].name, docs[d].name_len + 1);
+        docs[d].text_off = (uint32_t)strings.len;
+        docs[d].text_len = (uint32_t)list.docs[d].len;
+        docs[d].token_count = list.docs[d].tokens;
+        docs[d].desc_len = (uint32_t)list.docs[d].desc_len;
+        if (sb_append(&strings, list.docs[d].text, list.docs[d].len + 1) != 0) {
+            free(docs);
+            goto out;
+        }
+    }
+
+    sorted = malloc((terms.used ? terms.used : 1) * sizeof(*sorted));
+    IndexTerm *iterms = calloc(terms.used ? terms.used : 1, sizeof(*iterms));
+    if (!sorted || !iterms) {
+        free(docs);
+        free(iterms);
+        goto out;
+    }
+    size_t term_count = 0;
+    for (size_t i = 0; i < terms.cap; i++) {
+        if (terms.slots[i].term) sorted[term_count++] = &terms.slots[i];
+    }
+    qsort(sorted, term_count, sizeof(*sorted), compare_term_ptr);
+    for (size_t t = 0; t < term_count; t++) {
+        TermAcc *acc = sorted[t];
+        iterms[t].str_off = (uint32_t)strings.len;
+        iterms[t].str_len = acc->len;
+        sb_append(&strings, acc->term, acc->len + 1);
+        iterms[t].post_off = (uint32_t)words.count;
+        /* Occurrences are in document order; group them per document */
+        size_t i = 0;
+        while (i < acc->count) {
+            size_t j = i;
+            while (j < acc->count && acc->occ[j].doc == acc->occ[i].doc) j++;
+            words_push(&words, acc->occ[i].doc);
+            words_push(&words, (uint32_t)(j - i));
+            for (size_t k = i; k < j; k++) {
+                words_push(&words, acc->occ[k].pos);
+                words_push(&words, acc->occ[k].off);
+            }
+            iterms[t].df++;
+            i = j;
+        }
+    }
+
+    tris = malloc((pair_count ? pair_count : 1) * sizeof(*tris));
+    if (!tris || sort_pairs(pairs, pair_count) != 0) {
+        free(docs);
+        free(iterms);
+        goto out;
+    }
+    for (size_t i = 0; i < pair_count;) {
+        size_t j = i;
+        tris[tri_count].key = pairs[i].key;
+        tris[tri_count].list_off = (uint32_t)words.count;
+        while (j < pair_count && pairs[j].key == pairs[i].key) {
+            words_push(&words, pairs[j].doc);
+            j++;
+        }
+        tris[tri_count].count = (uint32_t)(j - i);
+        tri_count++;
+        i = j;
+    }
+
+    IndexHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SEARCH_INDEX_MAGIC, sizeof(SEARCH_INDEX_MAGIC));
+    h.version = SEARCH_INDEX_VERSION;
+    h.doc_count = (uint32_t)list.count;
+    h.stamp = db_stamp(db);
+    h.term_count = (uint32_t)term_count;
+    h.trigram_count = (uint32_t)tri_count;
+    h.total_tokens = total_tokens;
+
+    sb_append(out, (const char *)&h, sizeof(h));
+    pad8(out);
+    h.docs_off = out->len;
+    sb_append(out, (const char *)docs, list.count * sizeof(*docs));
+    pad8(out);
+    h.terms_off = out->len;
+    sb_append(out, (const char *)iterms, term_count * sizeof(*iterms));
+    pad8(out);
+    h.trigrams_off = out->len;
+    sb_append(out, (const char *)tris, tri_count * sizeof(*tris));
+    pad8(out);
+    h.words_off = out->len;
+    sb_append(out, (const char *)words.data, words.count * sizeof(*words.data));
+    pad8(out);
+    h.strings_off = out->len;
+    if (sb_append(out, strings.data ? strings.data : "", strings.len) != 0) {
+        free(docs);
+        free(iterms);
+        goto out;
+    }
+    h.total_size = out->len;
+    memcpy(out->data, &h, sizeof(h));
+    free(docs);
+    free(iterms);
+    rc = 0;
+
+out:
+    for (size_t d = 0; d < list.count; d++) {
+        free(list.docs[d].name);
+        free(list.docs[d].text);
+    }
+    free(list.docs);
+    for (size_t i = 0; i < terms.cap; i++) {
+        free(terms.slots[i].term);
+        free(terms.slots[i].occ);
+    }
+    free(terms.slots);
+    free(pairs);
+    free(seen);
+    free(words.data);
+    sb_free(&strings);
+    free(sorted);
+    free(tris);
+    return rc;
+}
+
+int search_index_build(const Database *db, const char *path) {
+    StrBuf image = {0};
+    int rc = build_image(db, &image) == 0 ? cache_write(path, image.data, image.len) : -1;
+    sb_free(&image);
+    return rc;
+}
+
+/* ---- reader ---- */
+
+static int index_attach(SearchIndex *idx, const unsigned char *base, size_t size) {
+    const IndexHeader *h = (const IndexHeader *)base;
+    if (size < sizeof(*h) || memcmp(h->magic, SEARCH_INDEX_MAGIC, sizeof(SEARCH_INDEX_MAGIC)) != 0 ||
+        h->version != SEARCH_INDEX_VERSION || h->total_size != size ||
+        ((h->docs_off | h->terms_off | h->trigrams_off | h->words_off) & 3) != 0 ||
+        h->docs_off + (uint64_t)h->doc_count * sizeof(IndexDoc) > size ||
+        h->terms_off + (uint64_t)h->term_count * sizeof(IndexTerm) > size ||
+        h->trigrams_off + (uint64_t)h->trigram_count * sizeof(IndexTrigram) > size ||
+        h->words_off > h->strings_off || h->strings_off > size) {
+        return -1;
+    }
+    const IndexDoc *docs = (const IndexDoc *)(base + h->docs_off);
+    const IndexTerm *terms = (const IndexTerm *)(base + h->terms_off);
+    const IndexTrigram *trigrams = (const IndexTrigram *)(base + h->trigrams_off);
+    const uint32_t *words = (const uint32_t *)(base + h->words_off);
+    const char *strings = (const char *)(base + h->strings_off);
+    uint64_t words_len = (h->strings_off - h->words_off) / sizeof(uint32_t);
+    uint64_t strings_len = size - h->strings_off;
+    /* Names and texts are read as C strings too: each must end in a NUL */
+    for (uint32_t d = 0; d < h->doc_count; d++) {
+        const IndexDoc *doc = &docs[d];
+        if ((uint64_t)doc->name_off + doc->name_len >= strings_len || strings[doc->name_off + doc->name_len] != '\0' ||
+            (uint64_t)doc->text_off + doc->text_len >= strings_len || strings[doc->text_off + doc->text_len] != '\0' ||
+            doc->desc_len > doc->text_len) {
+            return -1;
+        }
+    }
+    for (uint32_t t = 0; t < h->term_count; t++) {
+        if ((uint64_t)terms[t].str_off + terms[t].str_len > strings_len || terms[t].post_off > words_len) return -1;
+    }
+    for (uint32_t t = 0; t < h->trigram_count; t++) {
+        if ((uint64_t)trigrams[t].list_off + trigrams[t].count > words_len) return -1;
+    }
+    /* The lists in the word area are checked when a query looks them up */
+    idx->base = base;
+    idx->size = size;
+    idx->header = h;
+    idx->docs = docs;
+    idx->terms = terms;
+    idx->trigrams = trigrams;
+    idx->words = words;
+    idx->strings = strings;
+    return 0;
+}
+
+static int index_map(SearchIndex *idx, const char *path) {
+    const unsigned char *base;
+    size_t size;
+    if (cache_map(path, &base, &size) != 0) return -1;
+    if (index_attach(idx, base, size) != 0) {
+        cache_unmap(base, size);
+        return -1;
+    }
+    return 0;
+}
+
+int search_index_open(SearchIndex *idx, const Database *db) {
+    memset(idx, 0, sizeof(*idx));
+    uint64_t stamp = db_stamp(db);
+    char path[600];
+    /* The embedded database is indexed in memory: a run does no file I/O for it */
+    int have_path = db->backend != DB_BACKEND_EMBEDDED &&
+                    cache_path("search", db->datadir, "idx", path, sizeof(path)) == 0;
+    if (have_path) {
+        if (index_map(idx, path) == 0) {
+            if (idx->header->stamp == stamp) {
+                return 0;
+            }
+            search_index_close(idx);
+        }
+        if (search_index_build(db, path) == 0 && index_map(idx, path) == 0) {
+            return 0;
+        }
+    }
+    /* No usable cache: keep the image in memory for this run */
+    StrBuf image = {0};
+    if (build_image(db, &image) != 0 || index_attach(idx, (const unsigned char *)image.data, image.len) != 0) {
+        sb_free(&image);
+        return -1;
+    }
+    idx->heap = image.data;
+    return 0;
+}
+
+void search_index_close(SearchIndex *idx) {
+    if (idx->heap) {
+        free(idx->heap);
+    } else {
+        cache_unmap(idx->base, idx->size);
+    }
+    memset(idx, 0, sizeof(*idx));
+}
+
+const char *search_doc_name(const SearchIndex *idx, uint32_t doc, size_t *len) {
+    if (len) *len = idx->docs[doc].name_len;
+    return idx->strings + idx->docs[doc].name_off;
+}
+
+const char *search_doc_text(const SearchIndex *idx, uint32_t doc, size_t *len) {
+    if (len) *len = idx->docs[doc].text_len;
+    return idx->strings + idx->docs[doc].text_off;
+}
+
+static uint64_t word_count(const SearchIndex *idx) {
+    return (idx->header->strings_off - idx->header->words_off) / sizeof(uint32_t);
+}
+
+/* Checks that the postings of t stay inside the word area and name valid
+ * documents and byte offsets inside their texts. Returns 0 if so.
+ */
+static int postings_valid(const SearchIndex *idx, const IndexTerm *t) {
+    uint64_t words = word_count(idx), at = t->post_off;
+    for (uint32_t i = 0; i < t->df; i++) {
+        if (at + 2 > words) return -1;
+        uint32_t doc = idx->words[at], tf = idx->words[at + 1];
+        if (doc >= idx->header->doc_count || tf == 0 || at + 2 + 2 * (uint64_t)tf > words) return -1;
+        for (uint32_t k = 0; k < tf; k++) {
+            if (idx->words[at + 3 + 2 * (uint64_t)k] > idx->docs[doc].text_len) return -1;
+        }
+        at += 2 + 2 * (uint64_t)tf;
+    }
+    return 0;
+}
+
+/* Finds term in the vocabulary; a term with corrupt postings is not found. */
+static const IndexTerm *find_term(const SearchIndex *idx, const char *term, size_t len) {
+    uint32_t lo = 0, hi = idx->header->term_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const IndexTerm *t = &idx->terms[mid];
+        size_t n = t->str_len < len ? t->str_len : len;
+        int cmp = memcmp(idx->strings + t->str_off, term, n);
+        if (cmp == 0) cmp = t->str_len < len ? -1 : (t->str_len > len);
+        if (cmp == 0) return postings_valid(idx, t) == 0 ? t : NULL;
+        if (cmp < 0) lo = mid + 1; else hi = mid;
+    }
+    return NULL;
+}
+
+/* Checks that the document ids of a trigram's list are valid. Returns 0 if so. */
+static int trigram_valid(const SearchIndex *idx, const IndexTrigram *t) {
+    for (uint32_t c = 0; c < t->count; c++) {
+        if (idx->words[t->list_off + c] >= idx->header->doc_count) return -1;
+    }
+    return 0;
+}
+
+/* Finds the document list of key; a corrupt list counts as no match. */
+static const IndexTrigram *find_trigram(const SearchIndex *idx, uint32_t key) {
+    uint32_t lo = 0, hi = idx->header->trigram_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (idx->trigrams[mid].key == key) return trigram_valid(idx, &idx->trigrams[mid]) == 0 ? &idx->trigrams[mid] : NULL;
+        if (idx->trigrams[mid].key < key) lo = mid + 1; else hi = mid;
+    }
+    return NULL;
+}
+
+static int list_contains(const uint32_t *list, uint32_t count, uint32_t doc) {
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (list[mid] == doc) return 1;
+        if (list[mid] < doc) lo = mid + 1; else hi = mid;
+    }
+    return 0;
+}
+
+static double bm25(const SearchIndex *idx, uint32_t df, uint32_t tf, uint32_t doc) {
+    double n = idx->header->doc_count;
+    double avgdl = n > 0 ? (double)idx->header->total_tokens / n : 1.0;
+    double dl = idx->docs[doc].token_count;
+    double idf = log((n - df + 0.5) / (df + 0.5) + 1.0);
+    return idf * (tf * (BM25_K1 + 1.0)) / (tf + BM25_K1 * (1.0 - BM25_B + BM25_B * dl / (avgdl > 0 ? avgdl : 1.0)));
+}
+
+typedef struct {
+    double *score;
+    uint32_t *hit_off;
+    uint32_t *hit_len;
+} Scores;
+
+static void note_hit(Scores *s, uint32_t doc, uint32_t off, uint32_t len) {
+    if (s->hit_len[doc] == 0) {
+        s->hit_off[doc] = off;
+        s->hit_len[doc] = len;
+    }
+}
+
+/* Scores a term found in the vocabulary. */
+static void score_term(const SearchIndex *idx, const IndexTerm *t, Scores *s) {
+    const uint32_t *w = idx->words + t->post_off;
+    for (uint32_t i = 0; i < t->df; i++) {
+        uint32_t doc = w[0], tf = w[1];
+        s->score[doc] += bm25(idx, t->df, tf, doc);
+        note_hit(s, doc, w[3], t->str_len);
+        w += 2 + 2 * tf;
+    }
+}
+
+/* Scores a term not in the vocabulary as a case-insensitive substring. */
+static void score_substring(const SearchIndex *idx, const char *needle, size_t len, Scores *s) {
+    uint32_t n_docs = idx->header->doc_count;
+    uint32_t *tf = calloc(n_docs ? n_docs : 1, sizeof(*tf));
+    uint32_t *first = calloc(n_docs ? n_docs : 1, sizeof(*first));
+    if (!tf || !first) {
+        free(tf);
+        free(first);
+        return;
+    }
+    /* Candidates: documents holding every trigram of the needle */
+    const IndexTrigram *rarest = NULL;
+    int impossible = 0;
+    if (len >= 3) {
+        for (size_t i = 0; i + 3 <= len; i++) {
+            const IndexTrigram *t = find_trigram(idx, trigram_key(needle + i));
+            if (!t) {
+                impossible = 1;
+                break;
+            }
+            if (!rarest || t->count < rarest->count) rarest = t;
+        }
+    }
+    uint32_t df = 0;
+    uint32_t cand_count = rarest ? rarest->count : n_docs;
+    for (uint32_t c = 0; !impossible && c < cand_count; c++) {
+        uint32_t doc = rarest ? idx->words[rarest->list_off + c] : c;
+        int ok = 1;
+        for (size_t i = 0; ok && rarest && i + 3 <= len; i++) {
+            const IndexTrigram *t = find_trigram(idx, trigram_key(needle + i));
+            ok = t == rarest || list_contains(idx->words + t->list_off, t->count, doc);
+        }
+        if (!ok) continue;
+        size_t text_len;
+        const char *text = search_doc_text(idx, doc, &text_len);
+        const char *p = text, *hit;
+        while ((hit = casefind(p, text_len - (size_t)(p - text), needle, len)) != NULL) {
+            if (tf[doc]++ == 0) first[doc] = (uint32_t)(hit - text);
+            p = hit + len;
+        }
+        if (tf[doc]) df++;
+    }
+    for (uint32_t doc = 0; doc < n_docs; doc++) {
+        if (!tf[doc]) continue;
+        s->score[doc] += bm25(idx, df, tf[doc], doc);
+        note_hit(s, doc, first[doc], (uint32_t)len);
+    }
+    free(tf);
+    free(first);
+}
+
+/* Adds a bonus for each place two consecutive query terms appear adjacently. */
+static void score_phrase(const SearchIndex *idx, const IndexTerm *a, const IndexTerm *b, Scores *s) {
+    const uint32_t *wa = idx->words + a->post_off;
+    const uint32_t *wb = idx->words + b->post_off;
+    uint32_t ia = 0, ib = 0;
+    while (ia < a->df && ib < b->df) {
+        uint32_t da = wa[0], db_ = wb[0];
+        if (da < db_) {
+            wa += 2 + 2 * wa[1];
+            ia++;
+        } else if (db_ < da) {
+            wb += 2 + 2 * wb[1];
+            ib++;
+        } else {
+            uint32_t ta = wa[1], tb = wb[1], x = 0, y = 0, adjacent = 0;
+            while (x < ta && y < tb) {
+                uint32_t pa = wa[2 + 2 * x], pb = wb[2 + 2 * y];
+                if (pa + 1 == pb) {
+                    if (adjacent++ == 0) {
+                        /* Prefer the phrase as the snippet anchor */
+                        s->hit_off[da] = wa[3 + 2 * x];
+                        s->hit_len[da] = wb[3 + 2 * y] + b->str_len - wa[3 + 2 * x];
+                    }
+                    x++;
+                    y++;
+                } else if (pa + 1 < pb) {
+                    x++;
+                } else {
+                    y++;
+                }
+            }
+            if (adjacent) s->score[da] += PHRASE_BONUS * log(1.0 + adjacent);
+            wa += 2 + 2 * ta;
+            wb += 2 + 2 * tb;
+            ia++;
+            ib++;
+        }
+    }
+}
+
+static int compare_results(const void *a, const void *b) {
+    const SearchResult *x = a, *y = b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    return x->doc < y->doc ? -1 : (x->doc > y->doc);
+}
+
+int search_index_query(const SearchIndex *idx, const char *query, SearchResult **results, size_t *count) {
+    *results = NULL;
+    *count = 0;
+    uint32_t n_docs = idx->header->doc_count;
+    if (n_docs == 0) return 0;
+    Scores s;
+    s.score = calloc(n_docs, sizeof(*s.score));
+    s.hit_off = calloc(n_docs, sizeof(*s.hit_off));
+    s.hit_len = calloc(n_docs, sizeof(*s.hit_len));
+    if (!s.score || !s.hit_off || !s.hit_len) {
+        free(s.score);
+        free(s.hit_off);
+        free(s.hit_len);
+        return -1;
+    }
+
+    const IndexTerm *prev = NULL;
+    size_t qlen = strlen(query), pos = 0, start;
+    char term[MAX_TERM_LEN + 1];
+    size_t n;
+    int terms_seen = 0;
+    while (terms_seen < MAX_QUERY_TERMS && (n = next_term(query, qlen, &pos, term, &start)) > 0) {
+        terms_seen++;
+        const IndexTerm *t = find_term(idx, term, n);
+        if (t) {
+            score_term(idx, t, &s);
+            if (prev) score_phrase(idx, prev, t, &s);
+        } else {
+            score_substring(idx, term, n, &s);
+        }
+        prev = t;
+    }
+    if (terms_seen == 0 && qlen > 0) {
+        /* Punctuation-only query such as "(c)": plain substring match */
+        char lowered[MAX_TERM_LEN + 1];
+        size_t len = qlen < MAX_TERM_LEN ? qlen : MAX_TERM_LEN;
+        for (size_t i = 0; i < len; i++) lowered[i] = (char)tolower((unsigned char)query[i]);
+        score_substring(idx, lowered, len, &s);
+    }
+    /* Matching the license name itself ranks first */
+    for (uint32_t d = 0; d < n_docs && qlen > 0; d++) {
+        size_t name_len;
+        const char *name = search_doc_name(idx, d, &name_len);
+        if (strcasestr(name, query)) s.score[d] += NAME_BONUS;
+    }
+
+    SearchResult *out = malloc(n_docs * sizeof(*out));
+    if (!out) {
+        free(s.score);
+        free(s.hit_off);
+        free(s.hit_len);
+        return -1;
+    }
+    size_t found = 0;
+    for (uint32_t d = 0; d < n_docs; d++) {
+        if (s.score[d] <= 0) continue;
+        out[found++] = (SearchResult){ d, s.score[d], s.hit_off[d], s.hit_len[d] };
+    }
+    qsort(out, found, sizeof(*out), compare_results);
+    free(s.score);
+    free(s.hit_off);
+    free(s.hit_len);
+    *results = out;
+    *count = found;
+    return 0;
+}
@@ -0,0 +1,105 @@
+/* File: src/search.h
+ *
+ * Header for the full-text search index.
+ *
+ * The index covers every license text together with its description. It holds
+ * a token inverted index with positional postings (for BM25 ranking, phrase
+ * boosts and snippets) and a trigram index for substring queries, and keeps a
+ * copy of each document so results can be shown without touching the data dir.
+ * It is persisted in the cache directory and rebuilt when db_stamp() changes.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "db.h"
+
+#define SEARCH_INDEX_MAGIC "OSLAIDX"
+#define SEARCH_INDEX_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t doc_count;
+    uint64_t stamp;
+    uint32_t term_count;
+    uint32_t trigram_count;
+    uint64_t total_tokens;
+    uint64_t docs_off;      /* IndexDoc[doc_count] */
+    uint64_t terms_off;     /* IndexTerm[term_count], sorted by term */
+    uint64_t trigrams_off;  /* IndexTrigram[trigram_count], sorted by key */
+    uint64_t words_off;     /* uint32_t postings and trigram doc lists */
+    uint64_t strings_off;   /* names, terms and document texts */
+    uint64_t total_size;
+} IndexHeader;
+
+typedef struct {
+    uint32_t name_off;
+    uint32_t name_len;
+    uint32_t text_off;
+    uint32_t text_len;
+    uint32_t token_count;
+    uint32_t desc_len;      /* the description forms the first desc_len bytes of the text */
+} IndexDoc;
+
+/* Postings at words[post_off]: per document, doc id, tf, then tf pairs of
+ * (token position, byte offset into the document text).
+ */
+typedef struct {
+    uint32_t str_off;
+    uint32_t str_len;
+    uint32_t df;
+    uint32_t post_off;
+} IndexTerm;
+
+/* Sorted document ids at words[list_off]. */
+typedef struct {
+    uint32_t key;
+    uint32_t count;
+    uint32_t list_off;
+} IndexTrigram;
+
+typedef struct {
+    const unsigned char *base;
+    size_t size;
+    const IndexHeader *header;
+    const IndexDoc *docs;
+    const IndexTerm *terms;
+    const IndexTrigram *trigrams;
+    const uint32_t *words;
+    const char *strings;
+    char *heap;             /* set when the image lives in memory instead of a mapping */
+} SearchIndex;
+
+typedef struct {
+    uint32_t doc;
+    double score;
+    uint32_t hit_off;       /* byte offset of the best match in the document text */
+    uint32_t hit_len;
+} SearchResult;
+
+/* Maps the cached index for db, rebuilding it first when it is missing or
+ * stale. Falls back to an in-memory index if the cache cannot be written,
+ * and always builds one in memory for the embedded database.
+ * Returns 0 on success.
+ */
+int search_index_open(SearchIndex *idx, const Database *db);
+
+void search_index_close(SearchIndex *idx);
+
+/* Builds the index for db and writes it to path. Returns 0 on success. */
+int search_index_build(const Database *db, const char *path);
+
+/* Runs a query and returns matching documents by descending score in *results
+ * (caller frees). Terms not in the vocabulary are matched as substrings via the
+ * trigram index. Returns 0 on success, -1 on allocation failure.
+ */
+int search_index_query(const SearchIndex *idx, const char *query, SearchResult **results, size_t *count);
+
+/* Accessors for a document's name and text (not NUL-terminated). */
+const char *search_doc_name(const SearchIndex *idx, uint32_t doc, size_t *len);
+const char *search_doc_text(const SearchIndex *idx, uint32_t doc, size_t *len);
+
+#endif /* SEARCH_H */
@@ -0,0 +1,582 @@
+/* File: src/server.c
+ *
+ * Implementation of the resident server and its client.
+ *
+ * One thread runs an epoll loop over the listening socket and every client
+ * connection. Sockets are non-blocking; each connection keeps an input buffer
+ * that is parsed into frames as bytes arrive and an output buffer that is
+ * flushed as the peer accepts it, so a slow client never stalls the others.
+ * Requests are cheap (compiled templates are filled in from memory), so they
+ * are answered inline on the loop thread.
+ */
+
+#define _GNU_SOURCE
+
+#include "server.h"
+#include "bundle.h"
+#include "io.h"
+#include "license.h"
+#include "meta.h"
+#include "paths.h"
+#include "search.h"
+#include "suggest.h"
+#include "template.h"
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define MAX_EVENTS 64
+#define READ_CHUNK 4096
+
+typedef struct {
+    Database *db;
+    Config *config;
+    TemplateSet templates;
+    int have_templates;
+    SearchIndex index;
+    int have_index;
+    char identity[2 * PATH_MAX + 256];
+} ServerState;
+
+typedef struct {
+    int fd;
+    StrBuf in;
+    StrBuf out;
+    size_t out_off;
+} Conn;
+
+static volatile sig_atomic_t stop_requested;
+static volatile sig_atomic_t reload_requested;
+
+static void on_signal(int sig) {
+    if (sig == SIGHUP) {
+        reload_requested = 1;
+    } else {
+        stop_requested = 1;
+    }
+}
+
+/* Directory of the default socket when XDG_RUNTIME_DIR is not set */
+static int fallback_dir(char *out, size_t out_size) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int n;
+    if (xdg && xdg[0]) {
+        n = snprintf(out, out_size, "%s/osla/server", xdg);
+    } else if (home && home[0]) {
+        n = snprintf(out, out_size, "%s/.cache/osla/server", home);
+    } else {
+        return -1;
+    }
+    return n < 0 || (size_t)n >= out_size ? -1 : 0;
+}
+
+int server_default_socket(char *out, size_t out_size) {
+    const char *env = getenv("OSLA_SOCKET");
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    char dir[PATH_MAX];
+    int n;
+    if (env && env[0]) {
+        n = snprintf(out, out_size, "%s", env);
+    } else if (runtime && runtime[0]) {
+        n = snprintf(out, out_size, "%s/osla.sock", runtime);
+    } else if (fallback_dir(dir, sizeof(dir)) == 0) {
+        n = snprintf(out, out_size, "%s/osla.sock", dir);
+    } else {
+        return -1;
+    }
+    return n < 0 || (size_t)n >= out_size ? -1 : 0;
+}
+
+/* Creates the fallback socket directory (and its parents) and checks that it
+ * belongs to this user and is closed to everyone else. Returns 0 on success.
+ */
+static int make_private_dir(void) {
+    char dir[PATH_MAX];
+    if (fallback_dir(dir, sizeof(dir)) != 0) return -1;
+    for (char *p = strchr(dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        int rc = ensure_directory_exists(dir);
+        *p = '/';
+        if (rc != 0) return -1;
+    }
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) return -1;
+    struct stat st;
+    if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Returns 1 if the process at the other end of fd runs as this user. */
+static int same_user(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || len != sizeof(cred)) return 0;
+    return cred.uid == getuid();
+}
+
+/* Describes the data directory and config file a render depends on, so a
+ * server never answers for a different OSLA_DATADIR, HOME or edited config.
+ * The stamps of the data directory's entries catch licenses added or removed
+ * and a rebuilt bundle; files edited in place are checked on each render.
+ */
+static void make_identity(char *out, size_t out_size) {
+    static const char *const entries[] = { "licenses", "descriptions", BUNDLE_FILENAME, META_FILENAME };
+    char datadir[PATH_MAX], config[PATH_MAX];
+    if (!realpath(get_data_dir(), datadir)) snprintf(datadir, sizeof(datadir), "%s", get_data_dir());
+    config_file_path(config, sizeof(config));
+    struct stat st;
+    if (stat(config, &st) != 0) memset(&st, 0, sizeof(st));
+    int n = snprintf(out, out_size, "%s\n%s\n%lld.%09ld:%lld", datadir, config, (long long)st.st_mtim.tv_sec,
+                     (long)st.st_mtim.tv_nsec, (long long)st.st_size);
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]) && n >= 0 && (size_t)n < out_size; i++) {
+        char path[PATH_MAX + 32];
+        snprintf(path, sizeof(path), "%s/%s", datadir, entries[i]);
+        if (stat(path, &st) != 0) memset(&st, 0, sizeof(st));
+        n += snprintf(out + n, out_size - (size_t)n, "\n%lld.%09ld:%lld", (long long)st.st_mtim.tv_sec,
+                      (long)st.st_mtim.tv_nsec, (long long)st.st_size);
+    }
+}
+
+static int make_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) return -1;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* ---- Server state ---- */
+
+static void unload_state(ServerState *st) {
+    if (st->have_templates) template_set_close(&st->templates);
+    st->have_templates = 0;
+    if (st->have_index) search_index_close(&st->index);
+    st->have_index = 0;
+}
+
+/* Compiles the templates and opens the search index. */
+static int load_state(ServerState *st) {
+    if (template_set_open(&st->templates, st->db, st->config) != 0) {
+        return -1;
+    }
+    st->have_templates = 1;
+    /* Search stays unavailable rather than failing the server */
+    st->have_index = search_index_open(&st->index, st->db) == 0;
+    return 0;
+}
+
+/* ---- Request handling ---- */
+
+/* Returns the template of name, recompiling the set when its license file was
+ * edited since. The check runs on every render rather than once per set, as a
+ * server outlives many edits. Returns NULL if name is unknown or the set is lost.
+ */
+static const TemplateEntry *current_template(ServerState *st, const char *name) {
+    if (!st->have_templates) {
+        unload_state(st);
+        if (load_state(st) != 0) return NULL;
+    }
+    const TemplateEntry *t = template_find(&st->templates, name);
+    if (!t) return NULL;
+    st->templates.checked[t - st->templates.entries] = 0;
+    t = template_get(&st->templates, name);
+    /* A failed recompile closes the set; the next render retries */
+    if (!st->templates.header) st->have_templates = 0;
+    return t;
+}
+
+/* Parses the optional format field of a query (absent: the table). Returns 0 on success. */
+static int request_format(const char *field, OutputFormat *format) {
+    int parsed = field ? output_format_parse(field) : OUTPUT_TABLE;
+    *format = (OutputFormat)parsed;
+    return parsed < 0 ? -1 : 0;
+}
+
+static void respond_error(StrBuf *out, size_t status_at, const char *message) {
+    out->len = status_at;
+    sb_append(out, "1", 1);
+    sb_append_str(out, message);
+}
+
+/* Appends a response (status byte and body) for one request payload to out. */
+static void handle_request(ServerState *st, const char *payload, size_t len, StrBuf *out) {
+    const char *identity = NULL;
+    const char *fields[3] = { NULL, NULL, NULL };
+    size_t count = 0;
+    for (size_t pos = 0; pos < len && count < 3;) {
+        const char *nul = memchr(payload + pos, '\0', len - pos);
+        if (!nul) break;
+        if (identity) {
+            fields[count++] = payload + pos;
+        } else {
+            identity = payload + pos;
+        }
+        pos = (size_t)(nul - payload) + 1;
+    }
+
+    size_t status_at = out->len;
+    sb_append(out, "0", 1);
+    char errmsg[256];
+    if (count == 0) {
+        respond_error(out, status_at, "Malformed request");
+    } else if (strcmp(identity, st->identity) != 0) {
+        respond_error(out, status_at, "Serving another data directory or configuration");
+        out->data[status_at] = '2';
+        /* The data or config changed under us: this client renders locally, later ones get the reload */
+        char current[sizeof(st->identity)];
+        make_identity(current, sizeof(current));
+        if (strcmp(identity, current) == 0) reload_requested = 1;
+    } else if (strcmp(fields[0], "render") == 0 && count == 2) {
+        const char *lic = fields[1][0] ? fields[1] : st->config->default_license;
+        char resolved[64];
+        if (db_resolve_alias(st->db, lic, resolved, sizeof(resolved)) != 0) {
+            snprintf(resolved, sizeof(resolved), "%s", lic);
+        }
+        const TemplateEntry *t = current_template(st, resolved);
+        if (!t) {
+            char hint[128];
+            if (suggest_hint(st->db, lic, hint, sizeof(hint)) != 0) {
+                snprintf(hint, sizeof(hint), " Try 'osla --list' to see available licenses.");
+            }
+            snprintf(errmsg, sizeof(errmsg), "License '%.64s' not found.%s", resolved, hint);
+            respond_error(out, status_at, errmsg);
+        } else {
+            TemplateValues values;
+            template_values(&values, st->config, NULL, NULL);
+            if (template_render(&st->templates, t, &values, out) != 0) {
+                respond_error(out, status_at, "Out of memory during placeholder expansion");
+            }
+        }
+    } else if (strcmp(fields[0], "list") == 0 && count <= 2) {
+        OutputFormat format;
+        if (request_format(count > 1 ? fields[1] : NULL, &format) != 0) {
+            respond_error(out, status_at, "Unknown output format");
+        } else if (list_license_files(st->db, -1, format, out) != 0) {
+            respond_error(out, status_at, "Unable to open licenses directory.");
+        }
+    } else if (strcmp(fields[0], "describe") == 0 && count >= 2) {
+        OutputFormat format;
+        if (request_format(count > 2 ? fields[2] : NULL, &format) != 0) {
+            respond_error(out, status_at, "Unknown output format");
+        } else if (print_description(fields[1], st->db, format, out) != 0) {
+            snprintf(errmsg, sizeof(errmsg), "Description file for '%.64s' not found.", fields[1]);
+            respond_error(out, status_at, errmsg);
+        }
+    } else if (strcmp(fields[0], "search") == 0 && count >= 2) {
+        OutputFormat format;
+        if (!st->have_index) {
+            respond_error(out, status_at, "Unable to build the search index.");
+        } else if (request_format(count > 2 ? fields[2] : NULL, &format) != 0) {
+            respond_error(out, status_at, "Unknown output format");
+        } else if (print_search_results(&st->index, fields[1], st->db, NULL, -1, format, 0, out) != 0) {
+            respond_error(out, status_at, "Out of memory while searching.");
+        }
+    } else {
+        snprintf(errmsg, sizeof(errmsg), "Unknown request '%.64s'", fields[0]);
+        respond_error(out, status_at, errmsg);
+    }
+}
+
+/* ---- Event loop ---- */
+
+static void conn_close(int epfd, Conn *conn) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    sb_free(&conn->in);
+    sb_free(&conn->out);
+    free(conn);
+}
+
+/* Writes as much pending output as the socket takes. Returns -1 on a write error. */
+static int conn_flush(int epfd, Conn *conn) {
+    while (conn->out_off < conn->out.len) {
+        ssize_t n = send(conn->fd, conn->out.data + conn->out_off, conn->out.len - conn->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+            break;
+        }
+        conn->out_off += (size_t)n;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+    if (conn->out_off < conn->out.len) {
+        ev.events |= EPOLLOUT;
+    } else {
+        conn->out.len = 0;
+        conn->out_off = 0;
+    }
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+/* Reads what is available and answers every complete frame.
+ * Returns -1 when the connection should be closed.
+ */
+static int conn_readable(int epfd, ServerState *st, Conn *conn) {
+    int eof = 0;
+    for (;;) {
+        if (sb_reserve(&conn->in, READ_CHUNK) != 0) return -1;
+        ssize_t n = recv(conn->fd, conn->in.data + conn->in.len, READ_CHUNK, 0);
+        if (n > 0) {
+            conn->in.len += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            eof = 1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+        break;
+    }
+
+    size_t pos = 0;
+    while (conn->in.len - pos >= 4) {
+        uint32_t len = get_u32((const unsigned char *)conn->in.data + pos);
+        if (len > SERVER_MAX_REQUEST) return -1;
+        if (conn->in.len - pos - 4 < len) break;
+        size_t frame_at = conn->out.len;
+        if (sb_append(&conn->out, "\0\0\0\0", 4) != 0) return -1;
+        handle_request(st, conn->in.data + pos + 4, len, &conn->out);
+        put_u32((unsigned char *)conn->out.data + frame_at, (uint32_t)(conn->out.len - frame_at - 4));
+        pos += 4 + (size_t)len;
+    }
+    memmove(conn->in.data, conn->in.data + pos, conn->in.len - pos);
+    conn->in.len -= pos;
+
+    if (conn_flush(epfd, conn) != 0) return -1;
+    /* A client that has hung up gets its pending answers before closing */
+    return eof && conn->out.len == 0 ? -1 : 0;
+}
+
+/* Binds the listening socket, replacing a stale socket file left by a dead server. */
+static int listen_on(const char *path) {
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) != 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int probe = errno == EADDRINUSE ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        int live = probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (probe < 0 || live || unlink(path) != 0 ||
+            bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+int run_server(const char *socket_path, Database *db, Config *config, int debug) {
+    ServerState st;
+    memset(&st, 0, sizeof(st));
+    st.db = db;
+    st.config = config;
+    char default_path[PATH_MAX];
+    if (!socket_path) {
+        if (server_default_socket(default_path, sizeof(default_path)) != 0 ||
+            (!getenv("OSLA_SOCKET") && !getenv("XDG_RUNTIME_DIR") && make_private_dir() != 0)) {
+            print_error("No private socket directory; set OSLA_SOCKET or XDG_RUNTIME_DIR");
+            return -1;
+        }
+        socket_path = default_path;
+    }
+    make_identity(st.identity, sizeof(st.identity));
+    if (load_state(&st) != 0) {
+        print_error("Unable to load license templates");
+        return -1;
+    }
+
+    int lfd = listen_on(socket_path);
+    if (lfd < 0) {
+        char errmsg[512];
+        snprintf(errmsg, sizeof(errmsg), "Unable to listen on '%s' (is a server already running?)", socket_path);
+        print_error(errmsg);
+        unload_state(&st);
+        return -1;
+    }
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev) != 0) {
+        print_error("Unable to set up the event loop");
+        if (epfd >= 0) close(epfd);
+        close(lfd);
+        unlink(socket_path);
+        unload_state(&st);
+        return -1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (debug) {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Serving %u templates on '%s'", st.templates.header->count, socket_path);
+        debug_print(msg);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (!stop_requested) {
+        if (reload_requested) {
+            reload_requested = 0;
+            unload_state(&st);
+            /* Stamp the config before reading it, so an edit racing the reload gets refused */
+            make_identity(st.identity, sizeof(st.identity));
+            if (load_config(config, debug) != 0 || load_state(&st) != 0) {
+                print_error("Reload failed; shutting down");
+                break;
+            }
+            if (debug) debug_print("Configuration and templates reloaded");
+        }
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            print_error("Event loop failed");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            Conn *conn = events[i].data.ptr;
+            if (!conn) {
+                int cfd;
+                while ((cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    if (!same_user(cfd)) {
+                        close(cfd);
+                        continue;
+                    }
+                    Conn *c = calloc(1, sizeof(*c));
+                    struct epoll_event cev = { .events = EPOLLIN, .data.ptr = c };
+                    if (!c || epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev) != 0) {
+                        free(c);
+                        close(cfd);
+                        continue;
+                    }
+                    c->fd = cfd;
+                }
+                continue;
+            }
+            int rc = 0;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                rc = conn_readable(epfd, &st, conn);
+            } else if (events[i].events & EPOLLOUT) {
+                rc = conn_flush(epfd, conn);
+            }
+            if (rc != 0) conn_close(epfd, conn);
+        }
+    }
+
+    /* Connections still open are dropped with the process */
+    close(epfd);
+    close(lfd);
+    unlink(socket_path);
+    unload_state(&st);
+    return 0;
+}
+
+/* ---- Client ---- */
+
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int server_request(const char *socket_path, const char *const *fields, size_t count,
+                   StrBuf *out, int *ok) {
+    struct sockaddr_un addr;
+    if (make_address(socket_path, &addr) != 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || !same_user(fd)) {
+        close(fd);
+        return -1;
+    }
+
+    char identity[2 * PATH_MAX + 256];
+    make_identity(identity, sizeof(identity));
+    StrBuf req = {0};
+    int rc = sb_append(&req, "\0\0\0\0", 4);
+    if (rc == 0) rc = sb_append(&req, identity, strlen(identity) + 1);
+    for (size_t i = 0; i < count && rc == 0; i++) {
+        rc = sb_append(&req, fields[i], strlen(fields[i]) + 1);
+    }
+    if (rc == 0 && req.len - 4 > SERVER_MAX_REQUEST) rc = -1;
+    if (rc == 0) {
+        put_u32((unsigned char *)req.data, (uint32_t)(req.len - 4));
+        rc = send_all(fd, req.data, req.len);
+    }
+    sb_free(&req);
+
+    unsigned char head[5];
+    if (rc == 0) rc = recv_all(fd, (char *)head, sizeof(head));
+    if (rc == 0) {
+        uint32_t len = get_u32(head);
+        if (len == 0) {
+            rc = -1;
+        } else {
+            rc = sb_reserve(out, len - 1);
+            if (rc == 0) rc = recv_all(fd, out->data + out->len, len - 1);
+            if (rc == 0) {
+                out->len += len - 1;
+                out->data[out->len] = '\0';
+                *ok = head[4] == '0';
+                /* A server for another data directory or config: render locally */
+                if (head[4] == '2') rc = -1;
+            }
+        }
+    }
+    close(fd);
+    return rc;
+}
@@ -0,0 +1,64 @@
+/* File: src/server.h
+ *
+ * Header for the resident server and its client.
+ *
+ * `osla --serve` keeps the configuration, the license templates and the
+ * search index in memory and answers requests on a Unix stream socket, so
+ * repeated invocations skip process setup, config loading and template reads.
+ *
+ * Every message is a frame: a 4-byte little-endian payload length followed by
+ * the payload. A request payload is the client's identity (see below), the
+ * command and its arguments, each terminated by a NUL byte:
+ *
+ *     render <license>             rendered license text ("" for the default license)
+ *     list [format]                output of --list
+ *     describe <license> [format]  output of --description
+ *     search <keyword> [format]    output of --search
+ *
+ * where format is a --format name; without one the table is sent.
+ * A response payload is one status byte ('0' success, '1' error, '2' refused)
+ * followed by the output or the error message.
+ *
+ * The identity names the resolved data directory, the config file and stamps
+ * (mtime and size) of that file, the licenses and descriptions directories,
+ * the bundle and the metadata file. A server only answers clients whose
+ * identity matches what it loaded and refuses the others, which then render
+ * locally; if the refused identity is the current one, the data or config
+ * changed and the server reloads. License files edited in place are
+ * re-checked on every render.
+ * Both ends check with SO_PEERCRED that the peer runs as the same user.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+#include "config.h"
+#include "db.h"
+#include "utils.h"
+
+#define SERVER_MAX_REQUEST 65536
+
+/* Writes the socket path used when none is given: $OSLA_SOCKET, else
+ * $XDG_RUNTIME_DIR/osla.sock, else osla.sock in the private directory
+ * $XDG_CACHE_HOME/osla/server (~/.cache/osla/server). Returns 0 on success,
+ * -1 if none of these is available.
+ */
+int server_default_socket(char *out, size_t out_size);
+
+/* Serves requests on socket_path (NULL for the default socket, whose private
+ * directory is created with mode 0700) until SIGINT or SIGTERM. SIGHUP reloads
+ * the configuration and templates. Returns 0 on a clean shutdown, -1 if the
+ * socket cannot be set up (including when another server is already listening).
+ */
+int run_server(const char *socket_path, Database *db, Config *config, int debug);
+
+/* Sends one request to the server at socket_path and stores the response body
+ * in out and its status in *ok (1 for success). Returns 0 if a response was
+ * received, -1 if no server of this user is reachable, it serves another data
+ * directory or config, or the exchange failed.
+ */
+int server_request(const char *socket_path, const char *const *fields, size_t count,
+                   StrBuf *out, int *ok);
+
+#endif /* SERVER_H */
@@ -0,0 +1,889 @@
+/* File: src/spdx.c
+ *
+ * Implementation of the SPDX license list importer.
+ *
+ * licenses.json is read with a small pull parser that keeps no tree: each
+ * license record is handled as soon as its closing brace is read, its details
+ * file is parsed the same way, and the outputs are written before the next
+ * record. Texts come from standardLicenseTemplate when the list has one,
+ * since it marks the copyright line as a variable; licenseText and
+ * text/<id>.txt are the fallbacks. Family aliases need every id of the list,
+ * so they are assigned once the list is read, when licenses.tsv is written.
+ */
+
+#define _GNU_SOURCE
+
+#include "spdx.h"
+#include "bundle.h"
+#include "catalog.h"
+#include "db.h"
+#include "io.h"
+#include "license.h"
+#include "meta.h"
+#include "names.h"
+#include "utils.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+/* Nesting of JSON values beyond this is treated as malformed */
+#define JSON_MAX_DEPTH 32
+/* Placeholder spellings the default config knows (see config.c) */
+#define YEAR_TOKEN "<YEAR>"
+#define HOLDER_TOKEN "<COPYRIGHT HOLDER>"
+
+/* ---- JSON reader ---- */
+
+typedef struct {
+    const char *p, *end;
+    int failed;
+} JsonReader;
+
+static int json_peek(JsonReader *j) {
+    while (j->p < j->end && (*j->p == ' ' || *j->p == '\t' || *j->p == '\n' || *j->p == '\r')) j->p++;
+    return j->p < j->end && !j->failed ? (unsigned char)*j->p : -1;
+}
+
+static int json_accept(JsonReader *j, char c) {
+    if (json_peek(j) != (unsigned char)c) return 0;
+    j->p++;
+    return 1;
+}
+
+static int json_hex4(const char *p, unsigned *v) {
+    *v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = (unsigned char)p[i], d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else return -1;
+        *v = *v * 16 + (unsigned)d;
+    }
+    return 0;
+}
+
+static void append_utf8(StrBuf *out, unsigned cp) {
+    char buf[4];
+    size_t n;
+    if (cp < 0x80) {
+        buf[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        buf[0] = (char)(0xc0 | (cp >> 6));
+        buf[1] = (char)(0x80 | (cp & 0x3f));
+        n = 2;
+    } else if (cp < 0x10000) {
+        buf[0] = (char)(0xe0 | (cp >> 12));
+        buf[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        buf[2] = (char)(0x80 | (cp & 0x3f));
+        n = 3;
+    } else {
+        buf[0] = (char)(0xf0 | (cp >> 18));
+        buf[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+        buf[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        buf[3] = (char)(0x80 | (cp & 0x3f));
+        n = 4;
+    }
+    sb_append(out, buf, n);
+}
+
+/* Reads a string into out (replacing its contents), or skips it when out is
+ * NULL. Returns 0 on success, -1 if the input is not a string.
+ */
+static int json_string(JsonReader *j, StrBuf *out) {
+    if (out) out->len = 0;
+    if (!json_accept(j, '"')) {
+        j->failed = 1;
+        return -1;
+    }
+    const char *p = j->p;
+    while (p < j->end && *p != '"') {
+        const char *run = p;
+        while (p < j->end && *p != '"' && *p != '\\') p++;
+        if (out) sb_append(out, run, (size_t)(p - run));
+        if (p >= j->end || *p == '"') break;
+        if (j->end - p < 2) break;
+        char c = p[1];
+        p += 2;
+        const char *simple = strchr("\"\\/bfnrt", c);
+        if (c && simple) {
+            static const char decoded[] = "\"\\/\b\f\n\r\t";
+            if (out) sb_append(out, &decoded[simple - "\"\\/bfnrt"], 1);
+            continue;
+        }
+        unsigned cp, low;
+        if (c != 'u' || j->end - p < 4 || json_hex4(p, &cp) != 0) {
+            j->failed = 1;
+            return -1;
+        }
+        p += 4;
+        if (cp >= 0xd800 && cp < 0xdc00 && j->end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+            json_hex4(p + 2, &low) == 0 && low >= 0xdc00 && low < 0xe000) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            p += 6;
+        } else if (cp >= 0xd800 && cp < 0xe000) {
+            cp = 0xfffd;    /* a lone surrogate */
+        }
+        if (out) append_utf8(out, cp);
+    }
+    if (p >= j->end) {
+        j->failed = 1;
+        return -1;
+    }
+    j->p = p + 1;
+    if (out && !out->data) sb_append(out, "", 0);
+    return 0;
+}
+
+/* Moves to the next element of the open array or member of the open object
+ * closed by close. Returns 1 if there is one, 0 at the end (or on error).
+ */
+static int json_next(JsonReader *j, char close, int *first) {
+    if (json_accept(j, close)) return 0;
+    if (!*first && !json_accept(j, ',')) {
+        j->failed = 1;
+        return 0;
+    }
+    *first = 0;
+    return !j->failed;
+}
+
+/* Moves to the next member of the open object and reads its key into key. */
+static int json_member(JsonReader *j, int *first, StrBuf *key) {
+    if (!json_next(j, '}', first)) return 0;
+    if (json_string(j, key) != 0 || !json_accept(j, ':')) {
+        j->failed = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static void json_skip_depth(JsonReader *j, int depth) {
+    int c = json_peek(j);
+    if (c == '"') {
+        json_string(j, NULL);
+    } else if (c == '{' || c == '[') {
+        if (depth >= JSON_MAX_DEPTH) {
+            j->failed = 1;
+            return;
+        }
+        j->p++;
+        int first = 1;
+        while (c == '{' ? json_member(j, &first, NULL) : json_next(j, ']', &first)) {
+            json_skip_depth(j, depth + 1);
+        }
+    } else {
+        /* true, false, null or a number */
+        const char *start = j->p;
+        while (j->p < j->end && (isalnum((unsigned char)*j->p) || strchr("+-.", *j->p))) j->p++;
+        if (j->p == start) j->failed = 1;
+    }
+}
+
+static void json_skip(JsonReader *j) {
+    json_skip_depth(j, 0);
+}
+
+/* Reads true or false; any other value is skipped and reads as false. */
+static int json_bool(JsonReader *j) {
+    json_peek(j);
+    if (j->end - j->p >= 4 && memcmp(j->p, "true", 4) == 0) {
+        j->p += 4;
+        return 1;
+    }
+    json_skip(j);
+    return 0;
+}
+
+static int key_is(const StrBuf *key, const char *name) {
+    return key->data && strcmp(key->data, name) == 0;
+}
+
+static const char *sb_str(const StrBuf *sb) {
+    return sb->data ? sb->data : "";
+}
+
+/* ---- text conversion ---- */
+
+/* Classifies a "<...>" or "[...]" token of a license text: 1 for a year, 2 for
+ * a copyright holder, 0 for anything else ("<program>", "<http://...>").
+ */
+static int token_kind(const char *s, size_t len) {
+    if (len == 0 || len > 40) return 0;
+    char word[48];
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (!isalpha(c) && c != ' ' && c != '-') return 0;
+        word[i] = (char)tolower(c);
+    }
+    word[len] = '\0';
+    if (strstr(word, "year") || strstr(word, "yyyy")) return 1;
+    static const char *const holders[] = { "holder", "owner", "author", "copyright", "fullname" };
+    for (size_t i = 0; i < sizeof(holders) / sizeof(holders[0]); i++) {
+        if (strstr(word, holders[i])) return 2;
+    }
+    return 0;
+}
+
+/* Appends text with its year and holder tokens in the default spellings.
+ * Returns the number of tokens replaced.
+ */
+static int append_tokens(StrBuf *out, const char *text, size_t len) {
+    int found = 0;
+    size_t i = 0, copied = 0;
+    while (i < len) {
+        char close = text[i] == '<' ? '>' : text[i] == '[' ? ']' : 0;
+        size_t window = len - i - 1 < 42 ? len - i - 1 : 42;
+        const char *end = close ? memchr(text + i + 1, close, window) : NULL;
+        int kind = end ? token_kind(text + i + 1, (size_t)(end - text - i - 1)) : 0;
+        if (!kind) {
+            i++;
+            continue;
+        }
+        sb_append(out, text + copied, i - copied);
+        sb_append_str(out, kind == 1 ? YEAR_TOKEN : HOLDER_TOKEN);
+        i = copied = (size_t)(end - text) + 1;
+        found++;
+    }
+    sb_append(out, text + copied, len - copied);
+    return found;
+}
+
+/* Finds the value of attr="..." in the fields of a template tag. */
+static int tag_attr(const char *tag, size_t len, const char *attr, const char **value, size_t *value_len) {
+    size_t n = strlen(attr);
+    for (size_t i = 0; i + n + 2 <= len; i++) {
+        if ((i == 0 || tag[i - 1] == ';') && memcmp(tag + i, attr, n) == 0 && tag[i + n] == '=' &&
+            tag[i + n + 1] == '"') {
+            const char *v = tag + i + n + 2;
+            const char *q = memchr(v, '"', len - (size_t)(v - tag));
+            if (!q) return -1;
+            *value = v;
+            *value_len = (size_t)(q - v);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Converts a standardLicenseTemplate into license text: optional markers are
+ * dropped with their text kept, and variables give their original text; a
+ * copyright variable without tokens gets the default copyright line.
+ */
+static void convert_template(StrBuf *out, const char *tmpl, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        const char *open = memmem(tmpl + i, len - i, "<<", 2);
+        if (!open) {
+            append_tokens(out, tmpl + i, len - i);
+            break;
+        }
+        append_tokens(out, tmpl + i, (size_t)(open - tmpl) - i);
+        /* The tag ends at the first ">>" outside quotes */
+        const char *p = open + 2, *end = tmpl + len;
+        int quoted = 0;
+        while (p + 1 < end && (quoted || p[0] != '>' || p[1] != '>')) {
+            if (*p == '"') quoted = !quoted;
+            p++;
+        }
+        if (p + 1 >= end) {
+            append_tokens(out, open, (size_t)(end - open));
+            break;
+        }
+        const char *tag = open + 2;
+        size_t tag_len = (size_t)(p - tag);
+        const char *value;
+        size_t value_len;
+        if (tag_len >= 3 && memcmp(tag, "var", 3) == 0 && tag_attr(tag, tag_len, "original", &value, &value_len) == 0) {
+            const char *name;
+            size_t name_len;
+            int is_copyright = tag_attr(tag, tag_len, "name", &name, &name_len) == 0 && name_len == 9 &&
+                               strncasecmp(name, "copyright", 9) == 0;
+            size_t mark = out->len;
+            if (append_tokens(out, value, value_len) == 0 && is_copyright) {
+                out->len = mark;
+                sb_append_str(out, "Copyright (c) " YEAR_TOKEN " " HOLDER_TOKEN);
+            }
+        } else if (!(tag_len >= 13 && memcmp(tag, "beginOptional", 13) == 0) &&
+                   !(tag_len >= 11 && memcmp(tag, "endOptional", 11) == 0)) {
+            append_tokens(out, open, (size_t)(p + 2 - open));
+        }
+        i = (size_t)(p + 2 - tmpl);
+    }
+}
+
+/* Strips trailing blanks from every line, drops leading and trailing blank
+ * lines, keeps at most one blank line in a row and ends text with a newline.
+ */
+static void tidy_text(StrBuf *text) {
+    size_t w = 0, blank_run = 0;
+    const char *p = sb_str(text), *end = p + text->len;
+    char *out = text->data;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        const char *stop = eol;
+        while (stop > p && (stop[-1] == ' ' || stop[-1] == '\t' || stop[-1] == '\r')) stop--;
+        if (stop == p) {
+            blank_run++;
+        } else {
+            if (w > 0 && blank_run > 0) out[w++] = '\n';
+            blank_run = 0;
+            memmove(out + w, p, (size_t)(stop - p));
+            w += (size_t)(stop - p);
+            out[w++] = '\n';
+        }
+        p = eol + 1;
+    }
+    text->len = w;
+    if (text->data) text->data[w] = '\0';
+}
+
+/* ---- metadata ---- */
+
+static const struct {
+    const char *prefix;
+    LicenseCategory category;
+} category_prefixes[] = {
+    { "CERN-OHL", LICENSE_HARDWARE }, { "TAPR-OHL", LICENSE_HARDWARE }, { "SHL-", LICENSE_HARDWARE },
+    { "OFL-", LICENSE_FONT }, { "GUST-Font", LICENSE_FONT }, { "Bitstream-", LICENSE_FONT },
+    { "Baekmuk", LICENSE_FONT }, { "IPA", LICENSE_FONT }, { "mplus", LICENSE_FONT }, { "Arphic-", LICENSE_FONT },
+    { "CC-", LICENSE_CONTENT }, { "CC0-", LICENSE_CONTENT }, { "GFDL-", LICENSE_CONTENT },
+    { "ODbL-", LICENSE_CONTENT }, { "ODC-", LICENSE_CONTENT }, { "PDDL-", LICENSE_CONTENT },
+    { "CDLA-", LICENSE_CONTENT }, { "OGL-", LICENSE_CONTENT }, { "DL-DE-", LICENSE_CONTENT },
+    { "etalab-", LICENSE_CONTENT }, { "LAL-", LICENSE_CONTENT },
+};
+
+/* The list does not categorize licenses; the id prefixes of the hardware,
+ * font and content families are enough for the ones it has.
+ */
+static LicenseCategory category_of(const char *id) {
+    for (size_t i = 0; i < sizeof(category_prefixes) / sizeof(category_prefixes[0]); i++) {
+        if (strncasecmp(id, category_prefixes[i].prefix, strlen(category_prefixes[i].prefix)) == 0) {
+            return category_prefixes[i].category;
+        }
+    }
+    return LICENSE_SOFTWARE;
+}
+
+/* Writes the family of id ("cecill" for "CECILL-2.1", "lgpl" for
+ * "LGPL-2.0-or-later") to out; it is "" for ids without a version.
+ */
+static void family_of(const char *id, char *out, size_t size) {
+    size_t len = strlen(id);
+    static const char *const suffixes[] = { "-only", "-or-later", "+" };
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t n = strlen(suffixes[i]);
+        if (len > n && strcasecmp(id + len - n, suffixes[i]) == 0) {
+            len -= n;
+            break;
+        }
+    }
+    /* A version is a trailing "-<digit>[0-9.]*[a-z]?": "-2.1", "-1.3c" */
+    const char *dash = NULL;
+    for (size_t i = len; i-- > 1;) {
+        if (id[i] == '-') {
+            dash = id + i;
+            break;
+        }
+    }
+    out[0] = '\0';
+    if (!dash || !isdigit((unsigned char)dash[1])) return;
+    const char *v = dash + 1, *end = id + len;
+    while (v < end && (isdigit((unsigned char)*v) || *v == '.')) v++;
+    if (v < end && isalpha((unsigned char)*v)) v++;
+    if (v != end) return;
+    size_t n = (size_t)(dash - id);
+    if (n >= size) return;
+    for (size_t i = 0; i < n; i++) out[i] = (char)tolower((unsigned char)id[i]);
+    out[n] = '\0';
+}
+
+/* ---- import ---- */
+
+typedef struct {
+    char name[64];
+    char spdx[64];
+    char family[64];
+    char aliases[64];
+    uint8_t category, flags;
+} ImportRow;
+
+typedef struct {
+    const char *src, *datadir;
+    int debug;
+    Meta old;                   /* licenses.tsv before the import */
+    ImportRow *rows;
+    size_t count, cap;
+    char **builtin_families;    /* families of ids osla ships, which get no alias */
+    size_t builtin_count, builtin_cap;
+    char version[32];           /* licenseListVersion */
+    size_t written, unchanged, deprecated, builtin, kept, invalid, failed;
+    StrBuf text, desc, tmpl, license_text, comments;
+} Import;
+
+/* One record of licenses.json */
+typedef struct {
+    StrBuf id, name, see_also;
+    int deprecated, osi, fsf;
+} ListRecord;
+
+static int valid_id(const char *id) {
+    size_t len = strlen(id);
+    if (len == 0 || len >= 64 || id[0] == '.' || id[0] == '-') return 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)id[i];
+        if (!isalnum(c) && c != '.' && c != '-' && c != '+') return 0;
+    }
+    return 1;
+}
+
+/* An id osla ships with metadata of its own, not one an earlier import added
+ * to the name table of a binary built from an imported data directory.
+ */
+static int builtin_covers(const char *id) {
+    const char *license = license_from_spdx(id);
+    return license && license_spdx_id(license) != NULL;
+}
+
+static int file_exists(const char *path) {
+    return access(path, F_OK) == 0;
+}
+
+/* Reads the text fields of json/details/<id>.json into im. */
+static int read_details(Import *im, const char *id) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/json/details/%s.json", im->src, id);
+    im->tmpl.len = im->license_text.len = im->comments.len = 0;
+    size_t len;
+    char *data = read_file(path, &len);
+    if (!data) return -1;
+    JsonReader j = { data, data + len, 0 };
+    StrBuf key = {0};
+    int first = 1;
+    if (!json_accept(&j, '{')) j.failed = 1;
+    while (json_member(&j, &first, &key)) {
+        if (key_is(&key, "standardLicenseTemplate")) json_string(&j, &im->tmpl);
+        else if (key_is(&key, "licenseText")) json_string(&j, &im->license_text);
+        else if (key_is(&key, "licenseComments")) json_string(&j, &im->comments);
+        else json_skip(&j);
+    }
+    sb_free(&key);
+    free(data);
+    return j.failed ? -1 : 0;
+}
+
+/* Builds the text of a license into im->text. Returns 0 if it has one. */
+static int build_text(Import *im, const char *id) {
+    im->text.len = 0;
+    int have_details = read_details(im, id) == 0;
+    if (have_details && im->tmpl.len > 0) {
+        convert_template(&im->text, im->tmpl.data, im->tmpl.len);
+    } else if (have_details && im->license_text.len > 0) {
+        append_tokens(&im->text, im->license_text.data, im->license_text.len);
+    } else {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/text/%s.txt", im->src, id);
+        size_t len;
+        char *data = read_file(path, &len);
+        if (!data) return -1;
+        append_tokens(&im->text, data, len);
+        free(data);
+    }
+    tidy_text(&im->text);
+    return im->text.len > 0 ? 0 : -1;
+}
+
+/* Builds the description: the list's name as title, then one paragraph. */
+static void build_description(Import *im, const ListRecord *rec) {
+    StrBuf *d = &im->desc;
+    d->len = 0;
+    sb_append_str(d, rec->name.len ? sb_str(&rec->name) : sb_str(&rec->id));
+    sb_append_str(d, ":\n");
+    size_t start = d->len;
+    if (im->comments.len) {
+        /* The paragraph is one line; fold the comments' line breaks */
+        for (size_t i = 0; i < im->comments.len; i++) {
+            char c = im->comments.data[i];
+            if (c == '\n' || c == '\r' || c == '\t') c = ' ';
+            if (c != ' ' || (d->len > start && d->data[d->len - 1] != ' ')) sb_append(d, &c, 1);
+        }
+        while (d->len > start && d->data[d->len - 1] == ' ') d->len--;
+        if (d->len > start && d->data[d->len - 1] != '.') sb_append(d, ".", 1);
+        sb_append(d, " ", 1);
+    }
+    sb_append_str(d, "SPDX license ");
+    sb_append_str(d, sb_str(&rec->id));
+    if (rec->osi && rec->fsf) sb_append_str(d, ", OSI approved and FSF free/libre");
+    else if (rec->osi) sb_append_str(d, ", OSI approved");
+    else if (rec->fsf) sb_append_str(d, ", FSF free/libre");
+    sb_append_str(d, ".");
+    if (rec->see_also.len) {
+        sb_append_str(d, " See ");
+        sb_append_str(d, rec->see_also.data);
+    }
+    sb_append_str(d, "\n");
+}
+
+static int push_row(Import *im, const ImportRow *row) {
+    if (im->count == im->cap) {
+        size_t cap = im->cap ? im->cap * 2 : 256;
+        ImportRow *grown = realloc(im->rows, cap * sizeof(*grown));
+        if (!grown) return -1;
+        im->rows = grown;
+        im->cap = cap;
+    }
+    im->rows[im->count++] = *row;
+    return 0;
+}
+
+static void note_builtin_family(Import *im, const char *id) {
+    char family[64];
+    family_of(id, family, sizeof(family));
+    if (!family[0]) return;
+    for (size_t i = 0; i < im->builtin_count; i++) {
+        if (strcmp(im->builtin_families[i], family) == 0) return;
+    }
+    if (im->builtin_count == im->builtin_cap) {
+        size_t cap = im->builtin_cap ? im->builtin_cap * 2 : 32;
+        char **grown = realloc(im->builtin_families, cap * sizeof(*grown));
+        if (!grown) return;
+        im->builtin_families = grown;
+        im->builtin_cap = cap;
+    }
+    char *copy = strdup(family);
+    if (copy) im->builtin_families[im->builtin_count++] = copy;
+}
+
+static void debug_skip(const Import *im, const char *id, const char *why) {
+    if (!im->debug) return;
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Skipping '%s': %s", id, why);
+    debug_print(msg);
+}
+
+/* Imports one record of licenses.json. Returns -1 only when the data
+ * directory cannot be written.
+ */
+static int import_record(Import *im, const ListRecord *rec) {
+    const char *id = sb_str(&rec->id);
+    if (!valid_id(id)) {
+        debug_skip(im, id, "not a usable SPDX id");
+        im->invalid++;
+        return 0;
+    }
+    if (rec->deprecated) {
+        im->deprecated++;
+        return 0;
+    }
+    if (builtin_covers(id)) {
+        note_builtin_family(im, id);
+        im->builtin++;
+        return 0;
+    }
+
+    ImportRow row;
+    memset(&row, 0, sizeof(row));
+    for (size_t i = 0; id[i]; i++) row.name[i] = (char)tolower((unsigned char)id[i]);
+    snprintf(row.spdx, sizeof(row.spdx), "%s", id);
+    row.category = (uint8_t)category_of(id);
+    row.flags = (uint8_t)((rec->osi ? LICENSE_OSI : 0) | (rec->fsf ? LICENSE_FSF : 0));
+    family_of(id, row.family, sizeof(row.family));
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/licenses/%s.txt", im->datadir, row.name);
+    const MetaEntry *prev = meta_find(&im->old, row.name);
+    if (file_exists(path) && !(prev && strcasecmp(prev->name, row.name) == 0)) {
+        debug_skip(im, id, "the data directory has a license file of its own");
+        im->kept++;
+        return 0;
+    }
+    if (build_text(im, id) != 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "No license text for '%s' in %s", id, im->src);
+        print_error(msg);
+        im->failed++;
+        return 0;
+    }
+    build_description(im, rec);
+
+    int rc = write_to_file(path, im->text.data, im->text.len, -1);
+    if (rc != WRITE_FAILED) {
+        int desc_rc;
+        snprintf(path, sizeof(path), "%s/descriptions/%s.desc", im->datadir, row.name);
+        desc_rc = write_to_file(path, im->desc.data, im->desc.len, -1);
+        if (desc_rc == WRITE_FAILED) rc = WRITE_FAILED;
+        else if (desc_rc == WRITE_DONE) rc = WRITE_DONE;
+    }
+    if (rc == WRITE_FAILED) {
+        char msg[4200];
+        snprintf(msg, sizeof(msg), "Failed to write %s: %s", path, strerror(errno));
+        print_error(msg);
+        return -1;
+    }
+    if (rc == WRITE_UNCHANGED) im->unchanged++;
+    else im->written++;
+    return push_row(im, &row);
+}
+
+/* Reads licenses.json record by record. Returns 0 on success, -1 if it is
+ * unreadable or malformed, -2 if the data directory cannot be written.
+ */
+static int import_list(Import *im) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/json/licenses.json", im->src);
+    size_t len;
+    char *data = read_file(path, &len);
+    if (!data) return -1;
+
+    JsonReader j = { data, data + len, 0 };
+    StrBuf key = {0}, version = {0};
+    ListRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    int rc = 0, first = 1;
+    if (!json_accept(&j, '{')) j.failed = 1;
+    while (rc == 0 && json_member(&j, &first, &key)) {
+        if (key_is(&key, "licenseListVersion")) {
+            json_string(&j, &version);
+            snprintf(im->version, sizeof(im->version), "%s", sb_str(&version));
+            continue;
+        }
+        if (!key_is(&key, "licenses") || json_peek(&j) != '[') {
+            json_skip(&j);
+            continue;
+        }
+        j.p++;
+        int first_lic = 1;
+        while (rc == 0 && json_next(&j, ']', &first_lic)) {
+            if (!json_accept(&j, '{')) {
+                j.failed = 1;
+                break;
+            }
+            rec.id.len = rec.name.len = rec.see_also.len = 0;
+            rec.deprecated = rec.osi = rec.fsf = 0;
+            int first_field = 1;
+            while (json_member(&j, &first_field, &key)) {
+                if (key_is(&key, "licenseId")) {
+                    json_string(&j, &rec.id);
+                } else if (key_is(&key, "name")) {
+                    json_string(&j, &rec.name);
+                } else if (key_is(&key, "isDeprecatedLicenseId")) {
+                    rec.deprecated = json_bool(&j);
+                } else if (key_is(&key, "isOsiApproved")) {
+                    rec.osi = json_bool(&j);
+                } else if (key_is(&key, "isFsfLibre")) {
+                    rec.fsf = json_bool(&j);
+                } else if (key_is(&key, "seeAlso") && json_accept(&j, '[')) {
+                    /* The first link is the license's home */
+                    int first_link = 1;
+                    while (json_next(&j, ']', &first_link)) {
+                        if (rec.see_also.len == 0 && json_peek(&j) == '"') json_string(&j, &rec.see_also);
+                        else json_skip(&j);
+                    }
+                } else {
+                    json_skip(&j);
+                }
+            }
+            if (!j.failed && import_record(im, &rec) != 0) rc = -2;
+        }
+    }
+    if (rc == 0 && j.failed) rc = -1;
+    sb_free(&key);
+    sb_free(&version);
+    sb_free(&rec.id);
+    sb_free(&rec.name);
+    sb_free(&rec.see_also);
+    free(data);
+    return rc;
+}
+
+static int compare_family(const void *a, const void *b) {
+    const ImportRow *x = a, *y = b;
+    int c = strcmp(x->family, y->family);
+    return c ? c : strverscmp(x->spdx, y->spdx);
+}
+
+static int compare_name_ptr(const void *a, const void *b) {
+    return strcasecmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static int compare_meta_entry(const void *a, const void *b) {
+    return strcmp(((const MetaEntry *)a)->name, ((const MetaEntry *)b)->name);
+}
+
+/* Whether alias can stand for a license without shadowing any other name. */
+static int alias_free(const Import *im, const char *alias, char **names, size_t name_count) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/licenses/%s.txt", im->datadir, alias);
+    if (name_find(alias) || file_exists(path) ||
+        bsearch(&alias, names, name_count, sizeof(*names), compare_name_ptr)) {
+        return 0;
+    }
+    const MetaEntry *e = meta_find(&im->old, alias);
+    if (e) {
+        /* Taken by a row this import keeps, rather than one it replaces */
+        const char *name = e->name;
+        if (!bsearch(&name, names, name_count, sizeof(*names), compare_name_ptr)) return 0;
+    }
+    for (size_t i = 0; i < im->builtin_count; i++) {
+        if (strcmp(im->builtin_families[i], alias) == 0) return 0;
+    }
+    return 1;
+}
+
+/* Gives the latest version of each family the family's name as an alias. */
+static int assign_aliases(Import *im) {
+    qsort(im->rows, im->count, sizeof(*im->rows), compare_family);
+    /* Every imported name and id, pointing into the rows, which stay put now */
+    char **names = malloc((im->count ? im->count : 1) * 2 * sizeof(*names));
+    if (!names) return -1;
+    size_t name_count = 0;
+    for (size_t i = 0; i < im->count; i++) {
+        names[name_count++] = im->rows[i].name;
+        names[name_count++] = im->rows[i].spdx;
+    }
+    qsort(names, name_count, sizeof(*names), compare_name_ptr);
+    for (size_t i = 0; i < im->count; i++) {
+        ImportRow *row = &im->rows[i];
+        int latest = i + 1 == im->count || strcmp(row->family, im->rows[i + 1].family) != 0;
+        if (latest && row->family[0] && alias_free(im, row->family, names, name_count)) {
+            snprintf(row->aliases, sizeof(row->aliases), "%s", row->family);
+        }
+    }
+    free(names);
+    return 0;
+}
+
+/* Writes licenses.tsv: the imported rows and the earlier rows of licenses this
+ * import did not touch, sorted by name.
+ */
+static int write_meta(Import *im) {
+    size_t max = im->count + im->old.count;
+    MetaEntry *entries = malloc((max ? max : 1) * sizeof(*entries));
+    if (!entries) return -1;
+    size_t n = 0;
+    for (size_t i = 0; i < im->count; i++) {
+        const ImportRow *r = &im->rows[i];
+        entries[n++] = (MetaEntry){ r->name, r->spdx, r->aliases, r->category, r->flags };
+    }
+    for (size_t i = 0; i < im->old.count; i++) {
+        int replaced = 0;
+        for (size_t k = 0; k < im->count && !replaced; k++) {
+            replaced = strcasecmp(im->rows[k].name, im->old.entries[i].name) == 0;
+        }
+        if (!replaced) entries[n++] = im->old.entries[i];
+    }
+    qsort(entries, n, sizeof(*entries), compare_meta_entry);
+
+    StrBuf out = {0};
+    char header[256];
+    snprintf(header, sizeof(header),
+             "# License metadata of this data directory (see meta.h); written by --import-spdx\n"
+             "# from SPDX License List %s.\n"
+             "# name\tSPDX id\tcategory\tflags\taliases\n",
+             im->version[0] ? im->version : "(unknown version)");
+    int rc = sb_append_str(&out, header);
+    for (size_t i = 0; i < n && rc == 0; i++) rc = meta_append_line(&out, &entries[i]);
+    free(entries);
+    if (rc == 0) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", im->datadir, META_FILENAME);
+        rc = write_to_file(path, out.data, out.len, -1) == WRITE_FAILED ? -1 : 0;
+    }
+    sb_free(&out);
+    return rc;
+}
+
+/* Rebuilds the bundle and catalog of the data directory, where it has them;
+ * the caches of the other indexes notice the change on their own.
+ */
+static int rebuild_indexes(const Import *im) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", im->datadir, BUNDLE_FILENAME);
+    if (file_exists(path)) {
+        if (bundle_build(im->datadir, path, NULL) != 0) {
+            print_error("Failed to rebuild the license bundle");
+            return -1;
+        }
+        printf("Rebuilt %s.\n", path);
+    }
+    Database db;
+    db_open(&db, im->datadir);
+    int rc = 0;
+    snprintf(path, sizeof(path), "%s/%s", im->datadir, CATALOG_FILENAME);
+    if (file_exists(path)) {
+        rc = catalog_build(&db, path);
+        if (rc == 0) printf("Rebuilt %s.\n", path);
+    } else {
+        /* Build the cached catalog now rather than on the next query */
+        Catalog cat;
+        rc = catalog_open(&cat, &db);
+        if (rc == 0) catalog_close(&cat);
+    }
+    db_close(&db);
+    if (rc != 0) print_error("Failed to rebuild the license catalog");
+    return rc;
+}
+
+int run_import_spdx(const char *src, const char *datadir, int debug) {
+    Import im;
+    memset(&im, 0, sizeof(im));
+    im.src = src;
+    im.datadir = datadir;
+    im.debug = debug;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/licenses", datadir);
+    int dir_rc = ensure_directory_exists(path);
+    snprintf(path, sizeof(path), "%s/descriptions", datadir);
+    if (dir_rc != 0 || ensure_directory_exists(path) != 0) {
+        char msg[4200];
+        snprintf(msg, sizeof(msg), "Unable to create the license directories of '%s'", datadir);
+        print_error(msg);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/%s", datadir, META_FILENAME);
+    if (meta_load(&im.old, path) != 0) {
+        print_error("Out of memory reading the license metadata");
+        return -1;
+    }
+
+    int rc = import_list(&im);
+    if (rc == -1) {
+        char msg[4200];
+        snprintf(msg, sizeof(msg), "Unable to read the SPDX license list '%s/json/licenses.json'", src);
+        print_error(msg);
+    }
+    if (rc == 0 && (assign_aliases(&im) != 0 || write_meta(&im) != 0)) {
+        char msg[4200];
+        snprintf(msg, sizeof(msg), "Failed to write %s/%s", datadir, META_FILENAME);
+        print_error(msg);
+        rc = -1;
+    }
+    if (rc == 0) rc = rebuild_indexes(&im);
+    if (rc == 0) {
+        printf("Imported %zu licenses from SPDX License List %s into %s (%zu written, %zu unchanged).\n",
+               im.count, im.version[0] ? im.version : "(unknown version)", datadir, im.written, im.unchanged);
+        printf("Skipped %zu shipped with osla, %zu deprecated, %zu with license files of their own, "
+               "%zu invalid; %zu failed.\n",
+               im.builtin, im.deprecated, im.kept, im.invalid, im.failed);
+        rc = im.failed ? 1 : 0;
+    }
+
+    meta_free(&im.old);
+    free(im.rows);
+    for (size_t i = 0; i < im.builtin_count; i++) free(im.builtin_families[i]);
+    free(im.builtin_families);
+    sb_free(&im.text);
+    sb_free(&im.desc);
+    sb_free(&im.tmpl);
+    sb_free(&im.license_text);
+    sb_free(&im.comments);
+    return rc < 0 ? -1 : rc;
+}
@@ -0,0 +1,28 @@
+/* File: src/spdx.h
+ *
+ * Header for the SPDX license list importer (--import-spdx).
+ *
+ * The importer reads a local checkout of the SPDX license-list-data
+ * repository (json/licenses.json, json/details/<id>.json and text/<id>.txt)
+ * and adds every license osla does not already ship to a data directory: a
+ * text under licenses/ with the SPDX template variables turned into the
+ * placeholder spellings of the default config, a description under
+ * descriptions/, and a row in licenses.tsv (see meta.h) with the SPDX id,
+ * category, OSI/FSF flags and a family alias ("cecill" for the latest
+ * CECILL version). Deprecated ids are not imported; they resolve through the
+ * "-only"/"-or-later" spellings of the ids that replaced them.
+ */
+
+#ifndef SPDX_H
+#define SPDX_H
+
+/* Imports the license list at src into datadir, then rebuilds the bundle and
+ * catalog of datadir that depend on it. Files that already hold the imported
+ * text are left alone, so running it again after an update of the list only
+ * rewrites what changed. License files of datadir that an earlier import did
+ * not write are never replaced. Returns 0 on success, 1 if some licenses could
+ * not be imported, -1 if the list cannot be read or datadir not written.
+ */
+int run_import_spdx(const char *src, const char *datadir, int debug);
+
+#endif /* SPDX_H */
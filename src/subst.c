@@ -0,0 +1,232 @@
+/* File: src/subst.c
+ *
+ * Implementation of the placeholder substitution engine.
+ *
+ * The token set is compiled into a trie over byte equivalence classes (bytes that
+ * never occur in a token share class 0, so the transition table stays small).
+ * Rendering skips literal runs with a scan for token lead bytes (SSE2 when
+ * available), walks the trie at each candidate and appends to a growable buffer,
+ * so a render is one pass over the template whatever the number of tokens.
+ */
+
+#include "subst.h"
+#include "trace.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Lead-byte sets up to this size are scanned with vector compares. */
+#define SUBST_SIMD_LEADS 4
+
+struct Subst {
+    uint8_t byte_class[256];
+    int class_count;
+    int32_t *next;          /* state * class_count + class -> state, -1 if none */
+    int32_t *accept;        /* state -> token index, -1 if not a token end */
+    int state_count;
+    SubstField *fields;     /* token index -> field */
+    size_t token_count;
+    uint8_t is_lead[256];
+    unsigned char leads[SUBST_SIMD_LEADS];
+    int lead_count;         /* number of distinct lead bytes */
+};
+
+static const char *const field_names[SUBST_FIELD_COUNT] = {
+    [SUBST_YEAR]    = "year",
+    [SUBST_AUTHOR]  = "author",
+    [SUBST_PROJECT] = "project",
+    [SUBST_URL]     = "url",
+};
+
+int subst_field_from_name(const char *name) {
+    for (int i = 0; i < SUBST_FIELD_COUNT; i++) {
+        if (strcmp(name, field_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+Subst *subst_compile(const SubstToken *tokens, size_t count) {
+    Subst *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+
+    /* Assign a class to every byte used by a token, and count trie states. */
+    size_t total_len = 0;
+    s->class_count = 1;
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char *t = (const unsigned char *)tokens[i].text;
+        for (; *t; t++, total_len++) {
+            if (s->byte_class[*t] == 0) {
+                s->byte_class[*t] = (uint8_t)s->class_count++;
+            }
+        }
+    }
+
+    size_t max_states = total_len + 1;
+    s->next = malloc(max_states * (size_t)s->class_count * sizeof(*s->next));
+    s->accept = malloc(max_states * sizeof(*s->accept));
+    s->fields = malloc((count ? count : 1) * sizeof(*s->fields));
+    if (!s->next || !s->accept || !s->fields) {
+        subst_free(s);
+        return NULL;
+    }
+    memset(s->next, 0xff, max_states * (size_t)s->class_count * sizeof(*s->next));
+    memset(s->accept, 0xff, max_states * sizeof(*s->accept));
+    s->state_count = 1;
+    s->token_count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char *t = (const unsigned char *)tokens[i].text;
+        s->fields[i] = tokens[i].field;
+        if (*t == '\0') continue;
+        if (!s->is_lead[*t]) {
+            s->is_lead[*t] = 1;
+            if (s->lead_count < SUBST_SIMD_LEADS) {
+                s->leads[s->lead_count] = *t;
+            }
+            s->lead_count++;
+        }
+        int32_t state = 0;
+        for (; *t; t++) {
+            int32_t *slot = &s->next[(size_t)state * s->class_count + s->byte_class[*t]];
+            if (*slot < 0) {
+                *slot = s->state_count++;
+            }
+            state = *slot;
+        }
+        /* Duplicate spellings keep the first declaration. */
+        if (s->accept[state] < 0) {
+            s->accept[state] = (int32_t)i;
+        }
+    }
+    return s;
+}
+
+Subst *subst_compile_config(const Config *config, const char *license) {
+    SubstToken tokens[CONFIG_MAX_TOKENS];
+    size_t count = 0;
+    /* Tokens of the license go first, so they win over a global token of the same spelling */
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < config->token_count; i++) {
+            const ConfigToken *t = &config->tokens[i];
+            int field = subst_field_from_name(t->field);
+            int matches = pass == 0 ? license && t->license[0] != '\0' && strcasecmp(t->license, license) == 0
+                                    : t->license[0] == '\0';
+            if (field < 0 || t->text[0] == '\0' || !matches) {
+                continue;
+            }
+            tokens[count].text = t->text;
+            tokens[count].field = (SubstField)field;
+            count++;
+        }
+    }
+    return subst_compile(tokens, count);
+}
+
+void subst_free(Subst *subst) {
+    if (!subst) return;
+    free(subst->next);
+    free(subst->accept);
+    free(subst->fields);
+    free(subst);
+}
+
+/* Returns the first byte in [p, end) that can start a token, or NULL. */
+static const char *find_lead(const Subst *s, const char *p, const char *end) {
+    if (s->lead_count == 0) {
+        return NULL;
+    }
+#if defined(__SSE2__)
+    if (s->lead_count <= SUBST_SIMD_LEADS) {
+        __m128i lead[SUBST_SIMD_LEADS];
+        for (int i = 0; i < s->lead_count; i++) {
+            lead[i] = _mm_set1_epi8((char)s->leads[i]);
+        }
+        while (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+            __m128i hit = _mm_cmpeq_epi8(chunk, lead[0]);
+            for (int i = 1; i < s->lead_count; i++) {
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, lead[i]));
+            }
+            int mask = _mm_movemask_epi8(hit);
+            if (mask) {
+                return p + __builtin_ctz((unsigned)mask);
+            }
+            p += 16;
+        }
+    }
+#endif
+    while (p < end && !s->is_lead[(unsigned char)*p]) {
+        p++;
+    }
+    return p < end ? p : NULL;
+}
+
+const char *subst_next(const Subst *subst, const char *p, const char *end,
+                       size_t *token, size_t *match_len) {
+    while ((p = find_lead(subst, p, end)) != NULL) {
+        int32_t state = 0;
+        int32_t best = -1;
+        size_t best_len = 0;
+        for (const char *q = p; q < end; q++) {
+            state = subst->next[(size_t)state * subst->class_count +
+                                subst->byte_class[(unsigned char)*q]];
+            if (state < 0) break;
+            if (subst->accept[state] >= 0) {
+                best = subst->accept[state];
+                best_len = (size_t)(q - p) + 1;
+            }
+        }
+        if (best >= 0) {
+            *token = (size_t)best;
+            *match_len = best_len;
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+SubstField subst_token_field(const Subst *subst, size_t token) {
+    return subst->fields[token];
+}
+
+static int render(const Subst *subst, const char *content, size_t len,
+                  const char *const values[SUBST_FIELD_COUNT], StrBuf *out) {
+    const char *p = content;
+    const char *end = content + len;
+    size_t value_len[SUBST_FIELD_COUNT];
+    for (int i = 0; i < SUBST_FIELD_COUNT; i++) {
+        value_len[i] = values[i] ? strlen(values[i]) : 0;
+    }
+    /* Most templates hold a handful of tokens; reserve once for the common case. */
+    if (sb_reserve(out, len + 64) != 0) {
+        return -1;
+    }
+    size_t token, match_len;
+    const char *hit;
+    while ((hit = subst_next(subst, p, end, &token, &match_len)) != NULL) {
+        SubstField field = subst->fields[token];
+        if (sb_append(out, p, (size_t)(hit - p)) != 0 ||
+            (value_len[field] && sb_append(out, values[field], value_len[field]) != 0)) {
+            return -1;
+        }
+        p = hit + match_len;
+    }
+    return sb_append(out, p, (size_t)(end - p));
+}
+
+int subst_render(const Subst *subst, const char *content, size_t len,
+                 const char *const values[SUBST_FIELD_COUNT], StrBuf *out) {
+    TraceSpan span;
+    trace_begin(&span, TRACE_SUBST);
+    int rc = render(subst, content, len, values, out);
+    trace_end(&span, len);
+    return rc;
+}
@@ -0,0 +1,66 @@
+/* File: src/subst.h
+ *
+ * Header for the placeholder substitution engine.
+ *
+ * A token set is compiled once into a byte-class trie automaton and then applied
+ * to any number of license texts in a single left-to-right pass.
+ */
+
+#ifndef SUBST_H
+#define SUBST_H
+
+#include <stddef.h>
+#include "config.h"
+#include "utils.h"
+
+/* Values a placeholder token can expand to. */
+typedef enum {
+    SUBST_YEAR,
+    SUBST_AUTHOR,
+    SUBST_PROJECT,
+    SUBST_URL,
+    SUBST_FIELD_COUNT
+} SubstField;
+
+typedef struct {
+    const char *text;
+    SubstField field;
+} SubstToken;
+
+typedef struct Subst Subst;
+
+/* Maps a config field name ("year", "author", "project", "url") to its SubstField.
+ * Returns -1 for unknown names.
+ */
+int subst_field_from_name(const char *name);
+
+/* Compiles a token set. Tokens must be non-empty; at each position the
+ * longest matching token wins. Returns NULL on allocation failure.
+ */
+Subst *subst_compile(const SubstToken *tokens, size_t count);
+
+/* Compiles the token set declared in the configuration: the tokens for every
+ * license, plus those declared for license (token=<field>@<license>:...)
+ * unless license is NULL.
+ */
+Subst *subst_compile_config(const Config *config, const char *license);
+
+void subst_free(Subst *subst);
+
+/* Finds the leftmost-longest token occurrence in [p, end).
+ * Returns a pointer to its start and stores the token index and length,
+ * or returns NULL when the rest of the text holds no token.
+ */
+const char *subst_next(const Subst *subst, const char *p, const char *end,
+                       size_t *token, size_t *match_len);
+
+/* Returns the field the given token index expands to. */
+SubstField subst_token_field(const Subst *subst, size_t token);
+
+/* Appends content with every token replaced by values[field] to out.
+ * Returns 0 on success, -1 on allocation failure.
+ */
+int subst_render(const Subst *subst, const char *content, size_t len,
+                 const char *const values[SUBST_FIELD_COUNT], StrBuf *out);
+
+#endif /* SUBST_H */
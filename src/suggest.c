@@ -0,0 +1,198 @@
+/* File: src/suggest.c
+ *
+ * Implementation of "did you mean" suggestions.
+ *
+ * The input is the pattern of the Myers kernel, so it is limited to 64
+ * characters; license names are far shorter. Names, titles, SPDX ids and
+ * aliases come from the catalog, and only licenses it lists are suggested,
+ * whatever names the built-in table knows.
+ */
+
+#define _GNU_SOURCE
+
+#include "suggest.h"
+#include "catalog.h"
+#include "names.h"
+#include "utils.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Number of suggestions offered in error messages */
+#define HINT_COUNT 3
+
+typedef struct {
+    uint64_t peq[256];      /* bit i set where input[i] matches the character */
+    size_t len;
+    int bound;              /* candidates further than this are dropped */
+    Suggestion *best;       /* sorted by distance, then license name */
+    size_t count, k;
+} Ranker;
+
+/* Largest distance still worth suggesting for an input of len characters */
+static int distance_bound(size_t len) {
+    if (len < 3) return 1;
+    return len / 3 > 2 ? (int)(len / 3) : 2;
+}
+
+/* Levenshtein distance between the input and text, or bound + 1 once it is
+ * certain to exceed bound (Myers 1999, in Hyyrö's formulation).
+ */
+static int myers_distance(const Ranker *r, const char *text, size_t n) {
+    size_t m = r->len;
+    if (n > m + (size_t)r->bound || m > n + (size_t)r->bound) {
+        return r->bound + 1;
+    }
+    uint64_t pv = ~0ULL, mv = 0, last = 1ULL << (m - 1);
+    int score = (int)m;
+    for (size_t j = 0; j < n; j++) {
+        uint64_t eq = r->peq[(unsigned char)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) {
+            score++;
+        } else if (mh & last) {
+            score--;
+        }
+        /* Row 0 of the matrix grows by one per character: a global alignment */
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        /* Each remaining character can lower the score by at most one */
+        if (score - (int)(n - j - 1) > r->bound) {
+            return r->bound + 1;
+        }
+    }
+    return score;
+}
+
+static int ranks_before(const Suggestion *a, const Suggestion *b) {
+    if (a->distance != b->distance) return a->distance < b->distance;
+    return strcasecmp(a->license, b->license) < 0;
+}
+
+/* Offers candidate text, standing for license, to the top-k list. */
+static void offer(Ranker *r, const char *text, size_t len, const char *license) {
+    int d = myers_distance(r, text, len);
+    if (d > r->bound) return;
+
+    Suggestion s;
+    snprintf(s.license, sizeof(s.license), "%s", license);
+    snprintf(s.matched, sizeof(s.matched), "%.*s", (int)(len < sizeof(s.matched) ? len : sizeof(s.matched) - 1), text);
+    s.distance = d;
+
+    /* One entry per license: drop a worse match of the same license first */
+    size_t at = r->count;
+    for (size_t i = 0; i < r->count; i++) {
+        if (strcasecmp(r->best[i].license, license) == 0) {
+            if (r->best[i].distance <= d) return;
+            at = i;
+            break;
+        }
+    }
+    if (at == r->count) {
+        if (r->count < r->k) {
+            r->count++;
+        } else if (!ranks_before(&s, &r->best[r->count - 1])) {
+            return;
+        }
+        at = r->count - 1;
+    }
+    while (at > 0 && ranks_before(&s, &r->best[at - 1])) {
+        r->best[at] = r->best[at - 1];
+        at--;
+    }
+    r->best[at] = s;
+    /* Once the list is full only closer candidates can get in */
+    if (r->count == r->k) r->bound = r->best[r->count - 1].distance;
+}
+
+size_t suggest_licenses(const Database *db, const char *input, Suggestion *out, size_t k) {
+    size_t len = strlen(input);
+    if (len == 0 || len > 64 || k == 0) return 0;
+
+    Ranker r;
+    memset(&r, 0, sizeof(r));
+    r.len = len;
+    r.bound = distance_bound(len);
+    r.best = out;
+    r.k = k;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)input[i];
+        r.peq[tolower(c)] |= 1ULL << i;
+        r.peq[toupper(c)] |= 1ULL << i;
+    }
+
+    Catalog cat;
+    if (catalog_open(&cat, db) != 0) return 0;
+    for (uint32_t i = 0; i < cat.header->count; i++) {
+        const char *name = catalog_str(&cat, cat.entries[i].name_off);
+        const char *title = catalog_str(&cat, cat.entries[i].title_off);
+        const char *spdx = catalog_str(&cat, cat.entries[i].spdx_off);
+        const char *aliases = catalog_str(&cat, cat.entries[i].aliases_off);
+        offer(&r, name, strlen(name), name);
+        if (*title) offer(&r, title, strlen(title), name);
+        if (*spdx) offer(&r, spdx, strlen(spdx), name);
+        /* Licenses the data directory adds have no name table entries */
+        for (const char *a = aliases; *a;) {
+            size_t n = strcspn(a, ",");
+            offer(&r, a, n, name);
+            a += n;
+            a += strspn(a, ", ");
+        }
+    }
+    for (uint32_t i = 0; i < name_entry_count; i++) {
+        const NameEntry *e = &name_entries[i];
+        if (catalog_find(&cat, e->license)) offer(&r, e->key, strlen(e->key), e->license);
+    }
+    for (int i = 0; db->site && i < db->site->alias_count; i++) {
+        const ConfigAlias *a = &db->site->aliases[i];
+        char resolved[64];
+        if (db_resolve_alias(db, a->alias, resolved, sizeof(resolved)) == 0 && catalog_find(&cat, resolved)) {
+            offer(&r, a->alias, strlen(a->alias), resolved);
+        }
+    }
+    catalog_close(&cat);
+    return r.count;
+}
+
+int suggest_hint(const Database *db, const char *input, char *buf, size_t size) {
+    Suggestion best[HINT_COUNT];
+    size_t n = suggest_licenses(db, input, best, HINT_COUNT);
+    if (size > 0) buf[0] = '\0';
+    if (n == 0) return -1;
+    StrBuf hint = {0};
+    sb_append_str(&hint, " Did you mean ");
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) sb_append_str(&hint, i + 1 == n ? " or " : ", ");
+        sb_append(&hint, "'", 1);
+        sb_append_str(&hint, best[i].license);
+        sb_append(&hint, "'", 1);
+    }
+    sb_append(&hint, "?", 1);
+    snprintf(buf, size, "%s", hint.data ? hint.data : "");
+    sb_free(&hint);
+    return 0;
+}
+
+int print_suggestions(const Database *db, const char *input, FILE *out) {
+    Suggestion best[SUGGEST_MAX];
+    size_t n = suggest_licenses(db, input, best, SUGGEST_MAX);
+    if (n == 0) {
+        fprintf(out, "No license resembles '%s'.\n", input);
+        return -1;
+    }
+    fprintf(out, "Suggestions for '%s':\n", input);
+    fprintf(out, "%-20s %-30s %s\n", "Short Name", "Matched", "Distance");
+    fprintf(out, "-------------------------------------------------------------\n");
+    for (size_t i = 0; i < n; i++) {
+        fprintf(out, "%-20s %-30s %d\n", best[i].license, best[i].matched, best[i].distance);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+/* File: src/suggest.h
+ *
+ * Header for "did you mean" suggestions.
+ *
+ * Ranks every license name, alias (built-in and site), SPDX identifier and
+ * description title by case-insensitive Levenshtein distance to a misspelled
+ * name. Distances are computed with Myers' bit-parallel algorithm: one 64-bit
+ * word holds a whole column of the edit-distance matrix, so each candidate
+ * costs a few instructions per character, and a candidate is abandoned as
+ * soon as it can no longer come within the distance bound.
+ */
+
+#ifndef SUGGEST_H
+#define SUGGEST_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "db.h"
+
+/* Suggestions printed by osla --suggest */
+#define SUGGEST_MAX 5
+
+typedef struct {
+    char license[64];       /* canonical license name */
+    char matched[64];       /* the name, alias or title closest to the input */
+    int distance;
+} Suggestion;
+
+/* Fills out with up to k licenses closest to input, nearest first, one per
+ * license. Candidates further than a bound that grows with the length of
+ * input are left out. Returns the number of suggestions.
+ */
+size_t suggest_licenses(const Database *db, const char *input, Suggestion *out, size_t k);
+
+/* Writes a " Did you mean 'a', 'b' or 'c'?" sentence for input into buf.
+ * Returns 0 if there was anything to suggest, -1 otherwise (buf is then empty).
+ */
+int suggest_hint(const Database *db, const char *input, char *buf, size_t size);
+
+/* Prints the suggestions for input to out as a table (osla --suggest).
+ * Returns 0 if there was anything to suggest, -1 otherwise.
+ */
+int print_suggestions(const Database *db, const char *input, FILE *out);
+
+#endif /* SUGGEST_H */
@@ -0,0 +1,520 @@
+/* File: src/template.c
+ *
+ * Implementation of compiled license templates.
+ *
+ * Compiling walks a license text once, taking whichever comes first of the
+ * next config token (found by the substitution automaton) and the next "{{".
+ * The whole text is copied into the text area and literal ops point into it,
+ * so markup bytes are simply never referenced. Sections are kept on a small
+ * stack while compiling; a section still open at the end of the text turns
+ * back into the literal text of its tag.
+ */
+
+#define _GNU_SOURCE
+
+#include "template.h"
+#include "cache.h"
+#include "trace.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/* Longest markup tag, braces included */
+#define TAG_MAX 24
+/* Deepest nesting of sections */
+#define SECTION_DEPTH 16
+
+/* The token set decides where the slots are, so it is part of the stamp */
+static uint64_t template_stamp(const Database *db, const Config *config) {
+    uint64_t h = db_dir_stamp(db);
+    if (h == 0) return 0;
+    for (int i = 0; i < config->token_count; i++) {
+        const ConfigToken *t = &config->tokens[i];
+        h = hash_fnv1a(h, t->field, strlen(t->field) + 1);
+        h = hash_fnv1a(h, t->license, strlen(t->license) + 1);
+        h = hash_fnv1a(h, t->text, strlen(t->text) + 1);
+    }
+    return h ? h : 1;
+}
+
+/* ---- compiler ---- */
+
+typedef struct {
+    StrBuf entries;
+    StrBuf ops;
+    StrBuf text;
+    int failed;
+    const Database *db;
+    const Config *config;
+    const Subst *global;
+} Builder;
+
+static int push_op(Builder *b, TemplateOpKind kind, int field, uint32_t off, uint32_t len) {
+    TemplateOp op;
+    memset(&op, 0, sizeof(op));
+    op.kind = (uint8_t)kind;
+    op.field = (uint8_t)field;
+    op.off = off;
+    op.len = len;
+    return sb_append(&b->ops, (const char *)&op, sizeof(op));
+}
+
+static TemplateOp *op_at(Builder *b, size_t index) {
+    return (TemplateOp *)b->ops.data + index;
+}
+
+/* Parses the tag at p ("{{name}}", "{{#name}}", "{{^name}}" or "{{/name}}").
+ * Returns its length and stores the sigil (or '\0') and field, or 0 if it is
+ * not a tag.
+ */
+static size_t parse_tag(const char *p, const char *end, char *sigil, int *field) {
+    const char *close = memmem(p + 2, (size_t)(end - p - 2) < TAG_MAX ? (size_t)(end - p - 2) : TAG_MAX, "}}", 2);
+    if (!close) return 0;
+    const char *name = p + 2;
+    *sigil = *name == '#' || *name == '^' || *name == '/' ? *name++ : '\0';
+    char buf[TAG_MAX];
+    size_t len = (size_t)(close - name);
+    if (len == 0 || len >= sizeof(buf)) return 0;
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+    *field = subst_field_from_name(buf);
+    return *field < 0 ? 0 : (size_t)(close + 2 - p);
+}
+
+static int compile_text(Builder *b, const Subst *subst, const char *text, size_t len) {
+    uint32_t base = (uint32_t)b->text.len;
+    if (sb_append(&b->text, text, len) != 0) return -1;
+    size_t first = b->ops.len / sizeof(TemplateOp);
+    size_t open[SECTION_DEPTH], depth = 0;
+    const char *end = text + len;
+    const char *lit = text, *p = text;
+    const char *tok = NULL, *mark = NULL;
+    size_t token = 0, tok_len = 0;
+    int rc = 0;
+
+    while (p < end && rc == 0) {
+        /* Each search is redone only once p has passed its last hit */
+        if (!tok || tok < p) {
+            tok = subst_next(subst, p, end, &token, &tok_len);
+            if (!tok) tok = end;
+        }
+        if (!mark || mark < p) {
+            mark = memmem(p, (size_t)(end - p), "{{", 2);
+            if (!mark) mark = end;
+        }
+        if (tok == end && mark == end) break;
+
+        if (mark <= tok) {
+            char sigil;
+            int field;
+            size_t tag_len = parse_tag(mark, end, &sigil, &field);
+            if (tag_len == 0) {
+                p = mark + 2;
+                continue;
+            }
+            const char *after = mark + tag_len;
+            /* A section tag alone on its line takes the newline with it */
+            if (sigil && (mark == text || mark[-1] == '\n') && after < end && *after == '\n') {
+                after++;
+            }
+            if (sigil == '/' && (depth == 0 || op_at(b, open[depth - 1])->field != field)) {
+                p = after;          /* a stray closing tag stays literal */
+                continue;
+            }
+            if (sigil == '#' || sigil == '^') {
+                if (depth == SECTION_DEPTH) {
+                    p = after;
+                    continue;
+                }
+            }
+            if (mark > lit) rc |= push_op(b, TEMPLATE_LITERAL, 0, base + (uint32_t)(lit - text), (uint32_t)(mark - lit));
+            uint32_t tag_off = base + (uint32_t)(mark - text), tag_span = (uint32_t)(after - mark);
+            if (sigil == '\0') {
+                rc |= push_op(b, TEMPLATE_SLOT, field, tag_off, tag_span);
+            } else if (sigil == '/') {
+                size_t begin = open[--depth];
+                op_at(b, begin)->skip = (uint32_t)(b->ops.len / sizeof(TemplateOp) - first);
+            } else {
+                open[depth++] = b->ops.len / sizeof(TemplateOp);
+                rc |= push_op(b, sigil == '#' ? TEMPLATE_IF : TEMPLATE_UNLESS, field, tag_off, tag_span);
+            }
+            p = lit = after;
+        } else {
+            if (tok > lit) rc |= push_op(b, TEMPLATE_LITERAL, 0, base + (uint32_t)(lit - text), (uint32_t)(tok - lit));
+            rc |= push_op(b, TEMPLATE_SLOT, subst_token_field(subst, token), base + (uint32_t)(tok - text), (uint32_t)tok_len);
+            p = lit = tok + tok_len;
+        }
+    }
+    if (end > lit) rc |= push_op(b, TEMPLATE_LITERAL, 0, base + (uint32_t)(lit - text), (uint32_t)(end - lit));
+    /* Unclosed sections are plain text after all */
+    while (rc == 0 && depth > 0) {
+        op_at(b, open[--depth])->kind = TEMPLATE_LITERAL;
+    }
+    return rc;
+}
+
+static int compile_license(const char *name, void *ctx) {
+    Builder *b = ctx;
+    DbText text;
+    if (db_get(b->db, DB_LICENSE, name, &text) != 0) return 0;
+
+    /* Licenses with spellings of their own get an automaton of their own */
+    Subst *own = NULL;
+    for (int i = 0; i < b->config->token_count && !own; i++) {
+        if (strcasecmp(b->config->tokens[i].license, name) == 0) {
+            own = subst_compile_config(b->config, name);
+            if (!own) {
+                db_text_release(&text);
+                b->failed = 1;
+                return -1;
+            }
+        }
+    }
+
+    TemplateEntry e;
+    memset(&e, 0, sizeof(e));
+    e.name_off = (uint32_t)b->text.len;
+    e.first_op = (uint32_t)(b->ops.len / sizeof(TemplateOp));
+    e.source = db_entry_stamp(b->db, DB_LICENSE, name);
+    int rc = sb_append(&b->text, name, strlen(name) + 1);
+    if (rc == 0) rc = compile_text(b, own ? own : b->global, text.data, text.len);
+    e.op_count = (uint32_t)(b->ops.len / sizeof(TemplateOp)) - e.first_op;
+    if (rc == 0) rc = sb_append(&b->entries, (const char *)&e, sizeof(e));
+    subst_free(own);
+    db_text_release(&text);
+    b->failed = rc != 0;
+    return rc;
+}
+
+static void pad8(StrBuf *sb) {
+    static const char zeros[8] = {0};
+    if (sb->len % 8) sb_append(sb, zeros, 8 - sb->len % 8);
+}
+
+/* Compiles every license into a serialized set in out. */
+static int build_image(const Database *db, const Config *config, uint64_t stamp, StrBuf *out) {
+    Builder b;
+    memset(&b, 0, sizeof(b));
+    b.db = db;
+    b.config = config;
+    b.global = subst_compile_config(config, NULL);
+    uint32_t *slots = NULL;
+    int rc = -1;
+    TraceSpan span;
+    trace_begin(&span, TRACE_SUBST);
+    if (!b.global || db_each(db, DB_LICENSE, compile_license, &b) != 0 || b.failed || b.text.len > UINT32_MAX) {
+        goto out;
+    }
+
+    TemplateHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TEMPLATE_MAGIC, sizeof(TEMPLATE_MAGIC));
+    h.version = TEMPLATE_VERSION;
+    h.count = (uint32_t)(b.entries.len / sizeof(TemplateEntry));
+    h.stamp = stamp;
+    h.op_count = b.ops.len / sizeof(TemplateOp);
+    h.slot_count = 16;
+    while (h.slot_count < (uint64_t)h.count * 2) h.slot_count *= 2;
+
+    sb_append(out, (const char *)&h, sizeof(h));
+    pad8(out);
+    h.entries_off = out->len;
+    sb_append(out, b.entries.data, b.entries.len);
+    pad8(out);
+    h.slots_off = out->len;
+    slots = calloc(h.slot_count, sizeof(*slots));
+    if (!slots) goto out;
+    const TemplateEntry *entries = (const TemplateEntry *)b.entries.data;
+    for (uint32_t i = 0; i < h.count; i++) {
+        const char *name = b.text.data + entries[i].name_off;
+        size_t at = (size_t)hash_casefold(name, strlen(name)) & (h.slot_count - 1);
+        while (slots[at]) at = (at + 1) & (h.slot_count - 1);
+        slots[at] = i + 1;
+    }
+    sb_append(out, (const char *)slots, h.slot_count * sizeof(*slots));
+    pad8(out);
+    h.ops_off = out->len;
+    sb_append(out, b.ops.data, b.ops.len);
+    pad8(out);
+    h.text_off = out->len;
+    if (sb_append(out, b.text.data, b.text.len) != 0 || sb_append(out, "", 1) != 0) goto out;
+    h.total_size = out->len;
+    memcpy(out->data, &h, sizeof(h));
+    rc = 0;
+
+out:
+    trace_end(&span, b.text.len);
+    free(slots);
+    subst_free((Subst *)b.global);
+    sb_free(&b.entries);
+    sb_free(&b.ops);
+    sb_free(&b.text);
+    return rc;
+}
+
+/* ---- reader ---- */
+
+static int set_attach(TemplateSet *set, const unsigned char *base, size_t size, uint64_t stamp) {
+    const TemplateHeader *h = (const TemplateHeader *)base;
+    if (size < sizeof(*h) || memcmp(h->magic, TEMPLATE_MAGIC, sizeof(TEMPLATE_MAGIC)) != 0 ||
+        h->version != TEMPLATE_VERSION || h->stamp != stamp || h->total_size != size ||
+        h->entries_off + (uint64_t)h->count * sizeof(TemplateEntry) > size ||
+        h->slot_count == 0 || (h->slot_count & (h->slot_count - 1)) != 0 || h->slot_count <= h->count ||
+        h->slots_off + h->slot_count * sizeof(uint32_t) > size ||
+        h->ops_off + h->op_count * sizeof(TemplateOp) > size || h->text_off >= size ||
+        base[size - 1] != '\0') {
+        return -1;
+    }
+    const TemplateEntry *entries = (const TemplateEntry *)(base + h->entries_off);
+    const uint32_t *slots = (const uint32_t *)(base + h->slots_off);
+    const TemplateOp *ops = (const TemplateOp *)(base + h->ops_off);
+    uint64_t text_len = size - h->text_off;
+    for (uint64_t i = 0; i < h->slot_count; i++) {
+        if (slots[i] > h->count) return -1;
+    }
+    for (uint64_t i = 0; i < h->op_count; i++) {
+        if ((uint64_t)ops[i].off + ops[i].len > text_len || ops[i].field >= SUBST_FIELD_COUNT ||
+            ops[i].kind > TEMPLATE_UNLESS) {
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < h->count; i++) {
+        const TemplateEntry *e = &entries[i];
+        if (e->name_off >= text_len || (uint64_t)e->first_op + e->op_count > h->op_count) {
+            return -1;
+        }
+        /* A section must skip forward within its template, or rendering never ends */
+        for (uint32_t j = 0; j < e->op_count; j++) {
+            const TemplateOp *op = &ops[e->first_op + j];
+            if ((op->kind == TEMPLATE_IF || op->kind == TEMPLATE_UNLESS) && (op->skip <= j || op->skip > e->op_count)) {
+                return -1;
+            }
+        }
+    }
+    set->base = base;
+    set->size = size;
+    set->header = h;
+    set->entries = entries;
+    set->slots = slots;
+    set->ops = ops;
+    set->text = (const char *)(base + h->text_off);
+    set->checked = calloc(h->count ? h->count : 1, 1);
+    return set->checked ? 0 : -1;
+}
+
+/* Compiles the set, saving it to the cache when there is one and the
+ * database is not the embedded one.
+ */
+static int set_build(TemplateSet *set, uint64_t stamp) {
+    StrBuf image = {0};
+    if (build_image(set->db, set->config, stamp, &image) != 0 ||
+        set_attach(set, (const unsigned char *)image.data, image.len, stamp) != 0) {
+        sb_free(&image);
+        return -1;
+    }
+    char path[600];
+    if (set->db->backend != DB_BACKEND_EMBEDDED &&
+        cache_path("templates", set->db->datadir, "tpl", path, sizeof(path)) == 0) {
+        cache_write(path, image.data, image.len);
+    }
+    set->heap = image.data;
+    return 0;
+}
+
+int template_set_open(TemplateSet *set, const Database *db, const Config *config) {
+    memset(set, 0, sizeof(*set));
+    set->db = db;
+    set->config = config;
+    uint64_t stamp = template_stamp(db, config);
+    char path[600];
+    const unsigned char *base;
+    size_t size;
+    /* The embedded database is compiled in memory: a run does no file I/O for it */
+    if (db->backend != DB_BACKEND_EMBEDDED &&
+        cache_path("templates", db->datadir, "tpl", path, sizeof(path)) == 0 && cache_map(path, &base, &size) == 0) {
+        if (set_attach(set, base, size, stamp) == 0) return 0;
+        cache_unmap(base, size);
+    }
+    return set_build(set, stamp);
+}
+
+void template_set_close(TemplateSet *set) {
+    if (set->heap) {
+        free(set->heap);
+    } else if (set->base) {
+        cache_unmap(set->base, set->size);
+    }
+    free(set->checked);
+    memset(set, 0, sizeof(*set));
+}
+
+const TemplateEntry *template_find(const TemplateSet *set, const char *name) {
+    if (!set->header) return NULL;
+    size_t mask = (size_t)set->header->slot_count - 1;
+    for (size_t at = (size_t)hash_casefold(name, strlen(name)) & mask; set->slots[at]; at = (at + 1) & mask) {
+        const TemplateEntry *e = &set->entries[set->slots[at] - 1];
+        if (strcasecmp(set->text + e->name_off, name) == 0) return e;
+    }
+    return NULL;
+}
+
+const TemplateEntry *template_get(TemplateSet *set, const char *name) {
+    const TemplateEntry *t = template_find(set, name);
+    if (!t || set->checked[t - set->entries]) return t;
+    /* The stored name is the file's, whatever case the caller used */
+    if (db_entry_stamp(set->db, DB_LICENSE, set->text + t->name_off) != t->source) {
+        /* Edited in place: the directory stamp cannot tell, so recompile everything */
+        const Database *db = set->db;
+        const Config *config = set->config;
+        template_set_close(set);
+        set->db = db;
+        set->config = config;
+        if (set_build(set, template_stamp(db, config)) != 0) return NULL;
+        t = template_find(set, name);
+        if (!t) return NULL;
+    }
+    set->checked[t - set->entries] = 1;
+    return t;
+}
+
+/* ---- rendering ---- */
+
+/* Rewrites a year ending in '-' as a range up to the current year. */
+static void format_year(char *out, size_t size, const char *year) {
+    size_t len = strlen(year);
+    if (len == 0 || year[len - 1] != '-') {
+        snprintf(out, size, "%s", year);
+        return;
+    }
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char current[16];
+    snprintf(current, sizeof(current), "%d", tm.tm_year + 1900);
+    if (len - 1 == strlen(current) && strncmp(year, current, len - 1) == 0) {
+        snprintf(out, size, "%s", current);
+    } else {
+        snprintf(out, size, "%s%s", year, current);
+    }
+}
+
+/* Lists the ';'-separated holders as "A", "A and B" or "A, B and C". */
+static void format_holders(char *out, size_t size, const char *author) {
+    const char *names[32];
+    size_t lens[32], count = 0;
+    for (const char *p = author; *p && count < 32;) {
+        const char *semi = strchr(p, ';');
+        const char *stop = semi ? semi : p + strlen(p);
+        const char *q = p;
+        while (q < stop && (*q == ' ' || *q == '\t')) q++;
+        const char *e = stop;
+        while (e > q && (e[-1] == ' ' || e[-1] == '\t')) e--;
+        if (e > q) {
+            names[count] = q;
+            lens[count++] = (size_t)(e - q);
+        }
+        p = semi ? semi + 1 : stop;
+    }
+    size_t used = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < count && used < size; i++) {
+        const char *sep = i == 0 ? "" : i + 1 == count ? " and " : ", ";
+        int n = snprintf(out + used, size - used, "%s%.*s", sep, (int)lens[i], names[i]);
+        if (n < 0) break;
+        used += (size_t)n;
+    }
+}
+
+void template_values(TemplateValues *values, const Config *config, const char *year, const char *author) {
+    format_year(values->year, sizeof(values->year), year ? year : config->year);
+    format_holders(values->author, sizeof(values->author), author ? author : config->author);
+    values->values[SUBST_YEAR] = values->year;
+    values->values[SUBST_AUTHOR] = values->author;
+    values->values[SUBST_PROJECT] = config->project;
+    values->values[SUBST_URL] = config->url;
+    for (int i = 0; i < SUBST_FIELD_COUNT; i++) {
+        values->lengths[i] = strlen(values->values[i]);
+    }
+}
+
+/* Returns the next span of rendered text at or after op *i of ops, advancing
+ * *i past it, or 0 once the ops are exhausted.
+ */
+static int next_span(const TemplateSet *set, const TemplateOp *ops, uint32_t count, const TemplateValues *values,
+                     uint32_t *i, const char **data, size_t *len) {
+    while (*i < count) {
+        const TemplateOp *op = &ops[*i];
+        switch (op->kind) {
+        case TEMPLATE_LITERAL:
+            (*i)++;
+            *data = set->text + op->off;
+            *len = op->len;
+            return 1;
+        case TEMPLATE_SLOT:
+            (*i)++;
+            if (values->lengths[op->field]) {
+                *data = values->values[op->field];
+                *len = values->lengths[op->field];
+                return 1;
+            }
+            break;
+        case TEMPLATE_IF:
+            *i = values->lengths[op->field] ? *i + 1 : op->skip;
+            break;
+        default:
+            *i = values->lengths[op->field] ? op->skip : *i + 1;
+            break;
+        }
+    }
+    return 0;
+}
+
+size_t template_iov(const TemplateSet *set, const TemplateEntry *t, const TemplateValues *values, struct iovec *iov) {
+    TraceSpan span;
+    trace_begin(&span, TRACE_SUBST);
+    const TemplateOp *ops = set->ops + t->first_op;
+    size_t n = 0, bytes = 0, len;
+    const char *data;
+    for (uint32_t i = 0; next_span(set, ops, t->op_count, values, &i, &data, &len);) {
+        iov[n].iov_base = (void *)data;
+        iov[n++].iov_len = len;
+        bytes += len;
+    }
+    trace_end(&span, bytes);
+    return n;
+}
+
+size_t template_copy(const TemplateSet *set, const TemplateEntry *t, const TemplateValues *values, char *buf,
+                     size_t size) {
+    TraceSpan span;
+    trace_begin(&span, TRACE_SUBST);
+    const TemplateOp *ops = set->ops + t->first_op;
+    size_t total = 0, len;
+    const char *data;
+    for (uint32_t i = 0; next_span(set, ops, t->op_count, values, &i, &data, &len);) {
+        if (total + len <= size) memcpy(buf + total, data, len);
+        total += len;
+    }
+    if (total < size) buf[total] = '\0';
+    trace_end(&span, total);
+    return total;
+}
+
+int template_render(const TemplateSet *set, const TemplateEntry *t, const TemplateValues *values, StrBuf *out) {
+    struct iovec stack[64];
+    struct iovec *iov = t->op_count <= 64 ? stack : malloc(t->op_count * sizeof(*iov));
+    if (!iov) return -1;
+    size_t n = template_iov(set, t, values, iov), len = 0;
+    for (size_t i = 0; i < n; i++) len += iov[i].iov_len;
+    /* One allocation; an empty render still leaves out NUL-terminated */
+    int rc = sb_reserve(out, len);
+    for (size_t i = 0; i < n && rc == 0; i++) {
+        rc = sb_append(out, iov[i].iov_base, iov[i].iov_len);
+    }
+    if (rc == 0 && n == 0) rc = sb_append(out, "", 0);
+    if (iov != stack) free(iov);
+    return rc;
+}
@@ -0,0 +1,137 @@
+/* File: src/template.h
+ *
+ * Header for compiled license templates.
+ *
+ * Every license text is compiled once into literal spans, typed slots and
+ * conditional sections, so a render only fills in the slots and hands the
+ * spans to one vectored write; the text is never scanned again. Slots come
+ * from the placeholder spellings of the config (token=, including the
+ * per-license token=<field>@<license>:<spelling>) and from markup a license
+ * file may carry:
+ *
+ *   {{year}} {{author}} {{project}} {{url}}   a slot
+ *   {{#url}} ... {{/url}}                      kept only when url is set
+ *   {{^url}} ... {{/url}}                      kept only when url is not set
+ *
+ * A section tag alone on its line takes its newline with it. Markup that does
+ * not parse and sections that are never closed stay literal text. The compiled
+ * set of all licenses is cached under ~/.cache/osla and rebuilt when the data
+ * directory or the token set changes.
+ */
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "config.h"
+#include "db.h"
+#include "subst.h"
+#include "utils.h"
+
+#define TEMPLATE_MAGIC "OSLATPL"
+#define TEMPLATE_VERSION 1
+
+typedef enum {
+    TEMPLATE_LITERAL,       /* len bytes at off in the text area */
+    TEMPLATE_SLOT,          /* the value of field */
+    TEMPLATE_IF,            /* section kept when field is set */
+    TEMPLATE_UNLESS         /* section kept when field is not set */
+} TemplateOpKind;
+
+typedef struct {
+    uint8_t kind;           /* TemplateOpKind */
+    uint8_t field;          /* SubstField of slots and sections */
+    uint16_t reserved;
+    uint32_t skip;          /* sections: index of the first op after the section */
+    uint32_t off;
+    uint32_t len;
+} TemplateOp;
+
+typedef struct {
+    uint32_t name_off;
+    uint32_t first_op;
+    uint32_t op_count;      /* ops of this template; skip indexes count from first_op */
+    uint32_t reserved;
+    uint64_t source;        /* db_entry_stamp() of the license when compiled */
+} TemplateEntry;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t stamp;         /* db_dir_stamp() mixed with the token set */
+    uint64_t entries_off;   /* TemplateEntry[count] */
+    uint64_t slots_off;     /* uint32_t[slot_count]: entry index + 1 by name hash, 0 if empty */
+    uint64_t slot_count;    /* a power of two, at most half full */
+    uint64_t ops_off;       /* TemplateOp[op_count] */
+    uint64_t op_count;
+    uint64_t text_off;      /* literal text and names */
+    uint64_t total_size;
+} TemplateHeader;
+
+typedef struct {
+    const unsigned char *base;
+    size_t size;
+    const TemplateHeader *header;
+    const TemplateEntry *entries;
+    const uint32_t *slots;
+    const TemplateOp *ops;
+    const char *text;
+    char *heap;             /* set when the image lives in memory instead of a mapping */
+    unsigned char *checked; /* per entry: source verified by template_get() */
+    const Database *db;
+    const Config *config;
+} TemplateSet;
+
+/* Slot values of one render. */
+typedef struct {
+    char year[32];
+    char author[512];
+    const char *values[SUBST_FIELD_COUNT];
+    size_t lengths[SUBST_FIELD_COUNT];
+} TemplateValues;
+
+/* Opens the compiled templates of every license in db for the token set of
+ * config, from the cache if it is current, else compiled now (and cached,
+ * except for the embedded database, which is always compiled in memory).
+ * db and config must outlive the set. Returns 0 on success, -1 if the
+ * licenses cannot be read.
+ */
+int template_set_open(TemplateSet *set, const Database *db, const Config *config);
+
+void template_set_close(TemplateSet *set);
+
+/* Finds the template of a license name (case-insensitive), or NULL. */
+const TemplateEntry *template_find(const TemplateSet *set, const char *name);
+
+/* Like template_find(), but first checks that the license file has not been
+ * edited since it was compiled, recompiling the set if it has. Each license is
+ * checked once per set. A recompile invalidates earlier entries, and name must
+ * not point into the set.
+ */
+const TemplateEntry *template_get(TemplateSet *set, const char *name);
+
+/* Prepares the slot values from config, with year and author overriding the
+ * config's when not NULL. A year such as "2019-" runs to the current year
+ * ("2019-2026"); holders separated by ';' are listed as "A, B and C".
+ */
+void template_values(TemplateValues *values, const Config *config, const char *year, const char *author);
+
+/* Fills iov, which must have room for t->op_count spans, with the rendered
+ * text of t. Returns the number of spans used.
+ */
+size_t template_iov(const TemplateSet *set, const TemplateEntry *t, const TemplateValues *values, struct iovec *iov);
+
+/* Copies the rendered text of t into buf, NUL-terminated when there is room.
+ * Returns its length; if that is more than size, buf holds only part of it and
+ * the caller retries with a larger buffer. Allocates nothing.
+ */
+size_t template_copy(const TemplateSet *set, const TemplateEntry *t, const TemplateValues *values, char *buf,
+                     size_t size);
+
+/* Appends the rendered text of t to out. Returns 0 on success, -1 on allocation failure. */
+int template_render(const TemplateSet *set, const TemplateEntry *t, const TemplateValues *values, StrBuf *out);
+
+#endif /* TEMPLATE_H */
@@ -0,0 +1,240 @@
+/* File: src/trace.c
+ *
+ * Implementation of phase timing and trace output.
+ *
+ * Spans are appended to one event list under a mutex; per-phase totals are
+ * kept alongside for the summary. System calls are the read/write call
+ * counters (syscr + syscw) of /proc/self/io, sampled through a descriptor held
+ * open for the whole run. They are process-wide, and each sample is itself a
+ * read, so the samples taken while a span was open are subtracted.
+ */
+
+#define _GNU_SOURCE
+
+#include "trace.h"
+#include "io.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Events beyond this are still counted in the summary but not written out */
+#define TRACE_MAX_EVENTS 1000000
+
+typedef struct {
+    int phase;              /* -1: instant message */
+    int tid;
+    double ts_us;
+    double dur_us;
+    size_t bytes;
+    unsigned long long syscalls;
+    char *message;
+} TraceEvent;
+
+typedef struct {
+    unsigned long long count;
+    double total_us;
+    unsigned long long bytes;
+    unsigned long long syscalls;
+} PhaseTotals;
+
+static const char *const phase_names[TRACE_PHASE_COUNT] = {
+    [TRACE_CONFIG_LOAD]  = "config load",
+    [TRACE_DATADIR]      = "data-dir resolution",
+    [TRACE_DIR_SCAN]     = "directory scan",
+    [TRACE_FILE_READ]    = "file read",
+    [TRACE_SUBST]        = "placeholder substitution",
+    [TRACE_OUTPUT_WRITE] = "output write",
+};
+
+int trace_active;
+
+static char *trace_file;
+static int trace_stats;
+static int io_fd = -1;
+static struct timespec epoch;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceEvent *events;
+static size_t event_count, event_cap;
+static PhaseTotals totals[TRACE_PHASE_COUNT];
+static atomic_ullong io_samples;
+static _Thread_local int thread_id;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)(ts.tv_sec - epoch.tv_sec) * 1e6 + (double)(ts.tv_nsec - epoch.tv_nsec) / 1e3;
+}
+
+static int current_tid(void) {
+    if (thread_id == 0) thread_id = (int)syscall(SYS_gettid);
+    return thread_id;
+}
+
+/* Returns syscr + syscw from /proc/self/io, or 0 when unavailable. */
+static unsigned long long read_io_calls(void) {
+    if (io_fd < 0) return 0;
+    char buf[512];
+    ssize_t n = pread(io_fd, buf, sizeof(buf) - 1, 0);
+    atomic_fetch_add(&io_samples, 1);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+    unsigned long long total = 0;
+    const char *p = strstr(buf, "syscr: ");
+    if (p) total += strtoull(p + 7, NULL, 10);
+    p = strstr(buf, "syscw: ");
+    if (p) total += strtoull(p + 7, NULL, 10);
+    return total;
+}
+
+static void add_event(const TraceEvent *ev) {
+    pthread_mutex_lock(&trace_lock);
+    if (ev->phase >= 0) {
+        PhaseTotals *t = &totals[ev->phase];
+        t->count++;
+        t->total_us += ev->dur_us;
+        t->bytes += ev->bytes;
+        t->syscalls += ev->syscalls;
+    }
+    if (trace_file && event_count < TRACE_MAX_EVENTS) {
+        if (event_count == event_cap) {
+            size_t cap = event_cap ? event_cap * 2 : 1024;
+            TraceEvent *grown = realloc(events, cap * sizeof(*grown));
+            if (grown) {
+                events = grown;
+                event_cap = cap;
+            }
+        }
+        if (event_count < event_cap) {
+            events[event_count++] = *ev;
+            pthread_mutex_unlock(&trace_lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    free(ev->message);
+}
+
+int trace_start(const char *trace_path, int stats) {
+    if (trace_path) {
+        trace_file = strdup(trace_path);
+        if (!trace_file) return -1;
+    }
+    trace_stats = stats;
+    clock_gettime(CLOCK_MONOTONIC, &epoch);
+    io_fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    atexit(trace_finish);
+    trace_active = 1;
+    return 0;
+}
+
+void trace_begin_slow(TraceSpan *span, TracePhase phase) {
+    span->phase = (int)phase;
+    span->syscalls = read_io_calls();
+    span->samples = atomic_load(&io_samples);
+    span->start_us = now_us();
+}
+
+void trace_end_slow(TraceSpan *span, size_t bytes) {
+    TraceEvent ev = {0};
+    ev.phase = span->phase;
+    ev.tid = current_tid();
+    ev.ts_us = span->start_us;
+    ev.dur_us = now_us() - span->start_us;
+    ev.bytes = bytes;
+    unsigned long long calls = read_io_calls();
+    /* Samples taken in between, counting the one that opened this span */
+    unsigned long long own = atomic_load(&io_samples) - span->samples;
+    ev.syscalls = calls > span->syscalls + own ? calls - span->syscalls - own : 0;
+    span->phase = -1;
+    add_event(&ev);
+}
+
+void trace_message(const char *message) {
+    if (!trace_active || !trace_file) return;
+    TraceEvent ev = {0};
+    ev.phase = -1;
+    ev.tid = current_tid();
+    ev.ts_us = now_us();
+    ev.message = strdup(message);
+    if (ev.message) add_event(&ev);
+}
+
+static void write_json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void write_trace(void) {
+    FILE *fp = fopen(trace_file, "w");
+    if (!fp) {
+        char errmsg[512];
+        snprintf(errmsg, sizeof(errmsg), "Unable to write trace file '%s'", trace_file);
+        print_error(errmsg);
+        return;
+    }
+    int pid = (int)getpid();
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t i = 0; i < event_count; i++) {
+        const TraceEvent *ev = &events[i];
+        if (ev->phase >= 0) {
+            fprintf(fp, "{\"name\": \"%s\", \"cat\": \"osla\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+                        "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"bytes\": %zu, \"syscalls\": %llu}}",
+                    phase_names[ev->phase], pid, ev->tid, ev->ts_us, ev->dur_us, ev->bytes, ev->syscalls);
+        } else {
+            fprintf(fp, "{\"name\": ");
+            write_json_string(fp, ev->message);
+            fprintf(fp, ", \"cat\": \"debug\", \"ph\": \"i\", \"s\": \"t\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f}",
+                    pid, ev->tid, ev->ts_us);
+        }
+        fprintf(fp, "%s\n", i + 1 < event_count ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+    if (fclose(fp) != 0) {
+        print_error("Failed to write the trace file");
+    }
+}
+
+static void print_stats(void) {
+    fprintf(stderr, "%-26s %8s %12s %12s %10s\n", "Phase", "Count", "Total ms", "Bytes", "Syscalls");
+    fprintf(stderr, "---------------------------------------------------------------------\n");
+    for (int p = 0; p < TRACE_PHASE_COUNT; p++) {
+        const PhaseTotals *t = &totals[p];
+        if (t->count == 0) continue;
+        fprintf(stderr, "%-26s %8llu %12.3f %12llu %10llu\n", phase_names[p], t->count,
+                t->total_us / 1e3, t->bytes, t->syscalls);
+    }
+    fprintf(stderr, "%-26s %8s %12.3f\n", "wall time", "", now_us() / 1e3);
+}
+
+void trace_finish(void) {
+    if (!trace_active) return;
+    trace_active = 0;
+    pthread_mutex_lock(&trace_lock);
+    if (trace_file) write_trace();
+    if (trace_stats) print_stats();
+    for (size_t i = 0; i < event_count; i++) free(events[i].message);
+    free(events);
+    events = NULL;
+    event_count = event_cap = 0;
+    free(trace_file);
+    trace_file = NULL;
+    pthread_mutex_unlock(&trace_lock);
+    if (io_fd >= 0) close(io_fd);
+    io_fd = -1;
+}
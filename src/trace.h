@@ -0,0 +1,63 @@
+/* File: src/trace.h
+ *
+ * Header for phase timing and trace output.
+ *
+ * Code brackets each phase of work (config load, data-dir resolution,
+ * directory scans, file reads, placeholder substitution, output writes) in
+ * a span. When tracing is off, a span costs one load and branch of a global
+ * flag, so the calls stay compiled into release builds. When it is on, each
+ * span records its wall time, the bytes it handled and the read/write system
+ * calls the process made meanwhile, for a --stats summary and a Chrome
+ * trace-event file (--trace=<file>, viewable in chrome://tracing or Perfetto).
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+
+typedef enum {
+    TRACE_CONFIG_LOAD,
+    TRACE_DATADIR,
+    TRACE_DIR_SCAN,
+    TRACE_FILE_READ,
+    TRACE_SUBST,
+    TRACE_OUTPUT_WRITE,
+    TRACE_PHASE_COUNT
+} TracePhase;
+
+typedef struct {
+    int phase;              /* -1 when tracing was off at trace_begin() */
+    double start_us;
+    unsigned long long syscalls;
+    unsigned long long samples;
+} TraceSpan;
+
+extern int trace_active;
+
+/* Turns tracing on. trace_path (may be NULL) receives the trace-event JSON and
+ * stats requests the summary table on stderr; both are written by
+ * trace_finish(), which is registered with atexit(). Returns 0 on success.
+ */
+int trace_start(const char *trace_path, int stats);
+
+/* Writes the trace file and the summary table. Safe to call more than once. */
+void trace_finish(void);
+
+void trace_begin_slow(TraceSpan *span, TracePhase phase);
+void trace_end_slow(TraceSpan *span, size_t bytes);
+
+/* Records a free-text instant event (used for debug messages). */
+void trace_message(const char *message);
+
+static inline void trace_begin(TraceSpan *span, TracePhase phase) {
+    span->phase = -1;
+    if (__builtin_expect(trace_active, 0)) trace_begin_slow(span, phase);
+}
+
+/* Closes a span; bytes is the amount of data the phase read or produced. */
+static inline void trace_end(TraceSpan *span, size_t bytes) {
+    if (__builtin_expect(span->phase >= 0, 0)) trace_end_slow(span, bytes);
+}
+
+#endif /* TRACE_H */
@@ -2,7 +2,7 @@
  *
  * Implementation of utility functions.
  *
- * Includes functions for trimming strings and ensuring directory existence.
+ * Includes functions for trimming strings, growable buffers and ensuring directory existence.
  */
 
 #include "utils.h"
@@ -10,6 +10,8 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <dirent.h>
 
 /* A simple implementation to ensure a directory exists.
  * Uses mkdir on POSIX systems.
@@ -30,3 +32,131 @@ int ensure_directory_exists(const char *path) {
     return 0;
 }
 
+
+int sb_reserve(StrBuf *sb, size_t extra) {
+    if (sb->len + extra + 1 <= sb->cap) {
+        return 0;
+    }
+    size_t cap = sb->cap ? sb->cap : 256;
+    while (cap < sb->len + extra + 1) {
+        cap *= 2;
+    }
+    char *data = realloc(sb->data, cap);
+    if (!data) {
+        return -1;
+    }
+    sb->data = data;
+    sb->cap = cap;
+    return 0;
+}
+
+int sb_append(StrBuf *sb, const char *data, size_t len) {
+    if (sb_reserve(sb, len) != 0) {
+        return -1;
+    }
+    memcpy(sb->data + sb->len, data, len);
+    sb->len += len;
+    sb->data[sb->len] = '\0';
+    return 0;
+}
+
+void sb_free(StrBuf *sb) {
+    free(sb->data);
+    sb->data = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+}
+
+uint64_t hash_fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV1A_PRIME;
+    }
+    return h;
+}
+
+char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return NULL;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    long filesize = ftell(fp);
+    if (filesize < 0) {
+        fclose(fp);
+        return NULL;
+    }
+    rewind(fp);
+    char *buffer = malloc((size_t)filesize + 1);
+    if (!buffer) {
+        fclose(fp);
+        return NULL;
+    }
+    if (fread(buffer, 1, (size_t)filesize, fp) != (size_t)filesize) {
+        free(buffer);
+        fclose(fp);
+        return NULL;
+    }
+    buffer[filesize] = '\0';
+    fclose(fp);
+    if (len) {
+        *len = (size_t)filesize;
+    }
+    return buffer;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int list_dir_stems(const char *dir, const char *suffix, char ***names, size_t *count) {
+    *names = NULL;
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) {
+        return -1;
+    }
+    size_t suffix_len = strlen(suffix);
+    size_t cap = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        #ifdef DT_REG
+        if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) continue;
+        #endif
+        size_t len = strlen(entry->d_name);
+        if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, suffix) != 0) continue;
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 32;
+            char **grown = realloc(*names, cap * sizeof(*grown));
+            if (!grown) {
+                closedir(d);
+                free_names(*names, *count);
+                *names = NULL;
+                *count = 0;
+                return -1;
+            }
+            *names = grown;
+        }
+        char *stem = malloc(len - suffix_len + 1);
+        if (!stem) continue;
+        memcpy(stem, entry->d_name, len - suffix_len);
+        stem[len - suffix_len] = '\0';
+        (*names)[(*count)++] = stem;
+    }
+    closedir(d);
+    if (*count > 1) {
+        qsort(*names, *count, sizeof(**names), compare_names);
+    }
+    return 0;
+}
+
+void free_names(char **names, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
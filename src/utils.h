@@ -9,6 +9,7 @@
 #define UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 /* Trims newline characters from the end of a string */
@@ -20,6 +21,63 @@ static inline void trim_newline(char *str) {
     }
 }
 
+/* Growable byte buffer. The contents are always NUL-terminated once anything
+ * has been appended, so data can be handed out as a C string.
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} StrBuf;
+
+/* Makes room for at least extra more bytes. Returns 0 on success, -1 on allocation failure. */
+int sb_reserve(StrBuf *sb, size_t extra);
+
+/* Appends len bytes from data. Returns 0 on success, -1 on allocation failure. */
+int sb_append(StrBuf *sb, const char *data, size_t len);
+
+/* Appends a NUL-terminated string. */
+static inline int sb_append_str(StrBuf *sb, const char *str) {
+    return sb_append(sb, str, strlen(str));
+}
+
+/* Releases the buffer and resets it to empty. */
+void sb_free(StrBuf *sb);
+
+/* Starting value and multiplier of a 64-bit FNV-1a hash */
+#define FNV1A_INIT 0xcbf29ce484222325ULL
+#define FNV1A_PRIME 0x100000001b3ULL
+
+/* Folds len bytes into the 64-bit FNV-1a hash h (start from FNV1A_INIT), so
+ * several fields can be chained into one stamp.
+ */
+uint64_t hash_fnv1a(uint64_t h, const void *data, size_t len);
+
+/* 64-bit FNV-1a hash of len bytes, ASCII case-folded so lookups can be case-insensitive. */
+static inline uint64_t hash_casefold(const char *data, size_t len) {
+    uint64_t h = FNV1A_INIT;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c >= 'A' && c <= 'Z') c = (unsigned char)(c + ('a' - 'A'));
+        h ^= c;
+        h *= FNV1A_PRIME;
+    }
+    return h;
+}
+
+/* Reads a whole file into a NUL-terminated buffer and stores its size in len (if non-NULL).
+ * Returns NULL if the file cannot be read. Caller must free the returned buffer.
+ */
+char *read_file(const char *path, size_t *len);
+
+/* Collects the names of regular files in dir ending in suffix, with the suffix
+ * stripped, sorted by strcmp. Returns 0 on success (names may be empty),
+ * -1 if the directory cannot be read. Free the result with free_names().
+ */
+int list_dir_stems(const char *dir, const char *suffix, char ***names, size_t *count);
+
+void free_names(char **names, size_t count);
+
 /* Ensures that the specified directory exists.
  * Returns 0 if the directory exists or was created, non-zero on error.
  */
@@ -0,0 +1,381 @@
+/* File: src/walk.c
+ *
+ * Implementation of the parallel directory walker.
+ */
+
+#define _GNU_SOURCE
+
+#include "walk.h"
+#include "io.h"
+#include "pool.h"
+#include "trace.h"
+#include "utils.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define DENTS_BUF_SIZE 32768
+
+/* Kernel record returned by getdents64 */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* A value returned by a visit for the subdirectories to inherit. refs counts
+ * the directories queued or running under it, the scopes nested in it and,
+ * while it queues its subdirectories, the directory that returned it.
+ */
+typedef struct Scope {
+    const void *value;
+    struct Scope *parent;
+    atomic_long refs;
+} Scope;
+
+typedef struct {
+    char *path;
+    Scope *scope;           /* NULL at the root */
+} WalkTask;
+
+/* Owner pushes and pops at the tail; thieves take from the head. */
+typedef struct {
+    pthread_mutex_t lock;
+    WalkTask *items;
+    size_t head, tail, cap;
+} Deque;
+
+typedef struct {
+    Deque *deques;
+    int workers;
+    atomic_long pending;    /* queued or running directories */
+    atomic_int next_id;
+    atomic_long unreadable; /* directories that could not be listed */
+    /* Idle workers sleep on idle_cond until work_gen moves or pending drops to 0 */
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    atomic_ulong work_gen;
+    atomic_int sleepers;
+    WalkVisit visit;
+    WalkRelease release;
+    void *ctx;
+} Walker;
+
+static int deque_push(Deque *dq, WalkTask task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail == dq->cap) {
+        /* Compact before growing */
+        if (dq->head > 0) {
+            memmove(dq->items, dq->items + dq->head, (dq->tail - dq->head) * sizeof(*dq->items));
+            dq->tail -= dq->head;
+            dq->head = 0;
+        }
+        if (dq->tail == dq->cap) {
+            size_t cap = dq->cap ? dq->cap * 2 : 64;
+            WalkTask *grown = realloc(dq->items, cap * sizeof(*grown));
+            if (!grown) {
+                pthread_mutex_unlock(&dq->lock);
+                return -1;
+            }
+            dq->items = grown;
+            dq->cap = cap;
+        }
+    }
+    dq->items[dq->tail++] = task;
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+static int deque_pop(Deque *dq, WalkTask *task) {
+    int ok = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail > dq->head) {
+        *task = dq->items[--dq->tail];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return ok;
+}
+
+static int deque_steal(Deque *dq, WalkTask *task) {
+    int ok = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail > dq->head) {
+        *task = dq->items[dq->head++];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return ok;
+}
+
+static void scope_ref(Scope *scope) {
+    if (scope) atomic_fetch_add(&scope->refs, 1);
+}
+
+/* Drops a reference; the last one releases the value and the scope's own
+ * reference to its parent.
+ */
+static void scope_unref(Walker *w, Scope *scope) {
+    while (scope && atomic_fetch_sub(&scope->refs, 1) == 1) {
+        Scope *parent = scope->parent;
+        if (w->release) w->release(scope->value, w->ctx);
+        free(scope);
+        scope = parent;
+    }
+}
+
+/* Wakes the idle workers after new tasks were queued or the walk finished */
+static void wake_idle(Walker *w) {
+    atomic_fetch_add(&w->work_gen, 1);
+    if (atomic_load(&w->sleepers) == 0) return;
+    pthread_mutex_lock(&w->idle_lock);
+    pthread_cond_broadcast(&w->idle_cond);
+    pthread_mutex_unlock(&w->idle_lock);
+}
+
+static void report_unreadable(Walker *w, const char *path, int err) {
+    char errmsg[4200];
+    snprintf(errmsg, sizeof(errmsg), "Unable to read directory '%s': %s", path, strerror(err));
+    print_error(errmsg);
+    atomic_fetch_add(&w->unreadable, 1);
+}
+
+static int is_vcs_dir(const char *name) {
+    return strcmp(name, ".git") == 0 || strcmp(name, ".hg") == 0 || strcmp(name, ".svn") == 0;
+}
+
+typedef struct {
+    size_t name_off;
+    unsigned char type;
+} RawEntry;
+
+typedef struct {
+    RawEntry *items;
+    size_t count, cap;
+} RawList;
+
+static int raw_push(RawList *list, size_t name_off, unsigned char type) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        RawEntry *grown = realloc(list->items, cap * sizeof(*grown));
+        if (!grown) return -1;
+        list->items = grown;
+        list->cap = cap;
+    }
+    list->items[list->count++] = (RawEntry){ name_off, type };
+    return 0;
+}
+
+static void process_dir(Walker *w, Deque *own, WalkTask *task) {
+    int fd = open(task->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        report_unreadable(w, task->path, errno);
+        return;
+    }
+
+    StrBuf names = {0};
+    RawList files = {0}, dirs = {0};
+    char *buf = malloc(DENTS_BUF_SIZE);
+    if (!buf) {
+        close(fd);
+        return;
+    }
+    long n;
+    size_t listed = 0;
+    TraceSpan span;
+    trace_begin(&span, TRACE_DIR_SCAN);
+    while ((n = syscall(SYS_getdents64, fd, buf, DENTS_BUF_SIZE)) > 0) {
+        listed += (size_t)n;
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            off += d->d_reclen;
+            const char *name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            unsigned char type = d->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+                type = S_ISREG(st.st_mode) ? DT_REG : S_ISDIR(st.st_mode) ? DT_DIR : DT_LNK;
+            }
+            if (type != DT_REG && type != DT_DIR) continue;
+            if (type == DT_DIR && is_vcs_dir(name)) continue;
+            size_t name_off = names.len;
+            if (sb_append(&names, name, strlen(name) + 1) != 0) continue;
+            raw_push(type == DT_REG ? &files : &dirs, name_off, type);
+        }
+    }
+    if (n < 0) report_unreadable(w, task->path, errno);
+    close(fd);
+    free(buf);
+    trace_end(&span, listed);
+
+    WalkEntry *entries = malloc((files.count ? files.count : 1) * sizeof(*entries));
+    const void *inherited = task->scope ? task->scope->value : NULL;
+    Scope *scope = task->scope, *own_scope = NULL;
+    if (entries) {
+        for (size_t i = 0; i < files.count; i++) {
+            entries[i].name = names.data + files.items[i].name_off;
+            entries[i].type = files.items[i].type;
+        }
+        const void *value = w->visit(task->path, entries, files.count, inherited, w->ctx);
+        free(entries);
+        if (value != inherited) {
+            own_scope = malloc(sizeof(*own_scope));
+            if (own_scope) {
+                own_scope->value = value;
+                own_scope->parent = scope;
+                atomic_init(&own_scope->refs, 1);
+                scope_ref(scope);
+                scope = own_scope;
+            } else if (w->release) {
+                /* Nowhere to keep it: the subdirectories inherit the parent's value */
+                w->release(value, w->ctx);
+            }
+        }
+    }
+
+    size_t dir_len = strlen(task->path);
+    size_t queued = 0;
+    int trailing = dir_len > 0 && task->path[dir_len - 1] == '/';
+    for (size_t i = 0; i < dirs.count; i++) {
+        const char *name = names.data + dirs.items[i].name_off;
+        size_t len = dir_len + 1 + strlen(name) + 1;
+        char *path = malloc(len);
+        if (!path) continue;
+        snprintf(path, len, trailing ? "%s%s" : "%s/%s", task->path, name);
+        atomic_fetch_add(&w->pending, 1);
+        scope_ref(scope);
+        if (deque_push(own, (WalkTask){ path, scope }) != 0) {
+            atomic_fetch_sub(&w->pending, 1);
+            scope_unref(w, scope);
+            free(path);
+        } else {
+            queued++;
+        }
+    }
+    scope_unref(w, own_scope);
+    if (queued > 0) wake_idle(w);
+    sb_free(&names);
+    free(files.items);
+    free(dirs.items);
+}
+
+static void *walk_worker(void *arg) {
+    Walker *w = arg;
+    int id = atomic_fetch_add(&w->next_id, 1);
+    Deque *own = &w->deques[id];
+    unsigned victim = (unsigned)id;
+    for (;;) {
+        unsigned long gen = atomic_load(&w->work_gen);
+        WalkTask task;
+        int got = deque_pop(own, &task);
+        for (int tries = 0; !got && tries < w->workers; tries++) {
+            victim = (victim + 1) % (unsigned)w->workers;
+            if ((int)victim != id) got = deque_steal(&w->deques[victim], &task);
+        }
+        if (got) {
+            process_dir(w, own, &task);
+            scope_unref(w, task.scope);
+            free(task.path);
+            if (atomic_fetch_sub(&w->pending, 1) == 1) wake_idle(w);
+            continue;
+        }
+        if (atomic_load(&w->pending) == 0) break;
+        /* Nothing to steal: sleep until a worker queues subdirectories or the
+         * last directory is done. sleepers is raised before work_gen is read
+         * again, so a push either sees a sleeper or is seen by it. */
+        pthread_mutex_lock(&w->idle_lock);
+        atomic_fetch_add(&w->sleepers, 1);
+        while (atomic_load(&w->work_gen) == gen && atomic_load(&w->pending) != 0) {
+            pthread_cond_wait(&w->idle_cond, &w->idle_lock);
+        }
+        atomic_fetch_sub(&w->sleepers, 1);
+        pthread_mutex_unlock(&w->idle_lock);
+    }
+    return NULL;
+}
+
+int walk_tree(const char *root, int threads, WalkVisit visit, WalkRelease release, void *ctx) {
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return -1;
+    }
+    if (threads <= 0) threads = pool_default_threads();
+
+    Walker w;
+    w.workers = threads;
+    w.visit = visit;
+    w.release = release;
+    w.ctx = ctx;
+    atomic_init(&w.pending, 1);
+    atomic_init(&w.next_id, 0);
+    atomic_init(&w.unreadable, 0);
+    atomic_init(&w.work_gen, 0);
+    atomic_init(&w.sleepers, 0);
+    w.deques = calloc((size_t)threads, sizeof(*w.deques));
+    char *root_copy = strdup(root);
+    if (!w.deques || !root_copy) {
+        free(w.deques);
+        free(root_copy);
+        return -1;
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&w.deques[i].lock, NULL);
+    }
+    pthread_mutex_init(&w.idle_lock, NULL);
+    pthread_cond_init(&w.idle_cond, NULL);
+    deque_push(&w.deques[0], (WalkTask){ root_copy, NULL });
+
+    pthread_t *tids = malloc((size_t)threads * sizeof(*tids));
+    int spawned = 0;
+    for (; tids && spawned < threads - 1; spawned++) {
+        if (pthread_create(&tids[spawned], NULL, walk_worker, &w) != 0) break;
+    }
+    walk_worker(&w);
+    for (int i = 0; i < spawned; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&w.deques[i].lock);
+        free(w.deques[i].items);
+    }
+    free(w.deques);
+    pthread_mutex_destroy(&w.idle_lock);
+    pthread_cond_destroy(&w.idle_cond);
+    long unreadable = atomic_load(&w.unreadable);
+    return unreadable > INT_MAX ? INT_MAX : (int)unreadable;
+}
+
+long walk_read_head(const char *dir, const char *name, char *buf, size_t size) {
+    char path[4096];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir, name) >= sizeof(path)) return -1;
+    TraceSpan span;
+    trace_begin(&span, TRACE_FILE_READ);
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        trace_end(&span, 0);
+        return -1;
+    }
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = read(fd, buf + total, size - total);
+        if (n <= 0) break;
+        total += (size_t)n;
+    }
+    close(fd);
+    trace_end(&span, total);
+    return (long)total;
+}
@@ -0,0 +1,51 @@
+/* File: src/walk.h
+ *
+ * Header for the parallel directory walker.
+ *
+ * Each directory is one task. Workers list directories with getdents64,
+ * hand the regular files to a visit callback and queue the subdirectories
+ * on their own deque; idle workers steal from the other end of a busy
+ * worker's deque, and sleep until more work is queued when there is none.
+ * Only pending directory paths are kept in memory, never the file lists of
+ * directories that have already been visited.
+ */
+
+#ifndef WALK_H
+#define WALK_H
+
+#include <stddef.h>
+
+typedef struct {
+    const char *name;
+    unsigned char type;     /* DT_REG, DT_DIR, ... (resolved when the filesystem reports DT_UNKNOWN) */
+} WalkEntry;
+
+/* Called once per directory with its regular files. inherited is the value
+ * returned by the visit of the parent directory (NULL for the root); the
+ * return value is handed to this directory's subdirectories and must stay
+ * valid until it is released. May run concurrently on several workers.
+ */
+typedef const void *(*WalkVisit)(const char *dir, const WalkEntry *files, size_t count,
+                                 const void *inherited, void *ctx);
+
+/* Called once for each value a visit returned other than the one it
+ * inherited, after the last directory below that inherits it is done.
+ * May run concurrently on several workers.
+ */
+typedef void (*WalkRelease)(const void *value, void *ctx);
+
+/* Walks the tree rooted at root on up to threads workers (threads <= 0 means
+ * one per CPU). release may be NULL when the visits return nothing to free.
+ * Symlinks are not followed and version-control directories (.git, .hg,
+ * .svn) are skipped. Directories that cannot be listed are reported on
+ * stderr and left out. Returns 0 on success, -1 if root cannot be opened, or
+ * the number of directories that could not be read.
+ */
+int walk_tree(const char *root, int threads, WalkVisit visit, WalkRelease release, void *ctx);
+
+/* Reads up to size bytes from the start of dir/name into buf without reading
+ * the rest of the file. Returns the number of bytes read, or -1 on error.
+ */
+long walk_read_head(const char *dir, const char *name, char *buf, size_t size);
+
+#endif /* WALK_H */
@@ -0,0 +1,448 @@
+/* File: src/watch.c
+ *
+ * Implementation of watch mode.
+ *
+ * Events only mark what changed: the config file, the manifest, the bundle or
+ * a license text by name. Once no event has arrived for WATCH_DEBOUNCE_MS, the
+ * changes are applied in one pass: the config is reloaded and compared key by
+ * key with the one in force, the template set is reopened (which also
+ * recompiles edited texts), every target's license is resolved again, and a
+ * target is rendered when its resolved license, the text of that license or
+ * one of the config keys it depends on changed.
+ */
+
+#define _GNU_SOURCE
+
+#include "watch.h"
+#include "batch.h"
+#include "bundle.h"
+#include "io.h"
+#include "template.h"
+#include "utils.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+/* Quiet time after the last event before the changes are applied */
+#define WATCH_DEBOUNCE_MS 150
+
+/* License texts remembered by name per pass; more mean "all changed" */
+#define WATCH_MAX_CHANGED 64
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+/* Dependency bits: one per slot field, then the keys every output reads */
+#define DEP_OUTPUT (1u << SUBST_FIELD_COUNT)    /* output, output_mode */
+#define DEP_TOKENS (DEP_OUTPUT << 1)            /* the compiled placeholders */
+
+typedef struct {
+    const char *dir;
+    const char *spec;       /* license as given; NULL: default_license */
+    const char *author;     /* NULL: config value */
+    const char *year;       /* NULL: config value */
+    int line;               /* manifest line, 0 without a manifest */
+    char license[64];       /* spec resolved through the aliases */
+    unsigned deps;          /* DEP_* and 1 << SubstField bits the output reads */
+    int rendered;           /* rendered at least once */
+    int due;
+} WatchTarget;
+
+typedef struct {
+    Database *db;
+    Config *config;
+    Config file;            /* the config file as last read, before command line overrides */
+    int keep_output, keep_mode;
+    int debug;
+    const char *manifest_path;
+    ManifestEntry *entries;
+    size_t entry_count;
+    WatchTarget *targets;
+    size_t count;
+    TemplateSet templates;
+    int have_templates;
+
+    int fd;
+    int wd_config, wd_manifest, wd_datadir, wd_licenses;
+    char config_name[256];
+    const char *manifest_name;
+
+    /* Pending changes, applied once events settle */
+    int reload_config, reload_manifest, reload_db, all;
+    char changed[WATCH_MAX_CHANGED][64];
+    size_t changed_count;
+} Watch;
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int has_pending(const Watch *w) {
+    return w->reload_config || w->reload_manifest || w->reload_db || w->all || w->changed_count;
+}
+
+static unsigned config_changes(const Config *a, const Config *b) {
+    unsigned changes = 0;
+    if (strcmp(a->year, b->year) != 0) changes |= 1u << SUBST_YEAR;
+    if (strcmp(a->author, b->author) != 0) changes |= 1u << SUBST_AUTHOR;
+    if (strcmp(a->project, b->project) != 0) changes |= 1u << SUBST_PROJECT;
+    if (strcmp(a->url, b->url) != 0) changes |= 1u << SUBST_URL;
+    if (strcmp(a->output, b->output) != 0 || a->output_mode != b->output_mode) changes |= DEP_OUTPUT;
+    if (a->token_count != b->token_count ||
+        memcmp(a->tokens, b->tokens, (size_t)a->token_count * sizeof(a->tokens[0])) != 0) {
+        changes |= DEP_TOKENS;
+    }
+    /* default_license and the aliases act through the resolved license names */
+    return changes;
+}
+
+static unsigned template_deps(const TemplateSet *set, const TemplateEntry *t) {
+    unsigned deps = 0;
+    for (uint32_t i = 0; i < t->op_count; i++) {
+        const TemplateOp *op = &set->ops[t->first_op + i];
+        if (op->kind != TEMPLATE_LITERAL) deps |= 1u << op->field;
+    }
+    return deps;
+}
+
+static int set_targets(Watch *w, ManifestEntry *entries, size_t count, const char *license) {
+    WatchTarget *targets = calloc(count ? count : 1, sizeof(*targets));
+    if (!targets) {
+        return -1;
+    }
+    if (!w->manifest_path) {
+        targets[0].dir = ".";
+        targets[0].spec = license;
+        count = 1;
+    }
+    for (size_t i = 0; w->manifest_path && i < count; i++) {
+        targets[i].dir = entries[i].dir;
+        targets[i].spec = entries[i].license;
+        targets[i].author = entries[i].author;
+        targets[i].year = entries[i].year;
+        targets[i].line = entries[i].line;
+    }
+    free(w->targets);
+    manifest_free(w->entries, w->entry_count);
+    w->targets = targets;
+    w->count = count;
+    w->entries = entries;
+    w->entry_count = entries ? count : 0;
+    return 0;
+}
+
+static int read_manifest(Watch *w) {
+    ManifestEntry *entries;
+    size_t count;
+    int rc = manifest_read(w->manifest_path, &entries, &count);
+    if (rc != 0) {
+        char errmsg[512];
+        snprintf(errmsg, sizeof(errmsg), rc == -1 ? "Unable to open manifest '%s'" : "Out of memory reading manifest '%s'",
+                 w->manifest_path);
+        print_error(errmsg);
+        manifest_free(entries, count);
+        return -1;
+    }
+    if (set_targets(w, entries, count, NULL) != 0) {
+        print_error("Out of memory reading manifest");
+        manifest_free(entries, count);
+        return -1;
+    }
+    return 0;
+}
+
+/* Rereads the config file, keeping output options given on the command line.
+ * Returns the keys that changed.
+ */
+static unsigned reload_config(Watch *w) {
+    Config fresh;
+    if (load_config(&fresh, w->debug) != 0) {
+        print_error("Unable to reload the configuration; keeping the previous one");
+        return 0;
+    }
+    w->file = fresh;
+    if (w->keep_output) snprintf(fresh.output, sizeof(fresh.output), "%s", w->config->output);
+    if (w->keep_mode) fresh.output_mode = w->config->output_mode;
+    unsigned changes = config_changes(w->config, &fresh);
+    /* Copied in place: the database keeps pointing at it for the site aliases */
+    *w->config = fresh;
+    return changes;
+}
+
+static void reopen_db(Watch *w) {
+    char datadir[sizeof(w->db->datadir)];
+    snprintf(datadir, sizeof(datadir), "%s", w->db->datadir);
+    db_close(w->db);
+    db_open(w->db, datadir);
+    db_use_site_aliases(w->db, w->config);
+    if (w->debug) {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Reopened '%s' (%s)", datadir, db_backend_name(w->db));
+        debug_print(msg);
+    }
+}
+
+static int license_changed(const Watch *w, const char *license) {
+    for (size_t i = 0; i < w->changed_count; i++) {
+        if (strcasecmp(w->changed[i], license) == 0) return 1;
+    }
+    return 0;
+}
+
+static void render(Watch *w, WatchTarget *t, const TemplateEntry *tmpl) {
+    const Config *config = w->config;
+    char path[4096];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", t->dir, config->output) >= sizeof(path)) {
+        printf("FAILED  %s (%s): path too long\n", t->dir, t->license);
+        return;
+    }
+    TemplateValues values;
+    template_values(&values, config, t->year, t->author);
+    struct iovec stack[64];
+    struct iovec *iov = tmpl->op_count <= 64 ? stack : malloc(tmpl->op_count * sizeof(*iov));
+    if (!iov) {
+        printf("FAILED  %s (%s): out of memory\n", path, t->license);
+        return;
+    }
+    size_t spans = template_iov(&w->templates, tmpl, &values, iov);
+    int rc = write_iov_to_file(path, iov, spans, config->output_mode);
+    if (iov != stack) free(iov);
+    if (rc == WRITE_FAILED) {
+        printf("FAILED  %s (%s): %s\n", path, t->license, strerror(errno));
+    } else if (rc == WRITE_DONE) {
+        printf("updated %s (%s)\n", path, t->license);
+    } else if (w->debug) {
+        char msg[4200];
+        snprintf(msg, sizeof(msg), "%s is up to date", path);
+        debug_print(msg);
+    }
+
+    t->deps = template_deps(&w->templates, tmpl) | DEP_OUTPUT | DEP_TOKENS;
+    if (t->author) t->deps &= ~(1u << SUBST_AUTHOR);
+    if (t->year) t->deps &= ~(1u << SUBST_YEAR);
+}
+
+/* Applies the pending changes and renders the targets they affect. */
+static void apply(Watch *w) {
+    unsigned changes = 0;
+    int all = w->all;
+    if (w->have_templates) {
+        template_set_close(&w->templates);
+        w->have_templates = 0;
+    }
+    if (w->reload_config) changes |= reload_config(w);
+    if (w->reload_db) {
+        reopen_db(w);
+        all = 1;
+    } else if (w->reload_config) {
+        db_use_site_aliases(w->db, w->config);
+    }
+    if (w->reload_manifest && read_manifest(w) == 0) all = 1;
+    w->reload_config = w->reload_manifest = w->reload_db = w->all = 0;
+
+    if (template_set_open(&w->templates, w->db, w->config) != 0) {
+        print_error("Unable to compile the license templates");
+        w->changed_count = 0;
+        return;
+    }
+    w->have_templates = 1;
+
+    for (size_t i = 0; i < w->count; i++) {
+        WatchTarget *t = &w->targets[i];
+        const char *spec = t->spec ? t->spec : w->config->default_license;
+        char license[64];
+        if (db_resolve_alias(w->db, spec, license, sizeof(license)) != 0) {
+            snprintf(license, sizeof(license), "%s", spec);
+        }
+        t->due = all || !t->rendered || (t->deps & changes) || strcasecmp(license, t->license) != 0 ||
+                 license_changed(w, license);
+        snprintf(t->license, sizeof(t->license), "%s", license);
+        if (t->due) template_get(&w->templates, t->license);
+    }
+    w->changed_count = 0;
+
+    /* template_get() may have recompiled the set, so entries are looked up afterwards */
+    for (size_t i = 0; i < w->count; i++) {
+        WatchTarget *t = &w->targets[i];
+        if (!t->due) continue;
+        t->rendered = 1;
+        t->deps = DEP_OUTPUT | DEP_TOKENS;
+        const TemplateEntry *tmpl = template_find(&w->templates, t->license);
+        if (!t->dir) {
+            printf("FAILED  line %d: missing target directory\n", t->line);
+        } else if (t->license[0] == '\0') {
+            printf("FAILED  %s: no license given and no default_license in config\n", t->dir);
+        } else if (!tmpl) {
+            printf("FAILED  %s (%s): license not found\n", t->dir, t->license);
+        } else {
+            render(w, t, tmpl);
+        }
+    }
+    fflush(stdout);
+}
+
+static void note_license(Watch *w, const char *name) {
+    size_t len = strlen(name);
+    if (len <= 4 || name[0] == '.' || strcmp(name + len - 4, ".txt") != 0) return;
+    if (len - 4 >= sizeof(w->changed[0]) || w->changed_count == WATCH_MAX_CHANGED) {
+        w->all = 1;
+        return;
+    }
+    memcpy(w->changed[w->changed_count], name, len - 4);
+    w->changed[w->changed_count][len - 4] = '\0';
+    w->changed_count++;
+}
+
+static void read_events(Watch *w) {
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = read(w->fd, buf, sizeof(buf))) > 0) {
+        const struct inotify_event *ev;
+        for (char *p = buf; p < buf + n; p += sizeof(*ev) + ev->len) {
+            ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                /* Events were lost: assume everything changed */
+                w->reload_config = w->all = 1;
+                w->reload_manifest = w->wd_manifest >= 0;
+                continue;
+            }
+            if (ev->len == 0) continue;
+            if (w->debug) {
+                char msg[512];
+                snprintf(msg, sizeof(msg), "Event 0x%x on '%s'", (unsigned)ev->mask, ev->name);
+                debug_print(msg);
+            }
+            /* Two watched paths may share a directory, so every match is checked */
+            if (ev->wd == w->wd_config && strcmp(ev->name, w->config_name) == 0) w->reload_config = 1;
+            if (ev->wd == w->wd_manifest && strcmp(ev->name, w->manifest_name) == 0) w->reload_manifest = 1;
+            if (ev->wd == w->wd_datadir && strcmp(ev->name, BUNDLE_FILENAME) == 0) w->reload_db = 1;
+            if (ev->wd == w->wd_licenses) note_license(w, ev->name);
+        }
+    }
+}
+
+/* Watches the directory holding path and sets *name to the file name in it. */
+static int watch_parent(Watch *w, const char *path, const char **name) {
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+        *name = path;
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", slash == path ? 1 : (int)(slash - path), path);
+        *name = slash + 1;
+    }
+    return inotify_add_watch(w->fd, dir, WATCH_EVENTS);
+}
+
+static int watch_start(Watch *w) {
+    w->wd_config = w->wd_manifest = w->wd_datadir = w->wd_licenses = -1;
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd < 0) {
+        print_error("Unable to initialize inotify");
+        return -1;
+    }
+    char path[4096];
+    const char *name;
+    config_file_path(path, sizeof(path));
+    w->wd_config = watch_parent(w, path, &name);
+    snprintf(w->config_name, sizeof(w->config_name), "%s", name);
+    if (w->wd_config < 0) {
+        char errmsg[4200];
+        snprintf(errmsg, sizeof(errmsg), "Unable to watch the config file '%s'", path);
+        print_error(errmsg);
+        return -1;
+    }
+    /* A manifest read from stdin is read once */
+    if (w->manifest_path && strcmp(w->manifest_path, "-") != 0 &&
+        (w->wd_manifest = watch_parent(w, w->manifest_path, &w->manifest_name)) < 0) {
+        char errmsg[4200];
+        snprintf(errmsg, sizeof(errmsg), "Unable to watch the manifest '%s'", w->manifest_path);
+        print_error(errmsg);
+        return -1;
+    }
+    /* The embedded database never changes; a bundle may appear over loose files */
+    if (w->db->backend != DB_BACKEND_EMBEDDED) {
+        w->wd_datadir = inotify_add_watch(w->fd, w->db->datadir, WATCH_EVENTS);
+        snprintf(path, sizeof(path), "%s/licenses", w->db->datadir);
+        w->wd_licenses = inotify_add_watch(w->fd, path, WATCH_EVENTS);
+        if (w->wd_datadir < 0 && w->wd_licenses < 0) {
+            char errmsg[4200];
+            snprintf(errmsg, sizeof(errmsg), "Unable to watch the data directory '%s'", w->db->datadir);
+            print_error(errmsg);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int run_watch(const char *manifest_path, const char *license, Database *db, Config *config, int debug) {
+    Watch *w = calloc(1, sizeof(*w));
+    if (!w) {
+        print_error("Out of memory");
+        return -1;
+    }
+    w->db = db;
+    w->config = config;
+    w->debug = debug;
+    w->manifest_path = manifest_path;
+    w->fd = -1;
+    int rc = -1;
+
+    /* Output options that differ from the file were given on the command line and stay */
+    if (load_config(&w->file, debug) != 0) {
+        print_error("Failed to load configuration");
+        goto out;
+    }
+    w->keep_output = strcmp(w->file.output, config->output) != 0;
+    w->keep_mode = w->file.output_mode != config->output_mode;
+
+    if ((manifest_path ? read_manifest(w) : set_targets(w, NULL, 0, license)) != 0 || watch_start(w) != 0) {
+        goto out;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    w->all = 1;
+    apply(w);
+    printf("Watching %zu output%s; press Ctrl-C to stop.\n", w->count, w->count == 1 ? "" : "s");
+    fflush(stdout);
+
+    rc = 0;
+    while (!stop_requested) {
+        struct pollfd pfd = { w->fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, has_pending(w) ? WATCH_DEBOUNCE_MS : -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            print_error("Unable to wait for changes");
+            rc = -1;
+            break;
+        }
+        if (ready > 0) {
+            read_events(w);
+        } else {
+            apply(w);
+        }
+    }
+
+out:
+    if (w->fd >= 0) close(w->fd);
+    if (w->have_templates) template_set_close(&w->templates);
+    free(w->targets);
+    manifest_free(w->entries, w->entry_count);
+    free(w);
+    return rc;
+}
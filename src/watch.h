@@ -0,0 +1,32 @@
+/* File: src/watch.h
+ *
+ * Header for watch mode (--watch), which keeps generated LICENSE files in
+ * sync with the config and the license data.
+ *
+ * Every output is rendered once on start and its dependencies are recorded:
+ * the license template it was rendered from and the config keys it reads
+ * (the slot fields its template uses, default_license when no license was
+ * given, output and output_mode, the placeholder tokens and the aliases).
+ * inotify then reports writes to the config file, the license texts, the
+ * bundle and the manifest; a burst of events is collected until it settles,
+ * and only the outputs whose dependencies changed are rendered again. Writes
+ * go through write_iov_to_file(), so a file whose text did not change is not
+ * touched.
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "config.h"
+#include "db.h"
+
+/* Watches the outputs listed in the manifest at manifest_path, or, when it is
+ * NULL, the single output in the current directory rendered from license (NULL
+ * means the config's default_license). Runs until SIGINT or SIGTERM and
+ * prints every file it rewrites. db is reopened when the bundle changes, and
+ * config is reloaded in place, so both must be writable. Returns 0 on a clean
+ * stop, -1 if watching could not start.
+ */
+int run_watch(const char *manifest_path, const char *license, Database *db, Config *config, int debug);
+
+#endif /* WATCH_H */
@@ -0,0 +1,43 @@
+#!/bin/sh
+# File: tests/bump.sh
+# Checks that --bump-year only moves the years that follow a copyright marker
+# and leaves the text of a license (the FSF's notice in the GPL, the WIPO
+# treaty date) and years elsewhere on a line alone.
+# Usage: tests/bump.sh <osla binary>
+
+OSLA=${1:-./osla}
+case $OSLA in /*) ;; *) OSLA=$(pwd)/$OSLA ;; esac
+
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+mkdir -p "$WORK/home/.config" "$WORK/tree"
+export HOME="$WORK/home"
+export OSLA_DATADIR="${OSLA_DATADIR:-$(pwd)}"
+
+failures=0
+check() {
+    if [ "$2" != "$3" ]; then
+        echo "FAIL: $1: expected '$3', got '$2'"
+        failures=$((failures + 1))
+    fi
+}
+
+"$OSLA" gpl-3.0 --stdout > "$WORK/gpl.txt" || exit 1
+{ printf 'Copyright (C) 2019-2025 Jane Roe\n\n'; cat "$WORK/gpl.txt"; } > "$WORK/tree/LICENSE"
+printf 'int y = 2025; // Copyright notice year 2025\n' > "$WORK/tree/code.c"
+printf '// Copyright (c) 2025 Jane Roe\n// SPDX-FileCopyrightText: 2019, 2021 - 2024 Jane Roe\n' > "$WORK/tree/head.c"
+
+"$OSLA" --bump-year "$WORK/tree" 2026 > "$WORK/out" 2>&1
+check "exit status" "$?" 0
+
+check "LICENSE holder line" "$(sed -n 1p "$WORK/tree/LICENSE")" "Copyright (C) 2019-2026 Jane Roe"
+check "LICENSE text" "$(sed 1,2d "$WORK/tree/LICENSE" | cmp -s - "$WORK/gpl.txt" && echo same)" "same"
+check "code.c" "$(cat "$WORK/tree/code.c")" "int y = 2025; // Copyright notice year 2025"
+check "head.c line 1" "$(sed -n 1p "$WORK/tree/head.c")" "// Copyright (c) 2025-2026 Jane Roe"
+check "head.c line 2" "$(sed -n 2p "$WORK/tree/head.c")" "// SPDX-FileCopyrightText: 2019, 2021 - 2026 Jane Roe"
+
+if [ "$failures" -ne 0 ]; then
+    cat "$WORK/out"
+    exit 1
+fi
+echo "bump: all checks passed"
@@ -0,0 +1,50 @@
+#!/bin/sh
+# File: tests/headers.sh
+# Checks that --apply-headers keeps the bytes that must stay first in a file
+# (UTF-8 byte order mark, "#!" line, encoding declaration) ahead of the header.
+# Usage: tests/headers.sh <osla binary>
+
+OSLA=${1:-./osla}
+case $OSLA in /*) ;; *) OSLA=$(pwd)/$OSLA ;; esac
+
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+mkdir -p "$WORK/home/.config" "$WORK/tree"
+export HOME="$WORK/home"
+export OSLA_DATADIR="${OSLA_DATADIR:-$(pwd)}"
+
+failures=0
+check() {
+    if [ "$2" != "$3" ]; then
+        echo "FAIL: $1: expected '$3', got '$2'"
+        failures=$((failures + 1))
+    fi
+}
+
+bom=$(printf '\357\273\277')
+printf '%sint main(void) { return 0; }\n' "$bom" > "$WORK/tree/bom.c"
+printf '%s#!/usr/bin/env python3\n# -*- coding: utf-8 -*-\nprint(1)\n' "$bom" > "$WORK/tree/bom.py"
+printf '%s' "$bom" > "$WORK/tree/bom.sh"
+printf '#!/bin/sh\necho hi\n' > "$WORK/tree/plain.sh"
+
+"$OSLA" --apply-headers "$WORK/tree" MIT > "$WORK/out" 2>&1
+check "exit status" "$?" 0
+
+check "bom.c first line" "$(sed -n 1p "$WORK/tree/bom.c")" "$bom/*"
+check "bom.c SPDX line" "$(sed -n 2p "$WORK/tree/bom.c")" " * SPDX-License-Identifier: MIT"
+check "bom.py shebang" "$(sed -n 1p "$WORK/tree/bom.py")" "$bom#!/usr/bin/env python3"
+check "bom.py coding" "$(sed -n 2p "$WORK/tree/bom.py")" "# -*- coding: utf-8 -*-"
+check "bom.py SPDX line" "$(sed -n 3p "$WORK/tree/bom.py")" "# SPDX-License-Identifier: MIT"
+check "bom.sh SPDX line" "$(sed -n 1p "$WORK/tree/bom.sh")" "$bom# SPDX-License-Identifier: MIT"
+check "plain.sh shebang" "$(sed -n 1p "$WORK/tree/plain.sh")" "#!/bin/sh"
+check "plain.sh SPDX line" "$(sed -n 2p "$WORK/tree/plain.sh")" "# SPDX-License-Identifier: MIT"
+
+# A second run finds the headers behind the byte order mark
+"$OSLA" --apply-headers "$WORK/tree" MIT > "$WORK/out" 2>&1
+check "second run" "$(cat "$WORK/out")" "Added headers to 0 files (4 already present, 0 skipped, 0 failed)."
+
+if [ "$failures" -ne 0 ]; then
+    cat "$WORK/out"
+    exit 1
+fi
+echo "headers: all checks passed"
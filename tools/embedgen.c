@@ -0,0 +1,199 @@
+/* File: tools/embedgen.c
+ *
+ * Build-time generator for the embedded license database (make EMBED=1).
+ *
+ * Usage: embedgen <licenses_dir> <descriptions_dir> <output.c>
+ *
+ * Emits a C file defining embed_pool, embed_index, embed_count and embed_dict
+ * as declared in src/embed.h. Identical strings are stored once in the pool,
+ * and license texts are compressed against a dictionary trained on them.
+ */
+
+#define _GNU_SOURCE
+
+#include "dict.h"
+#include "embed.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *name;
+    uint32_t name_off;
+    uint32_t data_off;
+    uint32_t size;
+    uint32_t packed;
+} GenEntry;
+
+typedef struct {
+    GenEntry *items;
+    size_t count;
+} GenList;
+
+static StrBuf pool;
+static DictPack pack;
+
+/* Interned strings, for deduplication. Linear search is fine at build time. */
+static struct { char *str; size_t len; uint32_t off; } *interned;
+static size_t interned_count;
+
+static uint32_t intern(const char *str, size_t len) {
+    for (size_t i = 0; i < interned_count; i++) {
+        if (interned[i].len == len && memcmp(interned[i].str, str, len) == 0) {
+            return interned[i].off;
+        }
+    }
+    uint32_t off = (uint32_t)pool.len;
+    unsigned char prefix[4] = {
+        (unsigned char)(len & 0xff), (unsigned char)((len >> 8) & 0xff),
+        (unsigned char)((len >> 16) & 0xff), (unsigned char)((len >> 24) & 0xff)
+    };
+    if (sb_append(&pool, (const char *)prefix, 4) != 0 ||
+        sb_append(&pool, str, len) != 0 ||
+        sb_append(&pool, "", 1) != 0) {
+        fprintf(stderr, "embedgen: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    interned = realloc(interned, (interned_count + 1) * sizeof(*interned));
+    if (!interned) {
+        fprintf(stderr, "embedgen: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    interned[interned_count].str = malloc(len);
+    memcpy(interned[interned_count].str, str, len);
+    interned[interned_count].len = len;
+    interned[interned_count].off = off;
+    interned_count++;
+    return off;
+}
+
+static int compare_gen(const void *a, const void *b) {
+    return strcasecmp(((const GenEntry *)a)->name, ((const GenEntry *)b)->name);
+}
+
+static void add_dir(GenList *list, const char *dir, const char *suffix, int compress) {
+    char **names;
+    size_t count;
+    if (list_dir_stems(dir, suffix, &names, &count) != 0) {
+        fprintf(stderr, "embedgen: cannot read %s\n", dir);
+        exit(EXIT_FAILURE);
+    }
+    list->items = calloc(count ? count : 1, sizeof(*list->items));
+    char **texts = calloc(count ? count : 1, sizeof(*texts));
+    size_t *lens = calloc(count ? count : 1, sizeof(*lens));
+    if (!list->items || !texts || !lens) {
+        fprintf(stderr, "embedgen: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s%s", dir, names[i], suffix);
+        texts[i] = read_file(path, &lens[i]);
+        if (!texts[i]) {
+            fprintf(stderr, "embedgen: cannot read %s\n", path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (compress && dict_pack(&pack, (const char *const *)texts, lens, count) != 0) {
+        fprintf(stderr, "embedgen: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; i++) {
+        GenEntry *e = &list->items[i];
+        e->name = strdup(names[i]);
+        e->name_off = intern(names[i], strlen(names[i]));
+        e->size = (uint32_t)lens[i];
+        if (compress && pack.packed[i].len) {
+            e->data_off = intern(pack.packed[i].data, pack.packed[i].len);
+            e->packed = 1;
+        } else {
+            e->data_off = intern(texts[i], lens[i]);
+        }
+        free(texts[i]);
+    }
+    free(texts);
+    free(lens);
+    list->count = count;
+    free_names(names, count);
+    qsort(list->items, list->count, sizeof(*list->items), compare_gen);
+}
+
+static void add_aliases(GenList *list) {
+    static const char *const aliases[][2] = {
+#define OSLA_ALIAS(alias, name) { alias, name },
+#include "aliases.def"
+#undef OSLA_ALIAS
+    };
+    size_t count = sizeof(aliases) / sizeof(aliases[0]);
+    list->items = calloc(count, sizeof(*list->items));
+    for (size_t i = 0; i < count; i++) {
+        list->items[i].name = aliases[i][0];
+        list->items[i].name_off = intern(aliases[i][0], strlen(aliases[i][0]));
+        list->items[i].data_off = intern(aliases[i][1], strlen(aliases[i][1]));
+        list->items[i].size = (uint32_t)strlen(aliases[i][1]);
+    }
+    list->count = count;
+    qsort(list->items, list->count, sizeof(*list->items), compare_gen);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <licenses_dir> <descriptions_dir> <output.c>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    GenList lists[EMBED_KIND_COUNT] = {{0}};
+    add_dir(&lists[EMBED_LICENSE], argv[1], ".txt", 1);
+    add_dir(&lists[EMBED_DESCRIPTION], argv[2], ".desc", 0);
+    add_aliases(&lists[EMBED_ALIAS]);
+
+    FILE *out = fopen(argv[3], "w");
+    if (!out) {
+        fprintf(stderr, "embedgen: cannot write %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "/* Generated by tools/embedgen.c -- do not edit. */\n\n");
+    fprintf(out, "#include \"embed.h\"\n\n");
+    fprintf(out, "const unsigned char embed_pool[%zu] = {", pool.len ? pool.len : 1);
+    for (size_t i = 0; i < pool.len; i++) {
+        fprintf(out, "%s%u,", (i % 24) ? "" : "\n", (unsigned char)pool.data[i]);
+    }
+    fprintf(out, "%s\n};\n\n", pool.len ? "" : "0");
+    fprintf(out, "const unsigned char embed_dict[%zu] = {", pack.dict.len ? pack.dict.len : 1);
+    for (size_t i = 0; i < pack.dict.len; i++) {
+        fprintf(out, "%s%u,", (i % 24) ? "" : "\n", (unsigned char)pack.dict.data[i]);
+    }
+    fprintf(out, "%s\n};\n\nconst uint32_t embed_dict_len = %zu;\n\n", pack.dict.len ? "" : "0", pack.dict.len);
+
+    static const char *const kind_names[] = { "licenses", "descriptions", "aliases" };
+    for (int k = 0; k < EMBED_KIND_COUNT; k++) {
+        fprintf(out, "static const EmbedEntry embed_%s[] = {\n", kind_names[k]);
+        for (size_t i = 0; i < lists[k].count; i++) {
+            const GenEntry *e = &lists[k].items[i];
+            fprintf(out, "    { %u, %u, %u, %u }, /* %s */\n", e->name_off, e->data_off, e->size, e->packed, e->name);
+        }
+        if (lists[k].count == 0) {
+            fprintf(out, "    { 0, 0, 0, 0 }\n");
+        }
+        fprintf(out, "};\n\n");
+    }
+    fprintf(out, "const EmbedEntry *const embed_index[EMBED_KIND_COUNT] = {\n");
+    for (int k = 0; k < EMBED_KIND_COUNT; k++) {
+        fprintf(out, "    embed_%s,\n", kind_names[k]);
+    }
+    fprintf(out, "};\n\nconst uint32_t embed_count[EMBED_KIND_COUNT] = {");
+    for (int k = 0; k < EMBED_KIND_COUNT; k++) {
+        fprintf(out, " %zu%s", lists[k].count, k + 1 < EMBED_KIND_COUNT ? "," : " ");
+    }
+    fprintf(out, "};\n");
+    if (fclose(out) != 0) {
+        fprintf(stderr, "embedgen: failed writing %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "embedgen: %zu licenses, %zu descriptions, %zu aliases, %zu pool bytes, %zu dictionary bytes\n",
+            lists[EMBED_LICENSE].count, lists[EMBED_DESCRIPTION].count,
+            lists[EMBED_ALIAS].count, pool.len, pack.dict.len);
+    dict_print_stats(&pack.stats, "embedgen: licenses", stderr);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/* File: tools/namegen.c
+ *
+ * Build-time generator for the license name table (see src/names.h).
+ *
+ * Usage: namegen <licenses_dir> <output.c>
+ *
+ * Keys are the license names found in licenses_dir, the aliases from
+ * aliases.def and the SPDX identifiers from licenses.def. Keys that differ
+ * only in case are kept once, preferring a license name over an alias over an
+ * SPDX identifier. Buckets are seeded largest first; the first seed that sends
+ * every key of a bucket to a free slot is kept.
+ */
+
+#define _GNU_SOURCE
+
+#include "names.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Average keys per bucket */
+#define BUCKET_LOAD 4
+#define MAX_SEED (1u << 24)
+
+static const char *const aliases[][2] = {
+#define OSLA_ALIAS(alias, name) { alias, name },
+#include "aliases.def"
+#undef OSLA_ALIAS
+};
+#define ALIAS_COUNT (sizeof(aliases) / sizeof(aliases[0]))
+
+static const char *const spdx_ids[][2] = {
+#define OSLA_LICENSE(name, spdx, category, flags) { name, spdx },
+#include "licenses.def"
+#undef OSLA_LICENSE
+};
+#define SPDX_COUNT (sizeof(spdx_ids) / sizeof(spdx_ids[0]))
+
+typedef struct {
+    const char *key;
+    const char *license;
+    NameKind kind;
+    uint64_t hash;
+} Key;
+
+static Key *keys;
+static size_t key_count, key_cap;
+
+static void die(const char *message, const char *arg) {
+    fprintf(stderr, "namegen: %s%s\n", message, arg ? arg : "");
+    exit(EXIT_FAILURE);
+}
+
+static void add_key(const char *key, const char *license, NameKind kind) {
+    for (size_t i = 0; i < key_count; i++) {
+        if (strcasecmp(keys[i].key, key) == 0) return;
+    }
+    if (key_count == key_cap) {
+        key_cap = key_cap ? key_cap * 2 : 64;
+        keys = realloc(keys, key_cap * sizeof(*keys));
+        if (!keys) die("out of memory", NULL);
+    }
+    keys[key_count++] = (Key){ key, license, kind, hash_casefold(key, strlen(key)) };
+}
+
+static const char *alias_of(const char *license) {
+    for (size_t i = 0; i < ALIAS_COUNT; i++) {
+        if (strcmp(aliases[i][1], license) == 0) {
+            return aliases[i][0];
+        }
+    }
+    return NULL;
+}
+
+static const char *spdx_of(const char *license) {
+    for (size_t i = 0; i < SPDX_COUNT; i++) {
+        if (strcmp(spdx_ids[i][0], license) == 0) return spdx_ids[i][1];
+    }
+    return NULL;
+}
+
+static void emit_string(FILE *out, const char *s) {
+    if (!s) {
+        fputs("NULL", out);
+        return;
+    }
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+typedef struct {
+    uint32_t bucket;
+    uint32_t size;
+} BucketOrder;
+
+static int compare_buckets(const void *a, const void *b) {
+    const BucketOrder *x = a, *y = b;
+    if (x->size != y->size) return x->size > y->size ? -1 : 1;
+    return x->bucket < y->bucket ? -1 : x->bucket > y->bucket;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <licenses_dir> <output.c>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    char **names;
+    size_t name_count;
+    if (list_dir_stems(argv[1], ".txt", &names, &name_count) != 0) die("cannot read ", argv[1]);
+    for (size_t i = 0; i < name_count; i++) add_key(names[i], names[i], NAME_LICENSE);
+    for (size_t i = 0; i < ALIAS_COUNT; i++) add_key(aliases[i][1], aliases[i][1], NAME_LICENSE);
+    for (size_t i = 0; i < SPDX_COUNT; i++) add_key(spdx_ids[i][0], spdx_ids[i][0], NAME_LICENSE);
+    for (size_t i = 0; i < ALIAS_COUNT; i++) add_key(aliases[i][0], aliases[i][1], NAME_ALIAS);
+    for (size_t i = 0; i < SPDX_COUNT; i++) add_key(spdx_ids[i][1], spdx_ids[i][0], NAME_SPDX);
+
+    uint32_t n = (uint32_t)key_count;
+    uint32_t buckets = n ? (n + BUCKET_LOAD - 1) / BUCKET_LOAD : 1;
+    uint32_t *seeds = calloc(buckets, sizeof(*seeds));
+    int32_t *slot_key = malloc((n ? n : 1) * sizeof(*slot_key));
+    BucketOrder *order = calloc(buckets, sizeof(*order));
+    uint32_t *members = malloc((n ? n : 1) * sizeof(*members));
+    uint32_t *slots = malloc((n ? n : 1) * sizeof(*slots));
+    if (!seeds || !slot_key || !order || !members || !slots) die("out of memory", NULL);
+    for (uint32_t i = 0; i < n; i++) slot_key[i] = -1;
+    for (uint32_t b = 0; b < buckets; b++) order[b].bucket = b;
+    for (uint32_t i = 0; i < n; i++) order[name_bucket(keys[i].hash, buckets)].size++;
+    qsort(order, buckets, sizeof(*order), compare_buckets);
+
+    for (uint32_t o = 0; o < buckets && order[o].size > 0; o++) {
+        uint32_t b = order[o].bucket, m = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            if (name_bucket(keys[i].hash, buckets) == b) members[m++] = i;
+        }
+        uint32_t seed;
+        for (seed = 1; seed < MAX_SEED; seed++) {
+            uint32_t ok = 1;
+            for (uint32_t j = 0; j < m && ok; j++) {
+                slots[j] = (uint32_t)(name_mix(keys[members[j]].hash, seed) % n);
+                if (slot_key[slots[j]] >= 0) ok = 0;
+                for (uint32_t k = 0; k < j && ok; k++) {
+                    if (slots[k] == slots[j]) ok = 0;
+                }
+            }
+            if (ok) break;
+        }
+        if (seed == MAX_SEED) die("no perfect hash found", NULL);
+        seeds[b] = seed;
+        for (uint32_t j = 0; j < m; j++) slot_key[slots[j]] = (int32_t)members[j];
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out) die("cannot write ", argv[2]);
+    fprintf(out, "/* Generated by tools/namegen.c -- do not edit. */\n\n");
+    fprintf(out, "#include \"names.h\"\n\n");
+    fprintf(out, "const uint32_t name_entry_count = %u;\n", n);
+    fprintf(out, "const uint32_t name_bucket_count = %u;\n\n", buckets);
+    fprintf(out, "const uint32_t name_seeds[%u] = {", buckets);
+    for (uint32_t b = 0; b < buckets; b++) {
+        fprintf(out, "%s%u,", (b % 12) ? " " : "\n    ", seeds[b]);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "const NameEntry name_entries[%u] = {\n", n ? n : 1);
+    for (uint32_t s = 0; s < n; s++) {
+        const Key *k = &keys[slot_key[s]];
+        fprintf(out, "    { ");
+        emit_string(out, k->key);
+        fputs(", ", out);
+        emit_string(out, k->license);
+        fputs(", ", out);
+        emit_string(out, alias_of(k->license));
+        fputs(", ", out);
+        emit_string(out, spdx_of(k->license));
+        fprintf(out, ", %s },\n", k->kind == NAME_LICENSE ? "NAME_LICENSE" : k->kind == NAME_ALIAS ? "NAME_ALIAS" : "NAME_SPDX");
+    }
+    if (n == 0) fprintf(out, "    { NULL, NULL, NULL, NULL, NAME_LICENSE },\n");
+    fprintf(out, "};\n");
+    if (fclose(out) != 0) die("cannot write ", argv[2]);
+
+    free_names(names, name_count);
+    free(keys);
+    free(seeds);
+    free(slot_key);
+    free(order);
+    free(members);
+    free(slots);
+    return EXIT_SUCCESS;
+}